@@ -23,6 +23,24 @@ azalea_dev_folder = '/home/martin/azalea_dev'
 # Valgrind.
 test_attempt_mem_leak_check = False
 
+# Should the kernel count the system calls made by each process, and how long they take? The results can be read from
+# the "syscalls" file of each process in proc. This adds a little time to every system call, so it is off by default.
+kernel_syscall_stats = False
+
+# Should the kernel record binary trace events? These are stored in memory as they happen, and can be read from the
+# "trace" file in proc and decoded with build_support/exec_trace.py. Function entry and exit are recorded in binary
+# form for any file with tracing enabled.
+kernel_binary_tracing = False
+
+# If binary tracing is enabled, should a kernel thread write the records to the trace output (normally the serial
+# port) as they arrive? If so, they are no longer available from proc.
+kernel_binary_trace_output = False
+
+# Should every kernel source file be built with tracepoints, so that trace output can be turned on while the system is
+# running? Output is chosen by subsystem and level by writing to the "trace_control" file in proc - for example,
+# "mem flow" or "all off". Each disabled tracepoint costs a test and a branch, so this is best left off in normal use.
+kernel_runtime_tracing = False
+
 # Folder that is the root of a filesystem for an Azalea system - imagine that if you were running Linux, it would be a
 # folder you could chroot too. When built, the important system files end up here. If you choose to construct a virtual
 # machine disk image using `scons make_image` then any file in this folder will end up in that image.
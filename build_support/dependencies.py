@@ -53,6 +53,14 @@ echo_program = [
     '#user/echo/SConscript',
   ]
 
+ipc_bench_program = [
+    '#user/ipc_bench/SConscript',
+  ]
+
+syscall_bench_program = [
+    '#user/syscall_bench/SConscript',
+  ]
+
 user_mode_api = [
     '#user/libs/libazalea/SConscript',
     '#kernel/syscall/SConscript-user',
@@ -71,6 +79,7 @@ main_tests = [
     '#kernel/object_mgr/SConscript',
     '#kernel/syscall/SConscript-kernel',
     '#kernel/system_tree/SConscript',
+    '#kernel/system_tree/process/SConscript',
     '#test/SConscript-main',
     '#test/dummy_libs/core_mem/SConscript',
     '#test/dummy_libs/panic/SConscript',
@@ -1,4 +1,23 @@
 
+import bisect
+import struct
+import sys
+
+# Binary trace records, as defined by kl_trc_record in kernel/klib/tracing/trace_binary.h: timestamp, event ID,
+# processor ID, a reserved field and four arguments.
+RECORD_FORMAT = "<QHHI4Q"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+# Records written to the trace output by the kernel are preceded by this and followed by a 32-bit checksum.
+FRAME_MAGIC = b"AZTR"
+CHECKSUM_FORMAT = "<I"
+FRAME_SIZE = len(FRAME_MAGIC) + RECORD_SIZE + struct.calcsize(CHECKSUM_FORMAT)
+
+# Must match TRC_EVENT in kernel/klib/tracing/trace_binary.h
+EVENT_FN_ENTRY = 1
+EVENT_FN_EXIT = 2
+EVENT_THREAD_SWITCH = 3
+
 def main(trace_file, map_file, output_file):
   (map_dict, map_offsets) = read_map_file(map_file)
   
@@ -19,8 +38,7 @@ def read_map_file(map_file):
     if results is not None:
       map_dict[results[0]] = results[1]
       
-  keys = map_dict.keys()
-  keys.sort()
+  keys = sorted(map_dict.keys())
   
   return (map_dict, keys)
 
@@ -91,8 +109,89 @@ def interpret_map_line(map_file_line):
   results = (symbol_addr, fn_decl)
   return results
 
+def binary_main(trace_file, map_file, output_file, raw):
+  (map_dict, map_offsets) = read_map_file(map_file)
+  data = trace_file.read()
+
+  if raw:
+    records = read_raw_records(data)
+  else:
+    (records, bad_frames) = read_framed_records(data)
+    if bad_frames != 0:
+      output_file.write("# {0} damaged records discarded\n".format(bad_frames))
+
+  process_binary_records(map_dict, map_offsets, records, output_file)
+
+def read_raw_records(data):
+  # Records read from proc are stored one after another, with no framing.
+  records = [ ]
+  for pos in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+    records.append(struct.unpack_from(RECORD_FORMAT, data, pos))
+
+  return records
+
+def read_framed_records(data):
+  # Records from the trace output may be mixed in with text tracing. Find each frame, and check that nothing has been
+  # mixed in to it using the checksum - the sum of the record's 32-bit words.
+  records = [ ]
+  bad_frames = 0
+  pos = data.find(FRAME_MAGIC)
+
+  while (pos >= 0) and (pos + FRAME_SIZE <= len(data)):
+    record_start = pos + len(FRAME_MAGIC)
+    words = struct.unpack_from("<{0}I".format(RECORD_SIZE // 4), data, record_start)
+    (checksum,) = struct.unpack_from(CHECKSUM_FORMAT, data, record_start + RECORD_SIZE)
+
+    if (sum(words) & 0xFFFFFFFF) == checksum:
+      records.append(struct.unpack_from(RECORD_FORMAT, data, record_start))
+      pos = data.find(FRAME_MAGIC, pos + FRAME_SIZE)
+    else:
+      bad_frames += 1
+      pos = data.find(FRAME_MAGIC, pos + 1)
+
+  return (records, bad_frames)
+
+def lookup_symbol(map_dict, map_offsets, address):
+  idx = bisect.bisect_right(map_offsets, address)
+  if idx == 0:
+    return "(unknown)"
+
+  return map_dict[map_offsets[idx - 1]]
+
+def process_binary_records(map_dict, map_offsets, records, output_file):
+  # Each processor's records are in order, but the processors are interleaved arbitrarily, so sort them all by time.
+  # Function entries and exits are indented to show the call depth on each processor.
+  records = sorted(records, key = lambda r: r[0])
+  depths = { }
+
+  for (timestamp, event_id, proc_id, reserved, arg0, arg1, arg2, arg3) in records:
+    depth = depths.get(proc_id, 0)
+
+    if event_id == EVENT_FN_ENTRY:
+      description = ("  " * depth) + "{ " + lookup_symbol(map_dict, map_offsets, arg0)
+      depths[proc_id] = depth + 1
+    elif event_id == EVENT_FN_EXIT:
+      depth = max(depth - 1, 0)
+      depths[proc_id] = depth
+      description = ("  " * depth) + "} " + lookup_symbol(map_dict, map_offsets, arg0)
+    elif event_id == EVENT_THREAD_SWITCH:
+      description = "Thread switch {0:x} -> {1:x}".format(arg0, arg1)
+    else:
+      description = "Event {0:x}: {1:x} {2:x} {3:x} {4:x}".format(event_id, arg0, arg1, arg2, arg3)
+
+    output_file.write("{0:>20d} CPU {1: <3d} {2}\n".format(timestamp, proc_id, description))
+
 if __name__ == "__main__":
-  trace_file = open("/tmp/qemu.log")
-  map_file = open("/tmp/kernel_map.map")
-  output_file = open("/tmp/trace.txt", "w")
-  main(trace_file, map_file, output_file)
\ No newline at end of file
+  # With no arguments, annotate a qemu execution log. Otherwise:
+  #   exec_trace.py binary <trace file> <map file> <output file> [--raw]
+  # decodes binary trace records - framed, as written to the trace output, or raw if read from the proc trace file.
+  if (len(sys.argv) >= 5) and (sys.argv[1] == "binary"):
+    trace_file = open(sys.argv[2], "rb")
+    map_file = open(sys.argv[3])
+    output_file = open(sys.argv[4], "w")
+    binary_main(trace_file, map_file, output_file, "--raw" in sys.argv[5:])
+  else:
+    trace_file = open("/tmp/qemu.log")
+    map_file = open("/tmp/kernel_map.map")
+    output_file = open("/tmp/trace.txt", "w")
+    main(trace_file, map_file, output_file)
\ No newline at end of file
@@ -0,0 +1,76 @@
+import struct
+import sys
+
+from exec_trace import read_map_file, lookup_symbol
+
+# Profiler samples, as defined by prof_sample in kernel/processor/profiler.h: timestamp, processor ID, flags, number of
+# frames, thread, process and sixteen frames. Samples read from proc\profile are stored one after another.
+MAX_FRAMES = 16
+SAMPLE_FORMAT = "<QIHHQQ{0}Q".format(MAX_FRAMES)
+SAMPLE_SIZE = struct.calcsize(SAMPLE_FORMAT)
+
+# Must match PROF_SAMPLE_FLAGS in kernel/processor/profiler.h
+FLAG_USER_MODE = 1
+
+# Addresses from here upwards are in the kernel, those below it are in user mode programs.
+KERNEL_BASE = 0xFFFF800000000000
+
+def main(sample_file, kernel_map_file, user_map_files, output_file, by_process):
+  kernel_map = read_map_file(kernel_map_file)
+  user_maps = [read_map_file(f) for f in user_map_files]
+  data = sample_file.read()
+  stacks = { }
+
+  for pos in range(0, len(data) - SAMPLE_SIZE + 1, SAMPLE_SIZE):
+    sample = struct.unpack_from(SAMPLE_FORMAT, data, pos)
+    (timestamp, proc_id, flags, num_frames, thread, process) = sample[0:6]
+    frames = sample[6:6 + num_frames]
+
+    # Samples list the innermost frame first, but folded stacks start from the outermost.
+    names = [symbolise(kernel_map, user_maps, addr) for addr in reversed(frames)]
+    if by_process:
+      names.insert(0, "process {0:x}".format(process))
+
+    stack = ";".join(names)
+    stacks[stack] = stacks.get(stack, 0) + 1
+
+  for stack in sorted(stacks.keys()):
+    output_file.write("{0} {1}\n".format(stack, stacks[stack]))
+
+def symbolise(kernel_map, user_maps, address):
+  # User mode programs all share the same address range, so the maps given are tried in order.
+  if address >= KERNEL_BASE:
+    (map_dict, map_offsets) = kernel_map
+    return lookup_symbol(map_dict, map_offsets, address)
+
+  for (map_dict, map_offsets) in user_maps:
+    name = lookup_symbol(map_dict, map_offsets, address)
+    if name != "(unknown)":
+      return name
+
+  return "{0:x}".format(address)
+
+if __name__ == "__main__":
+  # profile_fold.py <samples> <kernel map> <output> [--user-map <map>]... [--by-process]
+  #
+  # Converts samples read from proc\profile in to folded stacks - one line per distinct stack, giving the functions from
+  # outermost to innermost separated by semicolons, then the number of samples - as used by flamegraph.pl.
+  if len(sys.argv) < 4:
+    print("Usage: profile_fold.py <samples> <kernel map> <output> [--user-map <map>]... [--by-process]")
+    sys.exit(1)
+
+  user_map_files = [ ]
+  by_process = False
+  args = sys.argv[4:]
+  while len(args) != 0:
+    if (args[0] == "--user-map") and (len(args) >= 2):
+      user_map_files.append(open(args[1]))
+      args = args[2:]
+    elif args[0] == "--by-process":
+      by_process = True
+      args = args[1:]
+    else:
+      print("Unknown argument: " + args[0])
+      sys.exit(1)
+
+  main(open(sys.argv[1], "rb"), open(sys.argv[2]), user_map_files, open(sys.argv[3], "w"), by_process)
@@ -540,16 +540,27 @@ do {                                                                         \
   (len)++;                                                             \
 } while (/* CONSTCOND */ 0)
 
+// Change by Martin - the kernel is built without SSE, so it can't do floating point arithmetic. Leave out support for
+// formatting floating point values in that case.
+#if !defined(__SSE__) && !defined(VSNPRINTF_NO_FLOAT)
+#define VSNPRINTF_NO_FLOAT 1
+#endif
+// End of change.
+
 static void fmtstr(char *, size_t *, size_t, const char *, int, int, int);
 static void fmtint(char *, size_t *, size_t, INTMAX_T, int, int, int, int);
-static void fmtflt(char *, size_t *, size_t, LDOUBLE, int, int, int, int *);
 static void printsep(char *, size_t *, size_t);
 static int getnumsep(int);
-static int getexponent(LDOUBLE);
 static int convert(UINTMAX_T, char *, size_t, int, int);
+// Change by Martin - floating point support is optional.
+#ifndef VSNPRINTF_NO_FLOAT
+static void fmtflt(char *, size_t *, size_t, LDOUBLE, int, int, int, int *);
+static int getexponent(LDOUBLE);
 static UINTMAX_T cast(LDOUBLE);
 static UINTMAX_T myround(LDOUBLE);
 static LDOUBLE mypow10(int);
+#endif
+// End of change.
 
 // Change by Martin. Hide errno from extern, it's not used elsewhere in the kernel. Define NULL to be nullptr
 int errno;
@@ -559,7 +570,11 @@ int errno;
 int
 rpl_vsnprintf(char *str, size_t size, const char *format, va_list args)
 {
+  // Change by Martin - floating point support is optional.
+#ifndef VSNPRINTF_NO_FLOAT
   LDOUBLE fvalue;
+#endif
+  // End of change.
   INTMAX_T value;
   unsigned char cvalue;
   const char *strvalue;
@@ -803,6 +818,8 @@ rpl_vsnprintf(char *str, size_t size, const char *format, va_list args)
         fmtint(str, &len, size, value, base, width,
             precision, flags);
         break;
+      // Change by Martin - floating point support is optional.
+#ifndef VSNPRINTF_NO_FLOAT
       case 'A':
         /* Not yet supported, we'll use "%F". */
         /* FALLTHROUGH */
@@ -855,6 +872,24 @@ rpl_vsnprintf(char *str, size_t size, const char *format, va_list args)
         if (overflow)
           goto out;
         break;
+#else
+      case 'A':
+      case 'F':
+      case 'a':
+      case 'f':
+      case 'E':
+      case 'e':
+      case 'G':
+      case 'g':
+        /*
+         * Floating point values can't be formatted, so nothing is output.
+         * Floating point arguments are passed separately from integers
+         * and pointers, so leaving the argument unread doesn't affect
+         * the remaining conversions.
+         */
+        break;
+#endif
+      // End of change.
       case 'c':
         cvalue = va_arg(args, int);
         OUTCHAR(str, len, size, cvalue);
@@ -1097,6 +1132,8 @@ fmtint(char *str, size_t *len, size_t size, INTMAX_T value, int base, int width,
   }
 }
 
+// Change by Martin - floating point support is optional.
+#ifndef VSNPRINTF_NO_FLOAT
 static void
 fmtflt(char *str, size_t *len, size_t size, LDOUBLE fvalue, int width,
        int precision, int flags, int *overflow)
@@ -1387,6 +1424,8 @@ again:
     padlen++;
   }
 }
+#endif
+// End of change.
 
 static void
 printsep(char *str, size_t *len, size_t size)
@@ -1421,6 +1460,8 @@ getnumsep(int digits)
   return separators;
 }
 
+// Change by Martin - floating point support is optional.
+#ifndef VSNPRINTF_NO_FLOAT
 static int
 getexponent(LDOUBLE value)
 {
@@ -1441,6 +1482,8 @@ getexponent(LDOUBLE value)
 
   return exponent;
 }
+#endif
+// End of change.
 
 static int
 convert(UINTMAX_T value, char *buf, size_t size, int base, int caps)
@@ -1457,6 +1500,8 @@ convert(UINTMAX_T value, char *buf, size_t size, int base, int caps)
   return (int)pos;
 }
 
+// Change by Martin - floating point support is optional.
+#ifndef VSNPRINTF_NO_FLOAT
 static UINTMAX_T
 cast(LDOUBLE value)
 {
@@ -1504,6 +1549,8 @@ mypow10(int exponent)
   }
   return result;
 }
+#endif
+// End of change.
 #endif  /* !HAVE_VSNPRINTF */
 
 #if !HAVE_VASPRINTF
@@ -26,8 +26,11 @@ void simple_terminal()
   const uint64_t buffer_size = 10;
   char buffer[buffer_size];
   uint64_t bytes_read;
-  klib_message_hdr msg_header;
+  const uint64_t max_msgs = 16;
+  klib_message_hdr msgs[max_msgs];
+  uint64_t num_msgs;
   keypress_msg *key_msg;
+  const uint64_t keypress_wait_us = 10000;
 
 
   // Set up the output pipe - the one that correlates to stdout/stderr.
@@ -70,38 +73,41 @@ void simple_terminal()
       KL_TRC_TRACE(TRC_LVL::FLOW, "Failed to read\n");
     }
 
-    // Grab any keyboard messages, and send them to the stdin pipe.
-    if (msg_retrieve_next_msg(msg_header) == ERR_CODE::NO_ERROR)
+    // Grab any keyboard messages, and send them to the stdin pipe. Sleep for a short while if there aren't any, rather
+    // than spinning - but not so long that output written to the pipe is noticeably delayed. Keypresses can arrive in
+    // bursts, so take all of those waiting at once.
+    if (msg_retrieve_msg_batch(msgs, max_msgs, num_msgs, keypress_wait_us) == ERR_CODE::NO_ERROR)
     {
-      //KL_TRC_TRACE(TRC_LVL::FLOW, "Got keyboard message. ");
-      switch (msg_header.msg_id)
+      for (uint64_t i = 0; i < num_msgs; i++)
       {
-        case SM_KEYDOWN:
-          break;
-
-        case SM_KEYUP:
-          break;
-
-        case SM_PCHAR:
-          if (msg_header.msg_length != sizeof(key_char_msg))
-          {
-            KL_TRC_TRACE(TRC_LVL::FLOW, "Wrong sized keyboard message\n");
-          }
-          else
-          {
-            key_msg = reinterpret_cast<keypress_msg *>(msg_header.msg_contents);
-            char pc = (char)key_msg->key_pressed;
-
-            output_term.handle_keypress(pc);
-          }
-          break;
-
-        default:
-          break;
+        switch (msgs[i].msg_id)
+        {
+          case SM_KEYDOWN:
+            break;
+
+          case SM_KEYUP:
+            break;
+
+          case SM_PCHAR:
+            if (msgs[i].msg_length != sizeof(key_char_msg))
+            {
+              KL_TRC_TRACE(TRC_LVL::FLOW, "Wrong sized keyboard message\n");
+            }
+            else
+            {
+              key_msg = reinterpret_cast<keypress_msg *>(msgs[i].msg_contents);
+              char pc = (char)key_msg->key_pressed;
+
+              output_term.handle_keypress(pc);
+            }
+            break;
+
+          default:
+            break;
+        }
+
+        msg_release_contents(msgs[i]);
       }
-      //KL_TRC_TRACE(TRC_LVL::FLOW, "\n");
-
-      msg_msg_complete(msg_header);
     }
   }
 
@@ -311,7 +311,13 @@ void ps2_keyboard_device::handle_interrupt_slow(uint8_t irq_num)
             hdr.msg_id = (this->_next_key_is_release ? SM_KEYUP : SM_KEYDOWN);
             hdr.msg_length = sizeof(keypress_msg);
 
-            msg_send_to_process(proc, hdr);
+            // Never wait for space in the recipient's queue - this may be running in interrupt context. If the
+            // queue is full the keypress is simply dropped.
+            if (msg_send_to_process(proc, hdr) != ERR_CODE::NO_ERROR)
+            {
+              KL_TRC_TRACE(TRC_LVL::FLOW, "Keypress message rejected\n");
+              delete updown_msg;
+            }
 
             if ((!this->_next_key_is_release) && (printable_char != 0))
             {
@@ -323,7 +329,11 @@ void ps2_keyboard_device::handle_interrupt_slow(uint8_t irq_num)
               hdr.msg_id = SM_PCHAR;
               hdr.msg_length = sizeof(key_char_msg);
 
-              msg_send_to_process(proc, hdr);
+              if (msg_send_to_process(proc, hdr) != ERR_CODE::NO_ERROR)
+              {
+                KL_TRC_TRACE(TRC_LVL::FLOW, "Character message rejected\n");
+                delete char_msg;
+              }
             }
           }
         }
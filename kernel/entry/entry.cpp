@@ -8,6 +8,7 @@
 #include "klib/klib.h"
 #include "processor/processor.h"
 #include "processor/timing/timing.h"
+#include "processor/boot_phases.h"
 #include "mem/mem.h"
 #include "syscall/syscall_kernel.h"
 #include "acpi/acpi_if.h"
@@ -42,7 +43,10 @@
 // Kernel wake-up task (kernel_start()):
 // - Bring other processors in to the task scheduling loop
 // - Permit full ACPI.
+// - Scan PCI, probe the PS/2 controller and mount the boot disk, all at once on separate threads.
 // - Load the user-mode "init" task (currently done by temporary code)
+//
+// Each step is timed with boot_phase_begin() and boot_phase_end(), and the results can be read from 'proc\boot_times'.
 
 // Known deficiencies:
 // Where to begin!
@@ -51,7 +55,10 @@
 
 extern "C" int main(unsigned int magic_number, multiboot_hdr *mb_header);
 void kernel_start() throw ();
-void setup_task_parameters(task_process *startup_proc);
+void boot_pci_thread();
+void boot_ps2_thread();
+void boot_root_fs_thread();
+bool boot_thread_finished(void *thread);
 
 // Temporary procedures and storage while the kernel is being developed. Eventually, the full kernel start procedure
 // will cause these to become unused.
@@ -63,6 +70,12 @@ gen_ps2_controller_device *ps2_controller;
 std::shared_ptr<task_process> *system_process;
 std::shared_ptr<task_process> *kernel_start_process;
 
+// Used by the device startup threads.
+dev_root_branch *boot_dev_root;
+
+// The phase covering everything from entering main() to starting the initial process.
+uint32_t boot_total_phase;
+
 volatile bool wait_for_term;
 
 // Assumptions used throughout the kernel
@@ -85,25 +98,64 @@ int main(uint32_t magic_number, multiboot_hdr *mb_header)
   // Check that the memory map flag is set.
   ASSERT((mb_header->flags && (1 << 6)) != 0);
 
+  // Start timing as early as possible. The TSC can be read before anything else is set up.
+  boot_total_phase = boot_phase_begin("boot_to_init_process");
+
   // Gather details about the memory map in advance of giving them to the memory manager.
   uint64_t e820_map_addr = mb_header->mmap_addr;
   e820_pointer e820_ptr;
   e820_ptr.table_ptr = reinterpret_cast<e820_record *>(e820_map_addr);
   e820_ptr.table_length = mb_header->mmap_length;
 
+  uint32_t phase;
+
+  phase = boot_phase_begin("proc_gen_init");
   proc_gen_init();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("mem_gen_init");
   mem_gen_init(&e820_ptr);
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("hm_gen_init");
   hm_gen_init();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("system_tree_init");
   system_tree_init();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("acpi_init_table_system");
   acpi_init_table_system();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("proc_shared_page_init");
+  proc_shared_page_init();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("time_gen_init");
   time_gen_init();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("proc_mp_init");
   proc_mp_init();
+  boot_phase_end(phase);
+
+  phase = boot_phase_begin("syscall_gen_init");
   syscall_gen_init();
+  boot_phase_end(phase);
+
+#ifdef KL_TRACE_BINARY
+  // Each processor's ring holds 4096 records - 192kB.
+  kl_trc_binary_init(proc_mp_proc_count(), 4096);
+#endif
 
   system_process = new std::shared_ptr<task_process>();
   kernel_start_process = new std::shared_ptr<task_process>();
 
+  phase = boot_phase_begin("task_init");
   *system_process = task_init();
+  boot_phase_end(phase);
 
   KL_TRC_TRACE(TRC_LVL::IMPORTANT, "Welcome to the OS!\n");
 
@@ -138,10 +190,19 @@ void kernel_start() throw ()
   const char hello_string[] = "Hello, world!";
   uint64_t br;
   std::shared_ptr<pipe_branch::pipe_read_leaf> pipe_read_leaf;
+  std::shared_ptr<task_thread> device_threads[3];
+  uint32_t phase;
 
   // Bring the ACPI system up to full readiness.
+  phase = boot_phase_begin("acpi_enable_subsystem");
   status = AcpiEnableSubsystem(ACPI_FULL_INITIALIZATION);
   ASSERT(status == AE_OK);
+  boot_phase_end(phase);
+
+#ifdef KL_TRACE_BINARY_OUTPUT
+  // Send binary trace records to the trace output as they arrive, rather than leaving them to be read from proc.
+  task_thread::create(kl_trc_binary_output_thread, *system_process)->start_thread();
+#endif
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   // Code below here is not intended to be part of the permanent kernel start procedure, but will sit here until the //
@@ -151,21 +212,36 @@ void kernel_start() throw ()
   // Start the device management system.
   std::shared_ptr<dev_root_branch> dev_root = std::make_shared<dev_root_branch>();
   ASSERT(system_tree()->add_child("dev", dev_root) == ERR_CODE::NO_ERROR);
-  dev_root->scan_for_devices();
-
-  // Enable the PS/2 controller.
-  ps2_controller = new gen_ps2_controller_device();
-
-  // Setup a basic file system.
-  std::shared_ptr<fat_filesystem> first_fs = setup_initial_fs();
-  ASSERT(first_fs != nullptr);
-  ASSERT(system_tree()->add_child("root", std::dynamic_pointer_cast<ISystemTreeBranch>(first_fs)) == ERR_CODE::NO_ERROR);
+  boot_dev_root = dev_root.get();
+
+  // Scanning PCI, probing the PS/2 controller and reading the boot disk don't depend on each other, and each spends
+  // most of its time waiting for hardware, so do them all at once on separate threads. The scheduler spreads the
+  // threads over the available processors. Each thread only adds to System Tree beneath a branch that no other thread
+  // is changing.
+  phase = boot_phase_begin("device_init");
+  device_threads[0] = task_thread::create(boot_pci_thread, *system_process);
+  device_threads[1] = task_thread::create(boot_ps2_thread, *system_process);
+  device_threads[2] = task_thread::create(boot_root_fs_thread, *system_process);
+
+  for (std::shared_ptr<task_thread> &t : device_threads)
+  {
+    t->start_thread();
+  }
+  for (std::shared_ptr<task_thread> &t : device_threads)
+  {
+    t->wait_for_signal_unless(boot_thread_finished, t.get());
+    t = nullptr;
+  }
+  boot_phase_end(phase);
 
   wait_for_term = true;
 
-  initial_proc = proc_load_elf_file("root\\initprog");
-  setup_task_parameters(initial_proc.get());
+  // Give init a plausible argc, argv and environ.
+  const char *initprog_args[] = { "testparam", nullptr };
+  const char *initprog_env[] = { "OSTYPE=azalea", nullptr };
+  ASSERT(proc_load_elf_file("root\\initprog", initial_proc) == ERR_CODE::NO_ERROR);
   ASSERT(initial_proc != nullptr);
+  ASSERT(proc_copy_start_params(initial_proc.get(), "initprog", initprog_args, initprog_env) == ERR_CODE::NO_ERROR);
 
   // Create a temporary in-RAM file system.
   std::shared_ptr<mem_fs_branch> ram_branch = mem_fs_branch::create();
@@ -208,6 +284,7 @@ void kernel_start() throw ()
   pipe_read_leaf->set_block_on_read(true);
 
   // Process should be good to go!
+  boot_phase_end(boot_total_phase);
   initial_proc->start_process();
 
   if (keyboard != nullptr)
@@ -223,6 +300,58 @@ void kernel_start() throw ()
   panic("System has 'shut down'");
 }
 
+// Scan the PCI bus, starting drivers for any devices found. Runs as its own thread during startup.
+void boot_pci_thread()
+{
+  KL_TRC_ENTRY;
+
+  uint32_t phase = boot_phase_begin("pci_scan");
+  boot_dev_root->scan_for_devices();
+  boot_phase_end(phase);
+
+  task_get_cur_thread()->destroy_thread();
+
+  KL_TRC_EXIT;
+}
+
+// Enable the PS/2 controller, and probe for devices attached to it. Runs as its own thread during startup.
+void boot_ps2_thread()
+{
+  KL_TRC_ENTRY;
+
+  uint32_t phase = boot_phase_begin("ps2_init");
+  ps2_controller = new gen_ps2_controller_device();
+  boot_phase_end(phase);
+
+  task_get_cur_thread()->destroy_thread();
+
+  KL_TRC_EXIT;
+}
+
+// Identify the boot disk and mount its filesystem as 'root'. Runs as its own thread during startup.
+void boot_root_fs_thread()
+{
+  KL_TRC_ENTRY;
+
+  uint32_t phase = boot_phase_begin("root_fs_init");
+  std::shared_ptr<fat_filesystem> first_fs = setup_initial_fs();
+  ASSERT(first_fs != nullptr);
+  ASSERT(system_tree()->add_child("root", std::dynamic_pointer_cast<ISystemTreeBranch>(first_fs)) ==
+         ERR_CODE::NO_ERROR);
+  first_fs = nullptr;
+  boot_phase_end(phase);
+
+  task_get_cur_thread()->destroy_thread();
+
+  KL_TRC_EXIT;
+}
+
+// Has one of the device startup threads finished? Used with WaitObject::wait_for_signal_unless().
+bool boot_thread_finished(void *thread)
+{
+  return reinterpret_cast<task_thread *>(thread)->thread_destroyed;
+}
+
 // Configure the filesystem of the (presumed) boot device as part of System Tree.
 const unsigned int base_reg_a = 0x1F0;
 std::shared_ptr<fat_filesystem> setup_initial_fs()
@@ -257,71 +386,4 @@ std::shared_ptr<fat_filesystem> setup_initial_fs()
 
   KL_TRC_EXIT;
   return first_fs;
-}
-
-// Setup a plausible argc, argv and environ in startup_proc.
-// Let's go for:
-// argc = 2
-// argv = "initprog", "testparam"
-// environ = "OSTYPE=azalea"
-void setup_task_parameters(task_process *startup_proc)
-{
-  // The default user mode stack starts from this position - 16 and grows downwards, we put the task parameters above
-  // this position.
-  const uintptr_t default_posn = 0x000000000F200000;
-
-  KL_TRC_ENTRY;
-
-  void *physical_backing;
-  void *kernel_map;
-  char **argv_ptr_k;
-  char **environ_ptr_k;
-  char *string_ptr_k;
-
-  char **argv_ptr_u;
-  char **environ_ptr_u;
-  char *string_ptr_u;
-
-  ASSERT(startup_proc != nullptr);
-  ASSERT(mem_get_phys_addr(reinterpret_cast<void *>(default_posn)) == nullptr);
-
-  physical_backing = mem_allocate_physical_pages(1);
-  kernel_map = mem_allocate_virtual_range(1);
-
-  mem_map_range(physical_backing, kernel_map, 1);
-  mem_vmm_allocate_specific_range(default_posn, 1, startup_proc);
-  mem_map_range(physical_backing, reinterpret_cast<void *>(default_posn), 1, startup_proc);
-
-  argv_ptr_k = reinterpret_cast<char **>(kernel_map);
-  argv_ptr_u = reinterpret_cast<char **>(default_posn);
-  // The end of argv is nullptr.
-  argv_ptr_k[2] = nullptr;
-
-  string_ptr_k = reinterpret_cast<char *>(argv_ptr_k + 3);
-  string_ptr_u = reinterpret_cast<char *>(argv_ptr_u + 3);
-
-  argv_ptr_k[0] = string_ptr_u;
-  kl_memcpy("initprog", string_ptr_k, 9);
-  string_ptr_k += 9;
-  string_ptr_u += 9;
-
-  argv_ptr_k[1] = string_ptr_u;
-  kl_memcpy("testparam", string_ptr_k, 10);
-  string_ptr_k += 10;
-  string_ptr_u += 10;
-
-  environ_ptr_k = reinterpret_cast<char **>(reinterpret_cast<uint64_t>(kernel_map) + 64);
-  environ_ptr_u = reinterpret_cast<char **>(default_posn + 64);
-  environ_ptr_k[1] = nullptr;
-  string_ptr_k = reinterpret_cast<char *>(environ_ptr_k + 2);
-  string_ptr_u = reinterpret_cast<char *>(environ_ptr_u + 2);
-  environ_ptr_k[0] = string_ptr_u;
-
-  kl_memcpy("OSTYPE=azalea", string_ptr_k, 14);
-
-  task_set_start_params(startup_proc, 2, argv_ptr_u, environ_ptr_u);
-
-  mem_unmap_range(kernel_map, 1, nullptr, false);
-
-  KL_TRC_EXIT;
 }
\ No newline at end of file
@@ -127,8 +127,10 @@ pre_main_32:
 
   ; Enable paging
   ; (CR0.PG = 1, CR4.PAE = 1, and IA32_EFER.LME = 1)
+  ; Also set CR0.WP, so that the kernel can't write to pages that are mapped read-only either - otherwise a process
+  ; could ask the kernel to write to pages it shares with other processes.
   mov eax, cr0
-  or eax, 0x80000000
+  or eax, 0x80010000
   mov cr0, eax
 
   ; Setup trivial GDT
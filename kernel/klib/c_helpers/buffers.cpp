@@ -8,6 +8,269 @@
 #include "klib/panic/panic.h"
 #include "klib/misc/assert.h"
 
+#ifdef _MSVC_LANG
+#include <intrin.h>
+#endif
+
+// The buffer functions sit underneath almost every data transfer in the kernel, so there are several implementations
+// of the copying and setting loops. The portable word loops are used until proc_gen_init() has looked at CPUID and
+// called kl_mem_select_impl(), after which the string instructions best suited to the processor take over.
+namespace
+{
+#ifndef _MSVC_LANG
+  // Buffers are accessed through this type when working a word at a time, so the compiler cannot assume that they
+  // don't alias objects of other types.
+  typedef uint64_t __attribute__((__may_alias__)) buf_word;
+#else
+  typedef uint64_t buf_word;
+#endif
+
+  // Buffers shorter than this are always handled by the word loops, since the string instructions have a start-up cost
+  // that outweighs their speed on short runs.
+  const uint64_t REP_STRING_THRESHOLD = 256;
+
+  // Non-temporal copies shorter than this are passed to kl_memcpy, since the data is likely to fit in the cache anyway.
+  const uint64_t NON_TEMPORAL_THRESHOLD = 4096;
+
+  // The implementation in use by kl_memcpy() and kl_memset().
+  KL_MEM_IMPL selected_impl = KL_MEM_IMPL::WORD_LOOP;
+
+  void copy_bytes(const uint8_t *from, uint8_t *to, uint64_t len)
+  {
+    for (uint64_t i = 0; i < len; i++)
+    {
+      to[i] = from[i];
+    }
+  }
+
+  void set_bytes(uint8_t *buffer, uint8_t val, uint64_t len)
+  {
+    for (uint64_t i = 0; i < len; i++)
+    {
+      buffer[i] = val;
+    }
+  }
+
+  // How many bytes must be handled individually before ptr is aligned to a word boundary? Limited to len.
+  uint64_t bytes_to_alignment(const uint8_t *ptr, uint64_t len)
+  {
+    uint64_t head = (0 - reinterpret_cast<uint64_t>(ptr)) & (sizeof(buf_word) - 1);
+
+    return (head < len) ? head : len;
+  }
+
+  void rep_movsb(const uint8_t *from, uint8_t *to, uint64_t len)
+  {
+#ifndef _MSVC_LANG
+    asm volatile("rep movsb" : "+D"(to), "+S"(from), "+c"(len) : : "memory");
+#else
+    __movsb(to, from, len);
+#endif
+  }
+
+  void rep_movsq(const uint8_t *from, uint8_t *to, uint64_t words)
+  {
+#ifndef _MSVC_LANG
+    asm volatile("rep movsq" : "+D"(to), "+S"(from), "+c"(words) : : "memory");
+#else
+    __movsq(reinterpret_cast<unsigned __int64 *>(to), reinterpret_cast<const unsigned __int64 *>(from), words);
+#endif
+  }
+
+  void rep_stosb(uint8_t *buffer, uint8_t val, uint64_t len)
+  {
+#ifndef _MSVC_LANG
+    asm volatile("rep stosb" : "+D"(buffer), "+c"(len) : "a"(val) : "memory");
+#else
+    __stosb(buffer, val, len);
+#endif
+  }
+
+  void rep_stosq(uint8_t *buffer, uint64_t pattern, uint64_t words)
+  {
+#ifndef _MSVC_LANG
+    asm volatile("rep stosq" : "+D"(buffer), "+c"(words) : "a"(pattern) : "memory");
+#else
+    __stosq(reinterpret_cast<unsigned __int64 *>(buffer), pattern, words);
+#endif
+  }
+
+  // Copy whole words, storing them without bringing the destination's cache lines in to the cache. movnti uses general
+  // purpose registers, so it is usable even though the kernel doesn't save SSE state. Non-temporal stores are weakly
+  // ordered, so they are fenced before returning.
+  void copy_words_nt(const uint8_t *from, uint8_t *to, uint64_t words)
+  {
+#ifndef _MSVC_LANG
+    uint64_t blocks = words / 4;
+    uint64_t remainder = words % 4;
+
+    // The loop is written in assembly so that it runs at full speed even though the kernel is built unoptimised.
+    if (blocks != 0)
+    {
+      asm volatile("1:\n"
+                   "  mov (%[src]), %%rax\n"
+                   "  mov 8(%[src]), %%rdx\n"
+                   "  movnti %%rax, (%[dst])\n"
+                   "  movnti %%rdx, 8(%[dst])\n"
+                   "  mov 16(%[src]), %%rax\n"
+                   "  mov 24(%[src]), %%rdx\n"
+                   "  movnti %%rax, 16(%[dst])\n"
+                   "  movnti %%rdx, 24(%[dst])\n"
+                   "  add $32, %[src]\n"
+                   "  add $32, %[dst]\n"
+                   "  dec %[blocks]\n"
+                   "  jnz 1b\n"
+                   : [src] "+r"(from), [dst] "+r"(to), [blocks] "+r"(blocks)
+                   :
+                   : "rax", "rdx", "cc", "memory");
+    }
+    if (remainder != 0)
+    {
+      asm volatile("1:\n"
+                   "  mov (%[src]), %%rax\n"
+                   "  movnti %%rax, (%[dst])\n"
+                   "  add $8, %[src]\n"
+                   "  add $8, %[dst]\n"
+                   "  dec %[remainder]\n"
+                   "  jnz 1b\n"
+                   : [src] "+r"(from), [dst] "+r"(to), [remainder] "+r"(remainder)
+                   :
+                   : "rax", "cc", "memory");
+    }
+    asm volatile("sfence" : : : "memory");
+#else
+    const buf_word *f = reinterpret_cast<const buf_word *>(from);
+    long long *t = reinterpret_cast<long long *>(to);
+
+    for (uint64_t i = 0; i < words; i++)
+    {
+      _mm_stream_si64x(t + i, f[i]);
+    }
+    _mm_sfence();
+#endif
+  }
+
+  // Make sure that a copy neither wraps the end of memory nor crosses between user and kernel space.
+  void check_copy_buffers(const void *from, void *to, uint64_t len)
+  {
+    uint64_t from_end = reinterpret_cast<uint64_t>(from) + len;
+    uint64_t to_end = reinterpret_cast<uint64_t>(to) + len;
+
+    // Make sure that the copying doesn't wrap.
+    ASSERT(from_end > reinterpret_cast<uint64_t>(from));
+    ASSERT(to_end > reinterpret_cast<uint64_t>(to));
+
+    // Ensure that the buffers are contained entirely within user space if they start there. If they start in kernel
+    // space then the ASSERTs above prevent them wrapping back to overlap userspace.
+    if (reinterpret_cast<uint64_t>(from) < 0x8000000000000000)
+    {
+      ASSERT(from_end < 0x8000000000000000);
+    }
+    if (reinterpret_cast<uint64_t>(to) < 0x8000000000000000)
+    {
+      ASSERT(to_end < 0x8000000000000000);
+    }
+  }
+
+  void copy_word_loop(const uint8_t *from, uint8_t *to, uint64_t len)
+  {
+    uint64_t head = bytes_to_alignment(to, len);
+    const buf_word *f;
+    buf_word *t;
+    uint64_t words;
+
+    copy_bytes(from, to, head);
+    from += head;
+    to += head;
+    len -= head;
+
+    // The destination is now aligned. The source may not be, but x64 handles misaligned loads well.
+    f = reinterpret_cast<const buf_word *>(from);
+    t = reinterpret_cast<buf_word *>(to);
+    words = len / sizeof(buf_word);
+
+    while (words >= 4)
+    {
+      t[0] = f[0];
+      t[1] = f[1];
+      t[2] = f[2];
+      t[3] = f[3];
+      t += 4;
+      f += 4;
+      words -= 4;
+    }
+    while (words != 0)
+    {
+      *t = *f;
+      t++;
+      f++;
+      words--;
+    }
+
+    copy_bytes(reinterpret_cast<const uint8_t *>(f), reinterpret_cast<uint8_t *>(t), len % sizeof(buf_word));
+  }
+
+  void set_word_loop(uint8_t *buffer, uint8_t val, uint64_t len)
+  {
+    uint64_t head = bytes_to_alignment(buffer, len);
+    uint64_t pattern = val * 0x0101010101010101ULL;
+    buf_word *b;
+    uint64_t words;
+
+    set_bytes(buffer, val, head);
+    buffer += head;
+    len -= head;
+
+    b = reinterpret_cast<buf_word *>(buffer);
+    words = len / sizeof(buf_word);
+
+    while (words >= 4)
+    {
+      b[0] = pattern;
+      b[1] = pattern;
+      b[2] = pattern;
+      b[3] = pattern;
+      b += 4;
+      words -= 4;
+    }
+    while (words != 0)
+    {
+      *b = pattern;
+      b++;
+      words--;
+    }
+
+    set_bytes(reinterpret_cast<uint8_t *>(b), val, len % sizeof(buf_word));
+  }
+
+  void copy_rep_qword(const uint8_t *from, uint8_t *to, uint64_t len)
+  {
+    uint64_t head = bytes_to_alignment(to, len);
+
+    copy_bytes(from, to, head);
+    from += head;
+    to += head;
+    len -= head;
+
+    rep_movsq(from, to, len / sizeof(buf_word));
+    copy_bytes(from + (len & ~(sizeof(buf_word) - 1)),
+               to + (len & ~(sizeof(buf_word) - 1)),
+               len % sizeof(buf_word));
+  }
+
+  void set_rep_qword(uint8_t *buffer, uint8_t val, uint64_t len)
+  {
+    uint64_t head = bytes_to_alignment(buffer, len);
+
+    set_bytes(buffer, val, head);
+    buffer += head;
+    len -= head;
+
+    rep_stosq(buffer, val * 0x0101010101010101ULL, len / sizeof(buf_word));
+    set_bytes(buffer + (len & ~(sizeof(buf_word) - 1)), val, len % sizeof(buf_word));
+  }
+}
+
 /// @brief Kernel memory setting function
 ///
 /// A drop-in replacement for the familiar memset function. The entire buffer must be contained within kernel memory
@@ -30,11 +293,20 @@ void kl_memset(void* buffer, uint8_t val, uint64_t len)
   ASSERT((reinterpret_cast<uint64_t>(buffer) & (((uint64_t)1) << 63)) != 0);
 #endif
 
-	unsigned char* b = (unsigned char*)buffer;
-	for(unsigned long done = 0; done < len; done++)
-	{
-		b[done] = val;
-	}
+  uint8_t *b = static_cast<uint8_t *>(buffer);
+
+  if ((len < REP_STRING_THRESHOLD) || (selected_impl == KL_MEM_IMPL::WORD_LOOP))
+  {
+    set_word_loop(b, val, len);
+  }
+  else if (selected_impl == KL_MEM_IMPL::REP_QWORD)
+  {
+    set_rep_qword(b, val, len);
+  }
+  else
+  {
+    rep_stosb(b, val, len);
+  }
 }
 
 /// @brief Kernel buffer copying function
@@ -53,10 +325,8 @@ void kl_memset(void* buffer, uint8_t val, uint64_t len)
 /// @param len The length of data to copy.
 void kl_memcpy(const void *from, void *to, uint64_t len)
 {
-  uint8_t *f = (uint8_t *)from;
-  uint8_t *t = (uint8_t *)to;
-  uint64_t from_end = (uint64_t)from + len;
-  uint64_t to_end = (uint64_t)to + len;
+  const uint8_t *f = static_cast<const uint8_t *>(from);
+  uint8_t *t = static_cast<uint8_t *>(to);
 
   // If length is zero, don't bother doing anything - we might as well bail out now. This also avoids any of the checks
   // below triggering.
@@ -65,27 +335,54 @@ void kl_memcpy(const void *from, void *to, uint64_t len)
     return;
   }
 
-  // Make sure that the copying doesn't wrap.
-  ASSERT(from_end > (uint64_t)from);
-  ASSERT(to_end > (uint64_t)to);
+  check_copy_buffers(from, to, len);
 
-  // Ensure that the buffers are contained entirely within user space if they start there. If they start in kernel
-  // space then the ASSERTs above prevent them wrapping back to overlap userspace.
-  if ((uint64_t)from < 0x8000000000000000)
+  if ((len < REP_STRING_THRESHOLD) || (selected_impl == KL_MEM_IMPL::WORD_LOOP))
+  {
+    copy_word_loop(f, t, len);
+  }
+  else if (selected_impl == KL_MEM_IMPL::REP_QWORD)
   {
-    ASSERT(from_end < 0x8000000000000000);
+    copy_rep_qword(f, t, len);
   }
-  if ((uint64_t)to < 0x8000000000000000)
+  else
   {
-    ASSERT(to_end < 0x8000000000000000);
+    rep_movsb(f, t, len);
   }
+}
+
+/// @brief Kernel buffer copying function, for large copies whose destination won't be read again soon.
+///
+/// Behaves exactly like kl_memcpy, but writes the destination with non-temporal stores so that copying a large buffer
+/// does not evict more useful data from the caches. Short copies are simply passed to kl_memcpy.
+///
+/// @param from The buffer to copy from
+///
+/// @param to The buffer to copy to
+///
+/// @param len The length of data to copy.
+void kl_memcpy_nt(const void *from, void *to, uint64_t len)
+{
+  const uint8_t *f = static_cast<const uint8_t *>(from);
+  uint8_t *t = static_cast<uint8_t *>(to);
+  uint64_t head;
 
-  for (uint64_t i = 0; i < len; i++)
+  if (len < NON_TEMPORAL_THRESHOLD)
   {
-    *t = *f;
-    t++;
-    f++;
+    kl_memcpy(from, to, len);
+    return;
   }
+
+  check_copy_buffers(from, to, len);
+
+  head = bytes_to_alignment(t, len);
+  copy_bytes(f, t, head);
+  f += head;
+  t += head;
+  len -= head;
+
+  copy_words_nt(f, t, len / sizeof(buf_word));
+  copy_bytes(f + (len & ~(sizeof(buf_word) - 1)), t + (len & ~(sizeof(buf_word) - 1)), len % sizeof(buf_word));
 }
 
 /// @brief Kernel buffer comparison function
@@ -105,6 +402,9 @@ int8_t kl_memcmp(const void *a, const void *b, uint64_t len)
   const uint8_t *_a = static_cast<const uint8_t *>(a);
   const uint8_t *_b = static_cast<const uint8_t *>(b);
 
+  const buf_word *wa = reinterpret_cast<const buf_word *>(a);
+  const buf_word *wb = reinterpret_cast<const buf_word *>(b);
+
   uint64_t ctr = 0;
 
   if (len == 0)
@@ -112,6 +412,17 @@ int8_t kl_memcmp(const void *a, const void *b, uint64_t len)
     return 0;
   }
 
+  // Skip over the matching words first. Only the mismatching word needs to be examined byte by byte, to find which
+  // buffer is lower.
+  while (((len - ctr) >= sizeof(buf_word)) && (*wa == *wb))
+  {
+    wa++;
+    wb++;
+    ctr += sizeof(buf_word);
+  }
+  _a += ctr;
+  _b += ctr;
+
   while (ctr < len)
   {
     if (*_a < *_b)
@@ -131,6 +442,29 @@ int8_t kl_memcmp(const void *a, const void *b, uint64_t len)
   return 0;
 }
 
+/// @brief Choose which implementation kl_memcpy() and kl_memset() use.
+///
+/// Called during processor initialisation, once the processor's features are known.
+///
+/// @param impl The implementation to use. The processor must support the instructions it relies on.
+void kl_mem_select_impl(KL_MEM_IMPL impl)
+{
+  KL_TRC_ENTRY;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Selected implementation: ", static_cast<uint64_t>(impl), "\n");
+  selected_impl = impl;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Which implementation are kl_memcpy() and kl_memset() using?
+///
+/// @return The implementation in use.
+KL_MEM_IMPL kl_mem_get_impl()
+{
+  return selected_impl;
+}
+
 // Don't include memmove in the test code, it just causes wobblies.
 #ifndef AZALEA_TEST_CODE
 void *memmove(void *dest, const void *src, uint64_t length)
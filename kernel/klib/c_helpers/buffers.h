@@ -6,9 +6,21 @@
 
 #include <stdint.h>
 
+/// @brief The available implementations of kl_memcpy() and kl_memset().
+enum class KL_MEM_IMPL
+{
+  WORD_LOOP, ///< Portable loops working a 64-bit word at a time. Used until kl_mem_select_impl() is called.
+  REP_QWORD, ///< rep movsq and rep stosq. Suits any x64 processor.
+  REP_BYTE, ///< rep movsb and rep stosb. Only fast on processors supporting Enhanced REP MOVSB/STOSB (ERMS).
+};
+
 void kl_memset(void* buffer, uint8_t val, uint64_t len);
 void kl_memcpy(const void *from, void *to, uint64_t len);
 int8_t kl_memcmp(const void *a, const void *b, uint64_t len);
+void kl_memcpy_nt(const void *from, void *to, uint64_t len);
+
+void kl_mem_select_impl(KL_MEM_IMPL impl);
+KL_MEM_IMPL kl_mem_get_impl();
 
 // Don't include memmove in the test code, it just causes wobblies.
 #ifndef AZALEA_TEST_CODE
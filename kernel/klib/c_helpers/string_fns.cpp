@@ -58,7 +58,7 @@ int32_t kl_strcmp(const char *str_a, const uint64_t max_len_a, const char *str_b
     }
 
     // If the end of string is reached, the strings are equal.
-    if (str_a == 0)
+    if (*str_a == 0)
     {
       return 0;
     }
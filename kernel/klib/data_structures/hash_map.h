@@ -0,0 +1,421 @@
+/// @file
+/// @brief KLib open-addressing hash map implementation
+///
+/// kl_hash_map stores its entries directly in a single array of slots, so inserting an entry never allocates memory
+/// unless the array needs to grow, and looking one up touches only neighbouring slots rather than following pointers.
+///
+/// Collisions are resolved by linear probing with "Robin Hood" insertion: an entry that is further from its ideal slot
+/// takes the place of one that is nearer to its own. This keeps probe sequences short and similar in length, which
+/// means a lookup for a missing key can stop as soon as it meets an entry nearer its ideal slot than the key would be.
+/// Entries are removed by shifting the following entries back, so no tombstones are needed.
+
+#ifndef __HASH_MAP_H
+#define __HASH_MAP_H
+
+#include <stdint.h>
+#include <utility>
+#include <type_traits>
+
+#include "klib/tracing/tracing.h"
+#include "klib/panic/panic.h"
+#include "klib/misc/assert.h"
+#include "klib/data_structures/string.h"
+
+/// @brief Mix the bits of a 64-bit value, so that keys differing only in their high bits land in different slots.
+///
+/// This is the finalizer of the SplitMix64 generator.
+///
+/// @param x The value to mix.
+///
+/// @return The mixed value.
+inline uint64_t kl_hash_mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+
+  return x;
+}
+
+/// @brief Default hash function for kl_hash_map.
+///
+/// Suitable for integer and enumeration types. Other key types need their own specialization.
+///
+/// @tparam key_type The type of key to hash.
+template <class key_type> struct kl_hash
+{
+  /// @brief Hash a key.
+  ///
+  /// @param key The key to hash.
+  ///
+  /// @return The hash of key.
+  uint64_t operator()(const key_type &key) const
+  {
+    static_assert(std::is_integral<key_type>::value || std::is_enum<key_type>::value,
+                  "kl_hash needs a specialization for this key type");
+    return kl_hash_mix(static_cast<uint64_t>(key));
+  }
+};
+
+/// @brief Hash function for pointer keys.
+///
+/// @tparam pointed_type The type being pointed at.
+template <class pointed_type> struct kl_hash<pointed_type *>
+{
+  /// @brief Hash a pointer.
+  ///
+  /// @param key The pointer to hash.
+  ///
+  /// @return The hash of key.
+  uint64_t operator()(pointed_type * const &key) const
+  {
+    return kl_hash_mix(reinterpret_cast<uint64_t>(key));
+  }
+};
+
+/// @brief Hash function for kl_string keys.
+template <> struct kl_hash<kl_string>
+{
+  /// @brief Hash a string.
+  ///
+  /// @param key The string to hash.
+  ///
+  /// @return The hash of key.
+  uint64_t operator()(const kl_string &key) const
+  {
+    return key.hash();
+  }
+};
+
+/// @brief KLib open-addressing hash map
+///
+/// Maps keys to values, like kl_rb_tree, but without ordering the keys. The map is entirely **thread-unsafe**. Two
+/// simultaneous operations on it may leave the map in an inconsistent state.
+///
+/// @tparam key_type The type to be used as the key in the map. It must be default constructible, movable, support
+///                  equality (==) and be hashable by hash_type.
+///
+/// @tparam value_type The type of the values being stored in the map. It must be default constructible and movable.
+///                    Empty slots hold a default constructed value, and a value is reset to that when it is removed.
+///
+/// @tparam hash_type A function object type that hashes keys. Defaults to kl_hash<key_type>.
+template <class key_type, class value_type, class hash_type = kl_hash<key_type>> class kl_hash_map
+{
+protected:
+  /// @brief A single slot of the map.
+  struct hash_slot
+  {
+    /// @brief The key stored in this slot. Default constructed if the slot is empty.
+    key_type key;
+
+    /// @brief The value associated with the key.
+    value_type value;
+
+    /// @brief Zero if the slot is empty. Otherwise, one more than the distance of this slot from the key's ideal slot.
+    uint64_t distance;
+  };
+
+  /// @brief The number of slots allocated when the first entry is inserted. Must be a power of two.
+  static const uint64_t MIN_CAPACITY = 8;
+
+  /// @brief The slots of the map. nullptr until the first entry is inserted.
+  hash_slot *slots;
+
+  /// @brief The number of slots. Always zero or a power of two.
+  uint64_t capacity;
+
+  /// @brief The number of slots in use.
+  uint64_t number_of_entries;
+
+  /// @brief The function object used to hash keys.
+  hash_type hasher;
+
+public:
+  /// @brief Standard constructor. The map allocates no memory until the first entry is inserted.
+  kl_hash_map() : slots(nullptr), capacity(0), number_of_entries(0)
+  {
+  }
+
+  kl_hash_map(const kl_hash_map &) = delete;
+  kl_hash_map &operator=(const kl_hash_map &) = delete;
+
+  /// @brief Standard destructor.
+  ///
+  /// Frees all memory associated with the map. Keys and values are destroyed in the normal way.
+  ~kl_hash_map()
+  {
+    delete[] slots;
+  }
+
+  /// @brief Remove all entries from the map, and free its slots.
+  void clear()
+  {
+    delete[] slots;
+    slots = nullptr;
+    capacity = 0;
+    number_of_entries = 0;
+  }
+
+  /// @brief Return the number of entries in the map.
+  ///
+  /// @return The number of entries in the map.
+  uint64_t num_entries() const
+  {
+    return number_of_entries;
+  }
+
+  /// @brief Make sure the map can hold at least the given number of entries without growing again.
+  ///
+  /// @param entries The number of entries to allow for.
+  void reserve(uint64_t entries)
+  {
+    uint64_t new_capacity = capacity;
+
+    if (new_capacity == 0)
+    {
+      new_capacity = MIN_CAPACITY;
+    }
+
+    while (too_full(entries, new_capacity))
+    {
+      new_capacity *= 2;
+    }
+
+    if (new_capacity != capacity)
+    {
+      resize(new_capacity);
+    }
+  }
+
+  /// @brief Insert a key-value pair in to the map
+  ///
+  /// If the key is already in the map, its value is replaced.
+  ///
+  /// @param key The key to use.
+  ///
+  /// @param value The value to associate with key.
+  void insert(const key_type &key, const value_type &value)
+  {
+    hash_slot *existing = find_slot(key);
+
+    if (existing != nullptr)
+    {
+      existing->value = value;
+    }
+    else
+    {
+      reserve(number_of_entries + 1);
+      place_entry(key_type(key), value_type(value));
+      number_of_entries++;
+    }
+  }
+
+  /// @brief Remove a key, and its associated value, from the map
+  ///
+  /// @param key The key to remove. The key **must** be contained within the map.
+  void remove(const key_type &key)
+  {
+    hash_slot *hole = find_slot(key);
+    uint64_t hole_idx;
+    uint64_t next_idx;
+
+    ASSERT(hole != nullptr);
+    hole_idx = hole - slots;
+
+    // Shift back the entries following the removed one, until one is found that is already in its ideal slot.
+    next_idx = (hole_idx + 1) & (capacity - 1);
+    while (slots[next_idx].distance > 1)
+    {
+      slots[hole_idx].key = std::move(slots[next_idx].key);
+      slots[hole_idx].value = std::move(slots[next_idx].value);
+      slots[hole_idx].distance = slots[next_idx].distance - 1;
+
+      hole_idx = next_idx;
+      next_idx = (next_idx + 1) & (capacity - 1);
+    }
+
+    slots[hole_idx].key = key_type();
+    slots[hole_idx].value = value_type();
+    slots[hole_idx].distance = 0;
+
+    number_of_entries--;
+  }
+
+  /// @brief Determines if key is in the map
+  ///
+  /// @param key The key to look for
+  ///
+  /// @return True if the key is found in the map, False otherwise.
+  bool contains(const key_type &key) const
+  {
+    return (find_slot(key) != nullptr);
+  }
+
+  /// @brief Return the value associated with the key
+  ///
+  /// @param key The key to look for. Key **must** be part of the map.
+  ///
+  /// @return The value associated with the key.
+  value_type search(const key_type &key) const
+  {
+    hash_slot *result = find_slot(key);
+    ASSERT(result != nullptr);
+
+    return result->value;
+  }
+
+  /// @brief Look for a key, and return its value if it is found.
+  ///
+  /// This saves looking the key up twice, as calling contains() then search() would.
+  ///
+  /// @param key The key to look for.
+  ///
+  /// @param[out] value The value associated with key. Unchanged if key is not in the map.
+  ///
+  /// @return True if the key was found, false otherwise.
+  bool find(const key_type &key, value_type &value) const
+  {
+    hash_slot *result = find_slot(key);
+
+    if (result != nullptr)
+    {
+      value = result->value;
+    }
+
+    return (result != nullptr);
+  }
+
+  /// @brief Check that the map is consistent, and panic if not. Useful only for testing.
+  void debug_verify_map() const
+  {
+    uint64_t entries_found = 0;
+    uint64_t ideal_idx;
+
+    ASSERT((capacity & (capacity - 1)) == 0);
+    ASSERT((slots == nullptr) == (capacity == 0));
+
+    for (uint64_t i = 0; i < capacity; i++)
+    {
+      if (slots[i].distance != 0)
+      {
+        entries_found++;
+
+        // The recorded distance must lead back to the key's ideal slot, and the entry must be findable.
+        ideal_idx = hasher(slots[i].key) & (capacity - 1);
+        ASSERT(((i - ideal_idx) & (capacity - 1)) == slots[i].distance - 1);
+        ASSERT(find_slot(slots[i].key) == &slots[i]);
+      }
+    }
+
+    ASSERT(entries_found == number_of_entries);
+  }
+
+protected:
+  /// @brief Would the map be too full if it held this many entries in this many slots?
+  ///
+  /// The map is kept no more than 7/8 full, beyond which Robin Hood probe sequences lengthen quickly.
+  ///
+  /// @param entries The number of entries.
+  ///
+  /// @param slot_count The number of slots.
+  ///
+  /// @return True if the map should grow.
+  static bool too_full(uint64_t entries, uint64_t slot_count)
+  {
+    return ((entries * 8) > (slot_count * 7));
+  }
+
+  /// @brief Find the slot containing a key.
+  ///
+  /// @param key The key to look for.
+  ///
+  /// @return The slot containing key, or nullptr if it is not in the map.
+  hash_slot *find_slot(const key_type &key) const
+  {
+    hash_slot *result = nullptr;
+    uint64_t idx;
+    uint64_t distance = 1;
+
+    if (number_of_entries != 0)
+    {
+      idx = hasher(key) & (capacity - 1);
+
+      // If the key were in the map, it would be found before any entry nearer to its ideal slot than the key would be.
+      while (slots[idx].distance >= distance)
+      {
+        if ((slots[idx].distance == distance) && (slots[idx].key == key))
+        {
+          result = &slots[idx];
+          break;
+        }
+
+        idx = (idx + 1) & (capacity - 1);
+        distance++;
+      }
+    }
+
+    return result;
+  }
+
+  /// @brief Store a new entry. The key must not already be in the map, and there must be at least one free slot.
+  ///
+  /// @param key The key to store.
+  ///
+  /// @param value The value to store with it.
+  void place_entry(key_type &&key, value_type &&value)
+  {
+    uint64_t idx = hasher(key) & (capacity - 1);
+    uint64_t distance = 1;
+
+    while (slots[idx].distance != 0)
+    {
+      // Robin Hood: the entry further from home keeps this slot, and the other carries on looking.
+      if (slots[idx].distance < distance)
+      {
+        std::swap(key, slots[idx].key);
+        std::swap(value, slots[idx].value);
+        std::swap(distance, slots[idx].distance);
+      }
+
+      idx = (idx + 1) & (capacity - 1);
+      distance++;
+    }
+
+    slots[idx].key = std::move(key);
+    slots[idx].value = std::move(value);
+    slots[idx].distance = distance;
+  }
+
+  /// @brief Move all entries in to a new array of slots.
+  ///
+  /// @param new_capacity The number of slots in the new array. Must be a power of two, large enough for all entries.
+  void resize(uint64_t new_capacity)
+  {
+    hash_slot *old_slots = slots;
+    uint64_t old_capacity = capacity;
+
+    ASSERT((new_capacity & (new_capacity - 1)) == 0);
+    ASSERT(!too_full(number_of_entries, new_capacity));
+
+    slots = new hash_slot[new_capacity];
+    capacity = new_capacity;
+    for (uint64_t i = 0; i < capacity; i++)
+    {
+      slots[i].distance = 0;
+    }
+
+    for (uint64_t i = 0; i < old_capacity; i++)
+    {
+      if (old_slots[i].distance != 0)
+      {
+        place_entry(std::move(old_slots[i].key), std::move(old_slots[i].value));
+      }
+    }
+
+    delete[] old_slots;
+  }
+};
+
+#endif
@@ -13,6 +13,13 @@
 /// 3. All leaves are black. In this implementation, the leaves that must be black are represented by nullptr.
 /// 4. If a node is red, then both its children are black.
 /// 5. Every path from a given node to any of its descendant leaf nodes contains the same number of black nodes.
+///
+/// The algorithms are in kl_rb_tree_base. Two trees are built on it:
+/// - kl_rb_tree, which allocates its own nodes, keeping released nodes in a pool for reuse.
+/// - kl_intrusive_rb_tree, which links nodes provided by the caller. The nodes are normally embedded in the objects
+///   being stored, so the tree never allocates memory.
+///
+/// Both provide in-order iterators and lower_bound() / upper_bound() queries.
 
 #ifndef __RED_BLACK_TREE_H
 #define __RED_BLACK_TREE_H
@@ -23,11 +30,41 @@
 #include "klib/panic/panic.h"
 #include "klib/misc/assert.h"
 
-/// @brief KLib Red-Black Tree
+/// @brief A single node of a red-black tree.
 ///
-/// Provides a simple red-black tree implementation. Not as capable as the standard C++ library one, but with no
-/// external dependencies. The tree is entirely **thread-unsafe**. Two simultaneous operations on it may leave the tree
-/// in an inconsistent state.
+/// Users of kl_intrusive_rb_tree embed one of these in each object to be stored, and set the key and value before
+/// inserting it. The remaining fields belong to the tree while the node is in one.
+///
+/// @tparam key_type The type of the key.
+///
+/// @tparam value_type The type of the value. For intrusive trees, this is normally a pointer back to the containing
+///                    object.
+template <class key_type, class value_type> struct kl_rb_tree_node
+{
+  /// @brief The key, has the usual meaning
+  key_type key;
+
+  /// @brief The value associated with the key. The tree doesn't care what this is.
+  value_type value;
+
+  /// @brief The left descendant of this node. Is nullptr if there are no descendants.
+  kl_rb_tree_node<key_type, value_type> *left;
+
+  /// @brief The right descendant of this node. Is nullptr if there are no descendants.
+  kl_rb_tree_node<key_type, value_type> *right;
+
+  /// @brief The parent node of this one. Is nullptr if this node is the tree root.
+  kl_rb_tree_node<key_type, value_type> *parent;
+
+  /// @brief Is this a black node? True if black, false if red.
+  bool is_black;
+};
+
+/// @brief KLib Red-Black Tree algorithms
+///
+/// Provides the searching, balancing and iteration for red-black trees, without deciding where nodes come from. Use
+/// kl_rb_tree or kl_intrusive_rb_tree rather than this class directly. The tree is entirely **thread-unsafe**. Two
+/// simultaneous operations on it may leave the tree in an inconsistent state.
 ///
 /// @tparam key_type The type to be used as the key in the tree. It is assumed that the following operators are defined
 ///                  for key_type:
@@ -38,294 +75,447 @@
 /// @tparam value_type The type of the values being stored in the array. This type is stored within the array using a
 ///                    normal assignment (=) operator, and provided back using a standard return statement. The user is
 ///                    responsible for ensuring this will not cause memory occupancy or other issues.
-template <class key_type, class value_type> class kl_rb_tree
+template <class key_type, class value_type> class kl_rb_tree_base
 {
-protected:
+public:
+  /// @brief The type of nodes in this tree.
+  typedef kl_rb_tree_node<key_type, value_type> tree_node;
 
-  /// @brief Data type for storing data within the tree. Represents a single node.
-  template <class nkey_type, class nvalue_type> struct kl_rb_tree_node
+  /// @brief Iterates over the nodes of a tree in key order.
+  ///
+  /// Dereferencing an iterator gives the node, so the key and value are available as iter->key and iter->value. The
+  /// key must not be changed. Inserting nodes does not invalidate iterators, but removing the node an iterator refers
+  /// to does.
+  class iterator
   {
-    /// @brief The key, has the usual meaning
-    key_type key;
+  public:
+    /// @brief Construct an iterator.
+    ///
+    /// @param tree The tree being iterated over.
+    ///
+    /// @param node The node the iterator refers to. nullptr means the end of the tree.
+    iterator(kl_rb_tree_base *tree = nullptr, tree_node *node = nullptr) : _tree(tree), _node(node) { }
+
+    tree_node &operator*() const { return *_node; }
+    tree_node *operator->() const { return _node; }
+
+    /// @brief Move to the node with the next largest key, or the end of the tree.
+    iterator &operator++()
+    {
+      ASSERT(_node != nullptr);
+      _node = kl_rb_tree_base::next_node(_node);
+      return *this;
+    }
 
-    /// @brief The value associated with the key. The tree doesn't care what this is.
-    value_type value;
+    iterator operator++(int)
+    {
+      iterator old = *this;
+      ++(*this);
+      return old;
+    }
 
-    /// @brief The left descendant of this node. Is nullptr if there are no descendants.
-    kl_rb_tree_node<nkey_type, nvalue_type> *left;
+    /// @brief Move to the node with the next smallest key. Moving back from the end of the tree gives the last node.
+    iterator &operator--()
+    {
+      if (_node == nullptr)
+      {
+        ASSERT(_tree != nullptr);
+        _node = (_tree->root == nullptr) ? nullptr : _tree->find_right_leaf(_tree->root);
+      }
+      else
+      {
+        _node = kl_rb_tree_base::prev_node(_node);
+      }
+      return *this;
+    }
 
-    /// @brief The right descendant of this node. Is nullptr if there are no descendants.
-    kl_rb_tree_node<nkey_type, nvalue_type> *right;
+    iterator operator--(int)
+    {
+      iterator old = *this;
+      --(*this);
+      return old;
+    }
 
-    /// @brief The parent node of this one. Is nullptr if this node is the tree root.
-    kl_rb_tree_node<nkey_type, nvalue_type> *parent;
+    bool operator==(const iterator &other) const { return _node == other._node; }
+    bool operator!=(const iterator &other) const { return _node != other._node; }
 
-    /// @brief Is this a black node? True if black, false if red.
-    bool is_black;
+  protected:
+    /// The tree being iterated over.
+    kl_rb_tree_base *_tree;
+
+    /// The current node, or nullptr at the end of the tree.
+    tree_node *_node;
   };
-  typedef kl_rb_tree_node<key_type, value_type> tree_node;
 
-  /// @brief The root of this node.
-  tree_node *root;
+  /// @brief Standard constructor. No copy or other constructor is provided at present.
+  kl_rb_tree_base() : root(nullptr), number_of_leaves(0), left_side_last(false)
+  {
+  }
 
-  /// @brief How many leaves are in this tree.
-  unsigned long number_of_leaves;
+  kl_rb_tree_base(const kl_rb_tree_base &) = delete;
+  kl_rb_tree_base &operator=(const kl_rb_tree_base &) = delete;
 
-public:
-  /// @brief Standard constructor. No copy or other constructor is provided at present.
-  kl_rb_tree() : root(nullptr), number_of_leaves(0), left_side_last(false)
+  /// @brief Return the number of leaves in the tree.
+  ///
+  /// @return The number of leaves in the tree.
+  unsigned long num_leaves()
   {
+    return number_of_leaves;
   }
 
-  /// @brief Standard destructor.
+  /// @brief Determines if key is in the tree
   ///
-  /// Frees all memory associated with the tree, but destroying the keys or values themselves is the responsibility of
-  /// the user.
-  ~kl_rb_tree()
+  /// @param key The key to look for
+  ///
+  /// @return True if the key is found in the tree, False otherwise.
+  bool contains(const key_type &key)
   {
-    clear_tree();
+    return (find_node(key) != nullptr);
   }
 
-  /// @brief Delete all leaves within the tree.
-  void clear_tree()
+  /// @brief Return the value associated with the key
+  ///
+  /// @param key The key to look for. Key **must** be part of the tree.
+  ///
+  /// @return The value associated with the key.
+  value_type search(const key_type &key)
+  {
+    tree_node *result = find_node(key);
+    ASSERT(result != nullptr);
+
+    return result->value;
+  }
+
+  /// @brief Find the node with a given key.
+  ///
+  /// @param key The key to look for.
+  ///
+  /// @return The node with that key, or nullptr if there isn't one.
+  tree_node *find_node(const key_type &key)
+  {
+    tree_node *result = node_search(nullptr, key);
+
+    if ((result != nullptr) && !(result->key == key))
+    {
+      result = nullptr;
+    }
+
+    return result;
+  }
+
+  bool get_root_node_key(key_type &out)
   {
     if (root != nullptr)
     {
-      delete_node(root);
-      root = nullptr;
+      out = root->key;
+      return true;
     }
+    return false;
   }
 
-  /// @brief Return the number of leaves in the tree.
+  /// @brief Return an iterator to the node with the smallest key.
   ///
-  /// @return The number of leaves in the tree.
-  unsigned long num_leaves()
+  /// @return An iterator to the first node, or end() if the tree is empty.
+  iterator begin()
   {
-    return number_of_leaves;
+    return iterator(this, (root == nullptr) ? nullptr : find_left_leaf(root));
   }
 
-  /// @brief Insert a key-value pair in to the tree
+  /// @brief Return an iterator past the node with the largest key.
   ///
-  /// @param key The key to use. Must provide the necessary operators.
+  /// @return The end iterator.
+  iterator end()
+  {
+    return iterator(this, nullptr);
+  }
+
+  /// @brief Find the first node with a key not less than the given key.
   ///
-  /// @param value The value to insert. This is opaque to the tree data structure.
-  void insert(key_type key, value_type value)
+  /// @param key The key to compare against.
+  ///
+  /// @return An iterator to that node, or end() if all keys are less than key.
+  iterator lower_bound(const key_type &key)
+  {
+    tree_node *search_node = root;
+    tree_node *result = nullptr;
+
+    while (search_node != nullptr)
+    {
+      if (search_node->key < key)
+      {
+        search_node = search_node->right;
+      }
+      else
+      {
+        result = search_node;
+        search_node = search_node->left;
+      }
+    }
+
+    return iterator(this, result);
+  }
+
+  /// @brief Find the first node with a key greater than the given key.
+  ///
+  /// @param key The key to compare against.
+  ///
+  /// @return An iterator to that node, or end() if no keys are greater than key.
+  iterator upper_bound(const key_type &key)
+  {
+    tree_node *search_node = root;
+    tree_node *result = nullptr;
+
+    while (search_node != nullptr)
+    {
+      if (key < search_node->key)
+      {
+        result = search_node;
+        search_node = search_node->left;
+      }
+      else
+      {
+        search_node = search_node->right;
+      }
+    }
+
+    return iterator(this, result);
+  }
+
+  /// @brief Verifies the tree is a valid Red-Black Tree.
+  ///
+  /// **THIS FUNCTION IS INTENDED FOR TEST CODE ONLY** - although it should function normally in all code.
+  ///
+  /// Panics if a fault is found.
+  void debug_verify_tree()
+  {
+    uint64_t nodes_found = 0;
+
+    ASSERT(debug_check_node(root));
+    debug_verify_black_length(root);
+
+    // The nodes must be in key order, and there must be as many of them as the tree thinks.
+    for (iterator iter = begin(); iter != end(); iter++)
+    {
+      nodes_found++;
+      ASSERT((nodes_found == 1) || (kl_rb_tree_base::prev_node(&(*iter))->key < iter->key));
+    }
+    ASSERT(nodes_found == number_of_leaves);
+  }
+
+protected:
+  /// @brief The root of this node.
+  tree_node *root;
+
+  /// @brief How many leaves are in this tree.
+  unsigned long number_of_leaves;
+
+  /// @brief When removing nodes, did we replace it with the left child last time?
+  bool left_side_last;
+
+  /// @brief Find where a key is, or would be, in the tree.
+  ///
+  /// @param key The key to look for.
+  ///
+  /// @param[out] parent If the key is not in the tree, the node a new node with that key should be attached to.
+  ///                    nullptr if the tree is empty.
+  ///
+  /// @return The node with that key, or nullptr if there isn't one.
+  tree_node *find_insert_point(const key_type &key, tree_node *&parent)
+  {
+    tree_node *result = node_search(nullptr, key);
+
+    parent = nullptr;
+    if ((result != nullptr) && !(result->key == key))
+    {
+      parent = result;
+      result = nullptr;
+    }
+
+    return result;
+  }
+
+  /// @brief Add a node to the tree, then rebalance it.
+  ///
+  /// @param new_node The node to add. Its key must be set, and must not already be in the tree.
+  ///
+  /// @param parent The node to attach new_node to, as given by find_insert_point().
+  void attach_node(tree_node *new_node, tree_node *parent)
   {
-    tree_node *search_node;
-    tree_node *new_node = nullptr;
     tree_node *uncle_node;
     tree_node *saved_parent;
 
-    if (root == nullptr)
+    ASSERT(new_node != nullptr);
+
+    new_node->left = nullptr;
+    new_node->right = nullptr;
+    new_node->parent = parent;
+
+    if (parent == nullptr)
     {
-      root = new tree_node;
-      root->key = key;
-      root->value = value;
-      root->left = nullptr;
-      root->right = nullptr;
-      root->parent = nullptr;
-      root->is_black = true;
+      ASSERT(root == nullptr);
+      root = new_node;
+      new_node->is_black = true;
     }
     else
     {
-      search_node = root;
-
-      while (1)
+      if (new_node->key < parent->key)
       {
-        if (key == search_node->key)
-        {
-          search_node->value = value;
-          break;
-        }
-        else if (key < search_node->key)
-        {
-          if (search_node->left == nullptr)
-          {
-            search_node->left = new tree_node;
-            new_node = search_node->left;
-            new_node->key = key;
-            new_node->value = value;
-            new_node->left = nullptr;
-            new_node->right = nullptr;
-            new_node->parent = search_node;
-            new_node->is_black = false;
-            break;
-          }
-          else
-          {
-            search_node = search_node->left;
-          }
-        }
-        else // key > search_node->key
-        {
-          if (search_node->right == nullptr)
-          {
-            search_node->right = new tree_node;
-            new_node = search_node->right;
-            new_node->key = key;
-            new_node->value = value;
-            new_node->left = nullptr;
-            new_node->right = nullptr;
-            new_node->parent = search_node;
-            new_node->is_black = false;
-            break;
-          }
-          else
-          {
-            search_node = search_node->right;
-          }
-        }
+        ASSERT(parent->left == nullptr);
+        parent->left = new_node;
+      }
+      else
+      {
+        ASSERT(parent->right == nullptr);
+        parent->right = new_node;
       }
+      new_node->is_black = false;
 
-      // We've just added a new red node. That could cause the tree to become unbalanced.
-      // Note that in this loop, new_node could refer to the new node created above, or to a node newly made red.
-      while(1)
+    // We've just added a new red node. That could cause the tree to become unbalanced.
+    // Note that in this loop, new_node could refer to the new node created above, or to a node newly made red.
+    while(1)
+    {
+      uncle_node = find_uncle(new_node);
+      if (new_node->parent == nullptr)
+      {
+        // The new node is at the root. Paint it black. The number of black nodes in each subtree is increased by
+        // one, equally.
+        new_node->is_black = true;
+        ASSERT(root == new_node);
+        break;
+      }
+      else if (new_node->parent->is_black == true)
+      {
+        // The child of a black node can be either colour, and red doesn't affect the length of the routes to the
+        // leaves so no damage done. Nothing left to do.
+        ASSERT (!new_node->is_black)
+        ASSERT((new_node->left == nullptr) || (new_node->left->is_black));
+        ASSERT((new_node->right == nullptr) || (new_node->right->is_black));
+        break;
+      }
+      else if ((uncle_node != nullptr) && (uncle_node->is_black == false))
+      {
+        // The parent is red, so new_node can't be just yet. If the uncle is also red, then both it and the parent
+        // can be coloured black. The grandparent can be switched to red at this point. However, since the
+        // grandparent may be the root node (which must be black) or the child of another red node, pretend that
+        // we've just inserted it and take another look through the tree to check constraints.
+        new_node->parent->is_black = true;
+        uncle_node->is_black = true;
+
+        // The grandparent must exist, otherwise we couldn't have an uncle.
+        new_node->parent->parent->is_black = false;
+
+        // We've just created a new red node, so spin around to check that it still satisfies all constraints.
+        new_node = new_node->parent->parent;
+      }
+      else
       {
-        uncle_node = find_uncle(new_node);
-        if (new_node->parent == nullptr)
+        // Since our parent node is red, it cannot be root, so our grandparent node can be accessed without further
+        // checking. Keep separate track of the parent node throughout, in case we move to a leaf which is nullptr.
+        saved_parent = new_node->parent;
+        ASSERT((new_node == saved_parent->left) || (new_node == saved_parent->right));
+
+        if ((new_node == new_node->parent->right) && (new_node->parent == new_node->parent->parent->left))
         {
-          // The new node is at the root. Paint it black. The number of black nodes in each subtree is increased by
-          // one, equally.
-          new_node->is_black = true;
-          ASSERT(root == new_node);
-          break;
+          rotate_left(new_node->parent);
+          saved_parent = new_node;
+          new_node = new_node->left;
         }
-        else if (new_node->parent->is_black == true)
+        else if ((new_node == new_node->parent->left) && (new_node->parent == new_node->parent->parent->right))
         {
-          // The child of a black node can be either colour, and red doesn't affect the length of the routes to the
-          // leaves so no damage done. Nothing left to do.
-          ASSERT (!new_node->is_black)
-          ASSERT((new_node->left == nullptr) || (new_node->left->is_black));
-          ASSERT((new_node->right == nullptr) || (new_node->right->is_black));
-          break;
+          rotate_right(new_node->parent);
+          saved_parent = new_node;
+          new_node = new_node->right;
         }
-        else if ((uncle_node != nullptr) && (uncle_node->is_black == false))
+
+        ASSERT(saved_parent->parent->is_black);
+        ASSERT(saved_parent->is_black == false);
+        saved_parent->is_black = true;
+        saved_parent->parent->is_black = false;
+        if (new_node == saved_parent->left)
         {
-          // The parent is red, so new_node can't be just yet. If the uncle is also red, then both it and the parent
-          // can be coloured black. The grandparent can be switched to red at this point. However, since the
-          // grandparent may be the root node (which must be black) or the child of another red node, pretend that
-          // we've just inserted it and take another look through the tree to check constraints.
-          new_node->parent->is_black = true;
-          uncle_node->is_black = true;
-
-          // The grandparent must exist, otherwise we couldn't have an uncle.
-          new_node->parent->parent->is_black = false;
-
-          // We've just created a new red node, so spin around to check that it still satisfies all constraints.
-          new_node = new_node->parent->parent;
+          rotate_right(saved_parent->parent);
         }
         else
         {
-          // Since our parent node is red, it cannot be root, so our grandparent node can be accessed without further
-          // checking. Keep separate track of the parent node throughout, in case we move to a leaf which is nullptr.
-          saved_parent = new_node->parent;
-          ASSERT((new_node == saved_parent->left) || (new_node == saved_parent->right));
-
-          if ((new_node == new_node->parent->right) && (new_node->parent == new_node->parent->parent->left))
-          {
-            rotate_left(new_node->parent);
-            saved_parent = new_node;
-            new_node = new_node->left;
-          }
-          else if ((new_node == new_node->parent->left) && (new_node->parent == new_node->parent->parent->right))
-          {
-            rotate_right(new_node->parent);
-            saved_parent = new_node;
-            new_node = new_node->right;
-          }
-
-          ASSERT(saved_parent->parent->is_black);
-          ASSERT(saved_parent->is_black == false);
-          saved_parent->is_black = true;
-          saved_parent->parent->is_black = false;
-          if (new_node == saved_parent->left)
-          {
-            rotate_right(saved_parent->parent);
-          }
-          else
-          {
-            ASSERT(new_node == saved_parent->right);
-            rotate_left(saved_parent->parent);
-          }
+          ASSERT(new_node == saved_parent->right);
+          rotate_left(saved_parent->parent);
+        }
 
-          ASSERT((new_node == nullptr) || (!new_node->is_black));
-          ASSERT(saved_parent->is_black);
+        ASSERT((new_node == nullptr) || (!new_node->is_black));
+        ASSERT(saved_parent->is_black);
 
-          break;
-        }
+        break;
       }
+    }
 
-      if (!new_node->is_black)
-      {
-        ASSERT((new_node->left == nullptr) || (new_node->left->is_black));
-        ASSERT((new_node->right == nullptr) || (new_node->right->is_black));
-      }
+    if (!new_node->is_black)
+    {
+      ASSERT((new_node->left == nullptr) || (new_node->left->is_black));
+      ASSERT((new_node->right == nullptr) || (new_node->right->is_black));
+    }
     }
 
     number_of_leaves++;
   }
 
-  /// @brief Remove the node associated with key from the tree
+  /// @brief Find the node with the next largest key.
   ///
-  /// @param key The key to remove. This has no effect on the lifetime of either key or the associated value, which is
-  ///            controlled by the user. The key **must** be contained within the tree.
-  void remove(key_type key)
+  /// @param node The node to start from.
+  ///
+  /// @return The next node in key order, or nullptr if node is the last.
+  static tree_node *next_node(tree_node *node)
   {
-    tree_node *node_to_delete = node_search(nullptr, key);
-    ASSERT((node_to_delete != nullptr) && (node_to_delete->key == key));
+    ASSERT(node != nullptr);
 
-    remove_node(node_to_delete);
-  }
+    if (node->right != nullptr)
+    {
+      node = node->right;
+      while (node->left != nullptr)
+      {
+        node = node->left;
+      }
+    }
+    else
+    {
+      while ((node->parent != nullptr) && (node == node->parent->right))
+      {
+        node = node->parent;
+      }
+      node = node->parent;
+    }
 
-  /// @brief Determines if key is in the tree
-  ///
-  /// @param key The key to look for
-  ///
-  /// @return True if the key is found in the tree, False otherwise.
-  bool contains(key_type key)
-  {
-    tree_node *result = node_search(nullptr, key);
-    return ((result != nullptr) && (result->key == key));
+    return node;
   }
 
-  /// @brief Return the value associated with the key
+  /// @brief Find the node with the next smallest key.
   ///
-  /// @param key The key to look for. Key **must** be part of the tree.
+  /// @param node The node to start from.
   ///
-  /// @return The value associated with the key.
-  value_type search(key_type key)
+  /// @return The previous node in key order, or nullptr if node is the first.
+  static tree_node *prev_node(tree_node *node)
   {
-    tree_node *result = node_search(nullptr, key);
-    ASSERT((result != nullptr) && (result->key == key));
-
-    return result->value;
-  }
+    ASSERT(node != nullptr);
 
-  bool get_root_node_key(key_type &out)
-  {
-    if (root != nullptr)
+    if (node->left != nullptr)
     {
-      out = root->key;
-      return true;
+      node = node->left;
+      while (node->right != nullptr)
+      {
+        node = node->right;
+      }
+    }
+    else
+    {
+      while ((node->parent != nullptr) && (node == node->parent->left))
+      {
+        node = node->parent;
+      }
+      node = node->parent;
     }
-    return false;
-  }
 
-  /// @brief Verifies the tree is a valid Red-Black Tree.
-  ///
-  /// **THIS FUNCTION IS INTENDED FOR TEST CODE ONLY** - although it should function normally in all code.
-  ///
-  /// Panics if a fault is found.
-  void debug_verify_tree()
-  {
-    ASSERT(debug_check_node(root));
-    debug_verify_black_length(root);
+    return node;
   }
 
-protected:
-  /// @brief When removing nodes, did we replace it with the left child last time?
-  bool left_side_last;
-
   /// @brief Keep traversing down the left side of the tree from this point, looking for the leaf.
   ///
   /// @param start The node to start looking from
@@ -495,15 +685,119 @@ protected:
     }
   }
 
+  /// @brief Point whichever link referred to old_child at new_child instead.
+  ///
+  /// @param parent The parent of old_child, or nullptr if old_child is the root.
+  ///
+  /// @param old_child The node being replaced.
+  ///
+  /// @param new_child The node to replace it with.
+  void replace_child(tree_node *parent, tree_node *old_child, tree_node *new_child)
+  {
+    if (parent == nullptr)
+    {
+      ASSERT(root == old_child);
+      root = new_child;
+    }
+    else if (parent->left == old_child)
+    {
+      parent->left = new_child;
+    }
+    else
+    {
+      ASSERT(parent->right == old_child);
+      parent->right = new_child;
+    }
+  }
+
+  /// @brief Exchange the positions and colours of two nodes in the tree.
+  ///
+  /// The nodes themselves are not modified other than their links, so pointers to them (and to any objects containing
+  /// them) remain valid.
+  ///
+  /// @param upper A node in the tree.
+  ///
+  /// @param lower A node in the subtree below upper.
+  void swap_nodes(tree_node *upper, tree_node *lower)
+  {
+    tree_node *upper_parent = upper->parent;
+    tree_node *upper_left = upper->left;
+    tree_node *upper_right = upper->right;
+    tree_node *lower_parent = lower->parent;
+    tree_node *lower_left = lower->left;
+    tree_node *lower_right = lower->right;
+    bool upper_black = upper->is_black;
+
+    ASSERT(upper != lower);
+
+    replace_child(upper_parent, upper, lower);
+    lower->parent = upper_parent;
+
+    if (lower_parent == upper)
+    {
+      // lower is a direct child of upper, so upper becomes its child in turn.
+      if (upper_left == lower)
+      {
+        lower->left = upper;
+        lower->right = upper_right;
+        if (upper_right != nullptr)
+        {
+          upper_right->parent = lower;
+        }
+      }
+      else
+      {
+        lower->right = upper;
+        lower->left = upper_left;
+        if (upper_left != nullptr)
+        {
+          upper_left->parent = lower;
+        }
+      }
+      upper->parent = lower;
+    }
+    else
+    {
+      lower->left = upper_left;
+      lower->right = upper_right;
+      if (upper_left != nullptr)
+      {
+        upper_left->parent = lower;
+      }
+      if (upper_right != nullptr)
+      {
+        upper_right->parent = lower;
+      }
+
+      replace_child(lower_parent, lower, upper);
+      upper->parent = lower_parent;
+    }
+
+    upper->left = lower_left;
+    upper->right = lower_right;
+    if (lower_left != nullptr)
+    {
+      lower_left->parent = upper;
+    }
+    if (lower_right != nullptr)
+    {
+      lower_right->parent = upper;
+    }
+
+    upper->is_black = lower->is_black;
+    lower->is_black = upper_black;
+  }
+
   /// @brief Removes the specified node from the tree
   ///
-  /// After removing the node, join up the tree in the most appropriate manner
+  /// After removing the node, join up the tree in the most appropriate manner. The node itself is not freed.
   ///
   /// @param node The node to remove.
-  void remove_node(tree_node *node)
+  void detach_node(tree_node *node)
   {
     tree_node *successor = nullptr;
     tree_node *child = nullptr;
+    tree_node *parent;
     bool child_was_black = true;
     bool left_side_deleted = false;
 
@@ -512,11 +806,12 @@ protected:
     if ((node->left != nullptr) && (node->right != nullptr))
     {
       // Two children. We alternate between choosing a successor from the left and right sides, to try and keep the
-      // tree as balanced as possible (although there is no guarantee of balanced-ness). There are no red-black
-      // specific actions, as we've copied a key and value and the tree colours remain unchanged for now.
+      // tree as balanced as possible (although there is no guarantee of balanced-ness). The successor takes the place
+      // of the node being removed, including its colour, so the tree is unchanged in red-black terms. The node being
+      // removed now has at most one child, which is covered by the "zero or one children" case, below.
       //
-      // However, removing the successor node might change that, but that will be covered by the "zero or one children"
-      // case, below.
+      // Swapping the nodes, rather than copying the successor's key and value, keeps nodes where their owners put
+      // them - which matters for intrusive trees and iterators.
       if (left_side_last)
       {
         successor = find_left_leaf(node->right);
@@ -525,62 +820,60 @@ protected:
       {
         successor = find_right_leaf(node->left);
       }
+      left_side_last = !left_side_last;
 
       ASSERT(successor != nullptr);
       ASSERT((successor->left == nullptr) || (successor->right == nullptr));
 
-      node->key = successor->key;
-      node->value = successor->value;
-
-      remove_node(successor);
+      swap_nodes(node, successor);
     }
-    else
-    {
-      // Zero or one children
-      child = (node->left == nullptr) ? (node->right) : (node->left);
 
-      // Replace the node with the child in the tree. The child must be black - either it was already black, or the
-      // parent was, and it was red. But in the case where only one is red, we want a black survivor and can get rid
-      // of the red node without affecting the tree.
-      if (child != nullptr)
-      {
-        child_was_black = child->is_black;
-        child->is_black = true;
-        child->parent = node->parent;
-      }
+    // Zero or one children
+    child = (node->left == nullptr) ? (node->right) : (node->left);
+    parent = node->parent;
+
+    // Replace the node with the child in the tree. The child must be black - either it was already black, or the
+    // parent was, and it was red. But in the case where only one is red, we want a black survivor and can get rid
+    // of the red node without affecting the tree.
+    if (child != nullptr)
+    {
+      child_was_black = child->is_black;
+      child->is_black = true;
+      child->parent = parent;
+    }
 
-      if (node->parent != nullptr)
+    if (parent != nullptr)
+    {
+      if (parent->left == node)
       {
-        if (node->parent->left == node)
-        {
-          node->parent->left = child;
-          left_side_deleted = true;
-        }
-        else
-        {
-          ASSERT(node->parent->right == node);
-          node->parent->right = child;
-          left_side_deleted = false;
-        }
+        parent->left = child;
+        left_side_deleted = true;
       }
       else
       {
-        root = child;
-      }
-
-      // If one of the two nodes was red, that's enough. But if both were black, the tree now needs rebalancing around
-      // the newly promoted child node.
-      if ((node->is_black) && (child_was_black) && (node->parent != nullptr))
-      {
-        // Use node->parent rather than child->parent (which would match the new tree structure better) because child
-        // might be nullptr.
-        rebalance_after_delete(node->parent, left_side_deleted);
+        ASSERT(parent->right == node);
+        parent->right = child;
+        left_side_deleted = false;
       }
+    }
+    else
+    {
+      root = child;
+    }
 
-      delete node;
-      node = nullptr;
+    // If one of the two nodes was red, that's enough. But if both were black, the tree now needs rebalancing around
+    // the newly promoted child node.
+    if ((node->is_black) && (child_was_black) && (parent != nullptr))
+    {
+      // Use the parent rather than child->parent (which would match the new tree structure better) because child
+      // might be nullptr.
+      rebalance_after_delete(parent, left_side_deleted);
     }
 
+    node->left = nullptr;
+    node->right = nullptr;
+    node->parent = nullptr;
+
     number_of_leaves--;
   }
 
@@ -767,22 +1060,6 @@ protected:
     }
   }
 
-  /// @brief Delete a node and all its descendants.
-  ///
-  /// @param node The node to delete
-  void delete_node(tree_node *node)
-  {
-    if (node->left != nullptr)
-    {
-      delete_node(node->left);
-    }
-    if (node->right != nullptr)
-    {
-      delete_node(node->right);
-    }
-    delete node;
-  }
-
   /// @brief Search for a node in the tree below start_node
   ///
   /// @param start_node The node to start looking from
@@ -945,4 +1222,256 @@ protected:
   }
 };
 
+/// @brief KLib Red-Black Tree
+///
+/// Provides a simple red-black tree implementation. Not as capable as the standard C++ library one, but with no
+/// external dependencies. The tree is entirely **thread-unsafe**. Two simultaneous operations on it may leave the tree
+/// in an inconsistent state.
+///
+/// Nodes removed from the tree are kept in a pool and reused by later insertions, so a tree whose size stays roughly
+/// constant stops allocating memory. Use trim_node_pool() to free the pool.
+///
+/// @tparam key_type The type to be used as the key in the tree. See kl_rb_tree_base.
+///
+/// @tparam value_type The type of the values being stored in the array. See kl_rb_tree_base. Pooled nodes hold a
+///                    default constructed key and value, so both must be default constructible.
+template <class key_type, class value_type> class kl_rb_tree : public kl_rb_tree_base<key_type, value_type>
+{
+public:
+  /// @brief The type of nodes in this tree.
+  typedef typename kl_rb_tree_base<key_type, value_type>::tree_node tree_node;
+
+  /// @brief Standard constructor. No copy or other constructor is provided at present.
+  kl_rb_tree() : free_nodes(nullptr), free_node_count(0)
+  {
+  }
+
+  /// @brief Standard destructor.
+  ///
+  /// Frees all memory associated with the tree, but destroying the keys or values themselves is the responsibility of
+  /// the user.
+  ~kl_rb_tree()
+  {
+    clear_tree();
+    trim_node_pool();
+  }
+
+  /// @brief Delete all leaves within the tree.
+  ///
+  /// The nodes are kept in the pool for reuse.
+  void clear_tree()
+  {
+    if (this->root != nullptr)
+    {
+      release_subtree(this->root);
+      this->root = nullptr;
+      this->number_of_leaves = 0;
+    }
+  }
+
+  /// @brief Insert a key-value pair in to the tree
+  ///
+  /// @param key The key to use. Must provide the necessary operators.
+  ///
+  /// @param value The value to insert. This is opaque to the tree data structure.
+  void insert(const key_type &key, const value_type &value)
+  {
+    tree_node *parent;
+    tree_node *node = this->find_insert_point(key, parent);
+
+    if (node != nullptr)
+    {
+      node->value = value;
+    }
+    else
+    {
+      node = allocate_node();
+      node->key = key;
+      node->value = value;
+      this->attach_node(node, parent);
+    }
+  }
+
+  /// @brief Remove the node associated with key from the tree
+  ///
+  /// @param key The key to remove. This has no effect on the lifetime of either key or the associated value, which is
+  ///            controlled by the user. The key **must** be contained within the tree.
+  void remove(const key_type &key)
+  {
+    tree_node *node_to_delete = this->find_node(key);
+    ASSERT(node_to_delete != nullptr);
+
+    this->detach_node(node_to_delete);
+    release_node(node_to_delete);
+  }
+
+  /// @brief Find the value associated with a key, without copying it.
+  ///
+  /// @param key The key to look for.
+  ///
+  /// @return A pointer to the value, which remains valid until the key is removed from the tree. nullptr if the key is
+  ///         not in the tree.
+  value_type *find(const key_type &key)
+  {
+    tree_node *node = this->find_node(key);
+    return (node == nullptr) ? nullptr : &node->value;
+  }
+
+  /// @brief Make sure that at least this many nodes can be inserted without allocating memory.
+  ///
+  /// @param count The number of nodes to have available in the pool.
+  void reserve_nodes(uint64_t count)
+  {
+    tree_node *node;
+
+    while (free_node_count < count)
+    {
+      node = new tree_node;
+      release_node(node);
+    }
+  }
+
+  /// @brief Free all nodes held in the pool.
+  void trim_node_pool()
+  {
+    tree_node *node;
+
+    while (free_nodes != nullptr)
+    {
+      node = free_nodes;
+      free_nodes = node->right;
+      delete node;
+    }
+    free_node_count = 0;
+  }
+
+protected:
+  /// @brief Nodes available for reuse, linked through their right pointers.
+  tree_node *free_nodes;
+
+  /// @brief The number of nodes in free_nodes.
+  uint64_t free_node_count;
+
+  /// @brief Get a node from the pool, or allocate a new one if the pool is empty.
+  ///
+  /// @return A node, not in any tree.
+  tree_node *allocate_node()
+  {
+    tree_node *node = free_nodes;
+
+    if (node != nullptr)
+    {
+      free_nodes = node->right;
+      free_node_count--;
+    }
+    else
+    {
+      node = new tree_node;
+    }
+
+    return node;
+  }
+
+  /// @brief Return a node to the pool.
+  ///
+  /// The key and value are reset, so that anything they hold is released now rather than when the node is reused.
+  ///
+  /// @param node The node to release. Must not be in a tree.
+  void release_node(tree_node *node)
+  {
+    node->key = key_type();
+    node->value = value_type();
+    node->left = nullptr;
+    node->parent = nullptr;
+    node->right = free_nodes;
+    free_nodes = node;
+    free_node_count++;
+  }
+
+  /// @brief Return a node and all its descendants to the pool.
+  ///
+  /// @param node The node to release
+  void release_subtree(tree_node *node)
+  {
+    if (node->left != nullptr)
+    {
+      release_subtree(node->left);
+    }
+    if (node->right != nullptr)
+    {
+      release_subtree(node->right);
+    }
+    release_node(node);
+  }
+};
+
+/// @brief KLib intrusive Red-Black Tree
+///
+/// A red-black tree of nodes provided by the caller, normally embedded in the objects being stored. The tree never
+/// allocates or frees memory, and removing a node needs no search. This makes it suitable for structures that are
+/// updated often, or where memory allocation is not permitted, such as timers.
+///
+/// The caller sets the key and value of a node before inserting it, and must not change the key while the node is in
+/// the tree. A node can only be in one tree at a time. The tree is entirely **thread-unsafe**.
+///
+/// @tparam key_type The type to be used as the key in the tree. See kl_rb_tree_base.
+///
+/// @tparam value_type The type of the value stored in each node, normally a pointer to the object containing it.
+template <class key_type, class value_type> class kl_intrusive_rb_tree : public kl_rb_tree_base<key_type, value_type>
+{
+public:
+  /// @brief The type of nodes in this tree.
+  typedef typename kl_rb_tree_base<key_type, value_type>::tree_node tree_node;
+
+  /// @brief Insert a node in to the tree.
+  ///
+  /// @param node The node to insert. Its key and value must already be set.
+  ///
+  /// @return True if the node was inserted. False if another node with the same key is already in the tree, in which
+  ///         case the tree is unchanged.
+  bool insert(tree_node *node)
+  {
+    tree_node *parent;
+    bool result = false;
+
+    ASSERT(node != nullptr);
+
+    if (this->find_insert_point(node->key, parent) == nullptr)
+    {
+      this->attach_node(node, parent);
+      result = true;
+    }
+
+    return result;
+  }
+
+  /// @brief Remove a node from the tree.
+  ///
+  /// @param node The node to remove. It **must** be in this tree.
+  void remove(tree_node *node)
+  {
+    ASSERT(node != nullptr);
+    ASSERT(this->find_node(node->key) == node);
+
+    this->detach_node(node);
+  }
+
+  /// @brief Find the node with a given key.
+  ///
+  /// @param key The key to look for.
+  ///
+  /// @return The node with that key, or nullptr if there isn't one.
+  tree_node *find(const key_type &key)
+  {
+    return this->find_node(key);
+  }
+
+  /// @brief Remove all nodes from the tree. The nodes themselves are not touched.
+  void clear_tree()
+  {
+    this->root = nullptr;
+    this->number_of_leaves = 0;
+  }
+};
+
 #endif
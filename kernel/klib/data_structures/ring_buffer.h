@@ -0,0 +1,448 @@
+/// @file
+/// @brief KLib lock-free ring buffers
+///
+/// Two ring buffers are provided:
+/// - kl_spsc_ring, for exactly one producer and one consumer. Neither side needs any atomic read-modify-write
+///   operations, so this is the cheapest option where it applies.
+/// - kl_mpmc_ring, for any number of producers and consumers. This is the bounded queue described by Dmitry Vyukov,
+///   where each slot carries a sequence number saying whether it is ready to be written or read.
+///
+/// Both rings have a power-of-two capacity, and use free-running 64-bit read and write counts that are masked to find a
+/// slot, so no slot needs to be left empty to distinguish a full ring from an empty one. Bulk operations copy as many
+/// entries as possible with at most two kl_memcpy() calls - one up to the end of the buffer and one from its start.
+///
+/// Because entries are copied with kl_memcpy(), the element type must be trivially copyable.
+
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+
+#include "klib/panic/panic.h"
+#include "klib/misc/assert.h"
+#include "klib/c_helpers/buffers.h"
+
+/// @brief The storage shared by both ring buffer types.
+///
+/// @tparam elem_type The type of entries stored in the ring.
+template <class elem_type> class kl_ring_storage
+{
+  static_assert(std::is_trivially_copyable<elem_type>::value, "Ring buffer entries are copied with kl_memcpy");
+
+public:
+  /// @brief Allocate storage for a ring.
+  ///
+  /// @param capacity The number of entries the ring can hold. Must be a non-zero power of two.
+  kl_ring_storage(uint64_t capacity) : _capacity(capacity), _mask(capacity - 1)
+  {
+    ASSERT((capacity != 0) && ((capacity & (capacity - 1)) == 0));
+    _buffer = new elem_type[capacity];
+  }
+
+  ~kl_ring_storage()
+  {
+    delete[] _buffer;
+  }
+
+  kl_ring_storage(const kl_ring_storage &) = delete;
+  kl_ring_storage &operator=(const kl_ring_storage &) = delete;
+
+  /// @brief Return the number of entries the ring can hold.
+  ///
+  /// @return The capacity of the ring.
+  uint64_t capacity() const
+  {
+    return _capacity;
+  }
+
+protected:
+  /// @brief Number of bytes to keep between the producer and consumer counts, so they are in different cache lines.
+  static const uint64_t CACHE_LINE_SIZE = 64;
+
+  /// @brief The entries of the ring.
+  elem_type *_buffer;
+
+  /// @brief The number of entries in _buffer.
+  const uint64_t _capacity;
+
+  /// @brief Mask to convert a read or write count in to an index in _buffer.
+  const uint64_t _mask;
+
+  /// @brief Copy entries in to the ring.
+  ///
+  /// @param pos The write count of the first entry to copy. The entries must be reserved for the caller.
+  ///
+  /// @param items The entries to copy.
+  ///
+  /// @param count The number of entries to copy. No more than the capacity of the ring.
+  void copy_in(uint64_t pos, const elem_type *items, uint64_t count)
+  {
+    uint64_t idx = pos & _mask;
+    uint64_t first_part = _capacity - idx;
+
+    if (first_part > count)
+    {
+      first_part = count;
+    }
+
+    kl_memcpy(items, _buffer + idx, first_part * sizeof(elem_type));
+    if (first_part < count)
+    {
+      kl_memcpy(items + first_part, _buffer, (count - first_part) * sizeof(elem_type));
+    }
+  }
+
+  /// @brief Copy entries out of the ring.
+  ///
+  /// @param pos The read count of the first entry to copy. The entries must be reserved for the caller.
+  ///
+  /// @param items Buffer to copy the entries in to.
+  ///
+  /// @param count The number of entries to copy. No more than the capacity of the ring.
+  void copy_out(uint64_t pos, elem_type *items, uint64_t count)
+  {
+    uint64_t idx = pos & _mask;
+    uint64_t first_part = _capacity - idx;
+
+    if (first_part > count)
+    {
+      first_part = count;
+    }
+
+    kl_memcpy(_buffer + idx, items, first_part * sizeof(elem_type));
+    if (first_part < count)
+    {
+      kl_memcpy(_buffer, items + first_part, (count - first_part) * sizeof(elem_type));
+    }
+  }
+};
+
+/// @brief KLib single-producer, single-consumer ring buffer
+///
+/// Exactly one thread may add entries, and exactly one thread may remove them, at any one time. Those may be different
+/// threads, and neither needs a lock. If there could be more than one of either, use kl_mpmc_ring or a lock instead.
+///
+/// @tparam elem_type The type of entries stored in the ring. Must be trivially copyable.
+template <class elem_type> class kl_spsc_ring : public kl_ring_storage<elem_type>
+{
+public:
+  /// @brief Create a ring.
+  ///
+  /// @param capacity The number of entries the ring can hold. Must be a non-zero power of two.
+  kl_spsc_ring(uint64_t capacity) : kl_ring_storage<elem_type>(capacity), _write_count(0), _read_count(0)
+  {
+  }
+
+  /// @brief How many entries are waiting to be read?
+  ///
+  /// Exact when called by the consumer, otherwise it may be out of date by the time it is used.
+  ///
+  /// @return The number of entries in the ring.
+  uint64_t entries_available() const
+  {
+    return _write_count.load(std::memory_order_acquire) - _read_count.load(std::memory_order_acquire);
+  }
+
+  /// @brief How many entries can be written before the ring is full?
+  ///
+  /// Exact when called by the producer, otherwise it may be out of date by the time it is used.
+  ///
+  /// @return The number of free slots in the ring.
+  uint64_t space_available() const
+  {
+    return this->_capacity - entries_available();
+  }
+
+  /// @brief Add one entry to the ring. Only the producer may call this.
+  ///
+  /// @param item The entry to add.
+  ///
+  /// @return True if the entry was added, false if the ring is full.
+  bool push(const elem_type &item)
+  {
+    return (push_bulk(&item, 1) == 1);
+  }
+
+  /// @brief Remove one entry from the ring. Only the consumer may call this.
+  ///
+  /// @param[out] item The entry removed. Unchanged if the ring is empty.
+  ///
+  /// @return True if an entry was removed, false if the ring is empty.
+  bool pop(elem_type &item)
+  {
+    return (pop_bulk(&item, 1) == 1);
+  }
+
+  /// @brief Add as many entries as will fit to the ring. Only the producer may call this.
+  ///
+  /// @param items The entries to add.
+  ///
+  /// @param count The number of entries in items.
+  ///
+  /// @return The number of entries added, which is less than count if the ring filled up.
+  uint64_t push_bulk(const elem_type *items, uint64_t count)
+  {
+    uint64_t write_pos = _write_count.load(std::memory_order_relaxed);
+    uint64_t space = this->_capacity - (write_pos - _read_count.load(std::memory_order_acquire));
+
+    if (count > space)
+    {
+      count = space;
+    }
+
+    if (count != 0)
+    {
+      this->copy_in(write_pos, items, count);
+
+      // Publish the new entries only once they have been copied.
+      _write_count.store(write_pos + count, std::memory_order_release);
+    }
+
+    return count;
+  }
+
+  /// @brief Remove as many entries as are available from the ring, up to a limit. Only the consumer may call this.
+  ///
+  /// @param items Buffer to copy the entries in to.
+  ///
+  /// @param count The maximum number of entries to remove.
+  ///
+  /// @return The number of entries removed.
+  uint64_t pop_bulk(elem_type *items, uint64_t count)
+  {
+    uint64_t read_pos = _read_count.load(std::memory_order_relaxed);
+    uint64_t avail = _write_count.load(std::memory_order_acquire) - read_pos;
+
+    if (count > avail)
+    {
+      count = avail;
+    }
+
+    if (count != 0)
+    {
+      this->copy_out(read_pos, items, count);
+
+      // Release the slots only once their contents have been copied out.
+      _read_count.store(read_pos + count, std::memory_order_release);
+    }
+
+    return count;
+  }
+
+protected:
+  /// @brief The total number of entries ever written. Only changed by the producer.
+  std::atomic<uint64_t> _write_count;
+
+  /// @brief Keeps the two counts in separate cache lines.
+  uint8_t _padding[kl_ring_storage<elem_type>::CACHE_LINE_SIZE];
+
+  /// @brief The total number of entries ever read. Only changed by the consumer.
+  std::atomic<uint64_t> _read_count;
+};
+
+/// @brief KLib multi-producer, multi-consumer ring buffer
+///
+/// Any number of threads may add and remove entries at once, without locks. An entry becomes readable once its own
+/// producer has finished copying it in, so while several producers are active a consumer may briefly see fewer entries
+/// than have been reserved.
+///
+/// @tparam elem_type The type of entries stored in the ring. Must be trivially copyable.
+template <class elem_type> class kl_mpmc_ring : public kl_ring_storage<elem_type>
+{
+public:
+  /// @brief Create a ring.
+  ///
+  /// @param capacity The number of entries the ring can hold. Must be a non-zero power of two.
+  kl_mpmc_ring(uint64_t capacity) : kl_ring_storage<elem_type>(capacity), _write_count(0), _read_count(0)
+  {
+    _sequences = new std::atomic<uint64_t>[capacity];
+    for (uint64_t i = 0; i < capacity; i++)
+    {
+      _sequences[i].store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~kl_mpmc_ring()
+  {
+    delete[] _sequences;
+  }
+
+  /// @brief Approximately how many entries are waiting to be read?
+  ///
+  /// @return The number of entries in the ring, which may be out of date by the time it is used.
+  uint64_t entries_available() const
+  {
+    uint64_t read_pos = _read_count.load(std::memory_order_acquire);
+    uint64_t write_pos = _write_count.load(std::memory_order_acquire);
+
+    return (write_pos > read_pos) ? (write_pos - read_pos) : 0;
+  }
+
+  /// @brief Approximately how many entries can be written before the ring is full?
+  ///
+  /// @return The number of free slots in the ring, which may be out of date by the time it is used.
+  uint64_t space_available() const
+  {
+    uint64_t entries = entries_available();
+
+    return (entries < this->_capacity) ? (this->_capacity - entries) : 0;
+  }
+
+  /// @brief Add one entry to the ring.
+  ///
+  /// @param item The entry to add.
+  ///
+  /// @return True if the entry was added, false if the ring is full.
+  bool push(const elem_type &item)
+  {
+    return (push_bulk(&item, 1) == 1);
+  }
+
+  /// @brief Remove one entry from the ring.
+  ///
+  /// @param[out] item The entry removed. Unchanged if the ring is empty.
+  ///
+  /// @return True if an entry was removed, false if the ring is empty.
+  bool pop(elem_type &item)
+  {
+    return (pop_bulk(&item, 1) == 1);
+  }
+
+  /// @brief Add as many entries as will fit to the ring.
+  ///
+  /// The entries added are consecutive in the ring, so a single consumer will read them in order and without entries
+  /// from other producers in between.
+  ///
+  /// @param items The entries to add.
+  ///
+  /// @param count The number of entries in items.
+  ///
+  /// @return The number of entries added, which is less than count if the ring filled up.
+  uint64_t push_bulk(const elem_type *items, uint64_t count)
+  {
+    uint64_t write_pos = _write_count.load(std::memory_order_relaxed);
+    uint64_t reserved = reserve(_write_count, write_pos, count, 0);
+
+    if (reserved != 0)
+    {
+      this->copy_in(write_pos, items, reserved);
+      publish(write_pos, reserved, 1);
+    }
+
+    return reserved;
+  }
+
+  /// @brief Remove as many entries as are available from the ring, up to a limit.
+  ///
+  /// @param items Buffer to copy the entries in to.
+  ///
+  /// @param count The maximum number of entries to remove.
+  ///
+  /// @return The number of entries removed.
+  uint64_t pop_bulk(elem_type *items, uint64_t count)
+  {
+    uint64_t read_pos = _read_count.load(std::memory_order_relaxed);
+    uint64_t reserved = reserve(_read_count, read_pos, count, 1);
+
+    if (reserved != 0)
+    {
+      this->copy_out(read_pos, items, reserved);
+      publish(read_pos, reserved, this->_capacity);
+    }
+
+    return reserved;
+  }
+
+protected:
+  /// @brief The sequence number of each slot.
+  ///
+  /// A slot whose sequence number equals a write count is free for the entry with that write count. One whose sequence
+  /// number is one greater than a read count holds the entry with that read count.
+  std::atomic<uint64_t> *_sequences;
+
+  /// @brief Keeps the write count out of the cache line holding the constant fields.
+  uint8_t _padding_a[kl_ring_storage<elem_type>::CACHE_LINE_SIZE];
+
+  /// @brief The write count of the next slot to be reserved by a producer.
+  std::atomic<uint64_t> _write_count;
+
+  /// @brief Keeps the two counts in separate cache lines.
+  uint8_t _padding_b[kl_ring_storage<elem_type>::CACHE_LINE_SIZE];
+
+  /// @brief The read count of the next slot to be reserved by a consumer.
+  std::atomic<uint64_t> _read_count;
+
+  /// @brief Reserve a run of slots that are ready for the caller.
+  ///
+  /// Used by both producers and consumers - a slot is ready for position pos if its sequence number is pos + offset.
+  ///
+  /// @param count_var The write or read count to advance past the reserved slots.
+  ///
+  /// @param[inout] pos On entry, a recent value of count_var. On exit, the position of the first reserved slot.
+  ///
+  /// @param count The maximum number of slots to reserve.
+  ///
+  /// @param offset 0 when reserving slots to write, 1 when reserving slots to read.
+  ///
+  /// @return The number of slots reserved. Zero if the ring is full (for producers) or empty (for consumers).
+  uint64_t reserve(std::atomic<uint64_t> &count_var, uint64_t &pos, uint64_t count, uint64_t offset)
+  {
+    uint64_t ready;
+    int64_t diff;
+
+    if (count > this->_capacity)
+    {
+      count = this->_capacity;
+    }
+
+    while (count != 0)
+    {
+      for (ready = 0; ready < count; ready++)
+      {
+        if (_sequences[(pos + ready) & this->_mask].load(std::memory_order_acquire) != (pos + ready + offset))
+        {
+          break;
+        }
+      }
+
+      if (ready == 0)
+      {
+        // If the first slot is behind pos, it still holds an entry to be read (or space not yet written) from the
+        // previous lap, and there is nothing to reserve. Otherwise, another thread has already moved past it.
+        diff = static_cast<int64_t>(_sequences[pos & this->_mask].load(std::memory_order_acquire) - (pos + offset));
+        if (diff < 0)
+        {
+          break;
+        }
+        pos = count_var.load(std::memory_order_relaxed);
+      }
+      else if (count_var.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed))
+      {
+        // The slots were all ready while count_var still equalled pos, so no other thread can have reserved them.
+        return ready;
+      }
+    }
+
+    return 0;
+  }
+
+  /// @brief Mark reserved slots as ready for the other side.
+  ///
+  /// @param pos The position of the first slot.
+  ///
+  /// @param count The number of slots.
+  ///
+  /// @param offset Added to each slot's position to give its new sequence number - 1 after writing, or the capacity
+  ///               of the ring after reading.
+  void publish(uint64_t pos, uint64_t count, uint64_t offset)
+  {
+    for (uint64_t i = 0; i < count; i++)
+    {
+      _sequences[(pos + i) & this->_mask].store(pos + i + offset, std::memory_order_release);
+    }
+  }
+};
+
+#endif
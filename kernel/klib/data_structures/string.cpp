@@ -10,39 +10,41 @@ namespace
   char out_of_bounds;
 }
 
-kl_string::kl_string()
+kl_string::kl_string() : string_contents(short_buffer), buffer_length(SHORT_STRING_SIZE)
 {
-  this->buffer_length = 0;
-  this->string_contents = nullptr;
+  this->short_buffer[0] = 0;
 }
 
-kl_string::kl_string(const char *s)
+kl_string::kl_string(const char *s) : kl_string()
 {
   uint64_t sl = kl_strlen(s, 0) + 1;
-  this->string_contents = new char [sl];
-  this->buffer_length = sl;
+  this->allocate_buffer(sl);
 
   kl_memcpy(s, this->string_contents, sl);
 }
 
-kl_string::kl_string(const char *s, uint64_t len)
+kl_string::kl_string(const char *s, uint64_t len) : kl_string()
 {
   uint64_t sl = kl_strlen(s, len) + 1;
-  this->string_contents = new char [sl];
-  this->buffer_length = sl;
+  this->allocate_buffer(sl);
 
   kl_memcpy(s, this->string_contents, sl - 1);
   this->string_contents[sl - 1] = 0;
 }
 
-kl_string::kl_string(const kl_string &s)
+kl_string::kl_string(const kl_string_view &s) : kl_string(s.data(), s.length())
 {
-  this->buffer_length = s.buffer_length;
-  this->string_contents = new char[this->buffer_length];
-  kl_memcpy(s.string_contents, this->string_contents, this->buffer_length);
 }
 
-kl_string::kl_string(kl_string &&s)
+kl_string::kl_string(const kl_string &s) : kl_string()
+{
+  uint64_t sl = s.length() + 1;
+  this->allocate_buffer(sl);
+
+  kl_memcpy(s.string_contents, this->string_contents, sl);
+}
+
+kl_string::kl_string(kl_string &&s) : kl_string()
 {
   this->move_kl_string(s);
 }
@@ -103,23 +105,24 @@ const bool kl_string::operator !=(const char *&s) const
 // Copy assignment operators
 kl_string &kl_string::operator =(const kl_string &s)
 {
-  this->reset_string();
-
-  this->buffer_length = s.buffer_length;
-  this->string_contents = new char[this->buffer_length];
+  uint64_t sl;
 
-  kl_memcpy(s.string_contents, this->string_contents, this->buffer_length);
+  if (this != &s)
+  {
+    sl = s.length() + 1;
+    this->allocate_buffer(sl);
+    kl_memcpy(s.string_contents, this->string_contents, sl);
+  }
 
   return *this;
 }
 
 kl_string &kl_string::operator =(const char *&s)
 {
-  this->reset_string();
+  uint64_t sl = kl_strlen(s, 0) + 1;
 
-  this->buffer_length = kl_strlen(s, 0) + 1;
-  this->string_contents = new char[this->buffer_length];
-  kl_memcpy(s, this->string_contents, this->buffer_length);
+  this->allocate_buffer(sl);
+  kl_memcpy(s, this->string_contents, sl);
 
   return *this;
 }
@@ -127,8 +130,11 @@ kl_string &kl_string::operator =(const char *&s)
 // Move assignment operator
 kl_string &kl_string::operator =(kl_string &&s)
 {
-  this->reset_string();
-  this->move_kl_string(s);
+  if (this != &s)
+  {
+    this->reset_string();
+    this->move_kl_string(s);
+  }
 
   return *this;
 }
@@ -141,8 +147,7 @@ kl_string kl_string::operator +(const kl_string &s) const
   uint64_t required_size = our_length + other_length + 1;
   kl_string new_string;
 
-  new_string.buffer_length = required_size;
-  new_string.string_contents = new char[required_size];
+  new_string.allocate_buffer(required_size);
 
   kl_memcpy(this->string_contents, new_string.string_contents, our_length);
   kl_memcpy(s.string_contents, (new_string.string_contents + our_length), other_length + 1);
@@ -157,8 +162,7 @@ kl_string kl_string::operator +(const char *&s) const
   uint64_t required_size = our_length + other_length + 1;
   kl_string new_string;
 
-  new_string.buffer_length = required_size;
-  new_string.string_contents = new char[required_size];
+  new_string.allocate_buffer(required_size);
 
   kl_memcpy(this->string_contents, new_string.string_contents, our_length);
   kl_memcpy(s, (new_string.string_contents + our_length), other_length + 1);
@@ -212,6 +216,13 @@ const uint64_t kl_string::length() const
   return kl_strlen(this->string_contents, this->buffer_length);
 }
 
+// Only the characters before the terminating zero are hashed, so that all the ways of storing an empty string hash to
+// the same value.
+const uint64_t kl_string::hash() const
+{
+  return kl_string_view(*this).hash();
+}
+
 kl_string kl_string::substr(uint64_t start, uint64_t len) const
 {
   kl_string ret_string;
@@ -228,8 +239,7 @@ kl_string kl_string::substr(uint64_t start, uint64_t len) const
       len = our_len - start;
     }
 
-    ret_string.buffer_length = len + 1;
-    ret_string.string_contents = new char[ret_string.buffer_length];
+    ret_string.allocate_buffer(len + 1);
 
     kl_memcpy((this->string_contents + start), ret_string.string_contents, len);
     ret_string.string_contents[len] = 0;
@@ -240,34 +250,162 @@ kl_string kl_string::substr(uint64_t start, uint64_t len) const
 
 void kl_string::reset_string()
 {
-  if (this->string_contents)
+  if (this->string_contents != this->short_buffer)
   {
     delete[] this->string_contents;
-    this->string_contents = nullptr;
-    this->buffer_length = 0;
+  }
+
+  this->string_contents = this->short_buffer;
+  this->buffer_length = SHORT_STRING_SIZE;
+  this->short_buffer[0] = 0;
+}
+
+void kl_string::allocate_buffer(uint64_t size)
+{
+  this->reset_string();
+
+  if (size > SHORT_STRING_SIZE)
+  {
+    this->string_contents = new char[size];
+    this->buffer_length = size;
   }
 }
 
 void kl_string::resize_buffer(uint64_t new_size)
 {
-  char *new_buf = new char[new_size];
+  char *new_buf;
+  uint64_t copy_length = (new_size < this->buffer_length ? new_size : this->buffer_length);
+
+  ASSERT(new_size != 0);
 
-  if ((this->buffer_length) != 0 && (this->string_contents != nullptr))
+  if ((this->string_contents == this->short_buffer) && (new_size <= SHORT_STRING_SIZE))
   {
-    kl_memcpy(this->string_contents, new_buf, (new_size < this->buffer_length ? new_size : this->buffer_length));
-    new_buf[new_size - 1] = 0;
-    delete[] this->string_contents;
+    this->short_buffer[new_size - 1] = 0;
   }
+  else
+  {
+    new_buf = (new_size <= SHORT_STRING_SIZE) ? this->short_buffer : new char[new_size];
+    kl_memcpy(this->string_contents, new_buf, copy_length);
+    new_buf[new_size - 1] = 0;
+
+    if (this->string_contents != this->short_buffer)
+    {
+      delete[] this->string_contents;
+    }
 
-  this->string_contents = new_buf;
-  this->buffer_length = new_size;
+    this->string_contents = new_buf;
+    this->buffer_length = (new_size <= SHORT_STRING_SIZE) ? SHORT_STRING_SIZE : new_size;
+  }
 }
 
 void kl_string::move_kl_string(kl_string &s)
 {
-  this->buffer_length = s.buffer_length;
-  this->string_contents = s.string_contents;
+  // The caller must have released this string's buffer.
+  ASSERT(this->string_contents == this->short_buffer);
 
-  s.buffer_length = 0;
-  s.string_contents = nullptr;
+  if (s.string_contents == s.short_buffer)
+  {
+    kl_memcpy(s.short_buffer, this->short_buffer, SHORT_STRING_SIZE);
+  }
+  else
+  {
+    this->string_contents = s.string_contents;
+    this->buffer_length = s.buffer_length;
+  }
+
+  s.string_contents = s.short_buffer;
+  s.buffer_length = SHORT_STRING_SIZE;
+  s.short_buffer[0] = 0;
+}
+
+kl_string_view::kl_string_view(const char *s) : view_start(s), view_length(0)
+{
+  if (s == nullptr)
+  {
+    this->view_start = "";
+  }
+  else
+  {
+    this->view_length = kl_strlen(s, 0);
+  }
+}
+
+kl_string_view::kl_string_view(const kl_string &s) : view_start(s.c_str()), view_length(s.length())
+{
+}
+
+uint64_t kl_string_view::find(char c) const
+{
+  uint64_t result = npos;
+
+  for (uint64_t i = 0; i < this->view_length; i++)
+  {
+    if (this->view_start[i] == c)
+    {
+      result = i;
+      break;
+    }
+  }
+
+  return result;
+}
+
+uint64_t kl_string_view::find(const kl_string_view &substr) const
+{
+  uint64_t result = npos;
+
+  if (substr.view_length <= this->view_length)
+  {
+    for (uint64_t p = 0; p <= (this->view_length - substr.view_length); p++)
+    {
+      if (kl_memcmp(this->view_start + p, substr.view_start, substr.view_length) == 0)
+      {
+        result = p;
+        break;
+      }
+    }
+  }
+
+  return result;
+}
+
+kl_string_view kl_string_view::substr(uint64_t start, uint64_t len) const
+{
+  kl_string_view result;
+
+  if (start < this->view_length)
+  {
+    if ((len == npos) || (len > (this->view_length - start)))
+    {
+      len = this->view_length - start;
+    }
+
+    result = kl_string_view(this->view_start + start, len);
+  }
+
+  return result;
+}
+
+// This is the 64-bit FNV-1a hash.
+uint64_t kl_string_view::hash() const
+{
+  uint64_t hash_val = 0xCBF29CE484222325ULL;
+
+  for (uint64_t i = 0; i < this->view_length; i++)
+  {
+    hash_val ^= static_cast<uint8_t>(this->view_start[i]);
+    hash_val *= 0x100000001B3ULL;
+  }
+
+  return hash_val;
+}
+
+bool operator ==(const kl_string_view &a, const kl_string_view &b)
+{
+  return (a.length() == b.length()) && (kl_memcmp(a.data(), b.data(), a.length()) == 0);
+}
+
+bool operator !=(const kl_string_view &a, const kl_string_view &b)
+{
+  return !(a == b);
 }
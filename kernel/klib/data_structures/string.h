@@ -3,7 +3,12 @@
 
 #include <stdint.h>
 
+class kl_string_view;
+
 /// @brief A simplified version of the standard C++ string class
+///
+/// Strings short enough to fit in a small buffer inside the object itself are stored there, so most names used by
+/// System Tree and the rest of the kernel never touch the heap.
 class kl_string
 {
 public:
@@ -43,6 +48,11 @@ public:
   ///            only be copied up to the terminator.
   kl_string(const char *s, uint64_t len);
 
+  /// @brief Constructor that copies the contents of a string view.
+  ///
+  /// @param s The view to copy in to this string.
+  explicit kl_string(const kl_string_view &s);
+
   /// @brief Standard destructor
   ~kl_string();
 
@@ -103,16 +113,44 @@ public:
   /// @return A string containing the requested substring.
   kl_string substr(uint64_t start, uint64_t len) const;
 
+  /// @brief Calculate a hash of this string, for use in hash tables.
+  ///
+  /// Strings that compare equal have equal hashes.
+  ///
+  /// @return The hash of this string.
+  const uint64_t hash() const;
+
+  /// @brief Return a pointer to the characters of this string, which are followed by a terminating zero.
+  ///
+  /// @return The characters of this string. Valid until the string is next modified or destroyed.
+  const char *c_str() const
+  {
+    return string_contents;
+  }
+
 protected:
-  /// A buffer containing the string stored here. May be larger than is required.
+  /// The size of short_buffer. Strings of up to one character less than this are stored there, rather than on the heap.
+  static const uint64_t SHORT_STRING_SIZE = 24;
+
+  /// A buffer containing the string stored here. May be larger than is required. Either points at short_buffer, or a
+  /// buffer allocated from the heap.
   char *string_contents;
 
   /// The current length of the buffer used in string_contents.
   unsigned long buffer_length;
 
+  /// Storage for short strings.
+  char short_buffer[SHORT_STRING_SIZE];
+
   /// Destroys string_contents and buffer_length. Effectively sets the string to "".
   void reset_string();
 
+  /// Discard the contents of this string and provide a buffer of at least the requested size. The buffer contents are
+  /// undefined.
+  ///
+  /// @param size The number of bytes required, including the terminating zero.
+  void allocate_buffer(uint64_t size);
+
   /// Resize the buffer in string_contents to a new size.
   void resize_buffer(uint64_t new_size);
 
@@ -122,4 +160,107 @@ protected:
   void move_kl_string(kl_string &s);
 };
 
+/// @brief A non-owning reference to a sequence of characters.
+///
+/// Views are cheap to create and copy, and taking a part of one with substr() doesn't allocate memory, which makes them
+/// suitable for walking paths. The characters viewed need not be zero-terminated, and must outlive the view.
+class kl_string_view
+{
+public:
+  /// Has the same meaning as kl_string::npos.
+  static constexpr uint64_t npos = kl_string::npos;
+
+  /// @brief Create an empty view.
+  kl_string_view() : view_start(""), view_length(0) { }
+
+  /// @brief Create a view of a zero-terminated string.
+  ///
+  /// @param s The string to view, excluding its terminator. If nullptr, the view is empty.
+  kl_string_view(const char *s);
+
+  /// @brief Create a view of a given number of characters.
+  ///
+  /// @param s The first character to view.
+  ///
+  /// @param len The number of characters to view.
+  kl_string_view(const char *s, uint64_t len) : view_start(s), view_length(len) { }
+
+  /// @brief Create a view of the contents of a kl_string.
+  ///
+  /// @param s The string to view. The view is invalidated if s is modified or destroyed.
+  kl_string_view(const kl_string &s);
+
+  /// @brief Return a pointer to the first character viewed. The characters are not necessarily zero-terminated.
+  ///
+  /// @return The first character.
+  const char *data() const
+  {
+    return view_start;
+  }
+
+  /// @brief Return the number of characters viewed.
+  ///
+  /// @return The length of the view.
+  uint64_t length() const
+  {
+    return view_length;
+  }
+
+  /// @brief Is this view empty?
+  ///
+  /// @return True if the view contains no characters.
+  bool empty() const
+  {
+    return view_length == 0;
+  }
+
+  /// @brief Return a character from the view.
+  ///
+  /// @param pos The position of the character. Must be less than length().
+  ///
+  /// @return The character at pos.
+  char operator [](const uint64_t pos) const
+  {
+    return view_start[pos];
+  }
+
+  /// @brief Find the first instance of a character in this view.
+  ///
+  /// @param c The character to find.
+  ///
+  /// @return The position of c, or npos if it is not in this view.
+  uint64_t find(char c) const;
+
+  /// @brief Find the first instance of another string in this view.
+  ///
+  /// @param substr The string to find.
+  ///
+  /// @return The position of substr, or npos if it is not in this view.
+  uint64_t find(const kl_string_view &substr) const;
+
+  /// @brief Return a view of part of this one. No memory is allocated.
+  ///
+  /// @param start The zero-based position that the new view should start from.
+  ///
+  /// @param len The length of the new view. Use npos to view the remainder of this one.
+  ///
+  /// @return The requested part of this view. Empty if start is beyond the end of this view.
+  kl_string_view substr(uint64_t start, uint64_t len = npos) const;
+
+  /// @brief Calculate a hash of the viewed characters. Equal to the hash of a kl_string with the same contents.
+  ///
+  /// @return The hash of this view.
+  uint64_t hash() const;
+
+protected:
+  /// The first character viewed.
+  const char *view_start;
+
+  /// The number of characters viewed.
+  uint64_t view_length;
+};
+
+bool operator ==(const kl_string_view &a, const kl_string_view &b);
+bool operator !=(const kl_string_view &a, const kl_string_view &b);
+
 #endif
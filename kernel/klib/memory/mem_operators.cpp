@@ -36,6 +36,11 @@ namespace std
 void __throw_bad_alloc()
 {
   panic("Bad allocation!");
+
+  // The standard library declares this function noreturn, but panic() isn't declared that way, so make sure.
+  while (1)
+  {
+  }
 }
 }
 
@@ -0,0 +1,163 @@
+/// @file
+/// @brief A ring buffer wrapper that makes threads wait for entries or space.
+
+#ifndef KLIB_BLOCKING_RING
+#define KLIB_BLOCKING_RING
+
+#include <stdint.h>
+
+#include "klib/data_structures/ring_buffer.h"
+#include "processor/synch_objects.h"
+
+/// @brief Wraps kl_spsc_ring or kl_mpmc_ring so that readers wait for entries and writers wait for space.
+///
+/// The rules about how many producers and consumers there may be are those of the wrapped ring. The non-blocking
+/// operations of the ring remain available through ring(), and mixing the two is fine so long as the blocking
+/// operations are used on both sides whenever a thread might be waiting.
+///
+/// @tparam ring_type The type of ring to wrap - kl_spsc_ring<elem_type> or kl_mpmc_ring<elem_type>.
+///
+/// @tparam elem_type The type of entries stored in the ring.
+template <class ring_type, class elem_type> class kl_blocking_ring
+{
+public:
+  /// @brief Create a ring.
+  ///
+  /// @param capacity The number of entries the ring can hold. Must be a non-zero power of two.
+  kl_blocking_ring(uint64_t capacity) : _ring(capacity)
+  {
+  }
+
+  /// @brief Give access to the wrapped ring, for non-blocking operations.
+  ///
+  /// @return The wrapped ring.
+  ring_type &ring()
+  {
+    return _ring;
+  }
+
+  /// @brief Add one entry to the ring, waiting for space if the ring is full.
+  ///
+  /// @param item The entry to add.
+  void push(const elem_type &item)
+  {
+    push_bulk(&item, 1);
+  }
+
+  /// @brief Remove one entry from the ring, waiting for one if the ring is empty.
+  ///
+  /// @param[out] item The entry removed.
+  void pop(elem_type &item)
+  {
+    pop_bulk(&item, 1);
+  }
+
+  /// @brief Add entries to the ring, waiting for space as needed until all of them have been added.
+  ///
+  /// @param items The entries to add.
+  ///
+  /// @param count The number of entries in items.
+  void push_bulk(const elem_type *items, uint64_t count)
+  {
+    uint64_t added;
+
+    while (count != 0)
+    {
+      added = _ring.push_bulk(items, count);
+      items += added;
+      count -= added;
+
+      if (added != 0)
+      {
+        _readers.wake_all();
+      }
+
+      if (count != 0)
+      {
+        _writers.wait_for_signal_unless(ring_has_space, &_ring);
+      }
+    }
+  }
+
+  /// @brief Remove entries from the ring, waiting until there is at least one.
+  ///
+  /// @param items Buffer to copy the entries in to.
+  ///
+  /// @param count The maximum number of entries to remove. Must not be zero.
+  ///
+  /// @return The number of entries removed. At least one.
+  uint64_t pop_bulk(elem_type *items, uint64_t count)
+  {
+    uint64_t removed;
+
+    ASSERT(count != 0);
+
+    while (1)
+    {
+      removed = _ring.pop_bulk(items, count);
+      if (removed != 0)
+      {
+        _writers.wake_all();
+        break;
+      }
+
+      _readers.wait_for_signal_unless(ring_has_entries, &_ring);
+    }
+
+    return removed;
+  }
+
+protected:
+  /// @brief A WaitObject that wakes all its waiting threads at once, since any of them may be able to continue.
+  class ring_waiter : public WaitObject
+  {
+  public:
+    /// @brief Wake all threads waiting on this object.
+    void wake_all()
+    {
+      bool waiting;
+
+      // Check under the lock, so that a thread part way through wait_for_signal_unless() is either seen here or sees
+      // the change to the ring that caused this call.
+      klib_synch_spinlock_lock(this->_list_lock);
+      waiting = (this->_waiting_threads.head != nullptr);
+      klib_synch_spinlock_unlock(this->_list_lock);
+
+      if (waiting)
+      {
+        this->trigger_all_threads();
+      }
+    }
+  };
+
+  /// @brief The wrapped ring.
+  ring_type _ring;
+
+  /// @brief Threads waiting for entries to read.
+  ring_waiter _readers;
+
+  /// @brief Threads waiting for space to write in.
+  ring_waiter _writers;
+
+  /// @brief Does the ring have entries to read? Used as a wait condition.
+  ///
+  /// @param ring The ring to check.
+  ///
+  /// @return True if there is at least one entry.
+  static bool ring_has_entries(void *ring)
+  {
+    return (reinterpret_cast<ring_type *>(ring)->entries_available() != 0);
+  }
+
+  /// @brief Does the ring have space to write? Used as a wait condition.
+  ///
+  /// @param ring The ring to check.
+  ///
+  /// @return True if there is space for at least one entry.
+  static bool ring_has_space(void *ring)
+  {
+    return (reinterpret_cast<ring_type *>(ring)->space_available() != 0);
+  }
+};
+
+#endif
@@ -1,6 +1,8 @@
 // KLib Message Passing functions
 
 #include "klib/klib.h"
+#include "klib/data_structures/hash_map.h"
+#include "processor/timing/timing.h"
 
 bool operator == (const klib_message_hdr &a, const klib_message_hdr &b)
 {
@@ -18,13 +20,26 @@ bool operator != (const klib_message_hdr &a, const klib_message_hdr &b)
 namespace
 {
   // Stores mapping of Message names to IDs.
-  kl_rb_tree<kl_string, message_id_number> *msg_name_id_map = nullptr;
+  kl_hash_map<kl_string, message_id_number> *msg_name_id_map = nullptr;
 
   // Stores the inverse mapping
-  kl_rb_tree<message_id_number, kl_string> *msg_id_name_map = nullptr;
+  kl_hash_map<message_id_number, kl_string> *msg_id_name_map = nullptr;
 
   // Stores set of broadcast groups and their ID numbers
-  //std::map<somethingy something>
+  kl_rb_tree<uint64_t, klib_msg_broadcast_grp *> *msg_broadcast_groups = nullptr;
+
+  // Protects msg_broadcast_groups, and the list of groups each process belongs to. When both this lock and a group's
+  // lock are needed, this lock must be taken first.
+  kernel_spinlock msg_broadcast_groups_lock;
+
+  uint64_t msg_int_compute_deadline(uint64_t max_wait);
+  bool msg_int_wait_on_list(klib_list<kl_ref_ptr<task_thread>> &wait_list,
+                            kernel_spinlock &lock,
+                            uint64_t deadline);
+  task_thread *msg_int_wake_first(klib_list<kl_ref_ptr<task_thread>> &wait_list);
+  void msg_int_wake_all(klib_list<kl_ref_ptr<task_thread>> &wait_list);
+  void msg_int_answer_call(task_thread *caller, ERR_CODE result);
+  void msg_int_remove_from_grp(klib_msg_broadcast_grp *group, task_process *proc);
 }
 
 /// @brief Register a new message type and generate an ID for it.
@@ -42,8 +57,8 @@ ERR_CODE msg_register_msg_id(kl_string msg_name, message_id_number new_id_number
 
   if (msg_name_id_map == nullptr)
   {
-    msg_name_id_map = new kl_rb_tree<kl_string, message_id_number>;
-    msg_id_name_map = new kl_rb_tree<message_id_number, kl_string>;
+    msg_name_id_map = new kl_hash_map<kl_string, message_id_number>;
+    msg_id_name_map = new kl_hash_map<message_id_number, kl_string>;
   }
 
   if (msg_name_id_map->contains(msg_name))
@@ -83,15 +98,11 @@ ERR_CODE msg_get_msg_id(kl_string msg_name, message_id_number &id_number)
 
   if (msg_name_id_map == nullptr)
   {
-    msg_name_id_map = new kl_rb_tree<kl_string, message_id_number>;
-    msg_id_name_map = new kl_rb_tree<message_id_number, kl_string>;
+    msg_name_id_map = new kl_hash_map<kl_string, message_id_number>;
+    msg_id_name_map = new kl_hash_map<message_id_number, kl_string>;
   }
 
-  if (msg_name_id_map->contains(msg_name))
-  {
-    id_number = msg_name_id_map->search(msg_name);
-  }
-  else
+  if (!msg_name_id_map->find(msg_name, id_number))
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Not found\n");
     res = ERR_CODE::NOT_FOUND;
@@ -118,15 +129,11 @@ ERR_CODE msg_get_msg_name(message_id_number id_num, kl_string &msg_name)
 
   if (msg_name_id_map == nullptr)
   {
-    msg_name_id_map = new kl_rb_tree<kl_string, message_id_number>;
-    msg_id_name_map = new kl_rb_tree<message_id_number, kl_string>;
+    msg_name_id_map = new kl_hash_map<kl_string, message_id_number>;
+    msg_id_name_map = new kl_hash_map<message_id_number, kl_string>;
   }
 
-  if (msg_id_name_map->contains(id_num))
-  {
-    msg_name = msg_id_name_map->search(id_num);
-  }
-  else
+  if (!msg_id_name_map->find(id_num, msg_name))
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Not found\n");
     res = ERR_CODE::NOT_FOUND;
@@ -146,8 +153,11 @@ ERR_CODE msg_get_msg_name(message_id_number id_num, kl_string &msg_name)
 ///
 /// @param proc The process to enable messaging for.
 ///
+/// @param queue_len The maximum number of messages that can be waiting for this process at once. Space for them is
+///                  allocated now. Once the queue is full, senders must either wait or have their message rejected.
+///
 /// @return A suitable error code.
-ERR_CODE msg_register_process(task_process *proc)
+ERR_CODE msg_register_process(task_process *proc, uint64_t queue_len)
 {
   KL_TRC_ENTRY;
 
@@ -157,12 +167,24 @@ ERR_CODE msg_register_process(task_process *proc)
   // a bad parameter.
   ASSERT(proc != nullptr);
 
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Queue length: ", queue_len, "\n");
+
   // Don't permit double-registration of processes as being able to handle messages.
   if (proc->accepts_msgs == true)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Double registration of process to accepts msgs\n");
     res = ERR_CODE::INVALID_OP;
   }
+  else if (proc->being_destroyed)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Process is being destroyed\n");
+    res = ERR_CODE::INVALID_OP;
+  }
+  else if (queue_len == 0)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Can't have a zero-length queue\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
   else
   {
     klib_synch_spinlock_init(proc->message_lock);
@@ -173,6 +195,13 @@ ERR_CODE msg_register_process(task_process *proc)
     proc->msg_queue_len = 0;
     proc->msg_outstanding = false;
 
+    proc->message_queue.entries = new klib_message_hdr[queue_len];
+    proc->message_queue.capacity = queue_len;
+    proc->message_queue.head = 0;
+    proc->message_queue.count = 0;
+    klib_list_initialize(&proc->msg_receivers_waiting);
+    klib_list_initialize(&proc->msg_senders_waiting);
+
     proc->accepts_msgs = true;
     klib_synch_spinlock_unlock(proc->message_lock);
   }
@@ -185,7 +214,10 @@ ERR_CODE msg_register_process(task_process *proc)
 
 /// @brief Disable sending messages to a process.
 ///
-/// Typically this function will be called when a process exits.
+/// This is called by task_process::destroy_process(), rather than the process's destructor, so that threads waiting to
+/// send to or call the process are released as soon as it starts exiting. The process leaves any broadcast groups it is
+/// a member of. Any messages still queued are discarded, and any threads waiting to send to, call, or receive from this
+/// process are released - they will see ERR_CODE::SYNC_MSG_NOT_ACCEPTED.
 ///
 /// @param proc The process to disable sending messages to.
 ///
@@ -193,10 +225,63 @@ ERR_CODE msg_register_process(task_process *proc)
 ERR_CODE msg_unregister_process(task_process *proc)
 {
   KL_TRC_ENTRY;
-  INCOMPLETE_CODE(msgs);
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+
+  ASSERT(proc != nullptr);
+  msg_msg_queue &queue = proc->message_queue;
+
+  if (!proc->accepts_msgs)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Process doesn't accept messages anyway\n");
+    res = ERR_CODE::INVALID_OP;
+  }
+  else
+  {
+    // Leave all broadcast groups before taking the message lock, since broadcasts take the locks in the other order.
+    klib_synch_spinlock_lock(msg_broadcast_groups_lock);
+    while (proc->msg_groups.head != nullptr)
+    {
+      msg_int_remove_from_grp(proc->msg_groups.head->item, proc);
+    }
+    klib_synch_spinlock_unlock(msg_broadcast_groups_lock);
+
+    klib_synch_spinlock_lock(proc->message_lock);
+    proc->accepts_msgs = false;
+
+    while (queue.count != 0)
+    {
+      msg_release_contents(queue.entries[queue.head]);
+      queue.head = (queue.head + 1) % queue.capacity;
+      queue.count--;
+    }
+
+    delete[] queue.entries;
+    queue.entries = nullptr;
+    queue.capacity = 0;
+    proc->msg_queue_len = 0;
+    proc->msg_outstanding = false;
+
+    msg_int_wake_all(proc->msg_receivers_waiting);
+    msg_int_wake_all(proc->msg_senders_waiting);
+
+    // Calls that have not been received yet will never be answered now. Calls already being served are answered by
+    // the serving thread as normal.
+    while (proc->calls_pending.head != nullptr)
+    {
+      task_thread *caller = proc->calls_pending.head->item.get();
+      klib_list_remove(proc->calls_pending.head);
+      msg_int_answer_call(caller, ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+    }
+    msg_int_wake_all(proc->call_servers_waiting);
+
+    klib_synch_spinlock_unlock(proc->message_lock);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
-  return ERR_CODE::UNKNOWN;
+  return res;
 }
 
 /// @brief Send a message to a process.
@@ -206,19 +291,31 @@ ERR_CODE msg_unregister_process(task_process *proc)
 /// retains responsibility for the message buffer. The caller retains responsibility for the message header itself at
 /// all times - after this function has seen it, it is no longer needed.
 ///
+/// If the recipient's queue is full the sender may wait for space for up to max_wait microseconds. Callers that must
+/// not block - for example, those running in interrupt context - should pass zero, in which case the message is
+/// rejected with ERR_CODE::SYNC_MSG_QUEUE_FULL.
+///
 /// @param proc The process to send a message to
 ///
 /// @param msg The header of the message to send.
 ///
+/// @param max_wait The maximum number of microseconds to wait for space in the queue. Zero means do not wait, and
+///                 MSG_MAX_WAIT means wait indefinitely.
+///
 /// @return A suitable error code.
-ERR_CODE msg_send_to_process(task_process *proc, klib_message_hdr &msg)
+ERR_CODE msg_send_to_process(task_process *proc, klib_message_hdr &msg, uint64_t max_wait)
 {
   KL_TRC_ENTRY;
 
   ERR_CODE res = ERR_CODE::NO_ERROR;
+  uint64_t deadline = msg_int_compute_deadline(max_wait);
 
   // Don't error code this one, the kernel should know better than to throw null pointers around!
   ASSERT(proc != nullptr);
+  msg_msg_queue &queue = proc->message_queue;
+
+  // Keep the recipient alive while this thread might be waiting on it - it may exit in the meantime.
+  std::shared_ptr<task_process> proc_ref = proc->shared_from_this();
 
   if (!proc->accepts_msgs)
   {
@@ -228,8 +325,36 @@ ERR_CODE msg_send_to_process(task_process *proc, klib_message_hdr &msg)
   else
   {
     klib_synch_spinlock_lock(proc->message_lock);
-    proc->message_queue.push(msg);
-    proc->msg_queue_len++;
+
+    while (proc->accepts_msgs && (queue.count == queue.capacity) && (max_wait != 0))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Queue full, wait for space\n");
+      if (!msg_int_wait_on_list(proc->msg_senders_waiting, proc->message_lock, deadline))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Timed out\n");
+        break;
+      }
+    }
+
+    if (!proc->accepts_msgs)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Process stopped accepting messages while waiting\n");
+      res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+    }
+    else if (queue.count == queue.capacity)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Queue full, reject message\n");
+      res = ERR_CODE::SYNC_MSG_QUEUE_FULL;
+    }
+    else
+    {
+      queue.entries[(queue.head + queue.count) % queue.capacity] = msg;
+      queue.count++;
+      proc->msg_queue_len++;
+
+      msg_int_wake_first(proc->msg_receivers_waiting);
+    }
+
     klib_synch_spinlock_unlock(proc->message_lock);
   }
 
@@ -246,16 +371,21 @@ ERR_CODE msg_send_to_process(task_process *proc, klib_message_hdr &msg)
 /// cleaning up the buffer containing the message, not the sender or recipient. The buffer will not be accessible after
 /// the message has been declared completed.
 ///
+/// If no message is waiting, the calling thread sleeps until one arrives or until max_wait microseconds have passed.
+///
 /// @param[out] msg A message header that will be filled in with details of the next message in this process's message
 ///                 queue.
 ///
-/// @return A suitable error code.
-ERR_CODE msg_retrieve_next_msg(klib_message_hdr &msg)
+/// @param max_wait The maximum number of microseconds to wait for a message to arrive. Zero means return immediately,
+///                 and MSG_MAX_WAIT means wait indefinitely.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_QUEUE_EMPTY if no message arrived in time.
+ERR_CODE msg_retrieve_next_msg(klib_message_hdr &msg, uint64_t max_wait)
 {
   KL_TRC_ENTRY;
 
   ERR_CODE res = ERR_CODE::NO_ERROR;
-  klib_message_hdr next_msg;
+  uint64_t deadline = msg_int_compute_deadline(max_wait);
 
   task_thread *thread = task_get_cur_thread();
   ASSERT(thread != nullptr);
@@ -271,7 +401,22 @@ ERR_CODE msg_retrieve_next_msg(klib_message_hdr &msg)
   {
     klib_synch_spinlock_lock(proc->message_lock);
 
-    if (proc->msg_outstanding)
+    while (proc->accepts_msgs && !proc->msg_outstanding && (proc->msg_queue_len == 0) && (max_wait != 0))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Wait for a message\n");
+      if (!msg_int_wait_on_list(proc->msg_receivers_waiting, proc->message_lock, deadline))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Timed out\n");
+        break;
+      }
+    }
+
+    if (!proc->accepts_msgs)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Stopped processing messages while waiting\n");
+      res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+    }
+    else if (proc->msg_outstanding)
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Already processing message\n");
       res = ERR_CODE::SYNC_MSG_INCOMPLETE;
@@ -283,10 +428,9 @@ ERR_CODE msg_retrieve_next_msg(klib_message_hdr &msg)
     }
     else
     {
-      next_msg = proc->message_queue.front();
+      msg = proc->message_queue.entries[proc->message_queue.head];
       proc->msg_queue_len--;
       proc->msg_outstanding = true;
-      msg = next_msg;
     }
 
     klib_synch_spinlock_unlock(proc->message_lock);
@@ -314,7 +458,6 @@ ERR_CODE msg_retrieve_cur_msg(klib_message_hdr &msg)
   KL_TRC_ENTRY;
 
   ERR_CODE res = ERR_CODE::NO_ERROR;
-  klib_message_hdr next_msg;
 
   task_thread *thread = task_get_cur_thread();
   ASSERT(thread != nullptr);
@@ -337,8 +480,7 @@ ERR_CODE msg_retrieve_cur_msg(klib_message_hdr &msg)
     }
     else
     {
-      next_msg = proc->message_queue.front();
-      msg = next_msg;
+      msg = proc->message_queue.entries[proc->message_queue.head];
     }
 
     klib_synch_spinlock_unlock(proc->message_lock);
@@ -384,19 +526,24 @@ ERR_CODE msg_msg_complete(klib_message_hdr &msg)
       KL_TRC_TRACE(TRC_LVL::FLOW, "No message being handled\n");
       res = ERR_CODE::SYNC_MSG_MISMATCH;
     }
-    else if(proc->message_queue.front() != msg)
+    else if(proc->message_queue.entries[proc->message_queue.head] != msg)
     {
-      KL_TRC_TRACE(TRV_LVL::FLOW, "Incorrect message to complete\n");
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Incorrect message to complete\n");
       res = ERR_CODE::SYNC_MSG_MISMATCH;
     }
     else
     {
-      delete[] msg.msg_contents;
+      // msg is a copy of the entry in the queue, so only one of them actually owns the contents.
+      msg_release_contents(proc->message_queue.entries[proc->message_queue.head]);
+      msg.shared_contents = nullptr;
       msg.msg_contents = nullptr;
       msg.msg_id = 0;
       proc->cur_msg = msg;
-      proc->message_queue.pop();
+      proc->message_queue.head = (proc->message_queue.head + 1) % proc->message_queue.capacity;
+      proc->message_queue.count--;
       proc->msg_outstanding = false;
+
+      msg_int_wake_first(proc->msg_senders_waiting);
     }
 
     klib_synch_spinlock_unlock(proc->message_lock);
@@ -408,59 +555,883 @@ ERR_CODE msg_msg_complete(klib_message_hdr &msg)
   return res;
 }
 
-/* ERR_CODE msg_init_broadcast_group()
+/// @brief Retrieve several messages from this process's queue at once.
+///
+/// This saves high-rate receivers from retrieving and completing each message individually. Unlike
+/// msg_retrieve_next_msg() the messages are removed from the queue immediately, so there is no need to call
+/// msg_msg_complete(). Instead the caller becomes responsible for the contents of each message, and must call
+/// msg_release_contents() on each of them once it has finished.
+///
+/// This cannot be used while a message retrieved by msg_retrieve_next_msg() is still being handled.
+///
+/// If no message is waiting, the calling thread sleeps until one arrives or until max_wait microseconds have passed.
+///
+/// @param[out] msgs Array to store the retrieved message headers in.
+///
+/// @param max_msgs The number of entries in msgs.
+///
+/// @param[out] num_msgs The number of messages retrieved.
+///
+/// @param max_wait The maximum number of microseconds to wait for a message to arrive. Zero means return immediately,
+///                 and MSG_MAX_WAIT means wait indefinitely.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_QUEUE_EMPTY if no message arrived in time.
+ERR_CODE msg_retrieve_msg_batch(klib_message_hdr *msgs, uint64_t max_msgs, uint64_t &num_msgs, uint64_t max_wait)
 {
   KL_TRC_ENTRY;
-  INCOMPLETE_CODE(msgs);
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  uint64_t deadline = msg_int_compute_deadline(max_wait);
+
+  task_thread *thread = task_get_cur_thread();
+  ASSERT(thread != nullptr);
+  std::shared_ptr<task_process> proc = thread->parent_process;
+  ASSERT(proc != nullptr);
+  msg_msg_queue &queue = proc->message_queue;
+
+  num_msgs = 0;
+
+  if ((msgs == nullptr) || (max_msgs == 0))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No space for messages\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else if (!proc->accepts_msgs)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Doesn't process messages\n");
+    res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+  }
+  else
+  {
+    klib_synch_spinlock_lock(proc->message_lock);
+
+    while (proc->accepts_msgs && !proc->msg_outstanding && (proc->msg_queue_len == 0) && (max_wait != 0))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Wait for a message\n");
+      if (!msg_int_wait_on_list(proc->msg_receivers_waiting, proc->message_lock, deadline))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Timed out\n");
+        break;
+      }
+    }
+
+    if (!proc->accepts_msgs)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Stopped processing messages while waiting\n");
+      res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+    }
+    else if (proc->msg_outstanding)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Already processing message\n");
+      res = ERR_CODE::SYNC_MSG_INCOMPLETE;
+    }
+    else if (proc->msg_queue_len == 0)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "No messages waiting\n");
+      res = ERR_CODE::SYNC_MSG_QUEUE_EMPTY;
+    }
+    else
+    {
+      while ((num_msgs < max_msgs) && (queue.count != 0))
+      {
+        // Move the message out of the queue, so the queue no longer holds a reference to any shared contents.
+        msgs[num_msgs] = queue.entries[queue.head];
+        queue.entries[queue.head].shared_contents = nullptr;
+        queue.entries[queue.head].msg_contents = nullptr;
+
+        queue.head = (queue.head + 1) % queue.capacity;
+        queue.count--;
+        proc->msg_queue_len--;
+        num_msgs++;
+      }
+
+      KL_TRC_TRACE(TRC_LVL::EXTRA, "Retrieved ", num_msgs, " messages\n");
+
+      // Several slots may have been freed, so let every waiting sender have a go.
+      msg_int_wake_all(proc->msg_senders_waiting);
+    }
+
+    klib_synch_spinlock_unlock(proc->message_lock);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
-  return ERR_CODE::UNKNOWN;
+  return res;
 }
 
-ERR_CODE msg_terminate_broadcast_group()
+/// @brief Free the contents of a message, or release this message's share of them.
+///
+/// Only needed for messages retrieved by msg_retrieve_msg_batch() - msg_msg_complete() deals with the contents of
+/// other messages.
+///
+/// @param msg The message whose contents are no longer needed.
+void msg_release_contents(klib_message_hdr &msg)
 {
   KL_TRC_ENTRY;
-  INCOMPLETE_CODE(msgs);
+
+  if (msg.shared_contents != nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Release shared contents\n");
+    msg.shared_contents = nullptr;
+  }
+  else
+  {
+    delete[] msg.msg_contents;
+  }
+  msg.msg_contents = nullptr;
+
   KL_TRC_EXIT;
+}
+
+/// @brief Make a synchronous call to a process, and wait for the reply.
+///
+/// Synchronous calls are a lighter-weight alternative to messages for request/response style traffic. The request and
+/// reply are a few words long, so they are copied between threads directly without allocating a message buffer or
+/// using the recipient's message queue. The calling thread sleeps until a thread in the recipient process has received
+/// the call (using msg_receive_call()) and replied to it (using msg_reply_call()).
+///
+/// If a thread in the recipient process is already waiting for a call then this processor switches directly to it,
+/// rather than waiting for the scheduler to get round to it. The reply switches directly back in the same way.
+///
+/// The recipient process must have registered to receive messages using msg_register_process().
+///
+/// @param proc The process to call.
+///
+/// @param request The words to send to the recipient.
+///
+/// @param[out] reply The words that the recipient replied with. Only valid if the result is ERR_CODE::NO_ERROR.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_NOT_ACCEPTED if the recipient does not accept messages, or stops
+///         accepting them before the call is answered - for example, because it is being destroyed.
+ERR_CODE msg_call_process(task_process *proc, const msg_call_words &request, msg_call_words &reply)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  task_thread *server;
 
-  return ERR_CODE::UNKNOWN;
+  task_thread *this_thread = task_get_cur_thread();
+  ASSERT(this_thread != nullptr);
+  ASSERT(proc != nullptr);
+  msg_call_state &state = this_thread->call_state;
+
+  // Keep the recipient alive until the call is answered - if it exits first, this thread still needs its message lock
+  // to see the answer.
+  std::shared_ptr<task_process> proc_ref = proc->shared_from_this();
+
+  klib_synch_spinlock_lock(proc->message_lock);
+
+  if (!proc->accepts_msgs)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Process can't accept calls\n");
+    res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+  }
+  else
+  {
+    state.words = request;
+    state.reply_ready = false;
+    state.result = ERR_CODE::NO_ERROR;
+
+    ASSERT(!klib_list_item_is_in_any_list(this_thread->synch_list_item));
+    klib_list_add_tail(&proc->calls_pending, this_thread->synch_list_item);
+    server = msg_int_wake_first(proc->call_servers_waiting);
+
+    // Unlike msg_int_wait_on_list() this thread may legitimately be out of every list while it waits, since the
+    // serving thread removes it from calls_pending when the call is received. The only thing that matters is whether
+    // the call has been answered yet.
+    while (!state.reply_ready)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Wait for reply\n");
+      task_continue_this_thread();
+      this_thread->stop_thread();
+      klib_synch_spinlock_unlock(proc->message_lock);
+      task_resume_scheduling();
+
+      if (server != nullptr)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Switch directly to server thread\n");
+        task_yield_to(server);
+        server = nullptr;
+      }
+      else
+      {
+        task_yield();
+      }
+
+      klib_synch_spinlock_lock(proc->message_lock);
+    }
+
+    res = state.result;
+    if (res == ERR_CODE::NO_ERROR)
+    {
+      reply = state.words;
+    }
+  }
+
+  klib_synch_spinlock_unlock(proc->message_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
 }
 
-ERR_CODE msg_add_process_to_grp()
+/// @brief Receive the next synchronous call made to this process.
+///
+/// Having received a call the thread must reply to it using msg_reply_call() before receiving another. Calls are
+/// received by individual threads, so several threads in the same process can serve calls at once.
+///
+/// @param[out] call Details of the call that was received.
+///
+/// @param max_wait The maximum number of microseconds to wait for a call to arrive. Zero means return immediately, and
+///                 MSG_MAX_WAIT means wait indefinitely.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_QUEUE_EMPTY if no call arrived in time, or
+///         ERR_CODE::SYNC_MSG_INCOMPLETE if this thread has not yet replied to the last call it received.
+ERR_CODE msg_receive_call(msg_call_details &call, uint64_t max_wait)
 {
   KL_TRC_ENTRY;
-  INCOMPLETE_CODE(msgs);
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  uint64_t deadline = msg_int_compute_deadline(max_wait);
+  klib_list_item<kl_ref_ptr<task_thread>> *caller_item;
+  kl_ref_ptr<task_thread> caller;
+
+  task_thread *thread = task_get_cur_thread();
+  ASSERT(thread != nullptr);
+  std::shared_ptr<task_process> proc = thread->parent_process;
+  ASSERT(proc != nullptr);
+
+  if (!proc->accepts_msgs)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Doesn't accept calls\n");
+    res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+  }
+  else if (thread->call_state.serving != nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Already serving a call\n");
+    res = ERR_CODE::SYNC_MSG_INCOMPLETE;
+  }
+  else
+  {
+    klib_synch_spinlock_lock(proc->message_lock);
+
+    while (proc->accepts_msgs && (proc->calls_pending.head == nullptr) && (max_wait != 0))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Wait for a call\n");
+      if (!msg_int_wait_on_list(proc->call_servers_waiting, proc->message_lock, deadline))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Timed out\n");
+        break;
+      }
+    }
+
+    if (!proc->accepts_msgs)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Stopped accepting calls while waiting\n");
+      res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+    }
+    else if (proc->calls_pending.head == nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "No calls waiting\n");
+      res = ERR_CODE::SYNC_MSG_QUEUE_EMPTY;
+    }
+    else
+    {
+      caller_item = proc->calls_pending.head;
+      caller = caller_item->item;
+      klib_list_remove(caller_item);
+
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Received call from thread ", caller.get(), "\n");
+      call.calling_proc_id = reinterpret_cast<uint64_t>(caller->parent_process.get());
+      call.request = caller->call_state.words;
+      thread->call_state.serving = std::move(caller);
+    }
+
+    klib_synch_spinlock_unlock(proc->message_lock);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
-  return ERR_CODE::UNKNOWN;
+  return res;
 }
 
-ERR_CODE msg_remove_process_from_grp()
+/// @brief Reply to the synchronous call that this thread is serving.
+///
+/// @param reply The words to return to the calling thread.
+///
+/// @param switch_to_caller If true, this processor switches directly to the calling thread, if possible. If false, the
+///                         calling thread is only preferred at the next scheduling decision - this is useful if the
+///                         current thread is about to sleep anyway, for example to wait for the next call.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_MISMATCH if this thread is not serving a call.
+ERR_CODE msg_reply_call(const msg_call_words &reply, bool switch_to_caller)
 {
   KL_TRC_ENTRY;
-  INCOMPLETE_CODE(msgs);
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  kl_ref_ptr<task_thread> caller;
+
+  task_thread *thread = task_get_cur_thread();
+  ASSERT(thread != nullptr);
+  std::shared_ptr<task_process> proc = thread->parent_process;
+  ASSERT(proc != nullptr);
+
+  klib_synch_spinlock_lock(proc->message_lock);
+
+  if (thread->call_state.serving == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Not serving a call\n");
+    res = ERR_CODE::SYNC_MSG_MISMATCH;
+  }
+  else
+  {
+    caller = std::move(thread->call_state.serving);
+
+    caller->call_state.words = reply;
+    msg_int_answer_call(caller.get(), ERR_CODE::NO_ERROR);
+  }
+
+  klib_synch_spinlock_unlock(proc->message_lock);
+
+  if (caller != nullptr)
+  {
+    if (switch_to_caller)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Switch directly to caller\n");
+      task_yield_to(caller.get());
+    }
+    else
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Prefer caller next\n");
+      task_set_switch_hint(caller.get());
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Release the caller of any synchronous call that a thread is serving.
+///
+/// This is called when a thread is destroyed, so that the thread waiting for its reply is not left waiting forever.
+/// The caller sees ERR_CODE::SYNC_MSG_NOT_ACCEPTED.
+///
+/// @param thread The thread being destroyed.
+void msg_abandon_call(task_thread *thread)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(thread != nullptr);
+  ASSERT(thread->parent_process != nullptr);
+
+  if (thread->call_state.serving != nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Abandon call from ", thread->call_state.serving.get(), "\n");
+    klib_synch_spinlock_lock(thread->parent_process->message_lock);
+    msg_int_answer_call(thread->call_state.serving.get(), ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+    thread->call_state.serving = nullptr;
+    klib_synch_spinlock_unlock(thread->parent_process->message_lock);
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Create a new broadcast group.
+///
+/// @param group_id The ID number of the new group. This must not already be in use.
+///
+/// @return A suitable error code. ERR_CODE::ALREADY_EXISTS if the ID is already in use.
+ERR_CODE msg_init_broadcast_group(uint64_t group_id)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  klib_msg_broadcast_grp *group;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Create group ", group_id, "\n");
+
+  klib_synch_spinlock_lock(msg_broadcast_groups_lock);
+
+  if (msg_broadcast_groups == nullptr)
+  {
+    msg_broadcast_groups = new kl_rb_tree<uint64_t, klib_msg_broadcast_grp *>;
+  }
+
+  if (msg_broadcast_groups->contains(group_id))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Group already exists\n");
+    res = ERR_CODE::ALREADY_EXISTS;
+  }
+  else
+  {
+    group = new klib_msg_broadcast_grp;
+    group->group_id = group_id;
+    klib_list_initialize(&group->members);
+    klib_synch_spinlock_init(group->lock);
+
+    msg_broadcast_groups->insert(group_id, group);
+  }
+
+  klib_synch_spinlock_unlock(msg_broadcast_groups_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Destroy a broadcast group.
+///
+/// All members are removed from the group first. Messages already broadcast to them are unaffected.
+///
+/// @param group_id The ID number of the group to destroy.
+///
+/// @return A suitable error code.
+ERR_CODE msg_terminate_broadcast_group(uint64_t group_id)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  klib_msg_broadcast_grp *group = nullptr;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Destroy group ", group_id, "\n");
+
+  klib_synch_spinlock_lock(msg_broadcast_groups_lock);
+
+  if ((msg_broadcast_groups == nullptr) || !msg_broadcast_groups->contains(group_id))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Group not found\n");
+    res = ERR_CODE::NOT_FOUND;
+  }
+  else
+  {
+    group = msg_broadcast_groups->search(group_id);
+    msg_broadcast_groups->remove(group_id);
+
+    while (group->members.head != nullptr)
+    {
+      msg_int_remove_from_grp(group, group->members.head->item);
+    }
+
+    // Wait for any broadcast still in progress to finish with the group. No new broadcast can find it now.
+    klib_synch_spinlock_lock(group->lock);
+    klib_synch_spinlock_unlock(group->lock);
+  }
+
+  klib_synch_spinlock_unlock(msg_broadcast_groups_lock);
+
+  delete group;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
-  return ERR_CODE::UNKNOWN;
+  return res;
 }
 
-ERR_CODE msg_broadcast_msg()
+/// @brief Add a process to a broadcast group.
+///
+/// The process will receive a copy of every message broadcast to the group from now on.
+///
+/// @param group_id The group to join.
+///
+/// @param proc The process to add. It must accept messages.
+///
+/// @return A suitable error code. ERR_CODE::ALREADY_EXISTS if the process is already a member of the group.
+ERR_CODE msg_add_process_to_grp(uint64_t group_id, task_process *proc)
 {
   KL_TRC_ENTRY;
-  INCOMPLETE_CODE(msgs);
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  klib_msg_broadcast_grp *group;
+  klib_list_item<klib_msg_broadcast_grp *> *group_item;
+  klib_list_item<task_process *> *proc_item;
+
+  ASSERT(proc != nullptr);
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Add process ", proc, " to group ", group_id, "\n");
+
+  klib_synch_spinlock_lock(msg_broadcast_groups_lock);
+
+  if (!proc->accepts_msgs)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Process doesn't accept messages\n");
+    res = ERR_CODE::SYNC_MSG_NOT_ACCEPTED;
+  }
+  else if ((msg_broadcast_groups == nullptr) || !msg_broadcast_groups->contains(group_id))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Group not found\n");
+    res = ERR_CODE::NOT_FOUND;
+  }
+  else
+  {
+    group = msg_broadcast_groups->search(group_id);
+
+    for (group_item = proc->msg_groups.head; group_item != nullptr; group_item = group_item->next)
+    {
+      if (group_item->item == group)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Already a member\n");
+        res = ERR_CODE::ALREADY_EXISTS;
+        break;
+      }
+    }
+
+    if (res == ERR_CODE::NO_ERROR)
+    {
+      group_item = new klib_list_item<klib_msg_broadcast_grp *>;
+      klib_list_item_initialize(group_item);
+      group_item->item = group;
+      klib_list_add_tail(&proc->msg_groups, group_item);
+
+      proc_item = new klib_list_item<task_process *>;
+      klib_list_item_initialize(proc_item);
+      proc_item->item = proc;
+
+      klib_synch_spinlock_lock(group->lock);
+      klib_list_add_tail(&group->members, proc_item);
+      klib_synch_spinlock_unlock(group->lock);
+    }
+  }
+
+  klib_synch_spinlock_unlock(msg_broadcast_groups_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
-  return ERR_CODE::UNKNOWN;
+  return res;
+}
+
+/// @brief Remove a process from a broadcast group.
+///
+/// Messages already broadcast to the process remain in its queue.
+///
+/// @param group_id The group to leave.
+///
+/// @param proc The process to remove.
+///
+/// @return A suitable error code. ERR_CODE::NOT_FOUND if the group doesn't exist, or the process isn't a member.
+ERR_CODE msg_remove_process_from_grp(uint64_t group_id, task_process *proc)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res = ERR_CODE::NOT_FOUND;
+  klib_list_item<klib_msg_broadcast_grp *> *group_item;
+
+  ASSERT(proc != nullptr);
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Remove process ", proc, " from group ", group_id, "\n");
+
+  klib_synch_spinlock_lock(msg_broadcast_groups_lock);
+
+  for (group_item = proc->msg_groups.head; group_item != nullptr; group_item = group_item->next)
+  {
+    if (group_item->item->group_id == group_id)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Found membership\n");
+      msg_int_remove_from_grp(group_item->item, proc);
+      res = ERR_CODE::NO_ERROR;
+      break;
+    }
+  }
+
+  klib_synch_spinlock_unlock(msg_broadcast_groups_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Send a message to every member of a broadcast group.
+///
+/// The message contents are stored once and shared between all recipients, rather than being copied for each of them.
+/// The buffer is freed once every recipient has completed the message.
+///
+/// Broadcasts never wait for space in a recipient's queue. A recipient whose queue is full simply doesn't receive the
+/// message - this is intended for notifications, where a slow recipient shouldn't hold up everyone else.
+///
+/// Unlike msg_send_to_process(), this function always takes responsibility for the message buffer, whether or not the
+/// message was delivered to anyone.
+///
+/// @param group_id The group to send the message to.
+///
+/// @param msg The header of the message to send. msg_contents must either be nullptr or have been allocated with
+///            new[].
+///
+/// @return A suitable error code. ERR_CODE::NO_ERROR is returned even if some members' queues were full.
+ERR_CODE msg_broadcast_msg(uint64_t group_id, klib_message_hdr &msg)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res = ERR_CODE::NO_ERROR;
+  ERR_CODE send_res;
+  klib_msg_broadcast_grp *group = nullptr;
+  klib_message_hdr recipient_msg;
+  klib_list_item<task_process *> *member;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Broadcast message ", msg.msg_id, " to group ", group_id, "\n");
+
+  if ((msg.msg_contents != nullptr) && (msg.shared_contents == nullptr))
+  {
+    msg.shared_contents = std::shared_ptr<char>(msg.msg_contents, std::default_delete<char[]>());
+  }
+
+  klib_synch_spinlock_lock(msg_broadcast_groups_lock);
+  if ((msg_broadcast_groups != nullptr) && msg_broadcast_groups->contains(group_id))
+  {
+    group = msg_broadcast_groups->search(group_id);
+    klib_synch_spinlock_lock(group->lock);
+  }
+  klib_synch_spinlock_unlock(msg_broadcast_groups_lock);
+
+  if (group == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Group not found\n");
+    res = ERR_CODE::NOT_FOUND;
+  }
+  else
+  {
+    for (member = group->members.head; member != nullptr; member = member->next)
+    {
+      // Each recipient gets its own header, but they all point at the same contents.
+      recipient_msg = msg;
+      send_res = msg_send_to_process(member->item, recipient_msg);
+      if (send_res != ERR_CODE::NO_ERROR)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Not delivered to ", member->item, ": ", send_res, "\n");
+      }
+    }
+
+    klib_synch_spinlock_unlock(group->lock);
+  }
+
+  // This message's reference to the contents is no longer needed. The recipients hold their own.
+  msg.shared_contents = nullptr;
+  msg.msg_contents = nullptr;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+namespace
+{
+  /// @brief Convert a maximum wait into a deadline in terms of the system timer.
+  ///
+  /// @param max_wait The maximum wait, in microseconds, or MSG_MAX_WAIT.
+  ///
+  /// @return The system timer count at which to stop waiting, or MSG_MAX_WAIT to wait indefinitely.
+  uint64_t msg_int_compute_deadline(uint64_t max_wait)
+  {
+    uint64_t deadline = MSG_MAX_WAIT;
+
+    if ((max_wait != 0) && (max_wait != MSG_MAX_WAIT))
+    {
+      deadline = time_get_system_timer_count() + time_get_system_timer_offset(max_wait * 1000);
+    }
+
+    return deadline;
+  }
+
+  /// @brief Sleep the current thread until it is woken from wait_list, or the deadline passes.
+  ///
+  /// This follows the same pattern as klib_synch_mutex_acquire(). The lock protecting wait_list must be held on entry,
+  /// and is held again on exit, but is released while the thread sleeps. The caller must re-examine whatever condition
+  /// it was waiting for, since other threads may have got there first.
+  ///
+  /// @param wait_list The list of threads to wait in.
+  ///
+  /// @param lock The lock protecting wait_list.
+  ///
+  /// @param deadline The system timer count at which to give up waiting, or MSG_MAX_WAIT to wait indefinitely.
+  ///
+  /// @return False if the deadline has passed, true otherwise.
+  bool msg_int_wait_on_list(klib_list<kl_ref_ptr<task_thread>> &wait_list,
+                            kernel_spinlock &lock,
+                            uint64_t deadline)
+  {
+    KL_TRC_ENTRY;
+
+    bool result = true;
+    task_thread *this_thread = task_get_cur_thread();
+    ASSERT(this_thread != nullptr);
+    ASSERT(!klib_list_item_is_in_any_list(this_thread->synch_list_item));
+
+    if ((deadline != MSG_MAX_WAIT) && (time_get_system_timer_count() >= deadline))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Deadline already passed\n");
+      result = false;
+    }
+    else
+    {
+      klib_list_add_tail(&wait_list, this_thread->synch_list_item);
+
+      // As with mutexes, don't allow this thread to be descheduled between stopping it and releasing the lock, since
+      // that would deadlock anyone trying to wake us.
+      task_continue_this_thread();
+      this_thread->stop_thread();
+      if (deadline != MSG_MAX_WAIT)
+      {
+        task_set_wake_time(this_thread, deadline);
+      }
+      klib_synch_spinlock_unlock(lock);
+
+      task_resume_scheduling();
+      task_yield();
+
+      task_cancel_wake_time(this_thread);
+      klib_synch_spinlock_lock(lock);
+
+      if (klib_list_item_is_in_any_list(this_thread->synch_list_item))
+      {
+        // Nobody removed us from the list, so we must have been woken by the timer.
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Woken without being signalled\n");
+        klib_list_remove(this_thread->synch_list_item);
+        this_thread->start_thread();
+        result = ((deadline == MSG_MAX_WAIT) || (time_get_system_timer_count() < deadline));
+      }
+    }
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+    KL_TRC_EXIT;
+
+    return result;
+  }
+
+  /// @brief Wake the first thread waiting in a list, if there is one.
+  ///
+  /// The lock protecting the list must be held by the caller.
+  ///
+  /// @param wait_list The list to wake a thread from.
+  ///
+  /// @return The thread that was woken, or nullptr if the list was empty.
+  task_thread *msg_int_wake_first(klib_list<kl_ref_ptr<task_thread>> &wait_list)
+  {
+    KL_TRC_ENTRY;
+
+    klib_list_item<kl_ref_ptr<task_thread>> *item = wait_list.head;
+    task_thread *woken = nullptr;
+
+    if (item != nullptr)
+    {
+      woken = item->item.get();
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Waking thread ", woken, "\n");
+      klib_list_remove(item);
+      woken->start_thread();
+    }
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", woken, "\n");
+    KL_TRC_EXIT;
+
+    return woken;
+  }
+
+  /// @brief Wake all threads waiting in a list.
+  ///
+  /// The lock protecting the list must be held by the caller.
+  ///
+  /// @param wait_list The list to wake all threads from.
+  void msg_int_wake_all(klib_list<kl_ref_ptr<task_thread>> &wait_list)
+  {
+    KL_TRC_ENTRY;
+
+    while (wait_list.head != nullptr)
+    {
+      msg_int_wake_first(wait_list);
+    }
+
+    KL_TRC_EXIT;
+  }
+
+  /// @brief Complete a synchronous call and allow the calling thread to continue.
+  ///
+  /// The message lock of the process that was called must be held by the caller. If result is ERR_CODE::NO_ERROR then
+  /// the reply words must already have been stored in the caller's call state.
+  ///
+  /// @param caller The thread that made the call.
+  ///
+  /// @param result The result to return to the calling thread.
+  void msg_int_answer_call(task_thread *caller, ERR_CODE result)
+  {
+    KL_TRC_ENTRY;
+
+    ASSERT(caller != nullptr);
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Answer call from ", caller, " with result ", result, "\n");
+
+    caller->call_state.result = result;
+    caller->call_state.reply_ready = true;
+    caller->start_thread();
+
+    KL_TRC_EXIT;
+  }
+
+  /// @brief Remove a process from a broadcast group.
+  ///
+  /// The caller must hold msg_broadcast_groups_lock, and the process must be a member of the group.
+  ///
+  /// @param group The group to remove the process from.
+  ///
+  /// @param proc The process to remove.
+  void msg_int_remove_from_grp(klib_msg_broadcast_grp *group, task_process *proc)
+  {
+    KL_TRC_ENTRY;
+
+    klib_list_item<klib_msg_broadcast_grp *> *group_item;
+    klib_list_item<task_process *> *proc_item;
+
+    ASSERT(group != nullptr);
+    ASSERT(proc != nullptr);
+
+    for (group_item = proc->msg_groups.head; group_item != nullptr; group_item = group_item->next)
+    {
+      if (group_item->item == group)
+      {
+        klib_list_remove(group_item);
+        delete group_item;
+        break;
+      }
+    }
+
+    klib_synch_spinlock_lock(group->lock);
+    for (proc_item = group->members.head; proc_item != nullptr; proc_item = proc_item->next)
+    {
+      if (proc_item->item == proc)
+      {
+        klib_list_remove(proc_item);
+        delete proc_item;
+        break;
+      }
+    }
+    klib_synch_spinlock_unlock(group->lock);
+
+    KL_TRC_EXIT;
+  }
 }
-*/
 
 #ifdef AZALEA_TEST_CODE
 void test_only_reset_message_system()
 {
+  uint64_t group_id;
+
   delete msg_name_id_map;
   delete msg_id_name_map;
 
   msg_name_id_map = nullptr;
   msg_id_name_map = nullptr;
+
+  if (msg_broadcast_groups != nullptr)
+  {
+    while (msg_broadcast_groups->get_root_node_key(group_id))
+    {
+      msg_terminate_broadcast_group(group_id);
+    }
+
+    delete msg_broadcast_groups;
+    msg_broadcast_groups = nullptr;
+  }
 }
 #endif
\ No newline at end of file
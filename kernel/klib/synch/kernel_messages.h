@@ -2,12 +2,16 @@
 #define KLIB_MSG_PASSING
 
 #include <stdint.h>
+#include <memory>
 
+#include "klib/data_structures/lists.h"
+#include "klib/synch/kernel_locks.h"
+#include "object_mgr/ref_counter.h"
 #include "user_interfaces/error_codes.h"
 #include "user_interfaces/messages.h"
-#include <queue>
 
 class task_process;
+class task_thread;
 
 struct klib_message_hdr
 {
@@ -19,36 +23,98 @@ struct klib_message_hdr
 
   // The message doesn't have any defined type, but using a byte-array allows 'delete' to be called on this pointer.
   char *msg_contents;
+
+  // If set, msg_contents is shared between several recipients - for example, because the message was broadcast - and
+  // is freed when the last of them releases it. If not set, msg_contents belongs to this message alone.
+  std::shared_ptr<char> shared_contents;
 };
 
 bool operator == (const klib_message_hdr &a, const klib_message_hdr &b);
 bool operator != (const klib_message_hdr &a, const klib_message_hdr &b);
 
+/// @brief A group of processes that all receive any message broadcast to the group.
+///
+/// Groups are identified by a number chosen by whoever creates them, in the same way as message IDs.
 struct klib_msg_broadcast_grp
 {
+  /// The ID number of this group.
+  uint64_t group_id;
+
+  /// The processes that receive messages broadcast to this group.
+  klib_list<task_process *> members;
 
+  /// Protects the member list. Broadcasts hold this lock while delivering a message.
+  kernel_spinlock lock;
 };
 
 typedef uint64_t message_id_number;
-typedef std::queue<klib_message_hdr> msg_msg_queue;
+
+/// @brief A fixed-capacity ring of message headers.
+///
+/// The ring is allocated when a process registers to receive messages, so that sending a message never needs to
+/// allocate space within the queue itself. The message at the head of the ring is the one being handled by the
+/// receiving process, if there is one.
+struct msg_msg_queue
+{
+  /// Storage for the ring. Contains `capacity` entries, or is nullptr if the process does not accept messages.
+  klib_message_hdr *entries;
+
+  /// The maximum number of messages that can be stored, including the message currently being handled.
+  uint64_t capacity;
+
+  /// The index of the oldest message in the ring.
+  uint64_t head;
+
+  /// The number of entries in use.
+  uint64_t count;
+};
+
+/// @brief The state of a synchronous call that a thread is making or serving.
+///
+/// Each thread contains one of these. Fields are protected by the message lock of the process being called.
+struct msg_call_state
+{
+  /// The words of the request while the call is waiting to be served, and the words of the reply once it has been
+  /// answered.
+  msg_call_words words;
+
+  /// Has the call made by this thread been answered?
+  bool reply_ready;
+
+  /// The result to return to the caller once reply_ready is set.
+  ERR_CODE result;
+
+  /// The thread whose call this thread is currently serving, if any. A thread serves at most one call at a time.
+  kl_ref_ptr<task_thread> serving;
+};
+
+/// The default number of messages that a process can have queued before senders are blocked or rejected.
+const uint64_t MSG_DEFAULT_QUEUE_LEN = 64;
 
 ERR_CODE msg_register_msg_id(kl_string msg_name, message_id_number new_id_number);
 ERR_CODE msg_get_msg_id(kl_string msg_name, message_id_number &id_number);
 ERR_CODE msg_get_msg_name(message_id_number id_num, kl_string &msg_name);
 
-ERR_CODE msg_register_process(task_process *proc);
+ERR_CODE msg_register_process(task_process *proc, uint64_t queue_len = MSG_DEFAULT_QUEUE_LEN);
 ERR_CODE msg_unregister_process(task_process *proc);
 
-ERR_CODE msg_send_to_process(task_process *proc, klib_message_hdr &msg);
-ERR_CODE msg_retrieve_next_msg(klib_message_hdr &msg);
+ERR_CODE msg_send_to_process(task_process *proc, klib_message_hdr &msg, uint64_t max_wait = 0);
+ERR_CODE msg_retrieve_next_msg(klib_message_hdr &msg, uint64_t max_wait = 0);
 ERR_CODE msg_retrieve_cur_msg(klib_message_hdr &msg);
 ERR_CODE msg_msg_complete(klib_message_hdr &msg);
-
-/*ERR_CODE msg_init_broadcast_group();
-ERR_CODE msg_terminate_broadcast_group();
-ERR_CODE msg_add_process_to_grp();
-ERR_CODE msg_remove_process_from_grp();
-ERR_CODE msg_broadcast_msg();*/
+ERR_CODE msg_retrieve_msg_batch(klib_message_hdr *msgs, uint64_t max_msgs, uint64_t &num_msgs, uint64_t max_wait = 0);
+void msg_release_contents(klib_message_hdr &msg);
+
+ERR_CODE msg_call_process(task_process *proc, const msg_call_words &request, msg_call_words &reply);
+ERR_CODE msg_receive_call(msg_call_details &call, uint64_t max_wait = 0);
+ERR_CODE msg_reply_call(const msg_call_words &reply, bool switch_to_caller = true);
+void msg_abandon_call(task_thread *thread);
+
+ERR_CODE msg_init_broadcast_group(uint64_t group_id);
+ERR_CODE msg_terminate_broadcast_group(uint64_t group_id);
+ERR_CODE msg_add_process_to_grp(uint64_t group_id, task_process *proc);
+ERR_CODE msg_remove_process_from_grp(uint64_t group_id, task_process *proc);
+ERR_CODE msg_broadcast_msg(uint64_t group_id, klib_message_hdr &msg);
 
 #ifdef AZALEA_TEST_CODE
 void test_only_reset_message_system();
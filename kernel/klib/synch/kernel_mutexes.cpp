@@ -115,7 +115,7 @@ void klib_synch_mutex_release(klib_mutex &mutex, const bool disregard_owner)
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Releasing mutex ", &mutex, " from thread ", task_get_cur_thread(), "\n");
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Owner thread: ", mutex.owner_thread, "\n");
 
-  klib_list_item<std::shared_ptr<task_thread>> *next_owner;
+  klib_list_item<kl_ref_ptr<task_thread>> *next_owner;
 
   ASSERT(mutex.mutex_locked);
   ASSERT((disregard_owner) || (mutex.owner_thread == task_get_cur_thread()));
@@ -130,7 +130,7 @@ void klib_synch_mutex_release(klib_mutex &mutex, const bool disregard_owner)
   else
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Getting next owner from the head of list\n");
-    KL_TRC_TRACE(TRC_LVL::EXTRA, "Next owner is", next_owner->item, "\n");
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Next owner is", next_owner->item.get(), "\n");
     mutex.owner_thread = next_owner->item.get();
     klib_list_remove(next_owner);
     next_owner->item->start_thread();
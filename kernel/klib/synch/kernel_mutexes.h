@@ -20,7 +20,7 @@ struct klib_mutex
   task_thread *owner_thread;
 
   // Which processes are waiting to grab this mutex?
-  klib_list<std::shared_ptr<task_thread>> waiting_threads_list;
+  klib_list<kl_ref_ptr<task_thread>> waiting_threads_list;
 
   // This lock is used to synchronize access to the fields in this structure.
   kernel_spinlock access_lock;
@@ -57,14 +57,13 @@ SYNC_ACQ_RESULT klib_synch_semaphore_wait(klib_semaphore &semaphore, uint64_t ma
 
     // Wait for the semaphore to become free. Add this thread to the list of waiting threads, then suspend this thread.
     task_thread *this_thread = task_get_cur_thread();
-    klib_list_item<std::shared_ptr<task_thread>> *item = new klib_list_item<std::shared_ptr<task_thread>>;
+    ASSERT(this_thread != nullptr);
+    ASSERT(!klib_list_item_is_in_any_list(this_thread->synch_list_item));
+    ASSERT(this_thread->synch_list_item->item.get() == this_thread);
 
     ASSERT(semaphore.cur_user_count == semaphore.max_users);
 
-    klib_list_item_initialize(item);
-    item->item = this_thread->synch_list_item->item;
-
-    klib_list_add_tail(&semaphore.waiting_threads_list, item);
+    klib_list_add_tail(&semaphore.waiting_threads_list, this_thread->synch_list_item);
 
     // To avoid marking this thread as not being scheduled before freeing the lock - which would deadlock anyone else
     // trying to use this semaphore - stop scheduling for the time being.
@@ -99,7 +98,7 @@ void klib_synch_semaphore_clear(klib_semaphore &semaphore)
 {
   KL_TRC_ENTRY;
 
-  klib_list_item<std::shared_ptr<task_thread>> *next_owner;
+  klib_list_item<kl_ref_ptr<task_thread>> *next_owner;
 
   klib_synch_spinlock_lock(semaphore.access_lock);
 
@@ -113,12 +112,10 @@ void klib_synch_semaphore_clear(klib_semaphore &semaphore)
   else
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Getting next user from the head of list\n");
-    KL_TRC_TRACE(TRC_LVL::EXTRA, "Next user is", next_owner->item, "\n");
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Next user is", next_owner->item.get(), "\n");
     ASSERT(semaphore.cur_user_count == semaphore.max_users);
     klib_list_remove(next_owner);
     next_owner->item->start_thread();
-    delete next_owner;
-    next_owner = nullptr;
   }
 
   klib_synch_spinlock_unlock(semaphore.access_lock);
@@ -29,7 +29,7 @@ struct klib_semaphore
 
   /// @brief Which processes are waiting to grab this semaphore?
   ///
-  klib_list<std::shared_ptr<task_thread>> waiting_threads_list;
+  klib_list<kl_ref_ptr<task_thread>> waiting_threads_list;
 
   /// @brief This lock is used to synchronize access to the fields in this structure.
   ///
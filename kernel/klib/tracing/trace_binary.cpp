@@ -0,0 +1,310 @@
+/// @file
+/// @brief Binary tracing, recorded in per-processor ring buffers.
+///
+/// None of the functions in this file may use text tracing, or call anything that does, since they are themselves
+/// called by KL_TRC_ENTRY and KL_TRC_EXIT.
+
+#include <atomic>
+
+#include "klib/tracing/tracing.h"
+#include "klib/tracing/trace_binary.h"
+#include "klib/data_structures/ring_buffer.h"
+#include "processor/processor.h"
+
+#ifdef AZALEA_TEST_CODE
+#include <chrono>
+#else
+#include "processor/x64/processor-x64.h"
+#include "processor/x64/processor-x64-int.h"
+#include "processor/timing/timing.h"
+#endif
+
+#ifdef _MSVC_LANG
+#include <intrin.h>
+#endif
+
+namespace
+{
+  // One ring per processor. No records are stored until trace_ring_count is set by kl_trc_binary_init().
+  kl_mpmc_ring<kl_trc_record> **trace_rings = nullptr;
+  std::atomic<uint32_t> trace_ring_count(0);
+
+  // Records that could not be stored, either because tracing wasn't running yet or because a ring was full.
+  std::atomic<uint64_t> records_dropped(0);
+
+  // The ring that the next drain starts from, so that a busy processor can't starve the others of output.
+  std::atomic<uint32_t> next_drain_ring(0);
+
+#ifndef AZALEA_TEST_CODE
+  // If RDTSCP is available, it gives the TSC and the processor ID (stored in IA32_TSC_AUX) in a single instruction.
+  // Otherwise, fall back to looking the ID up from the local APIC ID.
+  bool use_rdtscp = false;
+
+  // Records are framed when written to the trace output, so the decoder can find them amongst any text tracing.
+  const uint8_t FRAME_MAGIC[] = { 'A', 'Z', 'T', 'R' };
+
+  // Number of records written to the trace output in one go.
+  const uint64_t OUTPUT_BATCH = 16;
+
+  // How long the output thread waits when it finds no records.
+  const uint64_t OUTPUT_IDLE_WAIT_NS = 10000000;
+#endif
+
+#ifndef AZALEA_TEST_CODE
+  // Get the ID of the processor this is running on. This does the same as proc_mp_this_proc_id(), but that function
+  // traces its entry and exit, which would bring it straight back here.
+  uint32_t trc_this_proc_id()
+  {
+    uint64_t ebx_eax;
+    uint64_t edx_ecx;
+    uint32_t lapic_id;
+    uint32_t proc_id = 0;
+
+    asm_proc_read_cpuid(1, 0, &ebx_eax, &edx_ecx);
+    lapic_id = static_cast<uint8_t>(ebx_eax >> 56);
+
+    for (uint32_t i = 0; i < processor_count; i++)
+    {
+      if (proc_info_block[i].platform_data.lapic_id == lapic_id)
+      {
+        proc_id = proc_info_block[i].processor_id;
+        break;
+      }
+    }
+
+    return proc_id;
+  }
+#endif
+
+  // Get the current timestamp, and the ID of the processor it was taken on.
+  uint64_t trc_read_timestamp(uint32_t &proc_id)
+  {
+#ifdef AZALEA_TEST_CODE
+    proc_id = proc_mp_this_proc_id();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    uint64_t timestamp;
+
+    if (use_rdtscp)
+    {
+      timestamp = asm_proc_read_tscp(&proc_id);
+    }
+    else
+    {
+      proc_id = trc_this_proc_id();
+      timestamp = asm_proc_read_tsc();
+    }
+
+    return timestamp;
+#endif
+  }
+
+  void trc_store_record(TRC_EVENT event, uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3)
+  {
+    kl_trc_record record;
+    uint32_t proc_id;
+    uint32_t ring_count = trace_ring_count.load(std::memory_order_acquire);
+
+    if (ring_count == 0)
+    {
+      records_dropped++;
+      return;
+    }
+
+    record.timestamp = trc_read_timestamp(proc_id);
+    record.event_id = static_cast<uint16_t>(event);
+    record.proc_id = static_cast<uint16_t>(proc_id);
+    record.reserved = 0;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    record.args[2] = arg2;
+    record.args[3] = arg3;
+
+    // If this thread moves to another processor before the push completes, it shares that processor's ring for a
+    // moment. That's fine, the rings allow several producers.
+    if ((proc_id >= ring_count) || (!trace_rings[proc_id]->push(record)))
+    {
+      records_dropped++;
+    }
+  }
+}
+
+/// @brief Start storing binary trace records.
+///
+/// Records generated before this is called are counted as dropped. This must only be called once.
+///
+/// @param num_procs The number of processors in the system.
+///
+/// @param records_per_proc The number of records each processor's ring can hold. Must be a power of two.
+void kl_trc_binary_init(uint32_t num_procs, uint64_t records_per_proc)
+{
+  ASSERT(trace_ring_count.load() == 0);
+  ASSERT(num_procs != 0);
+
+#ifndef AZALEA_TEST_CODE
+  use_rdtscp = proc_x64_rdtscp_supported();
+#endif
+
+  trace_rings = new kl_mpmc_ring<kl_trc_record> *[num_procs];
+  for (uint32_t i = 0; i < num_procs; i++)
+  {
+    trace_rings[i] = new kl_mpmc_ring<kl_trc_record>(records_per_proc);
+  }
+
+  trace_ring_count.store(num_procs, std::memory_order_release);
+}
+
+/// @brief Store a binary trace record.
+///
+/// Normally called via KL_TRC_EVENT, so that the call disappears if binary tracing is not enabled. The record is
+/// dropped if the ring for this processor is full.
+///
+/// @param event The event being recorded.
+///
+/// @param arg0 Event-specific argument.
+///
+/// @param arg1 Event-specific argument.
+///
+/// @param arg2 Event-specific argument.
+///
+/// @param arg3 Event-specific argument.
+void kl_trc_event(TRC_EVENT event, uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3)
+{
+  trc_store_record(event, arg0, arg1, arg2, arg3);
+}
+
+/// @brief Store a binary trace record identifying the calling function.
+///
+/// Used by KL_TRC_ENTRY and KL_TRC_EXIT. The first argument of the record is the return address of this function,
+/// which is within the caller, so the decoder can look the caller up in the kernel's map file.
+///
+/// @param event The event being recorded - normally TRC_EVENT::FN_ENTRY or TRC_EVENT::FN_EXIT.
+void kl_trc_fn_event(TRC_EVENT event)
+{
+#ifndef _MSVC_LANG
+  uint64_t caller = reinterpret_cast<uint64_t>(__builtin_return_address(0));
+#else
+  uint64_t caller = reinterpret_cast<uint64_t>(_ReturnAddress());
+#endif
+
+  trc_store_record(event, caller, 0, 0, 0);
+}
+
+/// @brief Remove waiting records from the per-processor rings.
+///
+/// Records from each processor are kept in order, but records from different processors are not merged - the decoder
+/// sorts them by timestamp.
+///
+/// @param[out] records Buffer to store the records in.
+///
+/// @param max_records The maximum number of records to store in records.
+///
+/// @return The number of records stored in records.
+uint64_t kl_trc_binary_drain(kl_trc_record *records, uint64_t max_records)
+{
+  uint32_t ring_count = trace_ring_count.load(std::memory_order_acquire);
+  uint32_t start;
+  uint64_t found = 0;
+
+  if ((ring_count != 0) && (records != nullptr))
+  {
+    start = next_drain_ring.fetch_add(1) % ring_count;
+    for (uint32_t i = 0; (i < ring_count) && (found < max_records); i++)
+    {
+      found += trace_rings[(start + i) % ring_count]->pop_bulk(records + found, max_records - found);
+    }
+  }
+
+  return found;
+}
+
+/// @brief Approximately how many records are waiting to be drained?
+///
+/// @return The number of records waiting in all the rings, which may be out of date by the time it is used.
+uint64_t kl_trc_binary_waiting()
+{
+  uint32_t ring_count = trace_ring_count.load(std::memory_order_acquire);
+  uint64_t waiting = 0;
+
+  for (uint32_t i = 0; i < ring_count; i++)
+  {
+    waiting += trace_rings[i]->entries_available();
+  }
+
+  return waiting;
+}
+
+/// @brief How many records have been dropped since the system started?
+///
+/// @return The number of records dropped.
+uint64_t kl_trc_binary_dropped()
+{
+  return records_dropped.load();
+}
+
+#ifndef AZALEA_TEST_CODE
+/// @brief Thread that continually writes binary trace records to the trace output.
+///
+/// Each record is preceded by the bytes "AZTR" and followed by a 32-bit checksum - the sum of the record's 32-bit
+/// words - so that the decoder can find records amongst text tracing and discard any that text has been mixed in to.
+/// This thread is the only one that waits for the trace output, so tracing itself is not slowed down by it.
+void kl_trc_binary_output_thread()
+{
+  kl_trc_record records[OUTPUT_BATCH];
+  uint64_t count;
+  uint32_t checksum;
+  const uint8_t *record_bytes;
+  const uint32_t *record_words;
+
+  while (1)
+  {
+    count = kl_trc_binary_drain(records, OUTPUT_BATCH);
+    for (uint64_t i = 0; i < count; i++)
+    {
+      record_bytes = reinterpret_cast<const uint8_t *>(&records[i]);
+      record_words = reinterpret_cast<const uint32_t *>(&records[i]);
+
+      checksum = 0;
+      for (uint32_t j = 0; j < sizeof(kl_trc_record) / sizeof(uint32_t); j++)
+      {
+        checksum += record_words[j];
+      }
+
+      for (uint32_t j = 0; j < sizeof(FRAME_MAGIC); j++)
+      {
+        kl_trc_char(FRAME_MAGIC[j]);
+      }
+      for (uint32_t j = 0; j < sizeof(kl_trc_record); j++)
+      {
+        kl_trc_char(record_bytes[j]);
+      }
+      for (uint32_t j = 0; j < sizeof(checksum); j++)
+      {
+        kl_trc_char(static_cast<uint8_t>(checksum >> (j * 8)));
+      }
+    }
+
+    if (count == 0)
+    {
+      time_sleep_process(OUTPUT_IDLE_WAIT_NS);
+    }
+  }
+}
+#endif
+
+/// @brief Stop binary tracing and release the rings, so that another test can start again.
+void test_only_reset_binary_tracing()
+{
+  uint32_t ring_count = trace_ring_count.exchange(0);
+
+  for (uint32_t i = 0; i < ring_count; i++)
+  {
+    delete trace_rings[i];
+  }
+  delete[] trace_rings;
+  trace_rings = nullptr;
+
+  records_dropped = 0;
+  next_drain_ring = 0;
+}
@@ -0,0 +1,61 @@
+/// @file
+/// @brief Binary tracing, recorded in per-processor ring buffers.
+///
+/// Text tracing writes every character to the serial port as it is generated, so it slows the kernel enormously and
+/// changes its timing. Binary tracing instead stores a small fixed-size record per event in a lock-free ring belonging
+/// to the processor that generated it. The records are drained separately - either by reading 'proc\\trace', or by a
+/// kernel thread that writes them to the trace output - and decoded on the host by build_support/exec_trace.py.
+///
+/// Binary events are generated by KL_TRC_EVENT, and by KL_TRC_ENTRY and KL_TRC_EXIT in files that have tracing enabled,
+/// but only if the kernel is built with KL_TRACE_BINARY defined.
+
+#ifndef _KLIB_TRACE_BINARY_H
+#define _KLIB_TRACE_BINARY_H
+
+#include <stdint.h>
+
+/// @brief Identifies the event described by a binary trace record.
+///
+/// The decoder in build_support/exec_trace.py has a matching table, which must be kept in step with this one.
+enum class TRC_EVENT : uint16_t
+{
+  NONE = 0, ///< Not a valid event.
+  FN_ENTRY = 1, ///< A function was entered. Argument 0 is an address within the function.
+  FN_EXIT = 2, ///< A function is about to return. Argument 0 is an address within the function.
+  THREAD_SWITCH = 3, ///< The scheduler switched threads. Arguments 0 and 1 are the old and new threads.
+
+  FIRST_AD_HOC = 0x8000, ///< Event IDs from here upwards are free for temporary debugging.
+};
+
+/// @brief The number of arguments stored in each binary trace record.
+const uint32_t TRC_RECORD_ARGS = 4;
+
+/// @brief A single binary trace record.
+///
+/// The layout is fixed, since the decoder reads it directly.
+struct kl_trc_record
+{
+  uint64_t timestamp; ///< The processor's time stamp counter when the event occurred.
+  uint16_t event_id; ///< The TRC_EVENT describing the event.
+  uint16_t proc_id; ///< The processor that generated the record.
+  uint32_t reserved; ///< Always zero.
+  uint64_t args[TRC_RECORD_ARGS]; ///< Event-specific arguments. Unused arguments are zero.
+};
+static_assert(sizeof(kl_trc_record) == 48, "The trace decoder expects 48-byte records");
+
+void kl_trc_binary_init(uint32_t num_procs, uint64_t records_per_proc);
+void kl_trc_event(TRC_EVENT event, uint64_t arg0 = 0, uint64_t arg1 = 0, uint64_t arg2 = 0, uint64_t arg3 = 0);
+void kl_trc_fn_event(TRC_EVENT event);
+
+uint64_t kl_trc_binary_drain(kl_trc_record *records, uint64_t max_records);
+uint64_t kl_trc_binary_waiting();
+uint64_t kl_trc_binary_dropped();
+
+#ifndef AZALEA_TEST_CODE
+void kl_trc_binary_output_thread();
+#endif
+
+// Test-only code
+void test_only_reset_binary_tracing();
+
+#endif
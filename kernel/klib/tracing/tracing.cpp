@@ -1,6 +1,6 @@
 // KLib Kernel tracing library. In the live version of the kernel, these will do nothing.
 
-#include "tracing.h"
+#include "klib/klib.h"
 
 // The destination of tracing is controlled by defining one of the following possible flags at compile time.
 // The flag itself is currently passed directly to the compiler.
@@ -23,6 +23,140 @@ const uint16_t TRC_MAGIC_PORT = 0xE9;
 using namespace std;
 #endif
 
+std::atomic<uint8_t> kl_trc_cat_min_levels[static_cast<uint8_t>(TRC_CAT::COUNT)] =
+  { TRC_LVL_OFF, TRC_LVL_OFF, TRC_LVL_OFF, TRC_LVL_OFF, TRC_LVL_OFF,
+    TRC_LVL_OFF, TRC_LVL_OFF, TRC_LVL_OFF, TRC_LVL_OFF, TRC_LVL_OFF };
+static_assert(static_cast<uint8_t>(TRC_CAT::COUNT) == 10, "Update kl_trc_cat_min_levels and trc_cat_names");
+
+namespace
+{
+  // The names of each category, as used in trace control commands. In the same order as TRC_CAT.
+  const char *trc_cat_names[] = { "general", "acpi", "devices", "fs", "klib", "mem", "object_mgr", "processor",
+                                  "syscall", "system_tree" };
+
+  struct trc_level_name
+  {
+    const char *name;
+    uint8_t level;
+  };
+
+  // The names that can be given instead of a numeric level in trace control commands.
+  const trc_level_name trc_level_names[] = { { "extra", static_cast<uint8_t>(TRC_LVL::EXTRA) },
+                                             { "flow", static_cast<uint8_t>(TRC_LVL::FLOW) },
+                                             { "important", static_cast<uint8_t>(TRC_LVL::IMPORTANT) },
+                                             { "error", static_cast<uint8_t>(TRC_LVL::ERROR) },
+                                             { "fatal", static_cast<uint8_t>(TRC_LVL::FATAL) },
+                                             { "off", TRC_LVL_OFF } };
+
+  // Split the first whitespace-separated word from text, and remove it (and any whitespace before it) from text.
+  kl_string_view trc_next_word(kl_string_view &text)
+  {
+    uint64_t start = 0;
+    uint64_t end;
+
+    while ((start < text.length()) && ((text[start] == ' ') || (text[start] == '\t')))
+    {
+      start++;
+    }
+    end = start;
+    while ((end < text.length()) && (text[end] != ' ') && (text[end] != '\t'))
+    {
+      end++;
+    }
+
+    kl_string_view word = text.substr(start, end - start);
+    text = text.substr(end);
+
+    return word;
+  }
+
+  // Convert a level name or decimal number in to a level. Returns false if it is neither.
+  bool trc_parse_level(const kl_string_view &word, uint8_t &level)
+  {
+    uint64_t value = 0;
+
+    for (const trc_level_name &n : trc_level_names)
+    {
+      if (word == kl_string_view(n.name))
+      {
+        level = n.level;
+        return true;
+      }
+    }
+
+    if ((word.length() == 0) || (word.length() > 3))
+    {
+      return false;
+    }
+
+    for (uint64_t i = 0; i < word.length(); i++)
+    {
+      if ((word[i] < '0') || (word[i] > '9'))
+      {
+        return false;
+      }
+      value = (value * 10) + (word[i] - '0');
+    }
+
+    if (value > TRC_LVL_OFF)
+    {
+      return false;
+    }
+
+    level = static_cast<uint8_t>(value);
+    return true;
+  }
+
+  // Apply a single "<category> <level>" command. Blank lines are allowed, and ignored.
+  ERR_CODE trc_apply_command(kl_string_view line)
+  {
+    kl_string_view cat_word = trc_next_word(line);
+    kl_string_view level_word = trc_next_word(line);
+    kl_string_view extra_word = trc_next_word(line);
+    uint8_t level;
+    uint8_t first_cat;
+    uint8_t last_cat;
+
+    if (cat_word.length() == 0)
+    {
+      return ERR_CODE::NO_ERROR;
+    }
+
+    if ((extra_word.length() != 0) || !trc_parse_level(level_word, level))
+    {
+      return ERR_CODE::INVALID_PARAM;
+    }
+
+    if (cat_word == kl_string_view("all"))
+    {
+      first_cat = 0;
+      last_cat = static_cast<uint8_t>(TRC_CAT::COUNT) - 1;
+    }
+    else
+    {
+      for (first_cat = 0; first_cat < static_cast<uint8_t>(TRC_CAT::COUNT); first_cat++)
+      {
+        if (cat_word == kl_string_view(trc_cat_names[first_cat]))
+        {
+          break;
+        }
+      }
+      if (first_cat == static_cast<uint8_t>(TRC_CAT::COUNT))
+      {
+        return ERR_CODE::NOT_FOUND;
+      }
+      last_cat = first_cat;
+    }
+
+    for (uint8_t i = first_cat; i <= last_cat; i++)
+    {
+      kl_trc_set_level(static_cast<TRC_CAT>(i), level);
+    }
+
+    return ERR_CODE::NO_ERROR;
+  }
+}
+
 #ifdef KL_TRACE_BY_SERIAL_PORT
 
 bool kl_trc_serial_port_ready()
@@ -106,6 +240,14 @@ void kl_trc_output_kl_string_argument(kl_string &str)
   }
 }
 
+void kl_trc_output_kl_string_view_argument(const kl_string_view &str)
+{
+  for (uint64_t x = 0; x < str.length(); x++)
+  {
+    kl_trc_char(str[x]);
+  }
+}
+
 void kl_trc_output_err_code_argument(ERR_CODE ec)
 {
   const char *msg = nullptr;
@@ -189,3 +331,108 @@ void kl_trc_output_err_code_argument(ERR_CODE ec)
     kl_trc_output_int_argument((uint64_t)(ec));
   }
 }
+
+/// @brief Set the lowest level of trace output wanted from a category.
+///
+/// Only affects files that are built with tracepoints but without ENABLE_TRACING - see tracing.h.
+///
+/// @param cat The category to change.
+///
+/// @param min_level Trace output at this level or higher is produced. TRC_LVL_OFF turns the category off.
+void kl_trc_set_level(TRC_CAT cat, uint8_t min_level)
+{
+  ASSERT(cat < TRC_CAT::COUNT);
+  kl_trc_cat_min_levels[static_cast<uint8_t>(cat)].store(min_level, std::memory_order_relaxed);
+}
+
+/// @brief Get the lowest level of trace output wanted from a category.
+///
+/// @param cat The category to look at.
+///
+/// @return The lowest level of trace output produced, or TRC_LVL_OFF if the category is off.
+uint8_t kl_trc_get_level(TRC_CAT cat)
+{
+  ASSERT(cat < TRC_CAT::COUNT);
+  return kl_trc_cat_min_levels[static_cast<uint8_t>(cat)].load(std::memory_order_relaxed);
+}
+
+/// @brief Change trace levels using text commands.
+///
+/// Each line of commands is of the form "<category> <level>", where category is one of the names given by
+/// kl_trc_describe_levels() or "all", and level is one of "extra", "flow", "important", "error", "fatal", "off" or a
+/// number between 0 and 255. Commands are applied in order, and processing stops at the first bad line.
+///
+/// None of this code is traced, since it changes what tracing does.
+///
+/// @param commands The commands to apply.
+///
+/// @return ERR_CODE::NO_ERROR if all commands were applied. ERR_CODE::NOT_FOUND if a category is not recognised.
+///         ERR_CODE::INVALID_PARAM if a line is badly formed.
+ERR_CODE kl_trc_apply_control(const kl_string_view &commands)
+{
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  kl_string_view remaining = commands;
+  kl_string_view line;
+  uint64_t line_end;
+
+  while ((remaining.length() != 0) && (result == ERR_CODE::NO_ERROR))
+  {
+    line_end = remaining.find('\n');
+    line = remaining.substr(0, line_end);
+    if ((line.length() != 0) && (line[line.length() - 1] == '\r'))
+    {
+      line = line.substr(0, line.length() - 1);
+    }
+    remaining = (line_end == kl_string_view::npos) ? kl_string_view() : remaining.substr(line_end + 1);
+
+    result = trc_apply_command(line);
+  }
+
+  return result;
+}
+
+/// @brief Write the current trace levels as text, one "<category> <level>" line per category.
+///
+/// The output can be given straight back to kl_trc_apply_control().
+///
+/// @param[out] buffer Buffer to write the text in to. May be nullptr, to find the required size.
+///
+/// @param buffer_length The size of buffer. The text is truncated, but always zero-terminated, if it doesn't fit.
+///
+/// @return The length of the full text, not including the terminating zero.
+uint64_t kl_trc_describe_levels(char *buffer, uint64_t buffer_length)
+{
+  uint64_t total = 0;
+  uint64_t written;
+  uint8_t level;
+  char level_str[4];
+
+  if ((buffer != nullptr) && (buffer_length != 0))
+  {
+    buffer[0] = 0;
+  }
+
+  for (uint8_t i = 0; i < static_cast<uint8_t>(TRC_CAT::COUNT); i++)
+  {
+    level = kl_trc_get_level(static_cast<TRC_CAT>(i));
+    klib_snprintf(level_str, sizeof(level_str), "%u", static_cast<uint32_t>(level));
+
+    written = klib_snprintf((total < buffer_length) ? buffer + total : nullptr,
+                            (total < buffer_length) ? buffer_length - total : 0,
+                            "%s %s\n",
+                            trc_cat_names[i],
+                            (level == TRC_LVL_OFF) ? "off" : level_str);
+    total += written;
+  }
+
+  return total;
+}
+
+/// @brief Turn off all trace categories, so that another test starts from the default settings.
+void test_only_reset_trace_levels()
+{
+  for (uint8_t i = 0; i < static_cast<uint8_t>(TRC_CAT::COUNT); i++)
+  {
+    kl_trc_set_level(static_cast<TRC_CAT>(i), TRC_LVL_OFF);
+  }
+}
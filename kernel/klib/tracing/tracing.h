@@ -3,8 +3,11 @@
 
 #include <stdint.h>
 #include <type_traits>
+#include <atomic>
+#include <memory>
 #include "klib/data_structures/string.h"
 #include "user_interfaces/error_codes.h"
+#include "klib/tracing/trace_binary.h"
 
 //#define ENABLE_TRACING
 
@@ -21,12 +24,134 @@ enum class TRC_LVL
   FATAL = 100,
 };
 
+/// @brief Kernel subsystems, so that trace output can be selected at runtime.
+///
+/// Each file's category is worked out from its path by kl_trc_path_category(), unless the file defines KL_TRC_CATEGORY
+/// before including this header.
+enum class TRC_CAT : uint8_t
+{
+  GENERAL, ///< Anything not covered below.
+  ACPI, ///< The ACPI interface.
+  DEVICES, ///< Device drivers.
+  FS, ///< Filesystems.
+  KLIB, ///< The kernel library.
+  MEM, ///< The memory manager.
+  OBJECT_MGR, ///< The object manager.
+  PROCESSOR, ///< Processor control and the task manager.
+  SYSCALL, ///< The system call interface.
+  SYSTEM_TREE, ///< System tree, other than filesystems.
+
+  COUNT, ///< The number of categories. Not a category.
+};
+
+/// @brief The minimum level of a trace level setting that means "trace nothing".
+const uint8_t TRC_LVL_OFF = 255;
+
+/// @brief Does one string contain another? Forward and backward slashes are treated the same.
+///
+/// @param path The string to search.
+///
+/// @param part The string to look for. Should use forward slashes.
+///
+/// @return True if part is found in path.
+constexpr bool kl_trc_path_contains(const char *path, const char *part)
+{
+  uint64_t i = 0;
+
+  for (; *path != 0; path++)
+  {
+    i = 0;
+    while ((part[i] != 0) && ((path[i] == part[i]) || ((path[i] == '\\') && (part[i] == '/'))))
+    {
+      i++;
+    }
+    if (part[i] == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// @brief Work out the trace category of a source file from its path.
+///
+/// This is evaluated while compiling, so costs nothing at runtime.
+///
+/// @param path The path of the file, normally from __FILE__.
+///
+/// @return The category of the file.
+constexpr TRC_CAT kl_trc_path_category(const char *path)
+{
+  // Filesystems live within the system tree, so must be checked first.
+  if (kl_trc_path_contains(path, "/system_tree/fs/")) { return TRC_CAT::FS; }
+  if (kl_trc_path_contains(path, "/system_tree/")) { return TRC_CAT::SYSTEM_TREE; }
+  if (kl_trc_path_contains(path, "/acpi/")) { return TRC_CAT::ACPI; }
+  if (kl_trc_path_contains(path, "/devices/")) { return TRC_CAT::DEVICES; }
+  if (kl_trc_path_contains(path, "/klib/")) { return TRC_CAT::KLIB; }
+  if (kl_trc_path_contains(path, "/mem/")) { return TRC_CAT::MEM; }
+  if (kl_trc_path_contains(path, "/object_mgr/")) { return TRC_CAT::OBJECT_MGR; }
+  if (kl_trc_path_contains(path, "/processor/")) { return TRC_CAT::PROCESSOR; }
+  if (kl_trc_path_contains(path, "/syscall/")) { return TRC_CAT::SYSCALL; }
+
+  return TRC_CAT::GENERAL;
+}
+
+// The lowest level of trace output wanted from each category. Defaults to TRC_LVL_OFF.
+extern std::atomic<uint8_t> kl_trc_cat_min_levels[static_cast<uint8_t>(TRC_CAT::COUNT)];
+
+/// @brief Is trace output wanted from this category at this level?
+///
+/// Called by every tracepoint that is not forced on, so it is kept as cheap as possible.
+///
+/// @param cat The category of the tracepoint.
+///
+/// @param lvl The level of the tracepoint.
+///
+/// @return True if the output is wanted.
+inline bool kl_trc_enabled(TRC_CAT cat, TRC_LVL lvl)
+{
+  bool result = (static_cast<uint8_t>(lvl) >=
+                 kl_trc_cat_min_levels[static_cast<uint8_t>(cat)].load(std::memory_order_relaxed));
+#ifndef _MSVC_LANG
+  return __builtin_expect(result, false);
+#else
+  return result;
+#endif
+}
+
+// Tracepoints are compiled in to a file if it defines ENABLE_TRACING, or if KL_TRACE_ALL is defined for the whole
+// build. Files that define ENABLE_TRACING always produce output. Elsewhere, output is selected at runtime by category
+// and level - see kl_trc_set_level() and the 'trace_control' file in proc.
+#if defined(ENABLE_TRACING) || defined(KL_TRACE_ALL)
+
+#ifdef KL_TRC_CATEGORY
+#define KL_TRC_FILE_CATEGORY KL_TRC_CATEGORY
+#else
+#define KL_TRC_FILE_CATEGORY (std::integral_constant<TRC_CAT, kl_trc_path_category(__FILE__)>::value)
+#endif
+
 #ifdef ENABLE_TRACING
+#define KL_TRC_ACTIVE(lvl) (true)
+#else
+#define KL_TRC_ACTIVE(lvl) kl_trc_enabled(KL_TRC_FILE_CATEGORY, lvl)
+#endif
+
 #define KL_TRC_INIT_TRACING kl_tr_init_tracing
-#define KL_TRC_TRACE(...) kl_trc_trace(__VA_ARGS__)
+#define KL_TRC_TRACE(lvl, ...) do { if (KL_TRC_ACTIVE(lvl)) { kl_trc_trace(lvl, __VA_ARGS__); } } while (0)
 
-#define KL_TRC_ENTRY kl_trc_trace(TRC_LVL::FLOW, "ENTRY ", __FUNCTION__, " { \n")
-#define KL_TRC_EXIT kl_trc_trace(TRC_LVL::FLOW, "EXIT ", __FUNCTION__, " } \n")
+// With binary tracing, function entry and exit are recorded in the trace rings rather than being written out as text.
+#ifdef KL_TRACE_BINARY
+#define KL_TRC_ENTRY \
+  do { if (KL_TRC_ACTIVE(TRC_LVL::FLOW)) { kl_trc_fn_event(TRC_EVENT::FN_ENTRY); } } while (0)
+#define KL_TRC_EXIT \
+  do { if (KL_TRC_ACTIVE(TRC_LVL::FLOW)) { kl_trc_fn_event(TRC_EVENT::FN_EXIT); } } while (0)
+#else
+#define KL_TRC_ENTRY \
+  do { if (KL_TRC_ACTIVE(TRC_LVL::FLOW)) { kl_trc_trace(TRC_LVL::FLOW, "ENTRY ", __FUNCTION__, " { \n"); } } while (0)
+#define KL_TRC_EXIT \
+  do { if (KL_TRC_ACTIVE(TRC_LVL::FLOW)) { kl_trc_trace(TRC_LVL::FLOW, "EXIT ", __FUNCTION__, " } \n"); } } while (0)
+#endif
 
 #else
 #define KL_TRC_INIT_TRACING
@@ -37,10 +162,25 @@ enum class TRC_LVL
 
 #endif
 
+// Binary trace events are controlled by KL_TRACE_BINARY for the whole kernel, rather than ENABLE_TRACING in each file.
+#ifdef KL_TRACE_BINARY
+#define KL_TRC_EVENT(...) kl_trc_event(__VA_ARGS__)
+#else
+#define KL_TRC_EVENT(...)
+#endif
+
 // Function declarations. These should - largely - never be called directly, to
 // allow for compile-time removal of tracing calls in the release build.
 void kl_trc_init_tracing();
 
+void kl_trc_set_level(TRC_CAT cat, uint8_t min_level);
+uint8_t kl_trc_get_level(TRC_CAT cat);
+ERR_CODE kl_trc_apply_control(const kl_string_view &commands);
+uint64_t kl_trc_describe_levels(char *buffer, uint64_t buffer_length);
+
+// Test-only code
+void test_only_reset_trace_levels();
+
 template<typename ... args_t> void kl_trc_trace(TRC_LVL lvl, args_t ... params);
 template<typename p, typename ... args_t> void kl_trc_output_arguments(p param, args_t ... params);
 template<typename p> void kl_trc_output_arguments(p param);
@@ -51,6 +191,7 @@ void kl_trc_char(unsigned char c);
 void kl_trc_output_str_argument(char const *str);
 void kl_trc_output_int_argument(uint64_t value);
 void kl_trc_output_kl_string_argument(kl_string &str);
+void kl_trc_output_kl_string_view_argument(const kl_string_view &str);
 void kl_trc_output_err_code_argument(ERR_CODE ec);
 
 // Template to output integral types
@@ -78,6 +219,14 @@ T kl_trc_output_single_arg(T& param)
   return param;
 }
 
+template<typename T = kl_string_view, typename = typename std::enable_if<std::is_same<T, kl_string_view>::value>::type,
+    typename B = void, typename C = void, typename D = void, typename E = void, typename F = void, typename G = void>
+T kl_trc_output_single_arg(T param)
+{
+  kl_trc_output_kl_string_view_argument(param);
+  return param;
+}
+
 // Template to output all other pointers
 template<typename T, typename = typename std::enable_if<std::is_pointer<T>::value, T>::type,
     typename = typename std::enable_if<!std::is_same<T, char const *>::value>::type, typename X = void,
@@ -88,6 +237,23 @@ T kl_trc_output_single_arg(T param)
   return param;
 }
 
+// Template to output other enumerations as integers
+template<typename T, typename = typename std::enable_if<std::is_enum<T>::value>::type,
+    typename = typename std::enable_if<!std::is_same<T, ERR_CODE>::value>::type, typename B = void,
+    typename C = void, typename D = void, typename E = void, typename F = void, typename G = void, typename H = void>
+T kl_trc_output_single_arg(T param)
+{
+  kl_trc_output_int_argument(static_cast<uint64_t>(param));
+  return param;
+}
+
+// Template to output shared pointers as the address they point to
+template<typename T> std::shared_ptr<T> &kl_trc_output_single_arg(std::shared_ptr<T> &param)
+{
+  kl_trc_output_int_argument(reinterpret_cast<uint64_t>(param.get()));
+  return param;
+}
+
 // Template to output ERR_CODE results
 template<typename T, typename = typename std::enable_if<std::is_same<T, ERR_CODE>::value>::type,
     typename B = void, typename C = void, typename D = void, typename E = void, typename F = void>
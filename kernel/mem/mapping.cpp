@@ -51,16 +51,19 @@ void mem_map_init_counters()
 /// @param context Which process is this mapping occurring in. If nullptr, assume the current process.
 ///
 /// @param cache_mode The cache mode that should apply to this mapping. See MEM_CACHE_MODES for more.
+///
+/// @param writable Whether the page can be written to. If false, the page is read-only.
 void mem_map_virtual_page(uint64_t virt_addr,
                           uint64_t phys_addr,
                           task_process *context,
-                          MEM_CACHE_MODES cache_mode)
+                          MEM_CACHE_MODES cache_mode,
+                          bool writable)
 {
   uint32_t phys_page_num;
 
   KL_TRC_ENTRY;
 
-  mem_x64_map_virtual_page(virt_addr, phys_addr, context, cache_mode);
+  mem_x64_map_virtual_page(virt_addr, phys_addr, context, cache_mode, writable);
 
   klib_synch_spinlock_lock(counter_lock);
 
@@ -129,11 +132,14 @@ void mem_unmap_virtual_page(uint64_t virt_addr, task_process *context, bool allo
 /// @param context Which process is this mapping occurring in. If nullptr, assume the current process.
 ///
 /// @param cache_mode The cache mode that should apply to this mapping. See MEM_CACHE_MODES for more.
+///
+/// @param writable Whether the pages can be written to. If false, the pages are read-only.
 void mem_map_range(void *physical_start,
                    void* virtual_start,
                    uint32_t len,
                    task_process *context,
-                   MEM_CACHE_MODES cache_mode)
+                   MEM_CACHE_MODES cache_mode,
+                   bool writable)
 {
   KL_TRC_ENTRY;
 
@@ -155,7 +161,8 @@ void mem_map_range(void *physical_start,
     mem_map_virtual_page((uint64_t)cur_virt_addr,
                          (uint64_t)cur_phys_addr,
                          context,
-                         cache_mode);
+                         cache_mode,
+                         writable);
     cur_virt_addr += MEM_PAGE_SIZE;
     cur_phys_addr += MEM_PAGE_SIZE;
   }
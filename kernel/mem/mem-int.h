@@ -20,7 +20,8 @@ void mem_map_init_counters();
 void mem_map_virtual_page(uint64_t virt_addr,
                           uint64_t phys_addr,
                           task_process *context = nullptr,
-                          MEM_CACHE_MODES cache_mode = MEM_WRITE_BACK);
+                          MEM_CACHE_MODES cache_mode = MEM_WRITE_BACK,
+                          bool writable = true);
 void mem_unmap_virtual_page(uint64_t virt_addr, task_process *context, bool allow_phys_page_free);
 
 void mem_vmm_init_proc_data(vmm_process_data &proc_data_ref);
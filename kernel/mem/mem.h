@@ -107,7 +107,8 @@ void mem_map_range(void *physical_start,
                    void* virtual_start,
                    uint32_t len,
                    task_process *context = nullptr,
-                   MEM_CACHE_MODES cache_mode = MEM_WRITE_BACK);
+                   MEM_CACHE_MODES cache_mode = MEM_WRITE_BACK,
+                   bool writable = true);
 void *mem_allocate_pages(uint32_t num_pages);
 
 void mem_deallocate_physical_pages(void *start, uint32_t num_pages);
@@ -33,7 +33,8 @@ struct process_x64_data
 void mem_x64_map_virtual_page(uint64_t virt_addr,
                               uint64_t phys_addr,
                               task_process *context = nullptr,
-                              MEM_CACHE_MODES cache_mode = MEM_WRITE_BACK);
+                              MEM_CACHE_MODES cache_mode = MEM_WRITE_BACK,
+                              bool writable = true);
 void mem_x64_unmap_virtual_page(uint64_t virt_addr, task_process *context);
 
 uint64_t mem_encode_page_table_entry(page_table_entry &pte);
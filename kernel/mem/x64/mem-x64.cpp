@@ -199,10 +199,14 @@ void mem_gen_phys_pages_bitmap(e820_pointer *e820_ptr, uint64_t *bitmap_loc, uin
 /// @param context The process that the mapping should occur in. Defaults to the currently running process.
 ///
 /// @param cache_mode Which cache mode is required. Defaults to WRITE_BACK.
+///
+/// @param writable Whether the page can be written to. Defaults to true. Only the final page table entry is marked
+///                 read-only, since the tables above it may be shared with other mappings.
 void mem_x64_map_virtual_page(uint64_t virt_addr,
                               uint64_t phys_addr,
                               task_process *context,
-                              MEM_CACHE_MODES cache_mode)
+                              MEM_CACHE_MODES cache_mode,
+                              bool writable)
 {
   KL_TRC_ENTRY;
 
@@ -317,7 +321,7 @@ void mem_x64_map_virtual_page(uint64_t virt_addr,
 
   new_entry.target_addr = phys_addr;
   new_entry.present = true;
-  new_entry.writable = true;
+  new_entry.writable = writable;
   new_entry.user_mode = !is_kernel_allocation;
   new_entry.end_of_tree = true;
   new_entry.cache_type = (uint8_t)cache_mode;
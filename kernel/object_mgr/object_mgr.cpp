@@ -3,21 +3,34 @@
 ///
 /// The Object Manager correlates handles and objects. Objects are any data object the user wishes to keep a reference
 /// to. Users are responsible for ensuring that objects are removed from the Object Manager before destruction. The
-/// kernel has several instances of OM objects - each thread has one, since handles are unique to each thread.
+/// kernel has several instances of OM objects - each process has one, since handles are unique to each process.
 ///
 /// When an object is said to be "stored in OM" it does not mean that the object is in any way copied into OM. OM
 /// simply stores a reference to the object (a pointer at the moment) which continues to live where it did before.
 ///
-/// Handles within OM are unique to a thread - attempting to use a handle in a thread other than the one it was
+/// Handles within OM are unique to a process - attempting to use a handle in a process other than the one it was
 /// correlated in will cause the object lookup to fail.
+///
+/// Objects are kept in a table, with the lower HANDLE_INDEX_BITS bits of each handle giving the index of the object's
+/// slot. The remaining bits are the slot's generation, which is never zero, so no valid handle is zero.
 
 #include "klib/klib.h"
 #include "handles.h"
 #include "object_mgr.h"
 #include "processor/processor.h"
+#include "system_tree/fs/fs_file_interface.h"
+
+namespace
+{
+  const uint64_t OM_INITIAL_TABLE_SIZE = 16;
+  const uint64_t OM_INDEX_MASK = object_manager::MAX_OBJECTS - 1;
+}
 
 /// @brief Initialise the object manager system
-object_manager::object_manager()
+object_manager::object_manager() :
+  om_table(nullptr),
+  om_table_size(0),
+  om_first_free(0)
 {
   KL_TRC_ENTRY;
 
@@ -28,6 +41,8 @@ object_manager::object_manager()
 
 object_manager::~object_manager()
 {
+  delete[] om_table;
+  om_table = nullptr;
 }
 
 /// @brief Store an object in Object Manager
@@ -41,11 +56,44 @@ GEN_HANDLE object_manager::store_object(std::shared_ptr<IHandledObject> object_p
 {
   KL_TRC_ENTRY;
 
-  GEN_HANDLE new_handle = hm_get_handle();
+  GEN_HANDLE new_handle;
+  object_slot *slot;
+  uint64_t index;
+  IReadable *readable;
+  IWritable *writable;
+  WaitObject *wait_obj;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Object pointer: ", object_ptr, "\n");
 
   ASSERT(object_ptr != nullptr);
 
-  this->correlate_object(object_ptr, new_handle);
+  // Work out the interfaces before taking the lock, there's no need to hold it while doing so.
+  readable = dynamic_cast<IReadable *>(object_ptr.get());
+  writable = dynamic_cast<IWritable *>(object_ptr.get());
+  wait_obj = dynamic_cast<WaitObject *>(object_ptr.get());
+
+  klib_synch_spinlock_lock(om_main_lock);
+
+  if (om_first_free == om_table_size)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No free slots, grow table\n");
+    this->int_grow_table();
+  }
+
+  index = om_first_free;
+  slot = &om_table[index];
+  ASSERT(!slot->in_use);
+  om_first_free = slot->next_free;
+
+  new_handle = (slot->generation << HANDLE_INDEX_BITS) | index;
+  slot->data.object_ptr = object_ptr;
+  slot->data.handle = new_handle;
+  slot->data.readable = readable;
+  slot->data.writable = writable;
+  slot->data.wait_obj = wait_obj;
+  slot->in_use = true;
+
+  klib_synch_spinlock_unlock(om_main_lock);
 
   KL_TRC_TRACE(TRC_LVL::EXTRA, "New handle: ", new_handle, "\n");
   KL_TRC_EXIT;
@@ -53,147 +101,201 @@ GEN_HANDLE object_manager::store_object(std::shared_ptr<IHandledObject> object_p
   return new_handle;
 }
 
-/// @brief Store an object in Object Manager with a known handle
-///
-/// In some cases, it is useful for the caller to have generated a handle for an object it wishes to store in OM. This
-/// function stores the object and correlates it with the provided handle.
+/// @brief Retrieve the object that correlates to handle
 ///
-/// @param object_ptr A pointer to the object to be stored
+/// @param handle The handle to retrieve the corresponding object for
 ///
-/// @param handle The handle that should refer to object_ptr
-void object_manager::correlate_object(std::shared_ptr<IHandledObject> object_ptr, GEN_HANDLE handle)
+/// @return A pointer to the object stored in OM. nullptr if the handle does not correspond to an object in OM.
+std::shared_ptr<IHandledObject> object_manager::retrieve_object(GEN_HANDLE handle)
 {
   KL_TRC_ENTRY;
 
-  std::shared_ptr<object_data> new_object = std::make_shared<object_data>();
-
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Object pointer: ", object_ptr, "\n");
-
-  ASSERT(object_ptr != nullptr);
+  object_slot *slot;
+  std::shared_ptr<IHandledObject> object_ptr;
 
-  new_object->object_ptr = object_ptr;
-  new_object->handle = handle;
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Looking for handle ", handle, "\n");
 
   klib_synch_spinlock_lock(om_main_lock);
-  object_store.insert(handle, new_object);
+  slot = this->int_retrieve_slot(handle);
+  if (slot != nullptr)
+  {
+    object_ptr = slot->data.object_ptr;
+  }
   klib_synch_spinlock_unlock(om_main_lock);
 
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Found object: ", object_ptr.get(), "\n");
   KL_TRC_EXIT;
+
+  return object_ptr;
 }
 
-/// @brief Retrieve the object that correlates to handle
+/// @brief Retrieve an object along with its cached interfaces.
 ///
-/// @param handle The handle to retrieve the corresponding object for
+/// This is intended for hot paths like reading and writing, which can then use the interface they need without a
+/// dynamic cast.
 ///
-/// @return A pointer to the object stored in OM. nullptr if the handle does not correspond to an object in OM.
-std::shared_ptr<IHandledObject> object_manager::retrieve_object(GEN_HANDLE handle)
+/// @param handle The handle to retrieve the corresponding object for.
+///
+/// @param[out] data A copy of the stored data for the object. The interface pointers remain valid for as long as the
+///                  caller holds data.object_ptr.
+///
+/// @return True if the handle corresponds to an object in OM, false otherwise.
+bool object_manager::retrieve_object_data(GEN_HANDLE handle, object_data &data)
 {
   KL_TRC_ENTRY;
 
-  std::shared_ptr<object_data> found_object;
-  std::shared_ptr<IHandledObject> object_ptr;
+  object_slot *slot;
+  bool result = false;
 
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Looking for handle ", handle, "\n");
 
   klib_synch_spinlock_lock(om_main_lock);
-  found_object = this->int_retrieve_object(handle);
-  klib_synch_spinlock_unlock(om_main_lock);
-
-  if (found_object != nullptr)
+  slot = this->int_retrieve_slot(handle);
+  if (slot != nullptr)
   {
-    KL_TRC_TRACE(TRC_LVL::EXTRA, "Found object", found_object->object_ptr, "\n");
-    object_ptr = found_object->object_ptr;
-  }
-  else
-  {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Didn't find object\n");
-    object_ptr = nullptr;
+    data = slot->data;
+    result = true;
   }
+  klib_synch_spinlock_unlock(om_main_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
   KL_TRC_EXIT;
-  return object_ptr;
+
+  return result;
 }
 
 /// @brief Remove an object from OM and destroy the handle
 ///
 /// Removes the correlation between a handle and object, and frees the handle for re-use. It is up to the caller to
-/// manage the lifetime of the associated object.
+/// manage the lifetime of the associated object. Handles that do not correspond to an object are ignored.
 ///
 /// @param handle The handle to destroy
 void object_manager::remove_object(GEN_HANDLE handle)
 {
   KL_TRC_ENTRY;
 
+  object_slot *slot;
+  std::shared_ptr<IHandledObject> removed_obj;
+
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Remove and destroy handle ", handle, "\n");
-  this->decorrelate_object(handle);
-  hm_release_handle(handle);
+
+  klib_synch_spinlock_lock(om_main_lock);
+  slot = this->int_retrieve_slot(handle);
+  if (slot != nullptr)
+  {
+    // Keep the object alive until the lock is released, in case its destructor needs OM.
+    removed_obj = std::move(slot->data.object_ptr);
+    slot->data.object_ptr = nullptr;
+    slot->in_use = false;
+    slot->generation++;
+    if ((slot->generation << HANDLE_INDEX_BITS) == 0)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Generation wrapped\n");
+      slot->generation = 1;
+    }
+    slot->next_free = om_first_free;
+    om_first_free = handle & OM_INDEX_MASK;
+  }
+  klib_synch_spinlock_unlock(om_main_lock);
+
+  removed_obj = nullptr;
 
   KL_TRC_EXIT;
 }
 
-/// @brief Remove the correlation between handle and object, but leave both intact
+/// @brief Find the slot storing the object for a handle.
 ///
-/// Removes the correlation between a handle and object, but does not deallocate the handle It is up to the caller to
-/// manage the lifetime of both the object and handle.
+/// This function is internal to OM. The caller must hold om_main_lock.
 ///
-/// This function will fail and panic if the correlation is not legitimate.
+/// @param handle The handle to look for.
 ///
-/// @param handle The handle for the object to remove.
-void object_manager::decorrelate_object(GEN_HANDLE handle)
+/// @return The slot storing the object, or nullptr if the handle is not valid.
+object_manager::object_slot *object_manager::int_retrieve_slot(GEN_HANDLE handle)
 {
-  KL_TRC_ENTRY;
+  object_slot *slot = nullptr;
+  uint64_t index = handle & OM_INDEX_MASK;
 
-  std::shared_ptr<object_data> found_object;
-
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Removing object with handle ", handle, "\n");
-
-  klib_synch_spinlock_lock(om_main_lock);
-  found_object = this->int_retrieve_object(handle);
-  object_store.remove(handle);
-  klib_synch_spinlock_unlock(om_main_lock);
+  if ((index < om_table_size) &&
+      om_table[index].in_use &&
+      (om_table[index].data.handle == handle))
+  {
+    slot = &om_table[index];
+  }
 
-  KL_TRC_EXIT;
+  return slot;
 }
 
-/// @brief Retrieve all object data from OM
-///
-/// This function is internal to OM. It retrieves the underlying data structure storing a given object in OM. This
-/// function contains no locking - **appropriate serialisation MUST be used**, only one function can call this one at
-/// a time.
-///
-/// This function does not check that the handle is valid in this thread, that is up to the caller.
+/// @brief Double the size of the object table.
 ///
-/// @param handle The handle to retrieve data for
-///
-/// @return The underlying object data in OM.
-std::shared_ptr<object_data> object_manager::int_retrieve_object(GEN_HANDLE handle)
+/// This function is internal to OM. The caller must hold om_main_lock, and there must be no free slots.
+void object_manager::int_grow_table()
 {
   KL_TRC_ENTRY;
 
-  std::shared_ptr<object_data> found_object;
+  uint64_t new_size = (om_table_size == 0) ? OM_INITIAL_TABLE_SIZE : om_table_size * 2;
+  object_slot *new_table;
+
+  ASSERT(om_first_free == om_table_size);
+  if (new_size > MAX_OBJECTS)
+  {
+    panic("Out of handles!");
+  }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Handle to retrieve: ", handle, "\n");
+  new_table = new object_slot[new_size];
+  ASSERT(new_table != nullptr);
 
-  if (object_store.contains(handle))
+  for (uint64_t i = 0; i < new_size; i++)
   {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Object exists.\n");
-    found_object = object_store.search(handle);
+    if (i < om_table_size)
+    {
+      new_table[i] = std::move(om_table[i]);
+    }
+    else
+    {
+      new_table[i].data.object_ptr = nullptr;
+      new_table[i].data.handle = 0;
+      new_table[i].generation = 1;
+      new_table[i].next_free = i + 1;
+      new_table[i].in_use = false;
+    }
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Found item: ", found_object, "\n");
-  KL_TRC_EXIT;
+  delete[] om_table;
+  om_table = new_table;
+  om_table_size = new_size;
 
-  return found_object;
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "New table size: ", new_size, "\n");
+  KL_TRC_EXIT;
 }
 
+/// @brief Remove all objects from OM, releasing OM's references to them.
 void object_manager::remove_all_objects()
 {
   KL_TRC_ENTRY;
-  GEN_HANDLE root_handle;
 
-  while (object_store.get_root_node_key(root_handle))
+  GEN_HANDLE handle;
+  bool found;
+  bool at_end = false;
+
+  for (uint64_t i = 0; !at_end; i++)
   {
-    remove_object(root_handle);
+    found = false;
+
+    // The table may be reallocated while the lock is not held, so look it up afresh each time.
+    klib_synch_spinlock_lock(om_main_lock);
+    at_end = (i >= om_table_size);
+    if (!at_end && om_table[i].in_use)
+    {
+      handle = om_table[i].data.handle;
+      found = true;
+    }
+    klib_synch_spinlock_unlock(om_main_lock);
+
+    if (found)
+    {
+      remove_object(handle);
+    }
   }
 
   KL_TRC_EXIT;
-}
\ No newline at end of file
+}
@@ -3,12 +3,16 @@
 
 #include "handles.h"
 #include "ref_counter.h"
+#include "klib/synch/kernel_locks.h"
 #include "object_type.h"
-#include "klib/data_structures/red_black_tree.h"
 
-/// @brief Managers the relationship between handles an objects.
+/// @brief Manages the relationship between handles and objects.
 ///
-/// Each thread has it's own object manager, since handles are private to threads.
+/// Each process has its own object manager, since handles are private to processes.
+///
+/// Objects are stored in a table indexed directly by the handle, so storing, looking up and removing an object all take
+/// constant time. A handle combines the index of its slot in the table with a generation number for that slot, which
+/// changes every time the slot is freed, so stale handles are not mistaken for the object that reused their slot.
 ///
 /// For more information, see [docs/components/object_mgr/Object Manager.md]
 class object_manager
@@ -18,19 +22,45 @@ public:
   ~object_manager();
 
   GEN_HANDLE store_object(std::shared_ptr<IHandledObject> object_ptr);
-  void correlate_object(std::shared_ptr<IHandledObject>, GEN_HANDLE handle);
-  void decorrelate_object(GEN_HANDLE handle);
   std::shared_ptr<IHandledObject> retrieve_object(GEN_HANDLE handle);
+  bool retrieve_object_data(GEN_HANDLE handle, object_data &data);
   void remove_object(GEN_HANDLE handle);
 
   void remove_all_objects();
 
+  /// The number of bits of a handle that give the index of its slot in the table.
+  static const uint32_t HANDLE_INDEX_BITS = 24;
+
+  /// The maximum number of objects a single object manager can store.
+  static const uint64_t MAX_OBJECTS = 1ULL << HANDLE_INDEX_BITS;
+
 private:
-  kl_rb_tree<GEN_HANDLE, std::shared_ptr<object_data>> object_store;
+  /// @brief One slot of the object table.
+  struct object_slot
+  {
+    /// The object stored in this slot. Only valid if in_use is true.
+    object_data data;
+
+    /// The generation of this slot, which forms the upper part of the handle.
+    uint64_t generation;
+
+    /// The index of the next free slot, if this slot is free.
+    uint64_t next_free;
+
+    /// Is this slot storing an object?
+    bool in_use;
+  };
+
+  object_slot *om_table;
+  uint64_t om_table_size;
+
+  /// The index of the first free slot. Equal to om_table_size if there are no free slots.
+  uint64_t om_first_free;
 
   kernel_spinlock om_main_lock;
 
-  std::shared_ptr<object_data> int_retrieve_object(GEN_HANDLE handle);
+  object_slot *int_retrieve_slot(GEN_HANDLE handle);
+  void int_grow_table();
 };
 
 #endif
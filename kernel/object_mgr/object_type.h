@@ -5,12 +5,30 @@
 
 #include <memory>
 
+class IReadable;
+class IWritable;
+class WaitObject;
+
 /// @brief Stores an object and related data in the object manager.
 ///
+/// The interface pointers are worked out once, when the object is stored, so that looking up a handle for reading,
+/// writing or waiting needs no dynamic casts. They remain valid for as long as object_ptr is held.
 struct object_data
 {
+  /// The stored object.
   std::shared_ptr<IHandledObject> object_ptr;
+
+  /// The handle that refers to the object.
   GEN_HANDLE handle;
+
+  /// The object's IReadable interface, or nullptr if it doesn't have one.
+  IReadable *readable;
+
+  /// The object's IWritable interface, or nullptr if it doesn't have one.
+  IWritable *writable;
+
+  /// The object's WaitObject interface, or nullptr if it doesn't have one.
+  WaitObject *wait_obj;
 };
 
 #endif
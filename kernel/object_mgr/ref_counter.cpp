@@ -13,9 +13,8 @@
 ///
 /// The creator of this object automatically acquires it for the first time, there is no need to call `ref_acquire()`
 /// immediately after creating the object.
-IRefCounted::IRefCounted() : _ref_counter(0), _ref_counter_lock(0)
+IRefCounted::IRefCounted() : _ref_counter(1)
 {
-  this->ref_acquire();
 }
 
 /// @brief Acquire the right to use the object.
@@ -23,20 +22,12 @@ IRefCounted::IRefCounted() : _ref_counter(0), _ref_counter_lock(0)
 /// Increments the reference counter. Each object is free to do what it likes when it is acquired, but generally it is
 /// assumed that the object continues to exist while the reference counter is > 0.
 ///
-/// If the reference counter is about to overflow, reference counting stops. This is such an astronomically large
-/// number of references, it is probably safe to assume there's a referencing leak somewhere anyway.
+/// This is called on hot paths such as the scheduler's wait lists, so it is kept free of tracing and locks.
 void IRefCounted::ref_acquire()
 {
-  KL_TRC_ENTRY;
-
-  klib_synch_spinlock_lock(this->_ref_counter_lock);
-  if (this->_ref_counter < (~0 - 1))
-  {
-    this->_ref_counter++;
-  }
-  klib_synch_spinlock_unlock(this->_ref_counter_lock);
-
-  KL_TRC_EXIT;
+  // Taking a new reference doesn't need to be ordered with anything else - the caller already holds a reference, so
+  // the object can't be destroyed in the meantime.
+  this->_ref_counter.fetch_add(1, std::memory_order_relaxed);
 }
 
 /// @brief Release the object.
@@ -48,21 +39,17 @@ void IRefCounted::ref_acquire()
 /// they should assume the object is destroyed instantly.
 void IRefCounted::ref_release()
 {
-  KL_TRC_ENTRY;
+  uint64_t old_count;
 
-  klib_synch_spinlock_lock(this->_ref_counter_lock);
-  if (this->_ref_counter > 0)
-  {
-    this->_ref_counter--;
-  }
-  klib_synch_spinlock_unlock(this->_ref_counter_lock);
+  // Releasing must be ordered after any use of the object by this thread, so that the thread that sees the counter
+  // reach zero also sees all of those uses completed.
+  old_count = this->_ref_counter.fetch_sub(1, std::memory_order_acq_rel);
+  ASSERT(old_count != 0);
 
-  if (this->_ref_counter == 0)
+  if (old_count == 1)
   {
     this->ref_counter_zero();
   }
-
-  KL_TRC_EXIT;
 }
 
 /// @brief Handle the reference counter reaching zero.
@@ -73,4 +60,4 @@ void IRefCounted::ref_counter_zero()
 {
   KL_TRC_ENTRY;
   KL_TRC_EXIT;
-}
\ No newline at end of file
+}
@@ -2,10 +2,14 @@
 #define __REF_COUNT_INTFACE_HDR
 
 #include <stdint.h>
-#include "klib/synch/kernel_locks.h"
+#include <atomic>
+#include <cstddef>
 
 /// @brief Provides reference counting capabilities to a class
 ///
+/// The counter is stored in the object itself, so unlike std::shared_ptr there is no separate control block to
+/// allocate or follow. Objects are normally referenced through kl_ref_ptr, which acquires and releases them as needed.
+///
 /// Note that in order to prevent a race condition between acquire and release, only code that has already "acquired"
 /// the object can acquire it again. Ownership of the new acquisition can then be passed to another thread or part of
 /// the code.
@@ -17,14 +21,129 @@ public:
   IRefCounted();
   virtual ~IRefCounted() { }
 
-  virtual void ref_acquire();
-  virtual void ref_release();
+  void ref_acquire();
+  void ref_release();
 
 protected:
   virtual void ref_counter_zero();
 
-  volatile uint64_t _ref_counter;
-  kernel_spinlock _ref_counter_lock;
+  /// The number of references to this object.
+  std::atomic<uint64_t> _ref_counter;
+};
+
+/// @brief A lightweight smart pointer to an object derived from IRefCounted.
+///
+/// Copying a kl_ref_ptr acquires the object again, and destroying one releases it. Moving a kl_ref_ptr transfers the
+/// reference without touching the counter at all.
+///
+/// @tparam T The type of object pointed to. Must provide ref_acquire() and ref_release().
+template <typename T> class kl_ref_ptr
+{
+public:
+  /// @brief Construct a null pointer.
+  kl_ref_ptr() : _ptr(nullptr) { }
+
+  /// @brief Construct a null pointer.
+  kl_ref_ptr(std::nullptr_t) : _ptr(nullptr) { }
+
+  /// @brief Construct a pointer to an object, acquiring a new reference to it.
+  ///
+  /// @param ptr The object to point to. The caller must already hold a reference to it. May be nullptr.
+  explicit kl_ref_ptr(T *ptr) : _ptr(ptr)
+  {
+    if (_ptr != nullptr)
+    {
+      _ptr->ref_acquire();
+    }
+  }
+
+  /// @brief Copy a pointer, acquiring a new reference to the object.
+  ///
+  /// @param other The pointer to copy.
+  kl_ref_ptr(const kl_ref_ptr &other) : kl_ref_ptr(other._ptr) { }
+
+  /// @brief Move a pointer. The reference is transferred, and other is left null.
+  ///
+  /// @param other The pointer to move from.
+  kl_ref_ptr(kl_ref_ptr &&other) : _ptr(other._ptr)
+  {
+    other._ptr = nullptr;
+  }
+
+  ~kl_ref_ptr()
+  {
+    reset();
+  }
+
+  /// @brief Take over a reference the caller already holds, without acquiring another one.
+  ///
+  /// @param ptr The object to point to. May be nullptr.
+  ///
+  /// @return A pointer owning the caller's reference.
+  static kl_ref_ptr adopt(T *ptr)
+  {
+    kl_ref_ptr result;
+    result._ptr = ptr;
+    return result;
+  }
+
+  /// @brief Release the reference held by this pointer, if any, leaving it null.
+  void reset()
+  {
+    T *old_ptr = _ptr;
+    _ptr = nullptr;
+
+    if (old_ptr != nullptr)
+    {
+      old_ptr->ref_release();
+    }
+  }
+
+  kl_ref_ptr &operator=(const kl_ref_ptr &other)
+  {
+    // Acquire the new object before releasing the old one, in case they are the same.
+    T *new_ptr = other._ptr;
+    if (new_ptr != nullptr)
+    {
+      new_ptr->ref_acquire();
+    }
+    reset();
+    _ptr = new_ptr;
+
+    return *this;
+  }
+
+  kl_ref_ptr &operator=(kl_ref_ptr &&other)
+  {
+    if (this != &other)
+    {
+      reset();
+      _ptr = other._ptr;
+      other._ptr = nullptr;
+    }
+
+    return *this;
+  }
+
+  kl_ref_ptr &operator=(std::nullptr_t)
+  {
+    reset();
+    return *this;
+  }
+
+  T *get() const { return _ptr; }
+  T *operator->() const { return _ptr; }
+  T &operator*() const { return *_ptr; }
+  explicit operator bool() const { return _ptr != nullptr; }
+
+  bool operator==(const kl_ref_ptr &other) const { return _ptr == other._ptr; }
+  bool operator!=(const kl_ref_ptr &other) const { return _ptr != other._ptr; }
+  bool operator==(std::nullptr_t) const { return _ptr == nullptr; }
+  bool operator!=(std::nullptr_t) const { return _ptr != nullptr; }
+
+protected:
+  /// The object pointed to, or nullptr.
+  T *_ptr;
 };
 
 #endif
@@ -0,0 +1,183 @@
+/// @file
+/// @brief Records how long each phase of kernel startup takes.
+///
+/// boot_phase_begin() and boot_phase_end() are called before the memory manager is initialised, so they must not
+/// allocate memory.
+
+//#define ENABLE_TRACING
+
+#include <atomic>
+
+#include "klib/klib.h"
+#include "processor/boot_phases.h"
+#include "processor/timing/timing.h"
+
+#ifdef AZALEA_TEST_CODE
+#include <chrono>
+#else
+#include "processor/x64/processor-x64-int.h"
+#endif
+
+namespace
+{
+  /// @brief A single boot phase.
+  struct boot_phase_record
+  {
+    const char *name; ///< The name of the phase. Must be a string that lasts forever.
+    uint64_t start_tsc; ///< The TSC when the phase began.
+    std::atomic<uint64_t> end_tsc; ///< The TSC when the phase ended, or zero if it is still running.
+    std::atomic<bool> valid; ///< Set once name and start_tsc have been filled in.
+  };
+
+  boot_phase_record phases[BOOT_MAX_PHASES];
+
+  // The number of phases that have been started, including any that didn't fit in phases.
+  std::atomic<uint32_t> phases_started(0);
+
+  uint64_t boot_read_tsc()
+  {
+#ifdef AZALEA_TEST_CODE
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return asm_proc_read_tsc();
+#endif
+  }
+}
+
+/// @brief Record the start of a boot phase.
+///
+/// May be called from any thread, and before any other part of the kernel is initialised.
+///
+/// @param name The name of the phase. It is not copied, so must be a string literal or similar.
+///
+/// @return A number identifying the phase, to be passed to boot_phase_end(). BOOT_PHASE_NONE if too many phases have
+///         been recorded already.
+uint32_t boot_phase_begin(const char *name)
+{
+  uint32_t phase = phases_started.fetch_add(1);
+
+  if (phase >= BOOT_MAX_PHASES)
+  {
+    phase = BOOT_PHASE_NONE;
+  }
+  else
+  {
+    phases[phase].name = name;
+    phases[phase].start_tsc = boot_read_tsc();
+    phases[phase].valid.store(true, std::memory_order_release);
+  }
+
+  return phase;
+}
+
+/// @brief Record the end of a boot phase.
+///
+/// @param phase The value returned by boot_phase_begin(). If BOOT_PHASE_NONE, nothing happens.
+void boot_phase_end(uint32_t phase)
+{
+  if (phase < BOOT_MAX_PHASES)
+  {
+    phases[phase].end_tsc.store(boot_read_tsc(), std::memory_order_release);
+  }
+}
+
+/// @brief Write the recorded boot phases as text.
+///
+/// After a header line, there is one "<name> <start> <duration>" line per phase, in the order the phases started.
+/// Times are in microseconds, with start measured from the start of the first phase. If the TSC was never calibrated,
+/// the times are given in TSC ticks instead, and the header says so. The duration of a phase that hasn't finished is
+/// given as "-".
+///
+/// @param[out] buffer Buffer to write the text in to. May be nullptr, to find the required size.
+///
+/// @param buffer_length The size of buffer. The text is truncated, but always zero-terminated, if it doesn't fit.
+///
+/// @return The length of the full text, not including the terminating zero.
+uint64_t boot_phase_describe(char *buffer, uint64_t buffer_length)
+{
+  KL_TRC_ENTRY;
+
+  uint64_t total = 0;
+  uint32_t count = phases_started.load();
+  uint64_t first_tsc = 0;
+  uint64_t end_tsc;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  bool use_ns;
+  char duration_str[24];
+
+  if ((buffer != nullptr) && (buffer_length != 0))
+  {
+    buffer[0] = 0;
+  }
+
+  if (count > BOOT_MAX_PHASES)
+  {
+    count = BOOT_MAX_PHASES;
+  }
+
+  if ((count != 0) && phases[0].valid.load(std::memory_order_acquire))
+  {
+    first_tsc = phases[0].start_tsc;
+  }
+  use_ns = time_tsc_ticks_to_ns(0, start_ns);
+
+  total += klib_snprintf((total < buffer_length) ? buffer + total : nullptr,
+                         (total < buffer_length) ? buffer_length - total : 0,
+                         "phase start_%s duration_%s\n",
+                         use_ns ? "us" : "ticks",
+                         use_ns ? "us" : "ticks");
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (!phases[i].valid.load(std::memory_order_acquire))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Phase ", i, " not filled in yet\n");
+      continue;
+    }
+
+    start_ns = phases[i].start_tsc - first_tsc;
+    end_tsc = phases[i].end_tsc.load(std::memory_order_acquire);
+    duration_ns = end_tsc - phases[i].start_tsc;
+    if (use_ns)
+    {
+      time_tsc_ticks_to_ns(start_ns, start_ns);
+      time_tsc_ticks_to_ns(duration_ns, duration_ns);
+      start_ns /= 1000;
+      duration_ns /= 1000;
+    }
+
+    if (end_tsc == 0)
+    {
+      klib_snprintf(duration_str, sizeof(duration_str), "-");
+    }
+    else
+    {
+      klib_snprintf(duration_str, sizeof(duration_str), "%llu", static_cast<unsigned long long>(duration_ns));
+    }
+
+    total += klib_snprintf((total < buffer_length) ? buffer + total : nullptr,
+                           (total < buffer_length) ? buffer_length - total : 0,
+                           "%s %llu %s\n",
+                           phases[i].name,
+                           static_cast<unsigned long long>(start_ns),
+                           duration_str);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", total, "\n");
+  KL_TRC_EXIT;
+
+  return total;
+}
+
+/// @brief Forget all recorded phases, so that another test can start again.
+void test_only_reset_boot_phases()
+{
+  for (uint32_t i = 0; i < BOOT_MAX_PHASES; i++)
+  {
+    phases[i].valid = false;
+    phases[i].end_tsc = 0;
+  }
+  phases_started = 0;
+}
@@ -0,0 +1,28 @@
+/// @file
+/// @brief Records how long each phase of kernel startup takes.
+///
+/// Phases are timed using the TSC, since it can be read from the very first instruction of main() - before the memory
+/// manager, ACPI or any timer is ready. The TSC is converted to microseconds using the calibration done by
+/// time_gen_init(), and the results can be read from 'proc\\boot_times' once the system is running.
+///
+/// Phases may overlap, and several may run at once on different threads.
+
+#ifndef __BOOT_PHASES_H
+#define __BOOT_PHASES_H
+
+#include <stdint.h>
+
+/// @brief The maximum number of phases that can be recorded. Any more are ignored.
+const uint32_t BOOT_MAX_PHASES = 32;
+
+/// @brief Returned by boot_phase_begin() if the phase could not be recorded.
+const uint32_t BOOT_PHASE_NONE = 0xFFFFFFFF;
+
+uint32_t boot_phase_begin(const char *name);
+void boot_phase_end(uint32_t phase);
+uint64_t boot_phase_describe(char *buffer, uint64_t buffer_length);
+
+// Test-only code
+void test_only_reset_boot_phases();
+
+#endif
@@ -112,7 +112,7 @@ void *task_int_create_exec_context(ENTRY_PROC entry_point, task_thread *new_thre
 void task_int_delete_exec_context(task_thread *old_thread);
 
 task_thread *task_get_next_thread();
-extern "C" task_x64_exec_context *task_int_swap_task(uint64_t stack_addr, uint64_t cr3_value);
+extern "C" task_x64_exec_context *task_int_swap_task(uint64_t stack_addr, uint64_t cr3_value, bool timer_tick);
 
 void task_install_task_switcher();
 void task_platform_init();
@@ -139,6 +139,6 @@ extern const uint16_t PROC_NUM_IRQS;
 
 extern proc_interrupt_data proc_interrupt_data_table[];
 
-extern klib_list<std::shared_ptr<task_thread>> dead_thread_list;
+extern klib_list<kl_ref_ptr<task_thread>> dead_thread_list;
 
 #endif
@@ -23,9 +23,12 @@
 namespace
 {
   bool interrupt_table_cfgd = false;
+
+  // Serialises changes to the lists of interrupt handlers, since drivers may be started on several threads at once.
+  kernel_spinlock interrupt_table_lock;
 }
 
-klib_list<std::shared_ptr<task_thread>> dead_thread_list;
+klib_list<kl_ref_ptr<task_thread>> dead_thread_list;
 
 /// @brief Configure the kernel's interrupt data table.
 ///
@@ -41,6 +44,7 @@ void proc_config_interrupt_table()
   // get caught by this assert.
   ASSERT(interrupt_table_cfgd == false);
   interrupt_table_cfgd = true;
+  klib_synch_spinlock_init(interrupt_table_lock);
 
   for (int i = 0; i < PROC_NUM_INTERRUPTS; i++)
   {
@@ -84,7 +88,9 @@ void proc_register_interrupt_handler(uint8_t interrupt_number, IInterruptReceive
 
   new_item->item = new_handler;
 
+  klib_synch_spinlock_lock(interrupt_table_lock);
   klib_list_add_tail(&proc_interrupt_data_table[interrupt_number].interrupt_handlers, new_item);
+  klib_synch_spinlock_unlock(interrupt_table_lock);
 
   KL_TRC_EXIT;
 }
@@ -107,12 +113,13 @@ void proc_unregister_interrupt_handler(uint8_t interrupt_number, IInterruptRecei
   // for an IRQ.
   ASSERT((proc_interrupt_data_table[interrupt_number].reserved == false) ||
          (proc_interrupt_data_table[interrupt_number].is_irq == true));
-  ASSERT(!klib_list_is_empty(&proc_interrupt_data_table[interrupt_number].interrupt_handlers));
-
   bool found_receiver = false;
   klib_list_item<proc_interrupt_handler *> *cur_item;
   proc_interrupt_handler *item;
 
+  klib_synch_spinlock_lock(interrupt_table_lock);
+  ASSERT(!klib_list_is_empty(&proc_interrupt_data_table[interrupt_number].interrupt_handlers));
+
   cur_item = proc_interrupt_data_table[interrupt_number].interrupt_handlers.head;
 
   while(cur_item != nullptr)
@@ -135,6 +142,7 @@ void proc_unregister_interrupt_handler(uint8_t interrupt_number, IInterruptRecei
     cur_item = cur_item->next;
   }
 
+  klib_synch_spinlock_unlock(interrupt_table_lock);
   ASSERT(found_receiver);
 
   KL_TRC_EXIT;
@@ -330,20 +338,17 @@ void proc_interrupt_slowpath_thread()
 /// delete thread objects from within the actual thread could lead to deadlock.
 void proc_tidyup_thread()
 {
-  std::shared_ptr<task_thread> dead_thread;
+  kl_ref_ptr<task_thread> dead_thread;
 
   while(1)
   {
     while(!klib_list_is_empty(&dead_thread_list))
     {
-      dead_thread = dead_thread_list.head->item;
+      // Take over the list item's reference, so the thread is deleted here if nothing else refers to it.
+      dead_thread = std::move(dead_thread_list.head->item);
       klib_list_remove(dead_thread->synch_list_item);
-      dead_thread->synch_list_item->item = nullptr;
-      if (dead_thread.unique())
-      {
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Delete thread\n");
-        dead_thread = nullptr;
-      }
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Release dead thread ", dead_thread.get(), "\n");
+      dead_thread = nullptr;
     }
 
     time_stall_process(1000000000);
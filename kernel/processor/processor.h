@@ -24,6 +24,9 @@ typedef void (* ENTRY_PROC)();
 
 // Forward declare task_thread since task_process and task_thread refer to each other in a cycle.
 class task_thread;
+class io_ring;
+struct syscall_stats_table;
+class proc_exec_image;
 
 /// Structure to hold information about a process. All information is stored here, to be accessed by the various
 /// components as needed. This removes the need for per-component lookup tables for each process.
@@ -61,6 +64,21 @@ public:
   /// The process's queue of waiting messages.
   msg_msg_queue message_queue;
 
+  /// Threads of this process waiting for a message to arrive.
+  klib_list<kl_ref_ptr<task_thread>> msg_receivers_waiting;
+
+  /// Threads in any process waiting for space in this process's message queue.
+  klib_list<kl_ref_ptr<task_thread>> msg_senders_waiting;
+
+  /// Threads in any process that have made a synchronous call to this process that has not yet been received.
+  klib_list<kl_ref_ptr<task_thread>> calls_pending;
+
+  /// Threads of this process waiting for a synchronous call to arrive.
+  klib_list<kl_ref_ptr<task_thread>> call_servers_waiting;
+
+  /// The broadcast groups this process is a member of. Protected by the message system's broadcast group lock.
+  klib_list<klib_msg_broadcast_grp *> msg_groups;
+
   /// Does this process accept messages? Messages can't be sent to the process unless this flag is true. Accepting
   /// messages is optional as not all processes will need the capability to receive messages.
   bool accepts_msgs;
@@ -80,6 +98,22 @@ public:
   /// Is this process currently being destroyed?
   bool being_destroyed;
 
+  /// Store handles and the objects they correlate to. Handles are shared by all threads of the process.
+  object_manager proc_handles;
+
+  /// The asynchronous I/O ring serving this process, if it has created one. Protected by io_ring_lock.
+  std::shared_ptr<io_ring> io_ring_obj;
+
+  /// Protects io_ring_obj, so that a process can't end up with two rings.
+  kernel_spinlock io_ring_lock;
+
+  /// System call statistics for this process, one table per processor. nullptr unless the kernel is built with
+  /// AZALEA_SYSCALL_STATS defined. See syscall/syscall_stats.h.
+  syscall_stats_table *syscall_stats;
+
+  /// The shared read-only pages of the executable file this process is running, if it has any.
+  std::shared_ptr<proc_exec_image> exec_image;
+
   /// Has this process ever been started?
   bool has_ever_started;
 };
@@ -91,13 +125,23 @@ public:
 ///
 /// task_thread derives from WaitObject, but doesn't change the default logic of that class. The WaitObject is
 /// signalled when the thread is scheduled for destruction.
-class task_thread : public IHandledObject, public WaitObject
+///
+/// Threads are reference counted intrusively, so that the scheduler and synchronization primitives can hold them using
+/// kl_ref_ptr without the cost of copying a std::shared_ptr. All std::shared_ptr references to a thread, as returned by
+/// create(), share a single one of those intrusive references. The thread is deleted once every reference of both
+/// kinds has been released.
+class task_thread : public IHandledObject, public WaitObject, public IRefCounted
 {
 protected:
-  task_thread(ENTRY_PROC entry_point, std::shared_ptr<task_process> parent);
+  task_thread(ENTRY_PROC entry_point, std::shared_ptr<task_process> parent, bool kernel_mode);
+
+  virtual void ref_counter_zero() override;
+  static void release_shared_ref(task_thread *thread);
 
 public:
-  static std::shared_ptr<task_thread> create(ENTRY_PROC entry_point, std::shared_ptr<task_process> parent);
+  static std::shared_ptr<task_thread> create(ENTRY_PROC entry_point,
+                                             std::shared_ptr<task_process> parent,
+                                             bool kernel_mode = false);
   virtual ~task_thread();
 
   bool start_thread();
@@ -120,6 +164,10 @@ public:
   /// This thread's parent process. The process defines the address space, permissions, etc.
   std::shared_ptr<task_process> parent_process;
 
+  /// Does this thread run in kernel mode? Always true for threads of kernel mode processes, but user mode processes
+  /// may also contain kernel mode threads that work on their behalf.
+  bool kernel_mode;
+
   /// An entry for the parent's thread list.
   klib_list_item<std::shared_ptr<task_thread>> *process_list_item;
 
@@ -129,16 +177,24 @@ public:
 
   /// This item is used to associate the thread with the list of threads waiting for a mutex, semaphore or other
   /// synchronization primitive. The list itself is owned by that primitive, but this item must be initialized with the
-  /// rest of this structure.
-  klib_list_item<std::shared_ptr<task_thread>> *synch_list_item;
-
-  /// Store handles and the objects they correlate to.
-  object_manager thread_handles;
+  /// rest of this structure. The item holds a reference to the thread until the thread is destroyed.
+  klib_list_item<kl_ref_ptr<task_thread>> *synch_list_item;
 
   /// Has the thread been destroyed? Various operations are not permitted on a destroyed thread. This object will
   /// continue to exist until all references to it have been released.
   bool thread_destroyed;
 
+  /// Links this thread into the task manager's list of threads waiting to be woken at a specific time. Only in a list
+  /// if task_set_wake_time() has been called and the thread has not yet been woken.
+  klib_list_item<task_thread *> timed_wake_item;
+
+  /// The system timer count (as per time_get_system_timer_count()) after which this thread will be woken. Only valid
+  /// while timed_wake_item is in a list.
+  uint64_t wake_time;
+
+  /// The synchronous call this thread is making or serving, if any.
+  msg_call_state call_state;
+
 
 #ifdef AZALEA_TEST_CODE
   friend void test_only_reset_task_mgr();
@@ -210,6 +266,22 @@ task_thread *task_get_cur_thread();
 // Force a reschedule on this processor.
 void task_yield();
 
+// Hand this processor to a specific thread, if it is able to run.
+void task_set_switch_hint(task_thread *thread);
+void task_yield_to(task_thread *thread);
+
+// Wake a stopped thread at a given time, even if it has not otherwise been signalled to continue.
+void task_set_wake_time(task_thread *thread, uint64_t wake_time);
+void task_cancel_wake_time(task_thread *thread);
+
+// Maintain the read-only page shared with every user mode process.
+void proc_shared_page_init();
+void proc_shared_page_map(task_process *proc);
+void proc_shared_page_set_time(uint64_t base_tsc, uint64_t base_ns, uint64_t tsc_mult);
+void proc_shared_page_clear_time();
+void proc_shared_page_enable_cpu_ids();
+void proc_shared_page_note_switch(uint32_t proc_id, task_thread *thread);
+
 // Multiple processor control functions
 uint32_t proc_mp_proc_count();
 uint32_t proc_mp_this_proc_id();
@@ -235,6 +307,10 @@ bool proc_request_interrupt_block(uint8_t num_interrupts, uint8_t &start_vector)
 
 #ifdef AZALEA_TEST_CODE
 void test_only_reset_task_mgr();
+
+struct shared_page_layout;
+const shared_page_layout *test_only_get_shared_page();
+void test_only_reset_shared_page();
 #endif
 
 #endif /* PROCESSOR_H_ */
@@ -0,0 +1,279 @@
+/// @file
+/// @brief A sampling profiler, driven by the task manager's timer interrupt.
+///
+/// prof_timer_tick() is called with interrupts disabled, so it must not take locks, allocate memory or generate text
+/// tracing.
+
+//#define ENABLE_TRACING
+
+#include <atomic>
+
+#include "klib/klib.h"
+#include "klib/data_structures/ring_buffer.h"
+#include "processor/processor.h"
+#include "processor/profiler.h"
+#include "processor/timing/timing.h"
+
+namespace
+{
+  // One ring per processor. No samples are stored until sample_ring_count is set by prof_start().
+  kl_mpmc_ring<prof_sample> **sample_rings = nullptr;
+  std::atomic<uint32_t> sample_ring_count(0);
+
+  // The number of ticks each processor has seen since it last took a sample. Each entry is only used by its own
+  // processor, from within the timer interrupt.
+  uint32_t *ticks_since_sample = nullptr;
+
+  std::atomic<bool> profiler_running(false);
+  std::atomic<uint32_t> sample_interval(PROF_DEFAULT_INTERVAL);
+
+  // Samples that could not be stored because a ring was full.
+  std::atomic<uint64_t> samples_dropped(0);
+
+  // The ring that the next drain starts from, so that a busy processor can't starve the others of output.
+  std::atomic<uint32_t> next_drain_ring(0);
+
+  // Protects starting the profiler. A spinlock is just an atomic integer, and zero means unlocked.
+  kernel_spinlock control_lock(0);
+}
+
+/// @brief Start taking samples.
+///
+/// The sample rings are created the first time the profiler starts, and kept afterwards. Samples already in them are
+/// not discarded.
+///
+/// @param tick_interval The number of scheduler ticks between samples on each processor. Must not be zero.
+///
+/// @param samples_per_proc The number of samples each processor's ring can hold. Must be a power of two. Ignored if
+///                         the profiler has run before.
+///
+/// @return ERR_CODE::NO_ERROR if the profiler is now running, ERR_CODE::INVALID_PARAM otherwise.
+ERR_CODE prof_start(uint32_t tick_interval, uint64_t samples_per_proc)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint32_t num_procs;
+
+  if ((tick_interval == 0) || (samples_per_proc == 0) || ((samples_per_proc & (samples_per_proc - 1)) != 0))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid parameters\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    klib_synch_spinlock_lock(control_lock);
+
+    if (sample_ring_count.load() == 0)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Creating sample rings\n");
+      num_procs = proc_mp_proc_count();
+      ASSERT(num_procs != 0);
+
+      sample_rings = new kl_mpmc_ring<prof_sample> *[num_procs];
+      ticks_since_sample = new uint32_t[num_procs];
+      for (uint32_t i = 0; i < num_procs; i++)
+      {
+        sample_rings[i] = new kl_mpmc_ring<prof_sample>(samples_per_proc);
+        ticks_since_sample[i] = 0;
+      }
+
+      sample_ring_count.store(num_procs, std::memory_order_release);
+    }
+
+    sample_interval = tick_interval;
+    profiler_running = true;
+
+    klib_synch_spinlock_unlock(control_lock);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Stop taking samples. Samples already taken can still be read.
+void prof_stop()
+{
+  KL_TRC_ENTRY;
+
+  profiler_running = false;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Is the profiler taking samples?
+///
+/// @return True if the profiler is running.
+bool prof_is_running()
+{
+  return profiler_running.load();
+}
+
+/// @brief Called on every scheduler tick, to take a sample if one is due.
+///
+/// For kernel mode code, the backtrace is found by following frame pointers - each frame holds the caller's frame
+/// pointer followed by the return address. A frame pointer is only followed if the whole frame lies between stack_low
+/// and stack_high, which the caller must guarantee is mapped memory, and each frame must be above the last, so that a
+/// corrupt chain can neither fault nor loop.
+///
+/// User mode stacks are not followed, since user mode code controls its own stack and frame pointers and the kernel
+/// can't cheaply check that they point at mapped user memory. Only the instruction pointer is recorded.
+///
+/// @param rip The interrupted instruction pointer.
+///
+/// @param rbp The interrupted frame pointer.
+///
+/// @param stack_low The lowest address that the backtrace may read - normally the interrupted stack pointer. Ignored
+///                  for user mode samples.
+///
+/// @param stack_high The address just beyond the highest address the backtrace may read. Ignored for user mode
+///                   samples.
+///
+/// @param user_mode Was the processor running user mode code?
+///
+/// @param thread The interrupted thread. May be nullptr.
+void prof_timer_tick(uint64_t rip, uint64_t rbp, uint64_t stack_low, uint64_t stack_high, bool user_mode,
+                     task_thread *thread)
+{
+  prof_sample sample;
+  uint32_t ring_count;
+  uint32_t proc_id;
+  uint64_t *frame;
+
+  if (!profiler_running.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  ring_count = sample_ring_count.load(std::memory_order_acquire);
+  proc_id = proc_mp_this_proc_id();
+  if (proc_id >= ring_count)
+  {
+    return;
+  }
+
+  ticks_since_sample[proc_id]++;
+  if (ticks_since_sample[proc_id] < sample_interval.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  ticks_since_sample[proc_id] = 0;
+
+  sample.timestamp = time_now_ns();
+  sample.proc_id = proc_id;
+  sample.flags = user_mode ? PROF_SAMPLE_USER_MODE : 0;
+  sample.thread = reinterpret_cast<uint64_t>(thread);
+  sample.process = (thread != nullptr) ? reinterpret_cast<uint64_t>(thread->parent_process.get()) : 0;
+  sample.frames[0] = rip;
+  sample.num_frames = 1;
+
+  while ((!user_mode) &&
+         (sample.num_frames < PROF_MAX_FRAMES) &&
+         (rbp >= stack_low) &&
+         (rbp < stack_high) &&
+         ((stack_high - rbp) >= (2 * sizeof(uint64_t))) &&
+         ((rbp & (sizeof(uint64_t) - 1)) == 0))
+  {
+    frame = reinterpret_cast<uint64_t *>(rbp);
+    if (frame[1] == 0)
+    {
+      break;
+    }
+
+    sample.frames[sample.num_frames] = frame[1];
+    sample.num_frames++;
+
+    if (frame[0] <= rbp)
+    {
+      break;
+    }
+    rbp = frame[0];
+  }
+
+  for (uint32_t i = sample.num_frames; i < PROF_MAX_FRAMES; i++)
+  {
+    sample.frames[i] = 0;
+  }
+
+  if (!sample_rings[proc_id]->push(sample))
+  {
+    samples_dropped++;
+  }
+}
+
+/// @brief Remove waiting samples from the per-processor rings.
+///
+/// @param[out] samples Buffer to store the samples in.
+///
+/// @param max_samples The maximum number of samples to store in samples.
+///
+/// @return The number of samples stored in samples.
+uint64_t prof_drain(prof_sample *samples, uint64_t max_samples)
+{
+  KL_TRC_ENTRY;
+
+  uint32_t ring_count = sample_ring_count.load(std::memory_order_acquire);
+  uint32_t start;
+  uint64_t found = 0;
+
+  if ((ring_count != 0) && (samples != nullptr))
+  {
+    start = next_drain_ring.fetch_add(1) % ring_count;
+    for (uint32_t i = 0; (i < ring_count) && (found < max_samples); i++)
+    {
+      found += sample_rings[(start + i) % ring_count]->pop_bulk(samples + found, max_samples - found);
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Samples found: ", found, "\n");
+  KL_TRC_EXIT;
+
+  return found;
+}
+
+/// @brief Approximately how many samples are waiting to be drained?
+///
+/// @return The number of samples waiting in all the rings, which may be out of date by the time it is used.
+uint64_t prof_waiting()
+{
+  uint32_t ring_count = sample_ring_count.load(std::memory_order_acquire);
+  uint64_t waiting = 0;
+
+  for (uint32_t i = 0; i < ring_count; i++)
+  {
+    waiting += sample_rings[i]->entries_available();
+  }
+
+  return waiting;
+}
+
+/// @brief How many samples have been dropped because a ring was full?
+///
+/// @return The number of samples dropped.
+uint64_t prof_dropped()
+{
+  return samples_dropped.load();
+}
+
+/// @brief Stop the profiler and release the rings, so that another test can start again.
+void test_only_reset_profiler()
+{
+  uint32_t ring_count = sample_ring_count.exchange(0);
+
+  profiler_running = false;
+
+  for (uint32_t i = 0; i < ring_count; i++)
+  {
+    delete sample_rings[i];
+  }
+  delete[] sample_rings;
+  delete[] ticks_since_sample;
+  sample_rings = nullptr;
+  ticks_since_sample = nullptr;
+
+  sample_interval = PROF_DEFAULT_INTERVAL;
+  samples_dropped = 0;
+  next_drain_ring = 0;
+}
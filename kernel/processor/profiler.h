@@ -0,0 +1,61 @@
+/// @file
+/// @brief A sampling profiler, driven by the task manager's timer interrupt.
+///
+/// While the profiler is running, every few scheduler ticks each processor records where it was interrupted - the
+/// instruction pointer, the running thread and, for kernel mode code, a backtrace found by following the chain of frame
+/// pointers. Samples are stored in a lock-free ring belonging to each processor, and read from 'proc\\profile'. The
+/// samples are turned into folded stacks, suitable for drawing flame graphs, by build_support/profile_fold.py.
+
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <stdint.h>
+#include "user_interfaces/error_codes.h"
+
+class task_thread;
+
+/// @brief The maximum number of addresses stored in a sample, including the interrupted instruction pointer.
+const uint32_t PROF_MAX_FRAMES = 16;
+
+/// @brief Flags stored in prof_sample::flags.
+enum PROF_SAMPLE_FLAGS : uint16_t
+{
+  PROF_SAMPLE_USER_MODE = 1, ///< The processor was running user mode code when the sample was taken.
+};
+
+/// @brief A single profiler sample.
+///
+/// The layout is fixed, since build_support/profile_fold.py reads it directly.
+struct prof_sample
+{
+  uint64_t timestamp; ///< The system timer, in nanoseconds, when the sample was taken.
+  uint32_t proc_id; ///< The processor that took the sample.
+  uint16_t flags; ///< Flags from PROF_SAMPLE_FLAGS.
+  uint16_t num_frames; ///< The number of valid entries in frames. Always at least one.
+  uint64_t thread; ///< The address of the thread that was interrupted, or zero if there wasn't one.
+  uint64_t process; ///< The address of the process that owns thread, or zero.
+  uint64_t frames[PROF_MAX_FRAMES]; ///< The interrupted instruction pointer, followed by the return addresses found.
+};
+static_assert(sizeof(prof_sample) == 160, "The profile decoder expects 160-byte samples");
+
+/// @brief The number of samples stored per processor, unless the profiler is started with a different number.
+const uint64_t PROF_DEFAULT_SAMPLES_PER_PROC = 4096;
+
+/// @brief The default number of scheduler ticks between samples.
+const uint32_t PROF_DEFAULT_INTERVAL = 10;
+
+ERR_CODE prof_start(uint32_t tick_interval, uint64_t samples_per_proc = PROF_DEFAULT_SAMPLES_PER_PROC);
+void prof_stop();
+bool prof_is_running();
+
+void prof_timer_tick(uint64_t rip, uint64_t rbp, uint64_t stack_low, uint64_t stack_high, bool user_mode,
+                     task_thread *thread);
+
+uint64_t prof_drain(prof_sample *samples, uint64_t max_samples);
+uint64_t prof_waiting();
+uint64_t prof_dropped();
+
+// Test-only code
+void test_only_reset_profiler();
+
+#endif
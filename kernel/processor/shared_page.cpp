@@ -0,0 +1,222 @@
+/// @file
+/// @brief Manages the read-only page shared with every user mode process.
+///
+/// The kernel keeps a single copy of the page, which it updates through its own writable mapping. The same physical
+/// page is mapped read-only into each user mode process at SHARED_PAGE_USER_ADDR, so that libazalea can read the time
+/// and the current CPU and thread without making a system call.
+///
+/// Each block within the page carries a sequence number. Writers make it odd before changing the block and even again
+/// afterwards. Readers retry if the number was odd, or if it changed while they were reading.
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "processor.h"
+#include "processor-int.h"
+#include "mem/mem.h"
+#include "user_interfaces/shared_page.h"
+
+#include <atomic>
+
+static_assert(sizeof(shared_page_layout) <= MEM_PAGE_SIZE, "Shared page layout must fit in one page");
+static_assert(sizeof(shared_page_cpu_block) == 64, "Shared page CPU blocks should fill a cache line");
+
+namespace
+{
+  // The kernel's writable mapping of the shared page, or nullptr until proc_shared_page_init() is called.
+  shared_page_layout *shared_page = nullptr;
+
+  // The physical address of the shared page.
+  void *shared_page_phys = nullptr;
+
+  // Serialises updates to the time block. The CPU blocks are only ever written by their own processor, so don't need
+  // a lock.
+  kernel_spinlock time_block_lock;
+
+  /// @brief Begin an update of a block protected by a sequence number.
+  ///
+  /// @param sequence The sequence number of the block about to be updated.
+  void proc_int_seq_write_begin(volatile uint64_t &sequence)
+  {
+    sequence = sequence + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  /// @brief Complete an update of a block protected by a sequence number.
+  ///
+  /// @param sequence The sequence number of the block that has been updated.
+  void proc_int_seq_write_end(volatile uint64_t &sequence)
+  {
+    std::atomic_thread_fence(std::memory_order_release);
+    sequence = sequence + 1;
+  }
+}
+
+/// @brief Allocate and clear the shared page.
+///
+/// Must be called before any user mode process is created. Processes created beforehand do not have the page mapped.
+void proc_shared_page_init()
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(shared_page == nullptr);
+
+  shared_page = reinterpret_cast<shared_page_layout *>(mem_allocate_pages(1));
+  ASSERT(shared_page != nullptr);
+  kl_memset(shared_page, 0, MEM_PAGE_SIZE);
+  shared_page->version = SHARED_PAGE_VERSION;
+
+  shared_page_phys = mem_get_phys_addr(shared_page);
+  klib_synch_spinlock_init(time_block_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Shared page (kernel): ", shared_page, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Shared page (physical): ", shared_page_phys, "\n");
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Map the shared page into a user mode process.
+///
+/// The mapping is read-only, so that the process cannot interfere with the values seen by other processes. Since every
+/// processor runs with CR0.WP set, this also holds for writes the kernel makes on the process's behalf - a system call
+/// given an output pointer into the shared page faults rather than changing it.
+///
+/// @param proc The process to map the page into.
+void proc_shared_page_map(task_process *proc)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(proc != nullptr);
+  ASSERT(!proc->kernel_mode);
+
+  if (shared_page != nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Map shared page into process ", proc, "\n");
+    mem_vmm_allocate_specific_range(SHARED_PAGE_USER_ADDR, 1, proc);
+    mem_map_range(shared_page_phys,
+                  reinterpret_cast<void *>(SHARED_PAGE_USER_ADDR),
+                  1,
+                  proc,
+                  MEM_WRITE_BACK,
+                  false);
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Publish new TSC calibration values in the shared page.
+///
+/// Also marks the TSC as usable by user mode. See shared_page_time_block for how the values are used.
+///
+/// @param base_tsc The TSC value at base_ns.
+///
+/// @param base_ns Nanoseconds since boot at base_tsc.
+///
+/// @param tsc_mult Nanoseconds per TSC tick, shifted left by SHARED_PAGE_TSC_SHIFT.
+void proc_shared_page_set_time(uint64_t base_tsc, uint64_t base_ns, uint64_t tsc_mult)
+{
+  KL_TRC_ENTRY;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Base TSC: ", base_tsc, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Base ns: ", base_ns, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "TSC multiplier: ", tsc_mult, "\n");
+
+  ASSERT(shared_page != nullptr);
+
+  klib_synch_spinlock_lock(time_block_lock);
+  proc_int_seq_write_begin(shared_page->time.sequence);
+
+  shared_page->time.base_tsc = base_tsc;
+  shared_page->time.base_ns = base_ns;
+  shared_page->time.tsc_mult = tsc_mult;
+
+  proc_int_seq_write_end(shared_page->time.sequence);
+  shared_page->flags = shared_page->flags | SHARED_PAGE_FLAG_TSC_USABLE;
+  klib_synch_spinlock_unlock(time_block_lock);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Tell user mode that the TSC can no longer be used to find the time.
+///
+/// User mode then falls back to asking the kernel, which uses the HPET instead.
+void proc_shared_page_clear_time()
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(shared_page != nullptr);
+
+  klib_synch_spinlock_lock(time_block_lock);
+  shared_page->flags = shared_page->flags & ~static_cast<uint64_t>(SHARED_PAGE_FLAG_TSC_USABLE);
+  klib_synch_spinlock_unlock(time_block_lock);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Tell user mode that RDTSCP returns the kernel's ID for the current processor.
+///
+/// Call once IA32_TSC_AUX has been set on every processor.
+void proc_shared_page_enable_cpu_ids()
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(shared_page != nullptr);
+
+  klib_synch_spinlock_lock(time_block_lock);
+  shared_page->flags = shared_page->flags | SHARED_PAGE_FLAG_CPU_ID_USABLE;
+  klib_synch_spinlock_unlock(time_block_lock);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Record the thread that a processor is about to run.
+///
+/// Called by the scheduler on every scheduling decision, so does nothing unless the thread has actually changed.
+///
+/// @param proc_id The ID of the processor making the decision. It must be the processor calling this function.
+///
+/// @param thread The thread that processor will run next.
+void proc_shared_page_note_switch(uint32_t proc_id, task_thread *thread)
+{
+  KL_TRC_ENTRY;
+
+  shared_page_cpu_block *cpu_block;
+  uint64_t thread_id = reinterpret_cast<uint64_t>(thread);
+
+  if ((shared_page != nullptr) && (proc_id < SHARED_PAGE_MAX_CPUS) && (thread != nullptr))
+  {
+    cpu_block = &shared_page->cpus[proc_id];
+    if (cpu_block->thread_id != thread_id)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Processor ", proc_id, " now running thread ", thread, "\n");
+      proc_int_seq_write_begin(cpu_block->sequence);
+      cpu_block->thread_id = thread_id;
+      cpu_block->process_id = reinterpret_cast<uint64_t>(thread->parent_process.get());
+      proc_int_seq_write_end(cpu_block->sequence);
+    }
+  }
+
+  KL_TRC_EXIT;
+}
+
+#ifdef AZALEA_TEST_CODE
+const shared_page_layout *test_only_get_shared_page()
+{
+  return shared_page;
+}
+
+void test_only_reset_shared_page()
+{
+  KL_TRC_ENTRY;
+
+  if (shared_page != nullptr)
+  {
+    mem_deallocate_pages(shared_page, 1);
+  }
+
+  shared_page = nullptr;
+  shared_page_phys = nullptr;
+
+  KL_TRC_EXIT;
+}
+#endif
@@ -32,24 +32,53 @@ void WaitObject::wait_for_signal()
 {
   KL_TRC_ENTRY;
 
+  this->wait_for_signal_unless(nullptr, nullptr);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Cause this thread to wait until the WaitObject is triggered, unless a condition is already true.
+///
+/// The condition is checked while holding the same lock that trigger_next_thread() takes. So long as whoever makes the
+/// condition true triggers this object afterwards, the thread cannot miss that trigger between checking the condition
+/// and starting to wait.
+///
+/// @param condition Function returning true if there is no need to wait. If nullptr, the thread always waits.
+///
+/// @param context Passed to condition.
+void WaitObject::wait_for_signal_unless(bool (*condition)(void *), void *context)
+{
+  KL_TRC_ENTRY;
+
   task_thread *cur_thread = task_get_cur_thread();
   klib_list_item<task_thread *> *list_item = new klib_list_item<task_thread *>;
   klib_list_item_initialize(list_item);
   list_item->item = cur_thread;
 
   klib_synch_spinlock_lock(this->_list_lock);
-  task_continue_this_thread();
 
-  cur_thread->stop_thread();
-  klib_list_add_tail(&this->_waiting_threads, list_item);
-  klib_synch_spinlock_unlock(this->_list_lock);
+  if ((condition != nullptr) && condition(context))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Condition already met\n");
+    klib_synch_spinlock_unlock(this->_list_lock);
+    delete list_item;
+    list_item = nullptr;
+  }
+  else
+  {
+    task_continue_this_thread();
 
-  task_resume_scheduling();
+    cur_thread->stop_thread();
+    klib_list_add_tail(&this->_waiting_threads, list_item);
+    klib_synch_spinlock_unlock(this->_list_lock);
 
-  // Having added ourselves to the list we should not pass through task_yield() until the thread is re-awakened below.
-  // It is possible that the thread was signalled between the list being unlocked above and here, in which case it is
-  // reasonable to just carry on.
-  task_yield();
+    task_resume_scheduling();
+
+    // Having added ourselves to the list we should not pass through task_yield() until the thread is re-awakened
+    // below. It is possible that the thread was signalled between the list being unlocked above and here, in which
+    // case it is reasonable to just carry on.
+    task_yield();
+  }
 
   KL_TRC_EXIT;
 }
@@ -18,6 +18,7 @@ public:
   virtual ~WaitObject();
 
   virtual void wait_for_signal();
+  void wait_for_signal_unless(bool (*condition)(void *), void *context);
   virtual void cancel_waiting_thread(task_thread *thread);
 
   virtual uint64_t threads_waiting();
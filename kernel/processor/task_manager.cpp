@@ -27,6 +27,7 @@
 #include "processor.h"
 #include "processor-int.h"
 #include "mem/mem.h"
+#include "processor/timing/timing.h"
 #include "object_mgr/object_mgr.h"
 #include "system_tree/system_tree.h"
 #include "system_tree/fs/proc/proc_fs.h"
@@ -50,6 +51,11 @@ namespace
   // points to an array of bools equal in size to the number of processors.
   static bool *continue_this_thread = nullptr;
 
+  // A thread that each processor should prefer to run at its next scheduling decision, or nullptr if there is no
+  // preference. Set by task_set_switch_hint(), and after initialisation this points to an array of pointers equal in
+  // size to the number of processors.
+  task_thread **switch_hints = nullptr;
+
   // Idle threads for each processor. These are created during initialisation, and after initialisation this is an
   // array of pointers equal in size to the number of processors.
   task_thread **idle_threads = nullptr;
@@ -60,6 +66,14 @@ namespace
 
   // Protects the thread cycle from two threads making simultaneous changes.
   kernel_spinlock thread_cycle_lock;
+
+  // Threads that are waiting to be woken at a specific time, sorted so that the earliest wake time is at the head.
+  klib_list<task_thread *> timed_wake_list;
+
+  // Protects timed_wake_list.
+  kernel_spinlock timed_wake_lock;
+
+  void task_int_wake_expired_threads();
 }
 
 /// @brief Initialise and start the task management subsystem
@@ -98,6 +112,8 @@ void task_gen_init()
   uint32_t number_of_procs = proc_mp_proc_count();
 
   klib_synch_spinlock_init(thread_cycle_lock);
+  klib_synch_spinlock_init(timed_wake_lock);
+  klib_list_initialize(&timed_wake_list);
 
   std::shared_ptr<proc_fs_root_branch> proc_fs_root_ptr;
   proc_fs_root_ptr = std::make_shared<proc_fs_root_branch>();
@@ -111,6 +127,7 @@ void task_gen_init()
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Number of processors", number_of_procs);
   current_threads = new task_thread *[number_of_procs];
   continue_this_thread = new bool[number_of_procs];
+  switch_hints = new task_thread *[number_of_procs];
   idle_threads = new task_thread *[number_of_procs];
   klib_list_initialize(&dead_thread_list);
 
@@ -119,6 +136,7 @@ void task_gen_init()
     KL_TRC_TRACE(TRC_LVL::FLOW, "Initialising processor ", i, "\n");
     current_threads[i] = nullptr;
     continue_this_thread[i] = false;
+    switch_hints[i] = nullptr;
     idle_threads[i] = nullptr;
   }
 
@@ -196,6 +214,7 @@ task_thread *task_get_next_thread()
 {
   task_thread *next_thread = nullptr;
   task_thread *start_thread = nullptr;
+  task_thread *hinted_thread;
   uint32_t proc_id;
   bool found_thread;
   KL_TRC_ENTRY;
@@ -205,6 +224,13 @@ task_thread *task_get_next_thread()
   ASSERT(continue_this_thread != nullptr);
   ASSERT(current_threads != nullptr);
 
+  // Only one processor needs to check for threads whose wake time has passed. Use the one that receives the timer
+  // interrupt directly.
+  if (proc_id == 0)
+  {
+    task_int_wake_expired_threads();
+  }
+
   if (continue_this_thread[proc_id])
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Requested to continue current thread\n");
@@ -213,58 +239,87 @@ task_thread *task_get_next_thread()
   }
   else
   {
-    if (current_threads[proc_id] == idle_threads[proc_id])
-    {
-      KL_TRC_TRACE(TRC_LVL::FLOW, "Currently on an idle thread, attempt to find non-idle thread\n");
-      ASSERT(start_of_thread_cycle != nullptr);
-      next_thread = start_of_thread_cycle;
-    }
-    else if (current_threads[proc_id] == nullptr)
-    {
-      KL_TRC_TRACE(TRC_LVL::FLOW, "No threads running previously, start at the beginning\n");
-      ASSERT(start_of_thread_cycle != nullptr);
-      next_thread = start_of_thread_cycle;
-    }
-    else
+    found_thread = false;
+    hinted_thread = switch_hints[proc_id];
+    switch_hints[proc_id] = nullptr;
+
+    // If the thread that was running handed the processor to a specific thread, try that one before searching the
+    // cycle. This lets synchronous message passing switch straight to the thread that can make progress.
+    if ((hinted_thread != nullptr) &&
+        (hinted_thread != current_threads[proc_id]) &&
+        (hinted_thread->permit_running))
     {
-      KL_TRC_TRACE(TRC_LVL::FLOW, "Try next thread.\n");
-      next_thread = current_threads[proc_id]->next_thread;
-      ASSERT(next_thread != nullptr);
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Try hinted thread ", hinted_thread, "\n");
+      if (klib_synch_spinlock_try_lock(hinted_thread->cycle_lock))
+      {
+        if (hinted_thread->permit_running)
+        {
+          KL_TRC_TRACE(TRC_LVL::FLOW, "Switch directly to hinted thread\n");
+          next_thread = hinted_thread;
+          found_thread = true;
+        }
+        else
+        {
+          KL_TRC_TRACE(TRC_LVL::FLOW, "Hinted thread stopped, release it\n");
+          klib_synch_spinlock_unlock(hinted_thread->cycle_lock);
+        }
+      }
     }
 
-    start_thread = next_thread;
-    ASSERT(start_thread != nullptr);
-    found_thread = false;
-    do
+    if (!found_thread)
     {
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "Considering thread", (uint64_t)next_thread, "\n");
-      if ((next_thread->permit_running) && (next_thread->cycle_lock != 1))
+      if (current_threads[proc_id] == idle_threads[proc_id])
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Currently on an idle thread, attempt to find non-idle thread\n");
+        ASSERT(start_of_thread_cycle != nullptr);
+        next_thread = start_of_thread_cycle;
+      }
+      else if (current_threads[proc_id] == nullptr)
       {
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Trying to lock for ourselves... ");
-        if (klib_synch_spinlock_try_lock(next_thread->cycle_lock))
+        KL_TRC_TRACE(TRC_LVL::FLOW, "No threads running previously, start at the beginning\n");
+        ASSERT(start_of_thread_cycle != nullptr);
+        next_thread = start_of_thread_cycle;
+      }
+      else
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Try next thread.\n");
+        next_thread = current_threads[proc_id]->next_thread;
+        ASSERT(next_thread != nullptr);
+      }
+
+      start_thread = next_thread;
+      ASSERT(start_thread != nullptr);
+      do
+      {
+        KL_TRC_TRACE(TRC_LVL::EXTRA, "Considering thread", (uint64_t)next_thread, "\n");
+        if ((next_thread->permit_running) && (next_thread->cycle_lock != 1))
         {
-          // Having locked it, double check that it's still OK to run, otherwise release it and carry on
-          if (next_thread->permit_running)
+          KL_TRC_TRACE(TRC_LVL::FLOW, "Trying to lock for ourselves... ");
+          if (klib_synch_spinlock_try_lock(next_thread->cycle_lock))
           {
-            KL_TRC_TRACE(TRC_LVL::FLOW, "SUCCESS!\n");
-            found_thread = true;
-            break;
+            // Having locked it, double check that it's still OK to run, otherwise release it and carry on
+            if (next_thread->permit_running)
+            {
+              KL_TRC_TRACE(TRC_LVL::FLOW, "SUCCESS!\n");
+              found_thread = true;
+              break;
+            }
+            else
+            {
+              KL_TRC_TRACE(TRC_LVL::FLOW, "Had to release it again\n");
+              klib_synch_spinlock_unlock(next_thread->cycle_lock);
+            }
           }
           else
           {
-            KL_TRC_TRACE(TRC_LVL::FLOW, "Had to release it again\n");
-            klib_synch_spinlock_unlock(next_thread->cycle_lock);
+            KL_TRC_TRACE(TRC_LVL::FLOW, "Not this time, continue\n");
           }
         }
-        else
-        {
-          KL_TRC_TRACE(TRC_LVL::FLOW, "Not this time, continue\n");
-        }
-      }
 
-      next_thread = next_thread->next_thread;
-      ASSERT(next_thread != nullptr)
-    } while (next_thread != start_thread);
+        next_thread = next_thread->next_thread;
+        ASSERT(next_thread != nullptr)
+      } while (next_thread != start_thread);
+    }
 
     if (found_thread)
     {
@@ -294,7 +349,15 @@ task_thread *task_get_next_thread()
     }
   }
 
+  if (next_thread != current_threads[proc_id])
+  {
+    KL_TRC_EVENT(TRC_EVENT::THREAD_SWITCH,
+                 reinterpret_cast<uint64_t>(current_threads[proc_id]),
+                 reinterpret_cast<uint64_t>(next_thread));
+  }
+
   current_threads[proc_id] = next_thread;
+  proc_shared_page_note_switch(proc_id, next_thread);
 
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Next thread (addr)", (uint64_t)next_thread, "\n");
   KL_TRC_EXIT;
@@ -326,6 +389,44 @@ void task_resume_scheduling()
   KL_TRC_EXIT;
 }
 
+/// @brief Suggest which thread this processor should run next.
+///
+/// At the next scheduling decision on this processor, the scheduler tries to run the hinted thread before searching
+/// the rest of the thread cycle. If the hinted thread cannot run at that point it is ignored, so the hint never
+/// prevents progress. Only one hint is stored per processor - a later hint replaces an earlier one.
+///
+/// Hints to a thread are cleared when that thread is removed from the thread cycle.
+///
+/// @param thread The thread to prefer. nullptr clears any existing hint.
+void task_set_switch_hint(task_thread *thread)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(switch_hints != nullptr);
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Hint next thread: ", thread, "\n");
+  switch_hints[proc_mp_this_proc_id()] = thread;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Yield this processor directly to another thread.
+///
+/// This is intended for use where the current thread has just made another thread runnable and that thread is the
+/// only one that can make progress - for example, when a synchronous message call or reply is delivered. Rather than
+/// waiting for the scheduler to reach the target thread in the cycle, this processor switches to it immediately, if
+/// possible.
+///
+/// @param thread The thread to switch to.
+void task_yield_to(task_thread *thread)
+{
+  KL_TRC_ENTRY;
+
+  task_set_switch_hint(thread);
+  task_yield();
+
+  KL_TRC_EXIT;
+}
+
 #ifdef AZALEA_TEST_CODE
 void test_only_reset_task_mgr()
 {
@@ -358,21 +459,131 @@ void test_only_reset_task_mgr()
 
   delete[] current_threads;
   delete[] continue_this_thread;
+  delete[] switch_hints;
   delete[] idle_threads;
 
   current_threads = nullptr;
   continue_this_thread = nullptr;
+  switch_hints = nullptr;
   idle_threads = nullptr;
   start_of_thread_cycle = nullptr;
 
   thread_cycle_lock = 0;
 
+  klib_list_initialize(&timed_wake_list);
+  timed_wake_lock = 0;
+
   system_tree()->delete_child("proc");
 
   KL_TRC_EXIT;
 }
 #endif
 
+/// @brief Request that a thread be woken at a given time.
+///
+/// When the system timer reaches wake_time the thread is permitted to run again, whether or not whatever it was
+/// waiting for has signalled it. This allows synchronisation primitives to offer waits with a timeout - they must
+/// check for themselves whether the thread was signalled or simply woken up. If the thread is woken earlier by other
+/// means then the caller should use task_cancel_wake_time() to avoid a spurious wake later on.
+///
+/// Threads are only checked for expiry during scheduling, so the wake will be delayed by up to one scheduler period.
+///
+/// @param thread The thread to wake. If it already has a wake time set, that time is replaced.
+///
+/// @param wake_time The system timer count (as given by time_get_system_timer_count()) to wake the thread at.
+void task_set_wake_time(task_thread *thread, uint64_t wake_time)
+{
+  KL_TRC_ENTRY;
+
+  klib_list_item<task_thread *> *next_item;
+
+  ASSERT(thread != nullptr);
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Wake thread ", thread, " at ", wake_time, "\n");
+
+  klib_synch_spinlock_lock(timed_wake_lock);
+
+  if (klib_list_item_is_in_any_list(&thread->timed_wake_item))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Replace existing wake time\n");
+    klib_list_remove(&thread->timed_wake_item);
+  }
+
+  thread->wake_time = wake_time;
+
+  // Keep the list sorted by wake time, so the scheduler only ever needs to look at the head.
+  next_item = timed_wake_list.head;
+  while ((next_item != nullptr) && (next_item->item->wake_time <= wake_time))
+  {
+    next_item = next_item->next;
+  }
+
+  if (next_item == nullptr)
+  {
+    klib_list_add_tail(&timed_wake_list, &thread->timed_wake_item);
+  }
+  else
+  {
+    klib_list_add_before(next_item, &thread->timed_wake_item);
+  }
+
+  klib_synch_spinlock_unlock(timed_wake_lock);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Cancel a wake time previously set by task_set_wake_time().
+///
+/// If the thread has no pending wake time, nothing happens.
+///
+/// @param thread The thread to no longer wake.
+void task_cancel_wake_time(task_thread *thread)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(thread != nullptr);
+
+  klib_synch_spinlock_lock(timed_wake_lock);
+  if (klib_list_item_is_in_any_list(&thread->timed_wake_item))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Cancel wake for ", thread, "\n");
+    klib_list_remove(&thread->timed_wake_item);
+  }
+  klib_synch_spinlock_unlock(timed_wake_lock);
+
+  KL_TRC_EXIT;
+}
+
+namespace
+{
+  /// @brief Permit any threads whose wake time has passed to run again.
+  ///
+  /// Called by the scheduler. The system timer is only read if there is a thread waiting to be woken, since that read
+  /// is not free. The lock is only tried, not waited for, since the thread this processor has just interrupted might
+  /// be holding it - in which case the check simply waits for the next scheduling period.
+  void task_int_wake_expired_threads()
+  {
+    klib_list_item<task_thread *> *item;
+    uint64_t now;
+
+    if (timed_wake_list.head != nullptr)
+    {
+      now = time_get_system_timer_count();
+
+      if (klib_synch_spinlock_try_lock(timed_wake_lock))
+      {
+        item = timed_wake_list.head;
+        while ((item != nullptr) && (item->item->wake_time <= now))
+        {
+          klib_list_remove(item);
+          item->item->start_thread();
+          item = timed_wake_list.head;
+        }
+        klib_synch_spinlock_unlock(timed_wake_lock);
+      }
+    }
+  }
+}
+
 /// @brief Add a new thread to the cycle of all threads
 ///
 /// All threads are joined in a cycle by task_thread::next_thread. Add new_thread to this cycle.
@@ -442,6 +653,19 @@ void task_thread_cycle_remove(task_thread *thread)
     search_thread->next_thread = search_thread->next_thread->next_thread;
   }
 
+  // Don't leave any processor holding a hint to a thread that is going away.
+  if (switch_hints != nullptr)
+  {
+    for (uint32_t i = 0; i < proc_mp_proc_count(); i++)
+    {
+      if (switch_hints[i] == thread)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Clear switch hint on processor ", i, "\n");
+        switch_hints[i] = nullptr;
+      }
+    }
+  }
+
   task_thread_cycle_unlock();
   KL_TRC_EXIT;
 }
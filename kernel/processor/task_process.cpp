@@ -8,6 +8,8 @@
 #include "processor-int.h"
 #include "system_tree/fs/proc/proc_fs.h"
 #include "system_tree/system_tree.h"
+#include "syscall/io_ring.h"
+#include "syscall/syscall_stats.h"
 
 /// @brief Create a new process
 ///
@@ -24,11 +26,27 @@ task_process::task_process(ENTRY_PROC entry_point, bool kernel_mode, mem_process
   kernel_mode(kernel_mode),
   accepts_msgs(false),
   being_destroyed(false),
+  syscall_stats(nullptr),
   has_ever_started(false)
 {
   KL_TRC_ENTRY;
 
   klib_list_initialize(&this->child_threads);
+  klib_list_initialize(&this->msg_receivers_waiting);
+  klib_list_initialize(&this->msg_senders_waiting);
+  klib_list_initialize(&this->calls_pending);
+  klib_list_initialize(&this->call_servers_waiting);
+  klib_list_initialize(&this->msg_groups);
+  klib_synch_spinlock_init(this->message_lock);
+  klib_synch_spinlock_init(this->io_ring_lock);
+  this->message_queue.entries = nullptr;
+  this->message_queue.capacity = 0;
+  this->message_queue.head = 0;
+  this->message_queue.count = 0;
+
+#ifdef AZALEA_SYSCALL_STATS
+  this->syscall_stats = syscall_stats_alloc();
+#endif
 
   if (mem_info != nullptr)
   {
@@ -40,6 +58,12 @@ task_process::task_process(ENTRY_PROC entry_point, bool kernel_mode, mem_process
     KL_TRC_TRACE(TRC_LVL::FLOW, "No mem_info, create it\n");
     this->mem_info = mem_task_create_task_entry();
     mem_vmm_allocate_specific_range(0, 1, this);
+
+    if (!kernel_mode)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "User mode process, map shared page\n");
+      proc_shared_page_map(this);
+    }
   }
 
   KL_TRC_EXIT;
@@ -107,11 +131,15 @@ task_process::~task_process()
 {
   // Make sure the proces was destroyed via destroy_process.
   ASSERT(this->being_destroyed);
+  ASSERT(!this->accepts_msgs);
 
   // Free all memory associated with this process. This is safe because this destructor is never run in the context of
   // the process being destroyed - it either runs as part of proc_tidyup_thread or that of the thread that started the
   // destruction of the process.
   mem_task_free_task(this);
+
+  syscall_stats_free(this->syscall_stats);
+  this->syscall_stats = nullptr;
 }
 
 /// @brief Final destruction of a process.
@@ -124,6 +152,7 @@ void task_process::destroy_process()
   klib_list_item <std::shared_ptr<task_thread>> *list_item;
   klib_list_item <std::shared_ptr<task_thread>> *next_item;
   bool skipped_this_thread = false;
+  std::shared_ptr<io_ring> ring;
 
   if (!this->being_destroyed)
   {
@@ -139,6 +168,14 @@ void task_process::destroy_process()
     ASSERT(proc_fs_root_ptr);
     proc_fs_root_ptr->remove_process(shared_from_this());
 
+    // Stop accepting messages now, so that any threads waiting to send to or call this process are released rather
+    // than waiting for a process that will never answer. Any messages that were never handled are discarded.
+    if (this->accepts_msgs)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Stop accepting messages\n");
+      msg_unregister_process(this);
+    }
+
     // Destroy all threads except for this one.
     // this needs more locking! But that can wait for the re-write.
     list_item = this->child_threads.head;
@@ -160,6 +197,22 @@ void task_process::destroy_process()
       list_item = next_item;
     }
 
+    // The ring's workers have been destroyed now, so the ring can let go of them and of its owner.
+    klib_synch_spinlock_lock(this->io_ring_lock);
+    ring = this->io_ring_obj;
+    this->io_ring_obj = nullptr;
+    klib_synch_spinlock_unlock(this->io_ring_lock);
+
+    if (ring != nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Shut down I/O ring\n");
+      ring->shutdown();
+      ring = nullptr;
+    }
+
+    // Handles may refer to this process or its threads, so release them now rather than waiting for the destructor.
+    this->proc_handles.remove_all_objects();
+
     if (skipped_this_thread)
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Destroying this thread now\n");
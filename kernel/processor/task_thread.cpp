@@ -16,9 +16,12 @@
 /// @param entry_point The point that the thread will begin executing from.
 ///
 /// @param parent The process this thread is part of.
-task_thread::task_thread(ENTRY_PROC entry_point, std::shared_ptr<task_process> parent) :
+///
+/// @param kernel_mode Should the thread run in kernel mode, even if the parent process is a user mode process?
+task_thread::task_thread(ENTRY_PROC entry_point, std::shared_ptr<task_process> parent, bool kernel_mode) :
   permit_running(false),
   parent_process(parent),
+  kernel_mode(kernel_mode || parent->kernel_mode),
   thread_destroyed(false)
 {
   KL_TRC_ENTRY;
@@ -27,7 +30,12 @@ task_thread::task_thread(ENTRY_PROC entry_point, std::shared_ptr<task_process> p
   this->execution_context = task_int_create_exec_context(entry_point, this);
   KL_TRC_TRACE(TRC_LVL::FLOW, "Context created @ ", this->execution_context, "\n");
   this->process_list_item = new klib_list_item<std::shared_ptr<task_thread>>();
-  this->synch_list_item = new klib_list_item<std::shared_ptr<task_thread>>();
+  this->synch_list_item = new klib_list_item<kl_ref_ptr<task_thread>>();
+  klib_list_item_initialize(&this->timed_wake_item);
+  this->timed_wake_item.item = this;
+  this->wake_time = 0;
+  this->call_state.reply_ready = false;
+  this->call_state.result = ERR_CODE::NO_ERROR;
 
   if (!parent_process->being_destroyed)
   {
@@ -48,13 +56,28 @@ task_thread::task_thread(ENTRY_PROC entry_point, std::shared_ptr<task_process> p
   KL_TRC_EXIT;
 }
 
-std::shared_ptr<task_thread> task_thread::create(ENTRY_PROC entry_point, std::shared_ptr<task_process> parent)
+/// @brief Create a new thread.
+///
+/// See the constructor for details. The shared pointers returned by this function all hold the thread's first intrusive
+/// reference between them.
+///
+/// @param entry_point The point that the thread will begin executing from.
+///
+/// @param parent The process this thread is part of.
+///
+/// @param kernel_mode Should the thread run in kernel mode, even if the parent process is a user mode process?
+///
+/// @return The new thread.
+std::shared_ptr<task_thread> task_thread::create(ENTRY_PROC entry_point,
+                                                 std::shared_ptr<task_process> parent,
+                                                 bool kernel_mode)
 {
   KL_TRC_ENTRY;
 
-  std::shared_ptr<task_thread> new_thread = std::shared_ptr<task_thread>(new task_thread(entry_point, parent));
+  std::shared_ptr<task_thread> new_thread =
+    std::shared_ptr<task_thread>(new task_thread(entry_point, parent, kernel_mode), task_thread::release_shared_ref);
 
-  new_thread->synch_list_item->item = new_thread;
+  new_thread->synch_list_item->item = kl_ref_ptr<task_thread>(new_thread.get());
   new_thread->process_list_item->item = new_thread;
 
   parent->add_new_thread(new_thread);
@@ -76,6 +99,31 @@ task_thread::~task_thread()
   KL_TRC_EXIT;
 }
 
+/// @brief Delete the thread once the last reference to it has been released.
+void task_thread::ref_counter_zero()
+{
+  KL_TRC_ENTRY;
+
+  delete this;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Release the intrusive reference held by the thread's shared pointers.
+///
+/// Used as the deleter of the std::shared_ptr created by create(), so it is called once the last of those is released.
+///
+/// @param thread The thread to release.
+void task_thread::release_shared_ref(task_thread *thread)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(thread != nullptr);
+  thread->ref_release();
+
+  KL_TRC_EXIT;
+}
+
 /// @brief Parts of the thread destruction handled by the thread class.
 ///
 /// This code currently only triggers any threads that were waiting for the termination of this one.
@@ -90,6 +138,8 @@ void task_thread::destroy_thread()
     KL_TRC_TRACE(TRC_LVL::FLOW, "Destroying thread.\n");
     this->thread_destroyed = true;
     this->trigger_all_threads();
+    task_cancel_wake_time(this);
+    msg_abandon_call(this);
 
     destroying_this_thread = (task_get_cur_thread() == this);
 
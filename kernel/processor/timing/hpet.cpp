@@ -261,3 +261,27 @@ uint64_t time_hpet_cur_value()
 
   return hpet_config->main_counter_val;
 }
+
+/// @brief Convert a number of HPET ticks into nanoseconds.
+///
+/// Since the main counter is reset to zero when the HPET is initialised, this also converts a counter value into the
+/// number of nanoseconds since then.
+///
+/// @param ticks The number of ticks to convert.
+///
+/// @return The number of nanoseconds corresponding to ticks.
+uint64_t time_hpet_ticks_to_ns(uint64_t ticks)
+{
+  KL_TRC_ENTRY;
+
+  unsigned __int128 time_in_fs;
+  uint64_t result;
+
+  time_in_fs = static_cast<unsigned __int128>(ticks) * HPET_PERIOD(hpet_config->gen_cap_and_id);
+  result = static_cast<uint64_t>(time_in_fs / 1000000);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
@@ -9,6 +9,7 @@ void time_hpet_init();
 void time_hpet_stall(uint64_t wait_in_ns);
 uint64_t time_hpet_cur_value();
 uint64_t time_hpet_compute_wait(uint64_t wait_in_ns);
+uint64_t time_hpet_ticks_to_ns(uint64_t ticks);
 
 /*
 000-007h General Capabilities and ID Register Read Only
@@ -3,6 +3,68 @@
 #include "processor/timing/timing.h"
 #include "processor/timing/timing-int.h"
 #include "klib/klib.h"
+#include "processor/processor.h"
+#include "processor/x64/processor-x64.h"
+#include "processor/x64/processor-x64-int.h"
+#include "user_interfaces/shared_page.h"
+
+#include <atomic>
+
+namespace
+{
+  // How long to spend comparing the TSC against the HPET during startup.
+  const uint64_t tsc_calibration_period_ns = 50000000;
+
+  // How far a processor's TSC may be from the HPET, once the time taken to read the HPET is allowed for, before it is
+  // considered out of step with the other processors.
+  const uint64_t tsc_sync_tolerance_ns = 5000;
+
+  // How many times an AP tries to bring its TSC in to step before the kernel gives up on the TSC.
+  const uint32_t tsc_sync_attempts = 3;
+
+  // How often, in nanoseconds, the watchdog compares the TSC with the HPET.
+  const uint64_t watchdog_period_ns = 1000000000;
+
+  // If the TSC clock and the HPET are further apart than this, the TSC is assumed to have stopped or jumped.
+  const uint64_t watchdog_max_offset_ns = 1000000;
+
+  // If the TSC rate measured by the watchdog differs from the calibrated rate by more than 1 part in this value, the
+  // TSC is assumed not to be running at a constant rate after all.
+  const uint64_t watchdog_max_rate_error = 100;
+
+  /// @brief Parameters for converting the TSC to nanoseconds since boot, as per shared_page_time_block.
+  struct tsc_clock_params
+  {
+    uint64_t base_tsc; ///< TSC value at the time given by base_ns.
+    uint64_t base_ns; ///< Nanoseconds since boot at base_tsc.
+    uint64_t mult; ///< Nanoseconds per TSC tick, shifted left by SHARED_PAGE_TSC_SHIFT.
+  };
+
+  // Set once the TSC has been calibrated, and cleared again if it turns out not to be trustworthy - after which the
+  // HPET is used for everything.
+  std::atomic<bool> tsc_usable(false);
+
+  // The kernel's copy of the conversion parameters, protected by a seqlock in the same way as the shared page's copy.
+  // Only processor 0 writes them, so writers don't need a lock.
+  std::atomic<uint64_t> tsc_sequence(0);
+  std::atomic<uint64_t> tsc_base_tsc(0);
+  std::atomic<uint64_t> tsc_base_ns(0);
+  std::atomic<uint64_t> tsc_mult(0);
+
+  // The multiplier found during startup calibration, which later measurements are checked against.
+  uint64_t tsc_calibrated_mult = 0;
+
+  // Watchdog state. Only used by processor 0.
+  uint64_t watchdog_last_tsc = 0;
+  uint64_t watchdog_last_hpet_ns = 0;
+
+  void time_calibrate_tsc();
+  void time_read_tsc_params(tsc_clock_params &params);
+  void time_set_tsc_params(uint64_t base_tsc, uint64_t base_ns, uint64_t mult);
+  int64_t time_tsc_offset_ns(const tsc_clock_params &params, uint64_t tsc);
+  uint64_t time_read_hpet_and_tsc(uint64_t &tsc, uint64_t &window_ns);
+  void time_abandon_tsc();
+}
 
 /// @brief Initializes the kernel's timing systems.
 ///
@@ -10,7 +72,10 @@
 /// - ACPI is available on this system and is initialized.
 /// - At least one HPET is available, and can be found in the ACPI tables.
 ///
-/// This function will cause the HPET to start operating, and disable interrupts from the RTC and PIT.
+/// This function will cause the HPET to start operating, and disable interrupts from the RTC and PIT. It also
+/// calibrates the TSC against the HPET, so that both the kernel and user mode (via the shared page) can read the time
+/// cheaply.
+/// proc_shared_page_init() must have been called first.
 ///
 /// There is scope for emulating the high-precision element of the HPET using the PIT, processor cycle counting and so
 /// on, but that's a project for another time (and maybe never, what PC wouldn't have a HPET nowadays?)
@@ -21,6 +86,7 @@ void time_gen_init()
   ASSERT(time_hpet_exists());
 
   time_hpet_init();
+  time_calibrate_tsc();
 
   KL_TRC_EXIT;
 }
@@ -45,24 +111,83 @@ void time_stall_process(uint64_t wait_in_ns)
 {
   KL_TRC_ENTRY;
 
+  uint64_t end_ns = time_now_ns() + wait_in_ns;
+
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Stall for ns", wait_in_ns, "\n");
-  time_hpet_stall(wait_in_ns);
+  while (time_now_ns() < end_ns)
+  {
+    // Keep waiting.
+  }
 
   KL_TRC_EXIT;
 }
 
+/// @brief Get the number of nanoseconds since the system timer was started.
+///
+/// This is the kernel's main clock. If the processor has an invariant TSC, and it was found to be in step on all
+/// processors, it is read from the TSC - which takes a few tens of cycles - and is otherwise read from the HPET, which
+/// takes hundreds. Either way, the result is consistent across processors.
+///
+/// This function does no tracing, so that it can be used by instrumentation.
+///
+/// @return The number of nanoseconds since the HPET was started.
+uint64_t time_now_ns()
+{
+  tsc_clock_params params;
+
+  if (!tsc_usable.load(std::memory_order_acquire))
+  {
+    return time_hpet_ticks_to_ns(time_hpet_cur_value());
+  }
+
+  time_read_tsc_params(params);
+
+  return shared_page_tsc_to_ns(params.base_tsc, params.base_ns, params.mult, asm_proc_read_tsc());
+}
+
+/// @brief Is the kernel's clock being read from the TSC?
+///
+/// @return True if time_now_ns() uses the TSC, false if it uses the HPET.
+bool time_tsc_in_use()
+{
+  return tsc_usable.load(std::memory_order_acquire);
+}
+
+/// @brief Convert a number of TSC ticks into nanoseconds.
+///
+/// Uses the rate found when the TSC was calibrated, which remains a good estimate even if the kernel has since stopped
+/// using the TSC as its clock.
+///
+/// @param ticks The number of ticks to convert.
+///
+/// @param[out] ns The number of nanoseconds corresponding to ticks. Unchanged if the TSC was never calibrated.
+///
+/// @return True if the TSC was calibrated and ns has been set, false otherwise.
+bool time_tsc_ticks_to_ns(uint64_t ticks, uint64_t &ns)
+{
+  bool result = (tsc_calibrated_mult != 0);
+
+  if (result)
+  {
+    ns = static_cast<uint64_t>((static_cast<unsigned __int128>(ticks) * tsc_calibrated_mult) >> SHARED_PAGE_TSC_SHIFT);
+  }
+
+  return result;
+}
+
 /// @brief Get the raw data from the system timer.
 ///
-/// Returns the value of the HPET counter, for applications that may be interested - for example, for waiting a short
-/// period whilst polling, or for performance measurements
+/// For applications that may be interested - for example, for waiting a short period whilst polling, or for
+/// performance measurements. The system timer counts nanoseconds, the same as time_now_ns(), but callers should use
+/// time_get_system_timer_offset() to compute waits in case that ever changes.
 ///
-/// @return The value of the system timer - the HPET in Azalea. May not be directly meaningful!
+/// @return The value of the system timer.
 uint64_t time_get_system_timer_count()
 {
   KL_TRC_ENTRY;
   KL_TRC_EXIT;
 
-  return time_hpet_cur_value();
+  return time_now_ns();
 }
 
 /// @brief Translate a desired wait into a number of system timer units.
@@ -78,5 +203,304 @@ uint64_t time_get_system_timer_offset(uint64_t wait_in_ns)
   KL_TRC_ENTRY;
   KL_TRC_EXIT;
 
-  return time_hpet_compute_wait(wait_in_ns);
+  return wait_in_ns;
+}
+
+/// @brief Get the value of the system timer, in nanoseconds.
+///
+/// @return The number of nanoseconds since the system timer was started.
+uint64_t time_get_system_timer_ns()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+
+  return time_now_ns();
+}
+
+/// @brief Bring this processor's TSC in to step with the boot processor's.
+///
+/// Called by each AP as it starts, before it enables interrupts. The TSC is compared against the HPET - which all
+/// processors share - using the boot processor's calibration. If it is out of step, and the processor supports
+/// IA32_TSC_ADJUST, the TSC is moved to match. If it still can't be brought in to step, the kernel stops using the TSC
+/// altogether, since threads moving between processors would otherwise see time jump around.
+void time_ap_sync_tsc()
+{
+  KL_TRC_ENTRY;
+
+  tsc_clock_params params;
+  uint64_t tsc;
+  uint64_t window_ns;
+  uint64_t hpet_ns;
+  int64_t skew_ns;
+  int64_t skew_ticks;
+  bool in_step = false;
+  bool can_adjust;
+
+  if (tsc_usable.load(std::memory_order_acquire))
+  {
+    can_adjust = proc_x64_tsc_adjust_supported();
+
+    for (uint32_t i = 0; i < tsc_sync_attempts; i++)
+    {
+      time_read_tsc_params(params);
+      hpet_ns = time_read_hpet_and_tsc(tsc, window_ns);
+      skew_ns = (static_cast<int64_t>(params.base_ns) + time_tsc_offset_ns(params, tsc)) -
+                static_cast<int64_t>(hpet_ns);
+
+      KL_TRC_TRACE(TRC_LVL::EXTRA, "TSC skew (ns): ", skew_ns, ", window: ", window_ns, "\n");
+
+      // Half the time taken to read the HPET is an unavoidable uncertainty in the measurement.
+      if ((skew_ns < 0 ? -skew_ns : skew_ns) <= static_cast<int64_t>(tsc_sync_tolerance_ns + (window_ns / 2)))
+      {
+        in_step = true;
+        break;
+      }
+      else if (!can_adjust)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Can't adjust TSC\n");
+        break;
+      }
+
+      skew_ticks = static_cast<int64_t>((static_cast<__int128>(skew_ns) << SHARED_PAGE_TSC_SHIFT) / params.mult);
+      proc_write_msr(PROC_X64_MSRS::IA32_TSC_ADJUST,
+                     proc_read_msr(PROC_X64_MSRS::IA32_TSC_ADJUST) - static_cast<uint64_t>(skew_ticks));
+    }
+
+    if (!in_step)
+    {
+      KL_TRC_TRACE(TRC_LVL::IMPORTANT, "Processor ", proc_mp_this_proc_id(), " TSC out of step, use HPET\n");
+      time_abandon_tsc();
+    }
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Compare the TSC with the HPET, and correct any drift between them.
+///
+/// Called by processor 0 on every timer tick, but only does any work once watchdog_period_ns has passed since the last
+/// check, as measured by the kernel's clock. The boot calibration is only accurate to a few parts per million, so the
+/// TSC clock is steered back towards the HPET - by adjusting its rate so that the two meet again by the next check -
+/// rather than being stepped, so that it never goes backwards. If the two clocks disagree by more than a small amount,
+/// the TSC is assumed to be faulty and the HPET is used instead.
+void time_watchdog_tick()
+{
+  tsc_clock_params params;
+  uint64_t tsc;
+  uint64_t window_ns;
+  uint64_t hpet_ns;
+  uint64_t clock_ns;
+  int64_t offset_ns;
+  int64_t max_correction;
+  uint64_t elapsed_ns;
+  uint64_t elapsed_tsc;
+  uint64_t measured_mult;
+  uint64_t rate_error;
+
+  KL_TRC_ENTRY;
+
+  // The TSC clock is cheap to read, so use it to decide whether a check is due. The HPET is only read if it is.
+  if (tsc_usable.load(std::memory_order_acquire) && (time_now_ns() >= (watchdog_last_hpet_ns + watchdog_period_ns)))
+  {
+    time_read_tsc_params(params);
+    hpet_ns = time_read_hpet_and_tsc(tsc, window_ns);
+    clock_ns = params.base_ns + time_tsc_offset_ns(params, tsc);
+    offset_ns = static_cast<int64_t>(hpet_ns - clock_ns);
+    elapsed_ns = hpet_ns - watchdog_last_hpet_ns;
+    elapsed_tsc = tsc - watchdog_last_tsc;
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "HPET ahead of TSC by (ns): ", offset_ns, "\n");
+
+    if ((tsc <= watchdog_last_tsc) || (elapsed_ns == 0) ||
+        ((offset_ns < 0 ? -offset_ns : offset_ns) > static_cast<int64_t>(watchdog_max_offset_ns)))
+    {
+      KL_TRC_TRACE(TRC_LVL::IMPORTANT, "TSC has stopped or jumped, use HPET\n");
+      time_abandon_tsc();
+    }
+    else
+    {
+      measured_mult = static_cast<uint64_t>((static_cast<unsigned __int128>(elapsed_ns) << SHARED_PAGE_TSC_SHIFT) /
+                                            elapsed_tsc);
+      rate_error = (measured_mult > tsc_calibrated_mult) ?
+                   measured_mult - tsc_calibrated_mult : tsc_calibrated_mult - measured_mult;
+
+      if (rate_error > (tsc_calibrated_mult / watchdog_max_rate_error))
+      {
+        KL_TRC_TRACE(TRC_LVL::IMPORTANT, "TSC rate has changed, use HPET\n");
+        time_abandon_tsc();
+      }
+      else
+      {
+        // Aim to absorb the offset over the next period, but never so quickly that the clock could stop or go back.
+        max_correction = static_cast<int64_t>(elapsed_ns / 2);
+        if (offset_ns > max_correction)
+        {
+          offset_ns = max_correction;
+        }
+        else if (offset_ns < -max_correction)
+        {
+          offset_ns = -max_correction;
+        }
+
+        time_set_tsc_params(tsc,
+                            clock_ns,
+                            static_cast<uint64_t>((static_cast<unsigned __int128>(elapsed_ns + offset_ns)
+                                                   << SHARED_PAGE_TSC_SHIFT) / elapsed_tsc));
+      }
+    }
+
+    watchdog_last_tsc = tsc;
+    watchdog_last_hpet_ns = hpet_ns;
+  }
+
+  KL_TRC_EXIT;
+}
+
+namespace
+{
+  /// @brief Calibrate the TSC against the HPET, and start using it as the kernel's clock.
+  ///
+  /// The TSC is only used if the processor reports an invariant TSC - that is, one that runs at a constant rate in all
+  /// power states and on all processors. Otherwise, the kernel and user mode both carry on using the HPET.
+  void time_calibrate_tsc()
+  {
+    KL_TRC_ENTRY;
+
+    uint64_t ebx_eax;
+    uint64_t edx_ecx;
+    bool invariant_tsc = false;
+    uint64_t start_hpet_ns;
+    uint64_t start_tsc;
+    uint64_t end_hpet_ns;
+    uint64_t end_tsc;
+    uint64_t window_ns;
+    uint64_t mult;
+
+    asm_proc_read_cpuid(0x80000000, 0, &ebx_eax, &edx_ecx);
+    if ((ebx_eax & 0xFFFFFFFF) >= 0x80000007)
+    {
+      // Invariant TSC support is bit 8 of EDX, which is stored in the upper half of edx_ecx.
+      asm_proc_read_cpuid(0x80000007, 0, &ebx_eax, &edx_ecx);
+      invariant_tsc = ((edx_ecx & (1ULL << (32 + 8))) != 0);
+    }
+
+    if (invariant_tsc)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Invariant TSC, calibrate against HPET\n");
+      start_hpet_ns = time_read_hpet_and_tsc(start_tsc, window_ns);
+      time_hpet_stall(tsc_calibration_period_ns);
+      end_hpet_ns = time_read_hpet_and_tsc(end_tsc, window_ns);
+
+      ASSERT(end_tsc > start_tsc);
+      mult = static_cast<uint64_t>((static_cast<unsigned __int128>(end_hpet_ns - start_hpet_ns)
+                                    << SHARED_PAGE_TSC_SHIFT) / (end_tsc - start_tsc));
+
+      KL_TRC_TRACE(TRC_LVL::EXTRA, "TSC ticks: ", end_tsc - start_tsc, " in ns: ", end_hpet_ns - start_hpet_ns, "\n");
+      tsc_calibrated_mult = mult;
+      watchdog_last_tsc = end_tsc;
+      watchdog_last_hpet_ns = end_hpet_ns;
+      time_set_tsc_params(end_tsc, end_hpet_ns, mult);
+      tsc_usable.store(true, std::memory_order_release);
+    }
+    else
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "TSC not invariant, use HPET\n");
+    }
+
+    KL_TRC_EXIT;
+  }
+
+  /// @brief Take a consistent copy of the TSC conversion parameters.
+  ///
+  /// @param[out] params The parameters.
+  void time_read_tsc_params(tsc_clock_params &params)
+  {
+    uint64_t sequence;
+
+    do
+    {
+      sequence = tsc_sequence.load(std::memory_order_acquire);
+      params.base_tsc = tsc_base_tsc.load(std::memory_order_relaxed);
+      params.base_ns = tsc_base_ns.load(std::memory_order_relaxed);
+      params.mult = tsc_mult.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (((sequence & 1) != 0) || (sequence != tsc_sequence.load(std::memory_order_relaxed)));
+  }
+
+  /// @brief Update the TSC conversion parameters, in both the kernel and the shared page.
+  ///
+  /// Must only be called by one processor at a time.
+  ///
+  /// @param base_tsc The TSC value at base_ns.
+  ///
+  /// @param base_ns Nanoseconds since boot at base_tsc.
+  ///
+  /// @param mult Nanoseconds per TSC tick, shifted left by SHARED_PAGE_TSC_SHIFT.
+  void time_set_tsc_params(uint64_t base_tsc, uint64_t base_ns, uint64_t mult)
+  {
+    tsc_sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    tsc_base_tsc.store(base_tsc, std::memory_order_relaxed);
+    tsc_base_ns.store(base_ns, std::memory_order_relaxed);
+    tsc_mult.store(mult, std::memory_order_relaxed);
+    tsc_sequence.fetch_add(1, std::memory_order_release);
+
+    proc_shared_page_set_time(base_tsc, base_ns, mult);
+  }
+
+  /// @brief How many nanoseconds after the base time was the TSC at a given value?
+  ///
+  /// Unlike shared_page_tsc_to_ns(), this works for values before the base time too, giving a negative result.
+  ///
+  /// @param params The conversion parameters.
+  ///
+  /// @param tsc The TSC value to convert.
+  ///
+  /// @return The number of nanoseconds between params.base_tsc and tsc.
+  int64_t time_tsc_offset_ns(const tsc_clock_params &params, uint64_t tsc)
+  {
+    __int128 delta = static_cast<__int128>(static_cast<int64_t>(tsc - params.base_tsc)) * params.mult;
+
+    return static_cast<int64_t>(delta >> SHARED_PAGE_TSC_SHIFT);
+  }
+
+  /// @brief Read the HPET, and the TSC at very nearly the same moment.
+  ///
+  /// The TSC is read either side of the HPET, and the midpoint used, since reading the HPET is relatively slow.
+  ///
+  /// @param[out] tsc The TSC value at the moment the HPET was read.
+  ///
+  /// @param[out] window_ns Roughly how long the HPET took to read, which bounds the accuracy of the result.
+  ///
+  /// @return The HPET's value, in nanoseconds.
+  uint64_t time_read_hpet_and_tsc(uint64_t &tsc, uint64_t &window_ns)
+  {
+    uint64_t tsc_before;
+    uint64_t tsc_after;
+    uint64_t hpet;
+
+    tsc_before = asm_proc_read_tsc();
+    hpet = time_hpet_cur_value();
+    tsc_after = asm_proc_read_tsc();
+
+    tsc = tsc_before + ((tsc_after - tsc_before) / 2);
+    window_ns = (tsc_mult.load(std::memory_order_relaxed) == 0) ? 0 :
+                static_cast<uint64_t>((static_cast<unsigned __int128>(tsc_after - tsc_before) *
+                                       tsc_mult.load(std::memory_order_relaxed)) >> SHARED_PAGE_TSC_SHIFT);
+
+    return time_hpet_ticks_to_ns(hpet);
+  }
+
+  /// @brief Stop using the TSC, in both the kernel and user mode.
+  ///
+  /// The clock may step slightly when this happens, since the TSC and HPET are not exactly in step.
+  void time_abandon_tsc()
+  {
+    KL_TRC_ENTRY;
+
+    tsc_usable.store(false, std::memory_order_release);
+    proc_shared_page_clear_time();
+
+    KL_TRC_EXIT;
+  }
 }
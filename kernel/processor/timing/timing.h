@@ -21,8 +21,18 @@ void time_gen_init();
 void time_sleep_process(uint64_t wait_in_ns);
 void time_stall_process(uint64_t wait_in_ns);
 
+uint64_t time_now_ns();
+bool time_tsc_in_use();
+bool time_tsc_ticks_to_ns(uint64_t ticks, uint64_t &ns);
+
 uint64_t time_get_system_timer_count();
 uint64_t time_get_system_timer_offset(uint64_t wait_in_ns);
+uint64_t time_get_system_timer_ns();
+
+#ifndef AZALEA_TEST_CODE
+void time_ap_sync_tsc();
+void time_watchdog_tick();
+#endif
 
 const unsigned int time_task_mgr_int_period_ns = 100000;
 
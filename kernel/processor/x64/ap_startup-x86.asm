@@ -40,8 +40,9 @@ asm_ap_x86_entry:
 
   ; Enable paging
   ; (CR0.PG = 1, CR4.PAE = 1, and IA32_EFER.LME = 1)
+  ; Also set CR0.WP, for the same reason as in pre_main_32.
   mov eax, cr0
-  or eax, 0x80000000
+  or eax, 0x80010000
   mov cr0, eax
 
   mov eax, gdt_32_bit_ptr
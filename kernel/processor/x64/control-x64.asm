@@ -26,6 +26,24 @@ asm_proc_write_msr:
   wrmsr
   ret
 
+; Read the time stamp counter. It is returned as a combined 64 bit result (RAX)
+GLOBAL asm_proc_read_tsc
+asm_proc_read_tsc:
+  rdtsc
+  shl rdx, 32
+  or rax, rdx
+  ret
+
+; Read the time stamp counter and IA32_TSC_AUX together. The TSC is returned as a combined 64 bit result (RAX)
+; Parameter 1 (RDI): pointer to a 32-bit location to store the contents of IA32_TSC_AUX in.
+GLOBAL asm_proc_read_tscp
+asm_proc_read_tscp:
+  rdtscp
+  mov [rdi], ecx
+  shl rdx, 32
+  or rax, rdx
+  ret
+
 ; Read the specified processor port.
 ; Parameter 1 (RDI): port ID
 ; Parameter 2 (RSI): bits of width to use. It is assumed that the value is 8, 16 or 32. Undefined results otherwise.
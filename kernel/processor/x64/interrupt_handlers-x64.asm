@@ -11,6 +11,7 @@ EXTERN proc_page_fault_handler
 asm_proc_page_fault_handler:
     cli
     pushf
+    cld
     push rax
     push rbx
     push rcx
@@ -28,10 +28,15 @@ end_of_irq_ack_fn_wrapper:
   mov rsp, r12
 %endmacro
 
+; All of the handlers below clear the direction flag after saving the flags, since the interrupted code may have left
+; it set and the C code (in particular the string instructions used by kl_memcpy and kl_memset) assumes it is clear.
+; iretq restores the interrupted code's value.
+
 ; A default handler for interrupts. Simply calls a named function with the numerical argument given.
 %macro DEF_INT_HANDLER 2
     cli
     pushf
+    cld
     push rax
     push rbx
     push rcx
@@ -78,6 +83,7 @@ end_of_irq_ack_fn_wrapper:
 %macro DEF_ERR_CODE_INT_HANDLER 1
     cli
     pushf
+    cld
     push rax
     push rbx
     push rcx
@@ -125,6 +131,7 @@ end_of_irq_ack_fn_wrapper:
 %macro DEF_IRQ_HANDLER 2
     cli
     pushf
+    cld
     push rax
     push rbx
     push rcx
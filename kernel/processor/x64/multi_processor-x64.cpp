@@ -23,6 +23,7 @@
 #include "mem/x64/mem-x64.h"
 #include "syscall/x64/syscall_kernel-x64.h"
 #include "processor/timing/timing.h"
+#include "user_interfaces/shared_page.h"
 
 /// @brief Controls communication between source and target processors.
 enum class PROC_MP_X64_MSG_STATE
@@ -167,7 +168,7 @@ void proc_mp_init()
             trampoline_length);
 
   // Signal all of the processors to wake up. They will then suspend themselves, awaiting a RESUME IPI message.
-  wait_offset = time_get_system_timer_offset(10000000000); // How many HPET units is a 1-second wait?
+  wait_offset = time_get_system_timer_offset(10000000000); // How many timer units is a 10-second wait?
   for (int i = 0; i < processor_count; i++)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Looking at processor ", i, "\n");
@@ -176,6 +177,12 @@ void proc_mp_init()
       // This is the current processor. We know it is running.
       KL_TRC_TRACE(TRC_LVL::FLOW, "Current processor!\n");
       proc_info_block[i].processor_running = true;
+
+      if (proc_x64_rdtscp_supported())
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Store processor ID for RDTSCP\n");
+        proc_write_msr(PROC_X64_MSRS::IA32_TSC_AUX, i);
+      }
     }
     else
     {
@@ -213,6 +220,14 @@ void proc_mp_init()
     }
   }
 
+  // Every processor has now stored its ID in IA32_TSC_AUX, so user mode can use RDTSCP to find out which processor it
+  // is running on.
+  if (proc_x64_rdtscp_supported() && (processor_count <= SHARED_PAGE_MAX_CPUS))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Publish processor IDs to user mode\n");
+    proc_shared_page_enable_cpu_ids();
+  }
+
   // The APs have had their NMI handlers overwritten, ready to go. They are triggered in to life by proc_mp_start_aps()
   // Now all interrupt controllers needed for the BSP are good to go. Enable interrupts.
   asm_proc_start_interrupts();
@@ -245,6 +260,15 @@ void proc_mp_ap_startup()
   proc_load_tss(proc_mp_this_proc_id());
   proc_conf_local_int_controller();
 
+  if (proc_x64_rdtscp_supported())
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Store processor ID for RDTSCP\n");
+    proc_write_msr(PROC_X64_MSRS::IA32_TSC_AUX, proc_num);
+  }
+
+  // The kernel's clock reads the TSC of whichever processor it runs on, so make sure this one agrees with the others.
+  time_ap_sync_tsc();
+
   proc_info_block[proc_num].processor_running = true;
 
   asm_proc_start_interrupts();
@@ -6,6 +6,7 @@
 extern "C" void asm_proc_page_fault_handler();
 extern "C" void proc_page_fault_handler(uint64_t fault_code, uint64_t fault_addr, uint64_t fault_instruction);
 extern "C" void asm_task_switch_interrupt();
+extern "C" void asm_task_yield_interrupt();
 
 // IRQ handlers
 extern "C" void asm_proc_handle_irq_0();
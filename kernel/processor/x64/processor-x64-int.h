@@ -11,6 +11,8 @@ extern "C" void asm_proc_write_msr(uint64_t msr, uint64_t value);
 extern "C" uint64_t asm_proc_read_port(const uint64_t port_id, const uint8_t width);
 extern "C" void asm_proc_write_port(const uint64_t port_id, const uint64_t value, const uint8_t width);
 extern "C" void asm_proc_enable_fp_math();
+extern "C" uint64_t asm_proc_read_tsc();
+extern "C" uint64_t asm_proc_read_tscp(uint32_t *tsc_aux);
 
 // GDT Control
 #define TSS_DESC_LEN 16
@@ -42,4 +44,7 @@ extern "C" void proc_mp_ap_startup();
 // Helper functions
 void *proc_x64_allocate_stack();
 void proc_x64_deallocate_stack(void *stack_ptr);
+bool proc_x64_rdtscp_supported();
+bool proc_x64_erms_supported();
+bool proc_x64_tsc_adjust_supported();
 
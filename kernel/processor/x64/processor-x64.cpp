@@ -29,6 +29,9 @@ void proc_gen_init()
   // Enable the floating point units as well as SSE.
   asm_proc_enable_fp_math();
 
+  // Pick the fastest buffer copying and setting instructions this processor offers. Every x64 processor has rep movsq.
+  kl_mem_select_impl(proc_x64_erms_supported() ? KL_MEM_IMPL::REP_BYTE : KL_MEM_IMPL::REP_QWORD);
+
   // Set the current task to 0, since tasking isn't started yet and we don't want to accidentally believe we're running
   // a thread that doesn't exist.
   proc_write_msr(PROC_X64_MSRS::IA32_KERNEL_GS_BASE, 0);
@@ -222,4 +225,92 @@ uint64_t proc_x64_generate_msi_address(uint32_t kernel_proc_id)
   KL_TRC_EXIT;
 
   return result;
-}
\ No newline at end of file
+}
+
+/// @brief Determine whether this processor supports the RDTSCP instruction.
+///
+/// RDTSCP returns the contents of IA32_TSC_AUX alongside the TSC, which lets user mode discover which processor it is
+/// running on.
+///
+/// @return True if RDTSCP (and therefore IA32_TSC_AUX) is supported, false otherwise.
+bool proc_x64_rdtscp_supported()
+{
+  uint64_t ebx_eax;
+  uint64_t edx_ecx;
+  bool result = false;
+
+  KL_TRC_ENTRY;
+
+  asm_proc_read_cpuid(0x80000000, 0, &ebx_eax, &edx_ecx);
+  if ((ebx_eax & 0xFFFFFFFF) >= 0x80000001)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Extended feature flags available\n");
+    asm_proc_read_cpuid(0x80000001, 0, &ebx_eax, &edx_ecx);
+
+    // RDTSCP support is bit 27 of EDX, which is stored in the upper half of edx_ecx.
+    result = ((edx_ecx & (1ULL << (32 + 27))) != 0);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Determine whether this processor supports Enhanced REP MOVSB/STOSB (ERMS).
+///
+/// On processors with ERMS, rep movsb and rep stosb are the fastest way to copy or set all but the shortest buffers.
+///
+/// @return True if ERMS is supported, false otherwise.
+bool proc_x64_erms_supported()
+{
+  uint64_t ebx_eax;
+  uint64_t edx_ecx;
+  bool result = false;
+
+  KL_TRC_ENTRY;
+
+  asm_proc_read_cpuid(0, 0, &ebx_eax, &edx_ecx);
+  if ((ebx_eax & 0xFFFFFFFF) >= 7)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Structured extended feature flags available\n");
+    asm_proc_read_cpuid(7, 0, &ebx_eax, &edx_ecx);
+
+    // ERMS support is bit 9 of EBX, which is stored in the upper half of ebx_eax.
+    result = ((ebx_eax & (1ULL << (32 + 9))) != 0);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Determine whether this processor supports the IA32_TSC_ADJUST MSR.
+///
+/// Writing to IA32_TSC_ADJUST moves the TSC of the processor it is written on, without affecting any other processor.
+///
+/// @return True if IA32_TSC_ADJUST is supported, false otherwise.
+bool proc_x64_tsc_adjust_supported()
+{
+  uint64_t ebx_eax;
+  uint64_t edx_ecx;
+  bool result = false;
+
+  KL_TRC_ENTRY;
+
+  asm_proc_read_cpuid(0, 0, &ebx_eax, &edx_ecx);
+  if ((ebx_eax & 0xFFFFFFFF) >= 7)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Structured extended feature flags available\n");
+    asm_proc_read_cpuid(7, 0, &ebx_eax, &edx_ecx);
+
+    // IA32_TSC_ADJUST support is bit 1 of EBX, which is stored in the upper half of ebx_eax.
+    result = ((ebx_eax & (1ULL << (32 + 1))) != 0);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
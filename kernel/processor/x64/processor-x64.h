@@ -21,6 +21,7 @@ extern uint32_t processor_count;
 enum class PROC_X64_MSRS : uint64_t
 {
   IA32_APIC_BASE = 0x1b,
+  IA32_TSC_ADJUST = 0x3b,
   IA32_MTRRCAP = 0xfe,
   IA32_MTRR_PHYSBASE0 = 0x200,
   IA32_MTRR_PHYSMASK0 = 0x201,
@@ -41,6 +42,7 @@ enum class PROC_X64_MSRS : uint64_t
   IA32_FS_BASE = 0xC0000100,
   IA32_GS_BASE = 0xC0000101,
   IA32_KERNEL_GS_BASE = 0xC0000102,
+  IA32_TSC_AUX = 0xC0000103,
 };
 
 uint64_t proc_read_msr(PROC_X64_MSRS msr);
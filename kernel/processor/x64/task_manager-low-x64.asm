@@ -8,13 +8,32 @@ EXTERN task_int_swap_task
 EXTERN klib_synch_spinlock_lock
 EXTERN klib_synch_spinlock_unlock
 GLOBAL asm_task_switch_interrupt
+GLOBAL asm_task_yield_interrupt
 extern end_of_irq_ack_fn
 
 ; Note that throughout this code, the manipulations of the stack must match those in task_int_create_exec_context, or
 ; the process will crash as soon as it is started!
+;
+; Timer interrupts enter at asm_task_switch_interrupt, and yields at asm_task_yield_interrupt. The only difference is
+; whether task_int_swap_task is told that this is a timer tick. That flag is kept in R12 until the call, since R12 has
+; already been saved and klib_synch_spinlock_lock doesn't change it.
+;
+; As in the handlers in interrupts_defs.asm, the direction flag is cleared before calling any C code. The interrupted
+; thread's flags are saved by the processor, and restored by iretq when it next runs.
+asm_task_yield_interrupt:
+    cli
+    cld
+    push rax
+    mov rax, 0
+    jmp task_switch_common
+
 asm_task_switch_interrupt:
     cli
+    cld
     push rax
+    mov rax, 1
+
+task_switch_common:
     push rbx
     push rcx
     push rdx
@@ -30,6 +49,8 @@ asm_task_switch_interrupt:
     push r14
     push r15
 
+    mov r12, rax
+
     mov rdi, task_switch_lock
     call klib_synch_spinlock_lock
 
@@ -44,6 +65,9 @@ asm_task_switch_interrupt:
     ; Save the stack pointer as a parameter for task_int_swap_task.
     mov rdi, rsp
 
+    ; Is this a timer tick?
+    mov rdx, r12
+
     ; Execute the task swap.
     call task_int_swap_task
 
@@ -10,6 +10,8 @@
 
 #include "processor/processor.h"
 #include "processor/processor-int.h"
+#include "processor/profiler.h"
+#include "processor/timing/timing.h"
 #include "processor/x64/processor-x64.h"
 #include "processor/x64/processor-x64-int.h"
 #include "processor/x64/proc_interrupt_handlers-x64.h"
@@ -29,6 +31,10 @@ namespace
   // Setting one const equal to another of a different size seems to confuse the linker...!
   const uint32_t TM_INTERRUPT_NUM = 32; //(const uint32_t) PROC_IRQ_BASE;
 
+  // Yields use a different vector to the timer, so that the task switcher can tell them apart. It is above the IRQs
+  // and the block given out by proc_request_interrupt_block(), and below the APIC's spurious interrupt vector.
+  const uint32_t TM_YIELD_INTERRUPT_NUM = 126;
+
   const uint64_t DEF_USER_MODE_STACK_PAGE = 0x000000000F000000;
 
   void *task_int_allocate_user_mode_stack(task_process *proc);
@@ -97,7 +103,7 @@ void *task_int_create_exec_context(ENTRY_PROC entry_point, task_thread *new_thre
   new_context->syscall_stack = proc_x64_allocate_stack();
   new_context->orig_syscall_stack = new_context->syscall_stack;
 
-  if (parent_process->kernel_mode)
+  if (new_thread->kernel_mode)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Creating kernel mode context\n");
     //new_context->saved_stack.flags = DEF_RFLAGS_KERNEL;
@@ -222,8 +228,8 @@ void task_set_start_params(task_process *process, uint64_t argc, char **argv, ch
 
 /// @brief Main task switcher
 ///
-/// task_int_swap_task() is called by the timer interrupt. It saves the execution context of the thread currently
-/// executing, selects the next one and provides the new execution context to the caller.
+/// task_int_swap_task() is called by the timer interrupt, and when a thread yields. It saves the execution context of
+/// the thread currently executing, selects the next one and provides the new execution context to the caller.
 ///
 /// The action of choosing the next thread to execute is not platform specific, it is provided by generic code in
 /// #task_get_next_thread.
@@ -232,18 +238,38 @@ void task_set_start_params(task_process *process, uint64_t argc, char **argv, ch
 ///
 /// @param cr3_value The value of CR3 used by the suspended thread
 ///
+/// @param timer_tick True if this was called by the timer interrupt, false if the thread yielded.
+///
 /// @return The execution context for the caller to begin executing.
-task_x64_exec_context *task_int_swap_task(uint64_t stack_addr, uint64_t cr3_value)
+task_x64_exec_context *task_int_swap_task(uint64_t stack_addr, uint64_t cr3_value, bool timer_tick)
 {
   task_thread *current_thread;
   task_x64_exec_context *current_context;
   task_x64_exec_context *next_context;
   task_thread *next_thread;
   void *stack_ptr = reinterpret_cast<void *>(stack_addr);
+  task_x64_saved_stack *saved_stack = reinterpret_cast<task_x64_saved_stack *>(stack_addr);
+  uint64_t stack_page_end;
 
   KL_TRC_ENTRY;
 
   current_thread = task_get_cur_thread();
+
+  // Let the profiler sample the interrupted code before switching away from it. Yields aren't sampled, since they
+  // happen at times chosen by the code rather than at regular intervals. Only kernel mode stacks are followed, and
+  // kernel stacks are always mapped, so the backtrace can safely read from the stack pointer to the end of its page.
+  // Frames beyond it are simply not recorded.
+  if (timer_tick)
+  {
+    stack_page_end = saved_stack->proc_rsp - (saved_stack->proc_rsp % MEM_PAGE_SIZE) + MEM_PAGE_SIZE;
+    prof_timer_tick(saved_stack->proc_rip,
+                    saved_stack->rbp,
+                    saved_stack->proc_rsp,
+                    stack_page_end,
+                    ((saved_stack->proc_cs & 3) != 0),
+                    current_thread);
+  }
+
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Current: ", current_thread, " (", stack_ptr, ")\n");
   if (current_thread != nullptr)
   {
@@ -283,9 +309,12 @@ task_x64_exec_context *task_int_swap_task(uint64_t stack_addr, uint64_t cr3_valu
   proc_write_msr(PROC_X64_MSRS::IA32_GS_BASE, next_context->gs_base);
 
   // Only processor 0 directly receives timer interrupts. In order to trigger scheduling on all other processors, send
-  // them an IPI for the correct vector.
-  if (proc_mp_this_proc_id() == 0)
+  // them an IPI for the correct vector. A yield on processor 0 is not a timer tick, so it doesn't do this.
+  if (timer_tick && (proc_mp_this_proc_id() == 0))
   {
+    // Processor 0 is also the one that keeps an eye on the TSC clock.
+    time_watchdog_tick();
+
     KL_TRC_TRACE(TRC_LVL::FLOW, "Sending broadcast IPI\n");
     proc_send_ipi(0, PROC_IPI_SHORT_TARGET::ALL_EXCL_SELF, PROC_IPI_INTERRUPT::FIXED, TM_INTERRUPT_NUM, false);
   }
@@ -307,6 +336,8 @@ void task_install_task_switcher()
   KL_TRC_ENTRY;
 
   proc_configure_idt_entry(TM_INTERRUPT_NUM, 0, (void *)asm_task_switch_interrupt, 2);
+  proc_configure_idt_entry(TM_YIELD_INTERRUPT_NUM, 0, (void *)asm_task_yield_interrupt, 2);
+  proc_interrupt_data_table[TM_YIELD_INTERRUPT_NUM].reserved = true;
   asm_proc_install_idt();
 
   KL_TRC_EXIT;
@@ -331,7 +362,7 @@ void task_yield()
 
   // Signal ourselves with a task-switching interrupt and that'll allow the task manager to select a new thread to run
   // (which might be this one)
-  proc_send_ipi(0, PROC_IPI_SHORT_TARGET::SELF, PROC_IPI_INTERRUPT::FIXED, TM_INTERRUPT_NUM, true);
+  proc_send_ipi(0, PROC_IPI_SHORT_TARGET::SELF, PROC_IPI_INTERRUPT::FIXED, TM_YIELD_INTERRUPT_NUM, true);
 
   KL_TRC_EXIT;
 }
@@ -0,0 +1,618 @@
+/// @file
+/// @brief Kernel side of the asynchronous I/O rings.
+///
+/// Each request is taken from the submission queue under the ring lock, carried out without the lock held, and then
+/// its result is posted to the completion queue under the lock again. A completion queue entry is reserved before a
+/// request is taken, so a request is never carried out unless there is space for its result. That way, a process that
+/// stops reaping completions simply stops its requests being processed.
+///
+/// Worker threads with nothing to do sleep in a list belonging to the ring. They are woken by enter(), which a process
+/// must call after adding requests to the submission queue.
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "syscall/io_ring.h"
+#include "syscall/syscall_kernel-int.h"
+#include "processor/processor.h"
+#include "system_tree/system_tree.h"
+#include "system_tree/fs/fs_file_interface.h"
+
+#include <atomic>
+
+/// @brief Construct a new I/O ring object.
+///
+/// Use io_ring::create() instead.
+///
+/// @param ring The ring memory, which must already have been validated.
+///
+/// @param entries The number of entries in each queue. Must be a power of two.
+///
+/// @param owner The thread that created the ring. Requests use the handles of its process.
+io_ring::io_ring(io_ring_header *ring, uint32_t entries, std::shared_ptr<task_thread> owner) :
+  _ring(ring),
+  _entries(entries),
+  _sq_head(0),
+  _cq_tail(0),
+  _cq_reserved(0),
+  _owner(owner),
+  _shutting_down(false)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(ring != nullptr);
+  ASSERT(owner != nullptr);
+  ASSERT((entries != 0) && ((entries & (entries - 1)) == 0));
+
+  klib_list_initialize(&this->_workers);
+  klib_list_initialize(&this->_idle_workers);
+  klib_list_initialize(&this->_completion_waiters);
+  klib_synch_spinlock_init(this->_ring_lock);
+
+  this->_ring->sq_head = 0;
+  this->_ring->sq_tail = 0;
+  this->_ring->cq_head = 0;
+  this->_ring->cq_tail = 0;
+  this->_ring->entries = entries;
+  this->_ring->reserved = 0;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Create a new I/O ring, and its worker threads.
+///
+/// The ring is not attached to the owner's process by this function. The worker threads are created but not started,
+/// since they find their ring through the process.
+///
+/// @param ring The ring memory, which must already have been validated.
+///
+/// @param entries The number of entries in each queue. Must be a power of two.
+///
+/// @param num_workers The number of worker threads to create. If zero, requests are carried out by enter().
+///
+/// @param owner The thread that created the ring. Requests use the handles of its process.
+///
+/// @return The new ring.
+std::shared_ptr<io_ring> io_ring::create(io_ring_header *ring,
+                                         uint32_t entries,
+                                         uint32_t num_workers,
+                                         std::shared_ptr<task_thread> owner)
+{
+  std::shared_ptr<io_ring> new_ring;
+  klib_list_item<std::shared_ptr<task_thread>> *worker_item;
+
+  KL_TRC_ENTRY;
+
+  new_ring = std::shared_ptr<io_ring>(new io_ring(ring, entries, owner));
+
+  for (uint32_t i = 0; i < num_workers; i++)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Create worker ", i, "\n");
+    worker_item = new klib_list_item<std::shared_ptr<task_thread>>();
+    klib_list_item_initialize(worker_item);
+    worker_item->item = task_thread::create(io_ring_worker_thread, owner->parent_process, true);
+    klib_list_add_tail(&new_ring->_workers, worker_item);
+  }
+
+  KL_TRC_EXIT;
+
+  return new_ring;
+}
+
+/// @brief Start the ring's worker threads.
+///
+/// The ring must have been attached to the owner's process first.
+void io_ring::start_workers()
+{
+  klib_list_item<std::shared_ptr<task_thread>> *worker_item;
+
+  KL_TRC_ENTRY;
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+
+  ASSERT(this->_owner != nullptr);
+  ASSERT(this->_owner->parent_process->io_ring_obj.get() == this);
+
+  for (worker_item = this->_workers.head; worker_item != nullptr; worker_item = worker_item->next)
+  {
+    worker_item->item->start_thread();
+  }
+
+  klib_synch_spinlock_unlock(this->_ring_lock);
+
+  KL_TRC_EXIT;
+}
+
+io_ring::~io_ring()
+{
+  KL_TRC_ENTRY;
+
+  this->shutdown();
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Tell the kernel about new requests, and optionally wait for completions.
+///
+/// If the ring has worker threads, enough idle workers are woken to service the new requests. Otherwise, the requests
+/// are carried out by the calling thread before this function returns.
+///
+/// @param min_complete If the ring has worker threads, wait until at least this many completions are waiting to be
+///                     read by the process. Ignored if the ring has no worker threads, since all requests that can be
+///                     carried out already have been.
+void io_ring::enter(uint64_t min_complete)
+{
+  uint32_t to_wake;
+
+  KL_TRC_ENTRY;
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+
+  if (this->_workers.head == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No workers, process requests on this thread\n");
+    klib_synch_spinlock_unlock(this->_ring_lock);
+    while (this->process_one_request())
+    {
+      // Nothing else to do.
+    }
+  }
+  else
+  {
+    to_wake = this->no_lock_pending_requests();
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Wake up to ", to_wake, " workers\n");
+    while ((to_wake > 0) && this->wake_first(this->_idle_workers))
+    {
+      to_wake--;
+    }
+
+    if (min_complete > this->_entries)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Can't wait for more completions than there are entries\n");
+      min_complete = this->_entries;
+    }
+
+    while (!this->_shutting_down && (this->no_lock_completions_ready() < min_complete))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Wait for completions\n");
+      this->wait_on_list(this->_completion_waiters);
+    }
+
+    klib_synch_spinlock_unlock(this->_ring_lock);
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Stop servicing the ring.
+///
+/// Any threads waiting for the ring are woken. Worker threads return from worker_loop() once they have finished their
+/// current request. The ring releases its references to its workers and owner, so that they can be destroyed.
+void io_ring::shutdown()
+{
+  klib_list_item<std::shared_ptr<task_thread>> *worker_item;
+
+  KL_TRC_ENTRY;
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+
+  this->_shutting_down = true;
+  this->wake_all(this->_idle_workers);
+  this->wake_all(this->_completion_waiters);
+
+  while (this->_workers.head != nullptr)
+  {
+    worker_item = this->_workers.head;
+    klib_list_remove(worker_item);
+    worker_item->item = nullptr;
+    delete worker_item;
+  }
+
+  this->_owner = nullptr;
+
+  klib_synch_spinlock_unlock(this->_ring_lock);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Take one request from the submission queue, carry it out and post the result.
+///
+/// @return True if a request was processed, false if there were no requests, no space for a result, or the ring is
+///         shutting down.
+bool io_ring::process_one_request()
+{
+  bool result = false;
+  io_ring_sqe request;
+  io_ring_cqe completion;
+  io_ring_cqe *cq;
+
+  KL_TRC_ENTRY;
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+
+  if (this->no_lock_request_ready())
+  {
+    // Make sure the request is read after the tail that says it is there.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    request = io_ring_sq(this->_ring)[this->_sq_head & (this->_entries - 1)];
+    this->_sq_head++;
+    this->_ring->sq_head = this->_sq_head;
+    this->_cq_reserved++;
+    result = true;
+  }
+
+  klib_synch_spinlock_unlock(this->_ring_lock);
+
+  if (result)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Carry out request with user data ", request.user_data, "\n");
+    this->execute_request(request, completion);
+
+    klib_synch_spinlock_lock(this->_ring_lock);
+
+    // Don't use io_ring_cq(), since the process might have changed the number of entries given in the ring.
+    cq = reinterpret_cast<io_ring_cqe *>(io_ring_sq(this->_ring) + this->_entries);
+    cq[this->_cq_tail & (this->_entries - 1)] = completion;
+    this->_cq_tail++;
+    this->_cq_reserved--;
+
+    // Make sure the completion is visible before the process can see the new tail.
+    std::atomic_thread_fence(std::memory_order_release);
+    this->_ring->cq_tail = this->_cq_tail;
+
+    this->wake_all(this->_completion_waiters);
+
+    klib_synch_spinlock_unlock(this->_ring_lock);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief The main loop of a worker thread.
+///
+/// Processes requests until there are none left, then sleeps until woken by enter(). Returns once the ring has been
+/// shut down.
+void io_ring::worker_loop()
+{
+  KL_TRC_ENTRY;
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+
+  while (!this->_shutting_down)
+  {
+    klib_synch_spinlock_unlock(this->_ring_lock);
+    while (this->process_one_request())
+    {
+      // Keep going until the submission queue is empty.
+    }
+    klib_synch_spinlock_lock(this->_ring_lock);
+
+    if (!this->_shutting_down && !this->no_lock_request_ready())
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Nothing to do, sleep\n");
+      this->wait_on_list(this->_idle_workers);
+    }
+  }
+
+  klib_synch_spinlock_unlock(this->_ring_lock);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Carry out a single request.
+///
+/// Parameters are checked in the same way as by the equivalent system calls.
+///
+/// @param request A copy of the request, taken from the submission queue.
+///
+/// @param[out] completion The result of the request.
+void io_ring::execute_request(const io_ring_sqe &request, io_ring_cqe &completion)
+{
+  std::shared_ptr<task_thread> owner;
+  std::shared_ptr<IHandledObject> obj;
+  object_data handle_data;
+  object_manager *handles;
+  std::shared_ptr<ISystemTreeLeaf> leaf;
+  std::unique_ptr<char[]> path;
+
+  KL_TRC_ENTRY;
+
+  completion.user_data = request.user_data;
+  completion.result = ERR_CODE::NO_ERROR;
+  completion.value = 0;
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+  owner = this->_owner;
+  klib_synch_spinlock_unlock(this->_ring_lock);
+
+  if (owner == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Ring shut down\n");
+    completion.result = ERR_CODE::INVALID_OP;
+  }
+  else if ((request.opcode == static_cast<uint64_t>(IO_RING_OP::READ)) ||
+           (request.opcode == static_cast<uint64_t>(IO_RING_OP::WRITE)) ||
+           (request.opcode == static_cast<uint64_t>(IO_RING_OP::OPEN)))
+  {
+    if ((request.buffer == nullptr) ||
+        (request.length == 0) ||
+        !SYSCALL_IS_UM_ADDRESS(request.buffer) ||
+        !SYSCALL_IS_UM_ADDRESS(reinterpret_cast<uint64_t>(request.buffer) + request.length))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid buffer\n");
+      completion.result = ERR_CODE::INVALID_PARAM;
+    }
+  }
+
+  if (completion.result == ERR_CODE::NO_ERROR)
+  {
+    handles = &owner->parent_process->proc_handles;
+
+    switch (request.opcode)
+    {
+    case static_cast<uint64_t>(IO_RING_OP::NOP):
+      KL_TRC_TRACE(TRC_LVL::FLOW, "No-op\n");
+      break;
+
+    case static_cast<uint64_t>(IO_RING_OP::READ):
+      if (!handles->retrieve_object_data(request.handle, handle_data) || (handle_data.readable == nullptr))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Not a readable object\n");
+        completion.result = ERR_CODE::INVALID_OP;
+      }
+      else
+      {
+        completion.result = handle_data.readable->read_bytes(request.offset,
+                                                             request.length,
+                                                             reinterpret_cast<uint8_t *>(request.buffer),
+                                                             request.length,
+                                                             completion.value);
+      }
+      break;
+
+    case static_cast<uint64_t>(IO_RING_OP::WRITE):
+      if (!handles->retrieve_object_data(request.handle, handle_data) || (handle_data.writable == nullptr))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Not a writable object\n");
+        completion.result = ERR_CODE::INVALID_OP;
+      }
+      else
+      {
+        completion.result = handle_data.writable->write_bytes(request.offset,
+                                                              request.length,
+                                                              reinterpret_cast<const uint8_t *>(request.buffer),
+                                                              request.length,
+                                                              completion.value);
+      }
+      break;
+
+    case static_cast<uint64_t>(IO_RING_OP::OPEN):
+      path = std::make_unique<char[]>(request.length + 1);
+      kl_memcpy(request.buffer, path.get(), request.length);
+      path[request.length] = 0;
+      completion.result = system_tree()->get_child(kl_string_view(path.get()), leaf);
+      if (completion.result == ERR_CODE::NO_ERROR)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Opened leaf ", leaf.get(), "\n");
+        completion.value = handles->store_object(leaf);
+      }
+      break;
+
+    case static_cast<uint64_t>(IO_RING_OP::CLOSE):
+      obj = handles->retrieve_object(request.handle);
+      if (obj == nullptr)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Handle not found\n");
+        completion.result = ERR_CODE::NOT_FOUND;
+      }
+      else
+      {
+        handles->remove_object(request.handle);
+      }
+      break;
+
+    case static_cast<uint64_t>(IO_RING_OP::WAIT):
+      if (!handles->retrieve_object_data(request.handle, handle_data) || (handle_data.wait_obj == nullptr))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Not a wait object\n");
+        completion.result = ERR_CODE::INVALID_OP;
+      }
+      else
+      {
+        handle_data.wait_obj->wait_for_signal();
+      }
+      break;
+
+    default:
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown operation: ", request.opcode, "\n");
+      completion.result = ERR_CODE::INVALID_PARAM;
+      break;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", completion.result, "\n");
+  KL_TRC_EXIT;
+}
+
+/// @brief How many requests has the process submitted that the kernel has not yet taken?
+///
+/// The ring lock must be held by the caller.
+///
+/// @return The number of requests waiting. If the process has set the tail to something nonsensical, the requests are
+///         ignored until it is corrected.
+uint32_t io_ring::no_lock_pending_requests()
+{
+  uint32_t result;
+
+  KL_TRC_ENTRY;
+
+  result = this->_ring->sq_tail - this->_sq_head;
+  if (result > this->_entries)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid submission queue tail\n");
+    result = 0;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Can a request be taken from the submission queue now?
+///
+/// The ring lock must be held by the caller.
+///
+/// @return True if there is a request waiting and space to post its result.
+bool io_ring::no_lock_request_ready()
+{
+  bool result;
+  uint32_t cq_used;
+
+  KL_TRC_ENTRY;
+
+  cq_used = (this->_cq_tail + this->_cq_reserved) - this->_ring->cq_head;
+  result = !this->_shutting_down && (this->no_lock_pending_requests() != 0) && (cq_used < this->_entries);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief How many completions are waiting for the process to read them?
+///
+/// The ring lock must be held by the caller.
+///
+/// @return The number of completions waiting.
+uint32_t io_ring::no_lock_completions_ready()
+{
+  uint32_t result;
+
+  KL_TRC_ENTRY;
+
+  result = this->_cq_tail - this->_ring->cq_head;
+  if (result > this->_entries)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid completion queue head\n");
+    result = 0;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Sleep the current thread until it is woken from a wait list.
+///
+/// The ring lock must be held by the caller. It is released while the thread sleeps, and held again on return.
+///
+/// @param wait_list The list to wait in.
+void io_ring::wait_on_list(klib_list<kl_ref_ptr<task_thread>> &wait_list)
+{
+  KL_TRC_ENTRY;
+
+  task_thread *this_thread = task_get_cur_thread();
+  ASSERT(this_thread != nullptr);
+  ASSERT(!klib_list_item_is_in_any_list(this_thread->synch_list_item));
+
+  klib_list_add_tail(&wait_list, this_thread->synch_list_item);
+
+  // Don't allow this thread to be descheduled between stopping it and releasing the lock, since that would deadlock
+  // anyone trying to wake us.
+  task_continue_this_thread();
+  this_thread->stop_thread();
+  klib_synch_spinlock_unlock(this->_ring_lock);
+
+  task_resume_scheduling();
+  task_yield();
+
+  klib_synch_spinlock_lock(this->_ring_lock);
+
+  if (klib_list_item_is_in_any_list(this_thread->synch_list_item))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Woken without being signalled\n");
+    klib_list_remove(this_thread->synch_list_item);
+    this_thread->start_thread();
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Wake the first thread waiting in a list, if there is one.
+///
+/// The ring lock must be held by the caller.
+///
+/// @param wait_list The list to wake a thread from.
+///
+/// @return True if a thread was woken, false if the list was empty.
+bool io_ring::wake_first(klib_list<kl_ref_ptr<task_thread>> &wait_list)
+{
+  KL_TRC_ENTRY;
+
+  klib_list_item<kl_ref_ptr<task_thread>> *item = wait_list.head;
+  bool result = false;
+
+  if (item != nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Waking thread ", item->item.get(), "\n");
+    klib_list_remove(item);
+    item->item->start_thread();
+    result = true;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Wake all threads waiting in a list.
+///
+/// The ring lock must be held by the caller.
+///
+/// @param wait_list The list to wake threads from.
+void io_ring::wake_all(klib_list<kl_ref_ptr<task_thread>> &wait_list)
+{
+  KL_TRC_ENTRY;
+
+  while (this->wake_first(wait_list))
+  {
+    // Keep going until the list is empty.
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief The entry point of I/O ring worker threads.
+///
+/// Workers find their ring through their process, so the ring must be attached to the process before the workers are
+/// started.
+///
+/// Workers don't keep a reference to their ring. A process destroys its workers without them returning from
+/// worker_loop(), so a reference held here would never be released. The ring is owned by the process's io_ring_obj,
+/// which the process only releases after destroying the workers.
+void io_ring_worker_thread()
+{
+  KL_TRC_ENTRY;
+
+  task_thread *this_thread = task_get_cur_thread();
+  io_ring *ring;
+
+  ASSERT(this_thread != nullptr);
+  ring = this_thread->parent_process->io_ring_obj.get();
+
+  if (ring != nullptr)
+  {
+    ring->worker_loop();
+  }
+
+  KL_TRC_TRACE(TRC_LVL::FLOW, "Worker finished\n");
+  this_thread->destroy_thread();
+
+  KL_TRC_EXIT;
+}
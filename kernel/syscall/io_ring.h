@@ -0,0 +1,90 @@
+/// @file
+/// @brief Kernel side of the asynchronous I/O rings.
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+#include "user_interfaces/io_ring.h"
+#include "klib/data_structures/lists.h"
+#include "klib/synch/kernel_locks.h"
+#include "object_mgr/handled_obj.h"
+
+class task_thread;
+class task_process;
+
+/// @brief Services the submission and completion rings of a single process.
+///
+/// The ring memory belongs to the process, and the requests in it are carried out against the handles of the process.
+/// Requests are carried out by kernel mode worker threads that run within the process, so that they can use the
+/// buffers given in the requests directly. If the ring has no workers, requests are carried out by the thread calling
+/// enter() instead.
+///
+/// For more information about the layout of the ring, see user_interfaces/io_ring.h.
+class io_ring : public IHandledObject
+{
+protected:
+  io_ring(io_ring_header *ring, uint32_t entries, std::shared_ptr<task_thread> owner);
+
+public:
+  static std::shared_ptr<io_ring> create(io_ring_header *ring,
+                                         uint32_t entries,
+                                         uint32_t num_workers,
+                                         std::shared_ptr<task_thread> owner);
+  virtual ~io_ring();
+
+  void start_workers();
+  void enter(uint64_t min_complete);
+  void shutdown();
+
+  bool process_one_request();
+  void worker_loop();
+
+protected:
+  void execute_request(const io_ring_sqe &request, io_ring_cqe &completion);
+
+  uint32_t no_lock_pending_requests();
+  bool no_lock_request_ready();
+  uint32_t no_lock_completions_ready();
+
+  void wait_on_list(klib_list<kl_ref_ptr<task_thread>> &wait_list);
+  bool wake_first(klib_list<kl_ref_ptr<task_thread>> &wait_list);
+  void wake_all(klib_list<kl_ref_ptr<task_thread>> &wait_list);
+
+  /// The ring memory, in the owning process's address space.
+  io_ring_header *_ring;
+
+  /// The number of entries in each queue.
+  uint32_t _entries;
+
+  /// The kernel's copy of the submission queue head. The copy in the ring is only written, never read, so that the
+  /// process can't confuse the kernel by changing it.
+  uint32_t _sq_head;
+
+  /// The kernel's copy of the completion queue tail.
+  uint32_t _cq_tail;
+
+  /// The number of completion queue entries reserved for requests that are being carried out.
+  uint32_t _cq_reserved;
+
+  /// The thread that created the ring. Requests use the handles of its process.
+  std::shared_ptr<task_thread> _owner;
+
+  /// The worker threads servicing this ring.
+  klib_list<std::shared_ptr<task_thread>> _workers;
+
+  /// Worker threads waiting for new requests.
+  klib_list<kl_ref_ptr<task_thread>> _idle_workers;
+
+  /// Threads waiting in enter() for completions to be posted.
+  klib_list<kl_ref_ptr<task_thread>> _completion_waiters;
+
+  /// Has shutdown() been called?
+  bool _shutting_down;
+
+  /// Protects all of the fields above, and the kernel's use of the ring memory.
+  kernel_spinlock _ring_lock;
+};
+
+void io_ring_worker_thread();
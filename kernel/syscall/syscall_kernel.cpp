@@ -9,6 +9,7 @@
 #include "system_tree/system_tree.h"
 #include "system_tree/fs/fs_file_interface.h"
 #include "object_mgr/object_mgr.h"
+#include "syscall/io_ring.h"
 #include "processor/x64/processor-x64.h"
 
 #include <memory>
@@ -61,10 +62,29 @@ const void *syscall_pointers[] =
       (void *)syscall_create_obj_and_handle,
       (void *)syscall_set_handle_data_len,
       (void *)syscall_set_startup_params,
+      (void *)syscall_receive_message_details_wait,
+      (void *)syscall_call_process,
+      (void *)syscall_receive_call,
+      (void *)syscall_reply_call,
+      (void *)syscall_reply_and_receive_call,
+      (void *)syscall_join_broadcast_group,
+      (void *)syscall_leave_broadcast_group,
+      (void *)syscall_broadcast_message,
+      (void *)syscall_receive_message_batch,
+      (void *)syscall_get_system_clock,
+      (void *)syscall_read_handle_vec,
+      (void *)syscall_write_handle_vec,
+      (void *)syscall_io_ring_create,
+      (void *)syscall_io_ring_enter,
+      (void *)syscall_batch,
+      (void *)syscall_spawn_process,
     };
 
 const uint64_t syscall_max_idx = (sizeof(syscall_pointers) / sizeof(void *)) - 1;
 
+static_assert((sizeof(syscall_pointers) / sizeof(void *)) == SYSCALL_IDX_COUNT,
+              "SYSCALL_IDX_COUNT must match the number of system calls");
+
 bool syscall_is_um_address(const void *addr)
 {
   uint64_t addr_l = reinterpret_cast<uint64_t>(addr);
@@ -159,14 +179,13 @@ ERR_CODE syscall_open_handle(const char *path, uint64_t path_len, GEN_HANDLE *ha
     std::unique_ptr<char[]> buf = std::make_unique<char[]>(path_len + 1);
     kl_memcpy(path, buf.get(), path_len);
     buf[path_len] = 0;
-    kl_string str_path(path);
-    result = system_tree()->get_child(str_path, leaf);
+    result = system_tree()->get_child(kl_string_view(buf.get()), leaf);
 
     if (result == ERR_CODE::NO_ERROR)
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Successfully got leaf object: ", leaf.get(), "\n");
       std::shared_ptr<IHandledObject> leaf_ptr = std::shared_ptr<IHandledObject>(leaf);
-      new_handle = cur_thread->thread_handles.store_object(leaf_ptr);
+      new_handle = cur_thread->parent_process->proc_handles.store_object(leaf_ptr);
       *handle = new_handle;
 
       KL_TRC_TRACE(TRC_LVL::EXTRA, "Correlated to handle ", new_handle, "\n");
@@ -205,7 +224,7 @@ ERR_CODE syscall_close_handle(GEN_HANDLE handle)
   }
   else
   {
-    obj = cur_thread->thread_handles.retrieve_object(handle);
+    obj = cur_thread->parent_process->proc_handles.retrieve_object(handle);
     if (obj == nullptr)
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Object not found!\n");
@@ -216,7 +235,7 @@ ERR_CODE syscall_close_handle(GEN_HANDLE handle)
       KL_TRC_TRACE(TRC_LVL::FLOW, "Found object: ", obj.get(), " - destroying\n");
 
       // Don't delete the object, let the reference counting mechanism take care of it as needed.
-      cur_thread->thread_handles.remove_object(handle);
+      cur_thread->parent_process->proc_handles.remove_object(handle);
       obj = nullptr;
 
       result = ERR_CODE::NO_ERROR;
@@ -287,17 +306,15 @@ ERR_CODE syscall_read_handle(GEN_HANDLE handle,
   else
   {
     // Parameters check out, try to read.
-    std::shared_ptr<IHandledObject> leaf_ptr = cur_thread->thread_handles.retrieve_object(handle);
-    std::shared_ptr<IReadable> file = std::dynamic_pointer_cast<IReadable>(leaf_ptr);
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Retrieved leaf ", leaf_ptr.get(), " from OM\n");
-    if (leaf_ptr == nullptr)
+    object_data handle_data;
+    if (!cur_thread->parent_process->proc_handles.retrieve_object_data(handle, handle_data))
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf object not found - bad handle\n");
       result = ERR_CODE::INVALID_PARAM;
     }
     else
     {
-      if (file == nullptr)
+      if (handle_data.readable == nullptr)
       {
         KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf is not a file, so can't be read.\n");
         result = ERR_CODE::INVALID_OP;
@@ -309,8 +326,8 @@ ERR_CODE syscall_read_handle(GEN_HANDLE handle,
           KL_TRC_TRACE(TRC_LVL::FLOW, "Trimming bytes_to_read to max buffer length\n");
           bytes_to_read = buffer_size;
         }
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Going to attempt a read on file: ", file.get(), "\n");
-        result = file->read_bytes(start_offset, bytes_to_read, buffer, buffer_size, *bytes_read);
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Going to attempt a read on file: ", handle_data.readable, "\n");
+        result = handle_data.readable->read_bytes(start_offset, bytes_to_read, buffer, buffer_size, *bytes_read);
 
         KL_TRC_TRACE(TRC_LVL::FLOW, "bytes read: ", *bytes_read, "\n");
       }
@@ -355,7 +372,7 @@ ERR_CODE syscall_get_handle_data_len(GEN_HANDLE handle, uint64_t *data_length)
   else
   {
     std::shared_ptr<ISystemTreeLeaf> leaf =
-      std::dynamic_pointer_cast<ISystemTreeLeaf>(cur_thread->thread_handles.retrieve_object(handle));
+      std::dynamic_pointer_cast<ISystemTreeLeaf>(cur_thread->parent_process->proc_handles.retrieve_object(handle));
     KL_TRC_TRACE(TRC_LVL::FLOW, "Retrieved leaf ", leaf.get(), " from OM\n");
     if (leaf == nullptr)
     {
@@ -441,19 +458,16 @@ ERR_CODE syscall_write_handle(GEN_HANDLE handle,
   }
   else
   {
-    // Parameters check out, try to read.
-    std::shared_ptr<ISystemTreeLeaf> leaf =
-      std::dynamic_pointer_cast<ISystemTreeLeaf>(cur_thread->thread_handles.retrieve_object(handle));
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Retrieved leaf ", leaf.get(), " from OM\n");
-    if (leaf == nullptr)
+    // Parameters check out, try to write.
+    object_data handle_data;
+    if (!cur_thread->parent_process->proc_handles.retrieve_object_data(handle, handle_data))
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf object not found - bad handle\n");
       result = ERR_CODE::NOT_FOUND;
     }
     else
     {
-      std::shared_ptr<IWritable> file = std::dynamic_pointer_cast<IWritable>(leaf);
-      if (file == nullptr)
+      if (handle_data.writable == nullptr)
       {
         KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf is not writable.\n");
         result = ERR_CODE::INVALID_OP;
@@ -465,8 +479,8 @@ ERR_CODE syscall_write_handle(GEN_HANDLE handle,
           KL_TRC_TRACE(TRC_LVL::FLOW, "Trimming bytes_to_write to max buffer length\n");
           bytes_to_write = buffer_size;
         }
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Going to attempt a write on file: ", file.get(), "\n");
-        result = file->write_bytes(start_offset, bytes_to_write, buffer, buffer_size, *bytes_written);
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Going to attempt a write on file: ", handle_data.writable, "\n");
+        result = handle_data.writable->write_bytes(start_offset, bytes_to_write, buffer, buffer_size, *bytes_written);
 
         KL_TRC_TRACE(TRC_LVL::FLOW, "bytes written: ", *bytes_written, "\n");
       }
@@ -479,6 +493,507 @@ ERR_CODE syscall_write_handle(GEN_HANDLE handle,
   return result;
 }
 
+namespace
+{
+  /// @brief Validate an array of I/O vectors passed by a user mode process, and copy it into the kernel.
+  ///
+  /// Taking a copy prevents the process changing the vectors after they have been checked.
+  ///
+  /// @param vectors The user mode array of vectors.
+  ///
+  /// @param num_vectors The number of vectors in the array. Must be between 1 and IO_MAX_VECTORS.
+  ///
+  /// @param[out] k_vectors Kernel array to copy the vectors into. Must have space for IO_MAX_VECTORS entries.
+  ///
+  /// @return True if the vectors are valid and have been copied, false otherwise.
+  bool syscall_copy_io_vectors(const io_vector *vectors, uint64_t num_vectors, io_vector *k_vectors)
+  {
+    bool result = true;
+    uint64_t total_length;
+    uint64_t vectors_addr = reinterpret_cast<uint64_t>(vectors);
+    uint64_t vectors_end;
+    uint64_t buffer_addr;
+    uint64_t buffer_end;
+
+    KL_TRC_ENTRY;
+
+    // As in syscall_batch(), the size of the array can't overflow if num_vectors is in range, but its end might.
+    vectors_end = vectors_addr + ((num_vectors <= IO_MAX_VECTORS) ? num_vectors * sizeof(io_vector) : 0);
+
+    if ((vectors == nullptr) ||
+        !SYSCALL_IS_UM_ADDRESS(vectors) ||
+        (num_vectors == 0) ||
+        (num_vectors > IO_MAX_VECTORS) ||
+        (vectors_end < vectors_addr) ||
+        !SYSCALL_IS_UM_ADDRESS(vectors_end - 1))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Vector array is invalid\n");
+      result = false;
+    }
+    else
+    {
+      kl_memcpy(vectors, k_vectors, num_vectors * sizeof(io_vector));
+
+      // Each buffer must be entirely in user space, since the whole of it may be read or written.
+      for (uint64_t i = 0; i < num_vectors; i++)
+      {
+        buffer_addr = reinterpret_cast<uint64_t>(k_vectors[i].buffer);
+        buffer_end = buffer_addr + k_vectors[i].length;
+
+        if ((k_vectors[i].length != 0) &&
+            ((k_vectors[i].buffer == nullptr) ||
+             !SYSCALL_IS_UM_ADDRESS(k_vectors[i].buffer) ||
+             (buffer_end < buffer_addr) ||
+             !SYSCALL_IS_UM_ADDRESS(buffer_end - 1)))
+        {
+          KL_TRC_TRACE(TRC_LVL::FLOW, "Buffer ", i, " is invalid\n");
+          result = false;
+          break;
+        }
+      }
+
+      if (result && !fs_io_vectors_valid(k_vectors, num_vectors, total_length))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Vectors overflow\n");
+        result = false;
+      }
+    }
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+    KL_TRC_EXIT;
+
+    return result;
+  }
+}
+
+/// @brief Read data from the associated object into several buffers.
+///
+/// This works in the same way as syscall_read_handle(), except that the data is scattered across the buffers in the
+/// order they are given. Objects that support it service the whole request in one pass.
+///
+/// @param[in] handle The handle of the object to read data from.
+///
+/// @param[in] start_offset How many bytes after the start of the file/pipe data/whatever to begin reading
+///
+/// @param[in] vectors The buffers to read data in to. The total length of the buffers is the number of bytes to read.
+///
+/// @param[in] num_vectors The number of entries in vectors. Maximum IO_MAX_VECTORS.
+///
+/// @param[out] bytes_read The total number of bytes actually read in this request.
+///
+/// @return A suitable ERR_CODE value.
+ERR_CODE syscall_read_handle_vec(GEN_HANDLE handle,
+                                 uint64_t start_offset,
+                                 const io_vector *vectors,
+                                 uint64_t num_vectors,
+                                 uint64_t *bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  task_thread *cur_thread = task_get_cur_thread();
+  io_vector k_vectors[IO_MAX_VECTORS];
+
+  if ((bytes_read == nullptr) || !SYSCALL_IS_UM_ADDRESS(bytes_read))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "bytes_read is invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (!syscall_copy_io_vectors(vectors, num_vectors, k_vectors))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "vectors are invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (cur_thread == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Couldn't identify current thread\n");
+    result = ERR_CODE::INVALID_OP;
+  }
+  else
+  {
+    object_data handle_data;
+    if (!cur_thread->parent_process->proc_handles.retrieve_object_data(handle, handle_data))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf object not found - bad handle\n");
+      result = ERR_CODE::INVALID_PARAM;
+    }
+    else if (handle_data.readable == nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf is not a file, so can't be read.\n");
+      result = ERR_CODE::INVALID_OP;
+    }
+    else
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Going to attempt a vectored read on file: ", handle_data.readable, "\n");
+      result = handle_data.readable->read_bytes_vec(start_offset, k_vectors, num_vectors, *bytes_read);
+
+      KL_TRC_TRACE(TRC_LVL::FLOW, "bytes read: ", *bytes_read, "\n");
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Write data to the associated object from several buffers.
+///
+/// This works in the same way as syscall_write_handle(), except that the data is gathered from the buffers in the order
+/// they are given. Objects that support it service the whole request in one pass.
+///
+/// @param[in] handle The handle of the object to write data to.
+///
+/// @param[in] start_offset How many bytes after the start of the file/pipe data/whatever to begin writing
+///
+/// @param[in] vectors The buffers to write data from. The total length of the buffers is the number of bytes to write.
+///
+/// @param[in] num_vectors The number of entries in vectors. Maximum IO_MAX_VECTORS.
+///
+/// @param[out] bytes_written The total number of bytes actually written in this request.
+///
+/// @return A suitable ERR_CODE value.
+ERR_CODE syscall_write_handle_vec(GEN_HANDLE handle,
+                                  uint64_t start_offset,
+                                  const io_vector *vectors,
+                                  uint64_t num_vectors,
+                                  uint64_t *bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  task_thread *cur_thread = task_get_cur_thread();
+  io_vector k_vectors[IO_MAX_VECTORS];
+
+  if ((bytes_written == nullptr) || !SYSCALL_IS_UM_ADDRESS(bytes_written))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "bytes_written is invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (!syscall_copy_io_vectors(vectors, num_vectors, k_vectors))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "vectors are invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (cur_thread == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Couldn't identify current thread\n");
+    result = ERR_CODE::INVALID_OP;
+  }
+  else
+  {
+    object_data handle_data;
+    if (!cur_thread->parent_process->proc_handles.retrieve_object_data(handle, handle_data))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf object not found - bad handle\n");
+      result = ERR_CODE::NOT_FOUND;
+    }
+    else if (handle_data.writable == nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Leaf is not writable.\n");
+      result = ERR_CODE::INVALID_OP;
+    }
+    else
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Going to attempt a vectored write on file: ", handle_data.writable, "\n");
+      result = handle_data.writable->write_bytes_vec(start_offset, k_vectors, num_vectors, *bytes_written);
+
+      KL_TRC_TRACE(TRC_LVL::FLOW, "bytes written: ", *bytes_written, "\n");
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Create an asynchronous I/O ring for the calling process.
+///
+/// Each process may have one ring. Requests in the ring use the handles of the calling process. See
+/// user_interfaces/io_ring.h for a description of the ring.
+///
+/// @param[in] ring_memory Memory for the ring, which must be at least IO_RING_SIZE(entries) bytes long. The kernel
+///                        initialises the header. The memory must not be freed while the process is running.
+///
+/// @param[in] entries The number of entries in each queue. Must be a power of two, no greater than
+///                    IO_RING_MAX_ENTRIES.
+///
+/// @param[in] num_workers The number of kernel threads to carry out requests, up to IO_RING_MAX_WORKERS. If zero,
+///                        requests are carried out during syscall_io_ring_enter() instead.
+///
+/// @param[out] ring_handle A handle for the new ring, to pass to syscall_io_ring_enter().
+///
+/// @return ERR_CODE::ALREADY_EXISTS if the process already has a ring. ERR_CODE::INVALID_PARAM if any of the
+///         parameters are invalid. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE syscall_io_ring_create(void *ring_memory, uint64_t entries, uint64_t num_workers, GEN_HANDLE *ring_handle)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  task_thread *cur_thread = task_get_cur_thread();
+  std::shared_ptr<io_ring> ring;
+  uint64_t ring_addr = reinterpret_cast<uint64_t>(ring_memory);
+
+  if ((ring_memory == nullptr) ||
+      ((ring_addr % sizeof(uint64_t)) != 0) ||
+      (entries == 0) ||
+      (entries > IO_RING_MAX_ENTRIES) ||
+      ((entries & (entries - 1)) != 0) ||
+      !SYSCALL_IS_UM_ADDRESS(ring_memory) ||
+      !SYSCALL_IS_UM_ADDRESS(ring_addr + IO_RING_SIZE(entries)))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Ring memory is invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (num_workers > IO_RING_MAX_WORKERS)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Too many workers\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if ((ring_handle == nullptr) || !SYSCALL_IS_UM_ADDRESS(ring_handle))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "ring_handle is invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (cur_thread == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Couldn't identify current thread\n");
+    result = ERR_CODE::INVALID_OP;
+  }
+  else
+  {
+    // Check for an existing ring and attach the new one in a single step, so that two threads can't both create one.
+    klib_synch_spinlock_lock(cur_thread->parent_process->io_ring_lock);
+    if (cur_thread->parent_process->io_ring_obj != nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Process already has a ring\n");
+      result = ERR_CODE::ALREADY_EXISTS;
+    }
+    else
+    {
+      ring = io_ring::create(reinterpret_cast<io_ring_header *>(ring_memory),
+                             entries,
+                             num_workers,
+                             cur_thread->process_list_item->item);
+      cur_thread->parent_process->io_ring_obj = ring;
+      result = ERR_CODE::NO_ERROR;
+    }
+    klib_synch_spinlock_unlock(cur_thread->parent_process->io_ring_lock);
+
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      ring->start_workers();
+
+      *ring_handle = cur_thread->parent_process->proc_handles.store_object(ring);
+      KL_TRC_TRACE(TRC_LVL::EXTRA, "New ring handle: ", *ring_handle, "\n");
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Tell the kernel that new requests have been added to an I/O ring, and optionally wait for completions.
+///
+/// Must be called after adding requests to the submission queue, since idle worker threads are only woken by this
+/// call. Completions can be read from the ring without calling this function.
+///
+/// @param[in] ring_handle The handle of the ring, from syscall_io_ring_create().
+///
+/// @param[in] min_complete Wait until at least this many completions are waiting to be read. Zero means don't wait.
+///                         If the ring has no worker threads, all requests have been carried out by the time this call
+///                         returns, so this parameter is ignored.
+///
+/// @return ERR_CODE::NOT_FOUND if ring_handle is not the handle of a ring. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE syscall_io_ring_enter(GEN_HANDLE ring_handle, uint64_t min_complete)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  task_thread *cur_thread = task_get_cur_thread();
+  std::shared_ptr<io_ring> ring;
+
+  if (cur_thread == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Couldn't identify current thread\n");
+    result = ERR_CODE::INVALID_OP;
+  }
+  else
+  {
+    ring = std::dynamic_pointer_cast<io_ring>(cur_thread->parent_process->proc_handles.retrieve_object(ring_handle));
+    if (ring == nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Not a ring\n");
+      result = ERR_CODE::NOT_FOUND;
+    }
+    else
+    {
+      ring->enter(min_complete);
+      result = ERR_CODE::NO_ERROR;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+namespace
+{
+  /// The type of a system call, for the purposes of calling it from syscall_batch(). System calls with fewer
+  /// arguments ignore the extra ones, as they would if called from user mode.
+  typedef ERR_CODE (*SYSCALL_BATCH_FN)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+
+  /// @brief Make a single system call on behalf of syscall_batch().
+  ///
+  /// @param call A kernel copy of the details of the call to make.
+  ///
+  /// @return The result of the system call, or an error if it can't be made.
+  ERR_CODE syscall_batch_one_call(const syscall_batch_call &call)
+  {
+    ERR_CODE result = ERR_CODE::NO_ERROR;
+    uint64_t args[6];
+    const void *fn;
+
+    KL_TRC_ENTRY;
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "System call index: ", call.syscall_idx, "\n");
+
+    if (call.syscall_idx > syscall_max_idx)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Index out of range\n");
+      result = ERR_CODE::SYSCALL_INVALID_IDX;
+    }
+    else
+    {
+      fn = syscall_pointers[call.syscall_idx];
+
+      // Batches can't be nested, and calls that never return can't have their result stored.
+      if ((fn == reinterpret_cast<const void *>(syscall_batch)) ||
+          (fn == reinterpret_cast<const void *>(syscall_exit_process)) ||
+          (fn == reinterpret_cast<const void *>(syscall_exit_thread)))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "System call not permitted in a batch\n");
+        result = ERR_CODE::INVALID_OP;
+      }
+    }
+
+    for (uint32_t i = 0; (i < 6) && (result == ERR_CODE::NO_ERROR); i++)
+    {
+      args[i] = call.args[i];
+      if ((call.indirect_args & (1ULL << i)) != 0)
+      {
+        if ((args[i] == 0) || ((args[i] % sizeof(uint64_t)) != 0) || !SYSCALL_IS_UM_ADDRESS(args[i]))
+        {
+          KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid indirect argument ", i, "\n");
+          result = ERR_CODE::INVALID_PARAM;
+        }
+        else
+        {
+          args[i] = *reinterpret_cast<uint64_t *>(args[i]);
+        }
+      }
+    }
+
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      result = reinterpret_cast<SYSCALL_BATCH_FN>(const_cast<void *>(fn))(args[0],
+                                                                          args[1],
+                                                                          args[2],
+                                                                          args[3],
+                                                                          args[4],
+                                                                          args[5]);
+    }
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+    KL_TRC_EXIT;
+
+    return result;
+  }
+}
+
+/// @brief Make several system calls in one go.
+///
+/// The calls are made in order, exactly as if they had been made individually. Each call's result is stored in its
+/// entry in `calls`.
+///
+/// @param[in,out] calls The system calls to make. See syscall_batch_call for details.
+///
+/// @param[in] num_calls The number of entries in calls. Maximum SYSCALL_BATCH_MAX_CALLS.
+///
+/// @param[in] flags Any of the SYSCALL_BATCH_... flags.
+///
+/// @param[out] num_completed The number of calls that were made. This is less than num_calls only if
+///                           SYSCALL_BATCH_STOP_ON_ERROR is set and a call failed, in which case the failed call is the
+///                           last one made.
+///
+/// @return ERR_CODE::INVALID_PARAM if the parameters to this call are invalid, in which case no calls are made.
+///         ERR_CODE::NO_ERROR otherwise, even if some of the calls in the batch failed.
+ERR_CODE syscall_batch(syscall_batch_call *calls, uint64_t num_calls, uint64_t flags, uint64_t *num_completed)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  syscall_batch_call this_call;
+  uint64_t i;
+  uint64_t calls_addr = reinterpret_cast<uint64_t>(calls);
+  uint64_t calls_end;
+
+  // The whole of calls must be in user space, not just the first entry. Since num_calls is limited, the size can't
+  // overflow, but the end address might.
+  calls_end = calls_addr + ((num_calls <= SYSCALL_BATCH_MAX_CALLS) ? num_calls * sizeof(syscall_batch_call) : 0);
+
+  if ((calls == nullptr) ||
+      !SYSCALL_IS_UM_ADDRESS(calls) ||
+      (num_calls == 0) ||
+      (num_calls > SYSCALL_BATCH_MAX_CALLS) ||
+      (calls_end < calls_addr) ||
+      !SYSCALL_IS_UM_ADDRESS(calls_end - 1))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "calls is invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if ((num_completed == nullptr) || !SYSCALL_IS_UM_ADDRESS(num_completed))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "num_completed is invalid\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if ((flags & ~static_cast<uint64_t>(SYSCALL_BATCH_STOP_ON_ERROR)) != 0)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown flags\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    for (i = 0; i < num_calls; i++)
+    {
+      // Take a copy of each call just before making it, since earlier calls may have written to it.
+      kl_memcpy(&calls[i], &this_call, sizeof(this_call));
+      this_call.result = syscall_batch_one_call(this_call);
+      calls[i].result = this_call.result;
+
+      if (((flags & SYSCALL_BATCH_STOP_ON_ERROR) != 0) && (this_call.result != ERR_CODE::NO_ERROR))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Stop after failed call ", i, "\n");
+        i++;
+        break;
+      }
+    }
+
+    *num_completed = i;
+    result = ERR_CODE::NO_ERROR;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
 /// @brief Configure the base address of TLS for this thread.
 ///
 /// Threads generally define their thread-local storage relative to either FS or GS. It is difficult for them to set
@@ -570,7 +1085,7 @@ ERR_CODE syscall_create_obj_and_handle(const char *path, uint64_t path_len, GEN_
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "New leaf created!\n");
       new_leaf_ptr = std::dynamic_pointer_cast<IHandledObject>(new_leaf);
-      new_handle = cur_thread->thread_handles.store_object(new_leaf_ptr);
+      new_handle = cur_thread->parent_process->proc_handles.store_object(new_leaf_ptr);
       *handle = new_handle;
 
       KL_TRC_TRACE(TRC_LVL::EXTRA, "Correlated to handle ", new_handle, "\n");
@@ -604,7 +1119,7 @@ ERR_CODE syscall_set_handle_data_len(GEN_HANDLE handle, uint64_t data_length)
 
   if (cur_thread != nullptr)
   {
-    obj = cur_thread->thread_handles.retrieve_object(handle);
+    obj = cur_thread->parent_process->proc_handles.retrieve_object(handle);
     if (obj == nullptr)
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "No object for handle\n");
@@ -211,10 +211,11 @@ ERR_CODE syscall_map_memory(GEN_HANDLE proc_mapping_in,
   }
   else
   {
+    object_manager &handles = cur_thread->parent_process->proc_handles;
+
     if (proc_mapping_in != 0)
     {
-      receiving_proc =
-        std::dynamic_pointer_cast<task_process>(cur_thread->thread_handles.retrieve_object(proc_mapping_in));
+      receiving_proc = std::dynamic_pointer_cast<task_process>(handles.retrieve_object(proc_mapping_in));
     }
     else
     {
@@ -224,8 +225,7 @@ ERR_CODE syscall_map_memory(GEN_HANDLE proc_mapping_in,
 
     if (proc_already_in != 0)
     {
-      originating_proc =
-        std::dynamic_pointer_cast<task_process>(cur_thread->thread_handles.retrieve_object(proc_already_in));
+      originating_proc = std::dynamic_pointer_cast<task_process>(handles.retrieve_object(proc_already_in));
     }
     else
     {
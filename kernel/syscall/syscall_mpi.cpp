@@ -35,7 +35,7 @@ ERR_CODE syscall_register_for_mp()
     res = msg_register_process(ct->parent_process.get());
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
   return res;
@@ -51,7 +51,8 @@ ERR_CODE syscall_register_for_mp()
 ///
 /// @param[in] message_ptr A buffer containing the message to be sent. Must be at least as long as message_len.
 ///
-/// @return A suitable error code.
+/// @return A suitable error code. If the recipient's queue is full the message is not sent, and
+///         ERR_CODE::SYNC_MSG_QUEUE_FULL is returned.
 ERR_CODE syscall_send_message(uint64_t target_proc_id,
                               uint64_t message_id,
                               uint64_t message_len,
@@ -95,9 +96,15 @@ ERR_CODE syscall_send_message(uint64_t target_proc_id,
 
     // It feels a lot like we should stop using raw pointers as IDs...
     res = msg_send_to_process(reinterpret_cast<task_process *>(target_proc_id), msg);
+
+    if (res != ERR_CODE::NO_ERROR)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Message not sent, release buffer\n");
+      delete[] kernel_buffer;
+    }
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
   return res;
@@ -105,6 +112,9 @@ ERR_CODE syscall_send_message(uint64_t target_proc_id,
 
 /// @brief Retrieve details about the next message stored in the message queue.
 ///
+/// If no message is waiting, this function returns ERR_CODE::SYNC_MSG_QUEUE_EMPTY immediately. Use
+/// syscall_receive_message_details_wait() to sleep until a message arrives instead.
+///
 /// @param[out] sending_proc_id The ID number of the process sending the message.
 ///
 /// @param[out] message_id The ID of the message type.
@@ -118,6 +128,36 @@ ERR_CODE syscall_receive_message_details(uint64_t *sending_proc_id,
 {
   KL_TRC_ENTRY;
 
+  ERR_CODE res = syscall_receive_message_details_wait(sending_proc_id, message_id, message_len, 0);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Retrieve details about the next message stored in the message queue, waiting for one if needed.
+///
+/// The calling thread sleeps until a message arrives, or until max_wait microseconds have passed. This saves
+/// receivers from repeatedly polling their message queue.
+///
+/// @param[out] sending_proc_id The ID number of the process sending the message.
+///
+/// @param[out] message_id The ID of the message type.
+///
+/// @param[out] message_len The length of the message buffer required.
+///
+/// @param max_wait The maximum number of microseconds to wait for a message. Zero means do not wait, and MSG_MAX_WAIT
+///                 means wait indefinitely.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_QUEUE_EMPTY if no message arrived in time.
+ERR_CODE syscall_receive_message_details_wait(uint64_t *sending_proc_id,
+                                              uint64_t *message_id,
+                                              uint64_t *message_len,
+                                              uint64_t max_wait)
+{
+  KL_TRC_ENTRY;
+
   ERR_CODE res;
   klib_message_hdr msg;
   task_thread *this_thread = task_get_cur_thread();
@@ -129,10 +169,10 @@ ERR_CODE syscall_receive_message_details(uint64_t *sending_proc_id,
       !SYSCALL_IS_UM_ADDRESS(message_id) ||
       !SYSCALL_IS_UM_ADDRESS(message_len))
   {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid parameter addresses\n")
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid parameter addresses\n");
     res = ERR_CODE::INVALID_PARAM;
   }
-  if (this_thread == nullptr)
+  else if (this_thread == nullptr)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown originating thread\n");
     res = ERR_CODE::UNKNOWN;
@@ -144,7 +184,7 @@ ERR_CODE syscall_receive_message_details(uint64_t *sending_proc_id,
   }
   else
   {
-    res = msg_retrieve_next_msg(msg);
+    res = msg_retrieve_next_msg(msg, max_wait);
     if (res == ERR_CODE::NO_ERROR)
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Retrieved message\n");
@@ -154,7 +194,7 @@ ERR_CODE syscall_receive_message_details(uint64_t *sending_proc_id,
     }
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
   return res;
@@ -211,7 +251,7 @@ ERR_CODE syscall_receive_message_body(char *message_buffer, uint64_t buffer_size
     }
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
   return res;
@@ -253,8 +293,441 @@ ERR_CODE syscall_message_complete()
     }
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Retrieve several messages in one go.
+///
+/// This replaces the sequence of syscall_receive_message_details(), syscall_receive_message_body() and
+/// syscall_message_complete() for each message. Up to max_entries messages are removed from the queue. Their details
+/// are written to entries and their bodies are packed one after another into body_buffer. If body_buffer runs out of
+/// space, the remaining bodies are truncated - each entry records how much of its body was copied. All retrieved
+/// messages are completed before this function returns.
+///
+/// This cannot be used while a message retrieved by syscall_receive_message_details() is still outstanding.
+///
+/// @param[out] entries Storage for details of the retrieved messages.
+///
+/// @param max_entries The number of entries available. At most MSG_MAX_BATCH messages are retrieved per call.
+///
+/// @param[out] body_buffer Storage for the message bodies. May be nullptr if body_buffer_size is zero.
+///
+/// @param body_buffer_size The size of body_buffer.
+///
+/// @param[out] entries_received The number of messages retrieved.
+///
+/// @param max_wait The maximum number of microseconds to wait for at least one message. Zero means do not wait, and
+///                 MSG_MAX_WAIT means wait indefinitely.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_QUEUE_EMPTY if no message arrived in time.
+ERR_CODE syscall_receive_message_batch(msg_batch_entry *entries,
+                                       uint64_t max_entries,
+                                       char *body_buffer,
+                                       uint64_t body_buffer_size,
+                                       uint64_t *entries_received,
+                                       uint64_t max_wait)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  klib_message_hdr *msgs = nullptr;
+  uint64_t num_msgs = 0;
+  uint64_t body_offset = 0;
+  uint64_t copy_len;
+  task_thread *this_thread = task_get_cur_thread();
+  uint64_t entries_addr = reinterpret_cast<uint64_t>(entries);
+  uint64_t entries_end;
+  uint64_t body_addr = reinterpret_cast<uint64_t>(body_buffer);
+  uint64_t body_end = body_addr + body_buffer_size;
+
+  if (max_entries > MSG_MAX_BATCH)
+  {
+    max_entries = MSG_MAX_BATCH;
+  }
+
+  // Both buffers must be entirely in user space, not just their first bytes. Since max_entries is now limited the size
+  // of entries can't overflow, but either end address might.
+  entries_end = entries_addr + (max_entries * sizeof(msg_batch_entry));
+
+  if ((entries == nullptr) ||
+      (entries_received == nullptr) ||
+      !SYSCALL_IS_UM_ADDRESS(entries) ||
+      !SYSCALL_IS_UM_ADDRESS(entries_received) ||
+      ((max_entries != 0) && ((entries_end < entries_addr) || !SYSCALL_IS_UM_ADDRESS(entries_end - 1))) ||
+      ((body_buffer_size != 0) && ((body_buffer == nullptr) ||
+                                   !SYSCALL_IS_UM_ADDRESS(body_buffer) ||
+                                   (body_end < body_addr) ||
+                                   !SYSCALL_IS_UM_ADDRESS(body_end - 1))))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid parameter addresses\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else if (max_entries == 0)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No space for entries\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else if ((this_thread == nullptr) || (this_thread->parent_process == nullptr))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown originating process\n");
+    res = ERR_CODE::UNKNOWN;
+  }
+  else
+  {
+    msgs = new klib_message_hdr[max_entries];
+    res = msg_retrieve_msg_batch(msgs, max_entries, num_msgs, max_wait);
+
+    for (uint64_t i = 0; i < num_msgs; i++)
+    {
+      copy_len = body_buffer_size - body_offset;
+      if (copy_len > msgs[i].msg_length)
+      {
+        copy_len = msgs[i].msg_length;
+      }
+
+      if (copy_len != 0)
+      {
+        kl_memcpy(msgs[i].msg_contents, body_buffer + body_offset, copy_len);
+      }
+
+      entries[i].sending_proc_id = reinterpret_cast<uint64_t>(msgs[i].originating_process);
+      entries[i].message_id = msgs[i].msg_id;
+      entries[i].message_len = msgs[i].msg_length;
+      entries[i].body_offset = body_offset;
+      entries[i].body_copied = copy_len;
+
+      body_offset += copy_len;
+      msg_release_contents(msgs[i]);
+    }
+
+    *entries_received = num_msgs;
+    delete[] msgs;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Make a synchronous call to a process and wait for its reply.
+///
+/// The request is small enough to be passed entirely in registers. The calling thread sleeps until a thread in the
+/// target process replies using syscall_reply_call() or syscall_reply_and_receive_call(). See msg_call_process() for
+/// more details.
+///
+/// @param target_proc_id The process to call. It must have registered for message passing. Zero means the calling
+///                       process, which allows a thread to call a server thread within its own process.
+///
+/// @param word_0 The first word of the request.
+///
+/// @param word_1 The second word of the request.
+///
+/// @param word_2 The third word of the request.
+///
+/// @param word_3 The fourth word of the request.
+///
+/// @param[out] reply Storage for the words of the reply.
+///
+/// @return A suitable error code.
+ERR_CODE syscall_call_process(uint64_t target_proc_id,
+                              uint64_t word_0,
+                              uint64_t word_1,
+                              uint64_t word_2,
+                              uint64_t word_3,
+                              msg_call_words *reply)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  msg_call_words request;
+  msg_call_words reply_words;
+  task_thread *this_thread = task_get_cur_thread();
+
+  if ((reply == nullptr) || !SYSCALL_IS_UM_ADDRESS(reply))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid reply pointer\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else if ((this_thread == nullptr) || (this_thread->parent_process == nullptr))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown originating thread\n");
+    res = ERR_CODE::UNKNOWN;
+  }
+  else
+  {
+    request.words[0] = word_0;
+    request.words[1] = word_1;
+    request.words[2] = word_2;
+    request.words[3] = word_3;
+
+    // As with syscall_send_message(), process IDs are raw pointers for now.
+    if (target_proc_id == 0)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Call this process\n");
+      target_proc_id = reinterpret_cast<uint64_t>(this_thread->parent_process.get());
+    }
+    res = msg_call_process(reinterpret_cast<task_process *>(target_proc_id), request, reply_words);
+    if (res == ERR_CODE::NO_ERROR)
+    {
+      *reply = reply_words;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Receive the next synchronous call made to this process.
+///
+/// @param[out] call Storage for details of the call.
+///
+/// @param max_wait The maximum number of microseconds to wait for a call. Zero means do not wait, and MSG_MAX_WAIT
+///                 means wait indefinitely.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_QUEUE_EMPTY if no call arrived in time.
+ERR_CODE syscall_receive_call(msg_call_details *call, uint64_t max_wait)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  msg_call_details details;
+
+  if ((call == nullptr) || !SYSCALL_IS_UM_ADDRESS(call))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid call details pointer\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    res = msg_receive_call(details, max_wait);
+    if (res == ERR_CODE::NO_ERROR)
+    {
+      *call = details;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Reply to the synchronous call that this thread is serving.
+///
+/// The reply is small enough to be passed entirely in registers. The processor switches directly to the calling
+/// thread if it can.
+///
+/// @param word_0 The first word of the reply.
+///
+/// @param word_1 The second word of the reply.
+///
+/// @param word_2 The third word of the reply.
+///
+/// @param word_3 The fourth word of the reply.
+///
+/// @return A suitable error code. ERR_CODE::SYNC_MSG_MISMATCH if this thread is not serving a call.
+ERR_CODE syscall_reply_call(uint64_t word_0, uint64_t word_1, uint64_t word_2, uint64_t word_3)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  msg_call_words reply;
+
+  reply.words[0] = word_0;
+  reply.words[1] = word_1;
+  reply.words[2] = word_2;
+  reply.words[3] = word_3;
+
+  res = msg_reply_call(reply);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Reply to the current synchronous call, then wait for the next one.
+///
+/// This is the normal loop for a server thread, and saves a system call per request. If this thread is not serving a
+/// call then the reply is skipped and it simply waits for a call, so a server can use this from its first iteration.
+/// The calling thread is preferred to run next, so it picks up the reply while this thread waits.
+///
+/// @param word_0 The first word of the reply.
+///
+/// @param word_1 The second word of the reply.
+///
+/// @param word_2 The third word of the reply.
+///
+/// @param word_3 The fourth word of the reply.
+///
+/// @param[out] next_call Storage for details of the next call. This function waits indefinitely for one to arrive.
+///
+/// @return A suitable error code.
+ERR_CODE syscall_reply_and_receive_call(uint64_t word_0,
+                                        uint64_t word_1,
+                                        uint64_t word_2,
+                                        uint64_t word_3,
+                                        msg_call_details *next_call)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  msg_call_words reply;
+  msg_call_details details;
+
+  if ((next_call == nullptr) || !SYSCALL_IS_UM_ADDRESS(next_call))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid call details pointer\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    reply.words[0] = word_0;
+    reply.words[1] = word_1;
+    reply.words[2] = word_2;
+    reply.words[3] = word_3;
+
+    res = msg_reply_call(reply, false);
+    if ((res == ERR_CODE::NO_ERROR) || (res == ERR_CODE::SYNC_MSG_MISMATCH))
+    {
+      res = msg_receive_call(details, MSG_MAX_WAIT);
+      if (res == ERR_CODE::NO_ERROR)
+      {
+        *next_call = details;
+      }
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Join a broadcast group, creating it if necessary.
+///
+/// The calling process must have registered for message passing. Once it has joined, it receives every message
+/// broadcast to the group as a normal message.
+///
+/// @param group_id The ID number of the group to join.
+///
+/// @return A suitable error code.
+ERR_CODE syscall_join_broadcast_group(uint64_t group_id)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  task_thread *this_thread = task_get_cur_thread();
+
+  if ((this_thread == nullptr) || (this_thread->parent_process == nullptr))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown originating process\n");
+    res = ERR_CODE::UNKNOWN;
+  }
+  else
+  {
+    res = msg_init_broadcast_group(group_id);
+    if ((res == ERR_CODE::NO_ERROR) || (res == ERR_CODE::ALREADY_EXISTS))
+    {
+      res = msg_add_process_to_grp(group_id, this_thread->parent_process.get());
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Leave a broadcast group.
+///
+/// @param group_id The ID number of the group to leave.
+///
+/// @return A suitable error code.
+ERR_CODE syscall_leave_broadcast_group(uint64_t group_id)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  task_thread *this_thread = task_get_cur_thread();
+
+  if ((this_thread == nullptr) || (this_thread->parent_process == nullptr))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown originating process\n");
+    res = ERR_CODE::UNKNOWN;
+  }
+  else
+  {
+    res = msg_remove_process_from_grp(group_id, this_thread->parent_process.get());
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
+  KL_TRC_EXIT;
+
+  return res;
+}
+
+/// @brief Send a message to every member of a broadcast group.
+///
+/// The message is copied into the kernel once, however many members the group has. Members whose message queue is full
+/// do not receive the message.
+///
+/// @param group_id The group to send the message to.
+///
+/// @param message_id The ID number of the message type being sent.
+///
+/// @param message_len The length of the message to send.
+///
+/// @param message_ptr A buffer containing the message to be sent. Must be at least as long as message_len.
+///
+/// @return A suitable error code.
+ERR_CODE syscall_broadcast_message(uint64_t group_id,
+                                   uint64_t message_id,
+                                   uint64_t message_len,
+                                   const char *message_ptr)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE res;
+  klib_message_hdr msg;
+  task_thread *this_thread = task_get_cur_thread();
+
+  if ((message_len != 0) && ((message_ptr == nullptr) || !SYSCALL_IS_UM_ADDRESS(message_ptr)))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid message buffer ptr\n");
+    res = ERR_CODE::INVALID_PARAM;
+  }
+  else if ((this_thread == nullptr) || (this_thread->parent_process == nullptr))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown originating process\n");
+    res = ERR_CODE::UNKNOWN;
+  }
+  else
+  {
+    msg.msg_contents = nullptr;
+    if (message_len > 0)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Copying message to kernel buffer\n");
+      msg.msg_contents = new char[message_len];
+      kl_memcpy(message_ptr, msg.msg_contents, message_len);
+    }
+
+    msg.msg_id = message_id;
+    msg.msg_length = message_len;
+    msg.originating_process = this_thread->parent_process.get();
+
+    // The buffer belongs to the message system from now on, whatever the result.
+    res = msg_broadcast_msg(group_id, msg);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", res, "\n");
   KL_TRC_EXIT;
 
   return res;
-}
\ No newline at end of file
+}
@@ -10,6 +10,92 @@
 #include "processor/processor-int.h"
 #include "object_mgr/object_mgr.h"
 #include "klib/klib.h"
+#include "system_tree/process/process.h"
+
+#include <memory>
+
+namespace
+{
+  /// @brief Copy a user mode, nullptr-terminated, array of strings into the kernel.
+  ///
+  /// Each pointer and each string is read exactly once. The kernel then works only from the copy, so another thread in
+  /// the calling process can't change the array between it being checked and it being used.
+  ///
+  /// @param array The array to copy. nullptr is acceptable, and means an empty array.
+  ///
+  /// @param[out] array_copy The copied array, terminated by nullptr. The strings it points to are stored in strings.
+  ///
+  /// @param strings Storage for the copied strings. Must be PROC_START_PARAMS_MAX_SIZE bytes long.
+  ///
+  /// @param[in,out] strings_used The number of bytes of strings already in use. Updated to include the copied strings.
+  ///
+  /// @return ERR_CODE::INVALID_PARAM if the array or any of its strings is not in user space, or the array has too many
+  ///         entries. ERR_CODE::OUT_OF_RESOURCE if the strings don't fit in strings. ERR_CODE::NO_ERROR otherwise.
+  ERR_CODE syscall_copy_string_array(const char * const array[],
+                                     std::unique_ptr<const char *[]> &array_copy,
+                                     char *strings,
+                                     uint64_t &strings_used)
+  {
+    ERR_CODE result = ERR_CODE::NO_ERROR;
+    const uint64_t max_entries = PROC_START_PARAMS_MAX_SIZE / sizeof(char *);
+    uint64_t i = 0;
+    uint64_t space_left;
+    uint64_t str_len;
+    const char *cur_str;
+
+    array_copy = std::make_unique<const char *[]>(max_entries + 1);
+
+    while ((array != nullptr) && (result == ERR_CODE::NO_ERROR))
+    {
+      if ((i >= max_entries) || !SYSCALL_IS_UM_ADDRESS(&array[i]))
+      {
+        result = ERR_CODE::INVALID_PARAM;
+        break;
+      }
+
+      cur_str = array[i];
+      if (cur_str == nullptr)
+      {
+        break;
+      }
+
+      space_left = PROC_START_PARAMS_MAX_SIZE - strings_used;
+      if (!SYSCALL_IS_UM_ADDRESS(cur_str))
+      {
+        result = ERR_CODE::INVALID_PARAM;
+      }
+      else if (space_left < 2)
+      {
+        result = ERR_CODE::OUT_OF_RESOURCE;
+      }
+      else
+      {
+        // There must be room for the terminator as well as the string.
+        str_len = kl_strlen(cur_str, space_left);
+        if (str_len >= space_left)
+        {
+          result = ERR_CODE::OUT_OF_RESOURCE;
+        }
+        else if (!SYSCALL_IS_UM_ADDRESS(cur_str + str_len))
+        {
+          result = ERR_CODE::INVALID_PARAM;
+        }
+        else
+        {
+          kl_memcpy(cur_str, strings + strings_used, str_len);
+          strings[strings_used + str_len] = 0;
+          array_copy[i] = strings + strings_used;
+          strings_used += str_len + 1;
+          i++;
+        }
+      }
+    }
+
+    array_copy[i] = nullptr;
+
+    return result;
+  }
+}
 
 /// @brief Create a new process
 ///
@@ -50,7 +136,7 @@ ERR_CODE syscall_create_process(void *entry_point_addr, GEN_HANDLE *proc_handle)
     new_process = task_process::create(reinterpret_cast<ENTRY_PROC>(entry_point_addr));
 
     std::shared_ptr<IHandledObject> proc_ptr = std::dynamic_pointer_cast<IHandledObject>(new_process);
-    *proc_handle = cur_thread->thread_handles.store_object(proc_ptr);
+    *proc_handle = cur_thread->parent_process->proc_handles.store_object(proc_ptr);
     KL_TRC_TRACE(TRC_LVL::FLOW, "New process (", new_process.get(), ") created, handle: ", *proc_handle, "\n");
 
     result = ERR_CODE::NO_ERROR;
@@ -90,7 +176,8 @@ ERR_CODE syscall_set_startup_params(GEN_HANDLE proc_handle, uint64_t argc, uint6
   }
   else
   {
-    proc_obj = std::dynamic_pointer_cast<task_process>(cur_thread->thread_handles.retrieve_object(proc_handle));
+    proc_obj =
+      std::dynamic_pointer_cast<task_process>(cur_thread->parent_process->proc_handles.retrieve_object(proc_handle));
 
     if (proc_obj == nullptr)
     {
@@ -140,7 +227,8 @@ ERR_CODE syscall_start_process(GEN_HANDLE proc_handle)
   }
   else
   {
-    proc_obj = std::dynamic_pointer_cast<task_process>(cur_thread->thread_handles.retrieve_object(proc_handle));
+    proc_obj =
+      std::dynamic_pointer_cast<task_process>(cur_thread->parent_process->proc_handles.retrieve_object(proc_handle));
 
     if (proc_obj == nullptr)
     {
@@ -161,6 +249,91 @@ ERR_CODE syscall_start_process(GEN_HANDLE proc_handle)
   return result;
 }
 
+/// @brief Load an executable file into a new process and start it.
+///
+/// The kernel loads the file, copies the arguments and environment into the new process and starts it, all in one
+/// call. This replaces the sequence of creating a process, mapping and filling its memory, setting its start
+/// parameters and starting it from user mode. If anything fails, no process is left behind.
+///
+/// At present only statically linked ELF executables can be loaded.
+///
+/// @param path The System Tree path of the executable file. It is also given to the new process as argv[0].
+///
+/// @param path_len The number of characters in path.
+///
+/// @param argv The remaining arguments for the new process, terminated by nullptr. May be nullptr if there are none.
+///
+/// @param envp The environment for the new process, terminated by nullptr. May be nullptr for an empty environment.
+///
+/// @param[out] proc_handle Storage for a handle to the new process.
+///
+/// @return ERR_CODE::INVALID_PARAM if any parameter is invalid. ERR_CODE::NOT_FOUND if the file doesn't exist.
+///         ERR_CODE::UNRECOGNISED if it isn't a file that can be executed. ERR_CODE::OUT_OF_RESOURCE if the arguments
+///         and environment are too large. ERR_CODE::NO_ERROR if the process was started.
+ERR_CODE syscall_spawn_process(const char *path,
+                               uint64_t path_len,
+                               char * const argv[],
+                               char * const envp[],
+                               GEN_HANDLE *proc_handle)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::UNKNOWN;
+  std::shared_ptr<task_process> new_process;
+  std::unique_ptr<char[]> path_copy;
+  std::unique_ptr<char[]> strings;
+  std::unique_ptr<const char *[]> argv_copy;
+  std::unique_ptr<const char *[]> envp_copy;
+  uint64_t strings_used = 0;
+  task_thread *cur_thread = task_get_cur_thread();
+
+  if ((path == nullptr) ||
+      (!SYSCALL_IS_UM_ADDRESS(path)) ||
+      (path_len == 0) ||
+      (path_len >= PROC_START_PARAMS_MAX_SIZE) ||
+      (proc_handle == nullptr) ||
+      (!SYSCALL_IS_UM_ADDRESS(proc_handle)))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid parameters\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else if (cur_thread == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Couldn't identify current thread\n");
+    result = ERR_CODE::INVALID_OP;
+  }
+  else
+  {
+    // Take a copy of the arguments and environment, and work only from that, in case the caller changes them.
+    strings = std::make_unique<char[]>(PROC_START_PARAMS_MAX_SIZE);
+    result = syscall_copy_string_array(argv, argv_copy, strings.get(), strings_used);
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      result = syscall_copy_string_array(envp, envp_copy, strings.get(), strings_used);
+    }
+  }
+
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    path_copy = std::make_unique<char[]>(path_len + 1);
+    kl_memcpy(path, path_copy.get(), path_len);
+    path_copy[path_len] = 0;
+
+    result = proc_spawn_elf_file(path_copy.get(), argv_copy.get(), envp_copy.get(), new_process);
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      std::shared_ptr<IHandledObject> proc_ptr = std::dynamic_pointer_cast<IHandledObject>(new_process);
+      *proc_handle = cur_thread->parent_process->proc_handles.store_object(proc_ptr);
+      KL_TRC_TRACE(TRC_LVL::FLOW, "New process (", new_process.get(), ") started, handle: ", *proc_handle, "\n");
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
 /// @brief Cause a process to stop running.
 ///
 /// Has no effect if the process is already stopped. If any of the process's threads are executing on any CPU when this
@@ -186,7 +359,8 @@ ERR_CODE syscall_stop_process(GEN_HANDLE proc_handle)
   }
   else
   {
-    proc_obj = std::dynamic_pointer_cast<task_process>(cur_thread->thread_handles.retrieve_object(proc_handle));
+    proc_obj =
+      std::dynamic_pointer_cast<task_process>(cur_thread->parent_process->proc_handles.retrieve_object(proc_handle));
 
     if (proc_obj == nullptr)
     {
@@ -230,7 +404,8 @@ ERR_CODE syscall_destroy_process(GEN_HANDLE proc_handle)
   }
   else
   {
-    proc_obj = std::dynamic_pointer_cast<task_process>(cur_thread->thread_handles.retrieve_object(proc_handle));
+    proc_obj =
+      std::dynamic_pointer_cast<task_process>(cur_thread->parent_process->proc_handles.retrieve_object(proc_handle));
 
     if (proc_obj == nullptr)
     {
@@ -239,7 +414,7 @@ ERR_CODE syscall_destroy_process(GEN_HANDLE proc_handle)
     }
     else
     {
-      cur_thread->thread_handles.remove_object(proc_handle);
+      cur_thread->parent_process->proc_handles.remove_object(proc_handle);
       proc_obj->destroy_process();
       result = ERR_CODE::NO_ERROR;
     }
@@ -317,7 +492,7 @@ ERR_CODE syscall_create_thread(void (*entry_point)(), GEN_HANDLE *thread_handle)
 
     if (new_thread != nullptr)
     {
-      *thread_handle = cur_thread->thread_handles.store_object(new_thread);
+      *thread_handle = cur_thread->parent_process->proc_handles.store_object(new_thread);
       KL_TRC_TRACE(TRC_LVL::FLOW, "New thread (", new_thread.get(), ") created, handle: ", *thread_handle, "\n");
 
       result = ERR_CODE::NO_ERROR;
@@ -359,7 +534,8 @@ ERR_CODE syscall_start_thread(GEN_HANDLE thread_handle)
   }
   else
   {
-    thread_obj = std::dynamic_pointer_cast<task_thread>(cur_thread->thread_handles.retrieve_object(thread_handle));
+    thread_obj =
+      std::dynamic_pointer_cast<task_thread>(cur_thread->parent_process->proc_handles.retrieve_object(thread_handle));
 
     if (thread_obj == nullptr)
     {
@@ -412,7 +588,8 @@ ERR_CODE syscall_stop_thread(GEN_HANDLE thread_handle)
   }
   else
   {
-    thread_obj = std::dynamic_pointer_cast<task_thread>(cur_thread->thread_handles.retrieve_object(thread_handle));
+    thread_obj =
+      std::dynamic_pointer_cast<task_thread>(cur_thread->parent_process->proc_handles.retrieve_object(thread_handle));
 
     if (thread_obj == nullptr)
     {
@@ -456,7 +633,8 @@ ERR_CODE syscall_destroy_thread(GEN_HANDLE thread_handle)
   }
   else
   {
-    thread_obj = std::dynamic_pointer_cast<task_thread>(cur_thread->thread_handles.retrieve_object(thread_handle));
+    thread_obj =
+      std::dynamic_pointer_cast<task_thread>(cur_thread->parent_process->proc_handles.retrieve_object(thread_handle));
 
     if (thread_obj == nullptr)
     {
@@ -466,7 +644,7 @@ ERR_CODE syscall_destroy_thread(GEN_HANDLE thread_handle)
     else
     {
       // This also releases the handle's reference to the thread.
-      cur_thread->thread_handles.remove_object(thread_handle);
+      cur_thread->parent_process->proc_handles.remove_object(thread_handle);
       thread_obj->destroy_thread();
       result = ERR_CODE::NO_ERROR;
     }
@@ -0,0 +1,155 @@
+/// @file
+/// @brief Gathers per-process counts and latency histograms of system calls.
+///
+/// When the kernel is built with AZALEA_SYSCALL_STATS defined, the system call entry code reads the TSC either side of
+/// the call to the handler and passes the difference to syscall_stats_record(). The result is added to the calling
+/// process's table for the current processor. The tables for all processors are summed when the statistics are read,
+/// for example by proc_fs.
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "syscall/syscall_stats.h"
+#include "processor/processor.h"
+
+/// @brief Allocate a set of statistics tables for a new process.
+///
+/// @return An array of zeroed tables, one per processor. Release it with syscall_stats_free().
+syscall_stats_table *syscall_stats_alloc()
+{
+  KL_TRC_ENTRY;
+
+  uint32_t num_procs = proc_mp_proc_count();
+  syscall_stats_table *tables;
+
+  ASSERT(num_procs > 0);
+  tables = new syscall_stats_table[num_procs];
+  ASSERT(tables != nullptr);
+  kl_memset(tables, 0, sizeof(syscall_stats_table) * num_procs);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", tables, "\n");
+  KL_TRC_EXIT;
+
+  return tables;
+}
+
+/// @brief Release a set of tables allocated by syscall_stats_alloc().
+///
+/// @param tables The tables to release. May be nullptr.
+void syscall_stats_free(syscall_stats_table *tables)
+{
+  KL_TRC_ENTRY;
+
+  delete[] tables;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Find the histogram bucket for a call of the given length.
+///
+/// @param ticks The length of the call, in TSC ticks.
+///
+/// @return The bucket to count the call in.
+uint32_t syscall_stats_bucket(uint64_t ticks)
+{
+  uint32_t bucket = 0;
+  uint64_t power;
+
+  if (ticks >= (1ULL << SYSCALL_STATS_FIRST_BUCKET_SHIFT))
+  {
+    power = which_power_of_two(ticks);
+    bucket = static_cast<uint32_t>(power - SYSCALL_STATS_FIRST_BUCKET_SHIFT + 1);
+    if (bucket >= SYSCALL_STATS_NUM_BUCKETS)
+    {
+      bucket = SYSCALL_STATS_NUM_BUCKETS - 1;
+    }
+  }
+
+  return bucket;
+}
+
+/// @brief Add one completed call to a process's statistics.
+///
+/// The caller must make sure that nothing else can update the table for proc_id at the same time - normally by being
+/// that processor and having interrupts disabled.
+///
+/// @param proc The process that made the call. If it has no statistics tables, nothing is recorded.
+///
+/// @param proc_id The processor the call completed on.
+///
+/// @param syscall_idx The index of the call. Out of range indices are ignored.
+///
+/// @param ticks The length of the call, in TSC ticks.
+void syscall_stats_add(task_process *proc, uint32_t proc_id, uint64_t syscall_idx, uint64_t ticks)
+{
+  syscall_stats_entry *entry;
+
+  if ((proc != nullptr) &&
+      (proc->syscall_stats != nullptr) &&
+      (syscall_idx < SYSCALL_IDX_COUNT) &&
+      (proc_id < proc_mp_proc_count()))
+  {
+    entry = &proc->syscall_stats[proc_id].calls[syscall_idx];
+    entry->count++;
+    entry->total_ticks += ticks;
+    entry->histogram[syscall_stats_bucket(ticks)]++;
+  }
+}
+
+/// @brief Record a completed system call against the current process.
+///
+/// Called by the system call entry code, with interrupts disabled, after the handler has returned. Kept free of tracing
+/// because it runs on every system call.
+///
+/// @param syscall_idx The index of the call that completed.
+///
+/// @param ticks The number of TSC ticks the handler took.
+void syscall_stats_record(uint64_t syscall_idx, uint64_t ticks)
+{
+  task_thread *cur_thread = task_get_cur_thread();
+
+  if (cur_thread != nullptr)
+  {
+    syscall_stats_add(cur_thread->parent_process.get(), proc_mp_this_proc_id(), syscall_idx, ticks);
+  }
+}
+
+/// @brief Sum a process's statistics over all processors.
+///
+/// The tables are read without stopping the process, so a call that completes during the sum may be partly counted.
+///
+/// @param proc The process to sum the statistics of.
+///
+/// @param[out] total The summed statistics. Zeroed if the process has no statistics tables.
+void syscall_stats_sum(task_process *proc, syscall_stats_table &total)
+{
+  KL_TRC_ENTRY;
+
+  uint32_t num_procs = proc_mp_proc_count();
+  const syscall_stats_entry *in_entry;
+  syscall_stats_entry *out_entry;
+
+  ASSERT(proc != nullptr);
+  kl_memset(&total, 0, sizeof(total));
+
+  if (proc->syscall_stats != nullptr)
+  {
+    for (uint32_t i = 0; i < num_procs; i++)
+    {
+      for (uint32_t j = 0; j < SYSCALL_IDX_COUNT; j++)
+      {
+        in_entry = &proc->syscall_stats[i].calls[j];
+        out_entry = &total.calls[j];
+
+        out_entry->count += in_entry->count;
+        out_entry->total_ticks += in_entry->total_ticks;
+        for (uint32_t k = 0; k < SYSCALL_STATS_NUM_BUCKETS; k++)
+        {
+          out_entry->histogram[k] += in_entry->histogram[k];
+        }
+      }
+    }
+  }
+
+  KL_TRC_EXIT;
+}
@@ -0,0 +1,52 @@
+/// @file
+/// @brief Per-process counts and latency histograms of system calls.
+///
+/// These statistics are only gathered if the kernel is built with AZALEA_SYSCALL_STATS defined. Otherwise the system
+/// call entry path is unchanged and processes carry no statistics tables.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "user_interfaces/syscall.h"
+
+class task_process;
+
+/// The number of buckets in each latency histogram.
+const uint32_t SYSCALL_STATS_NUM_BUCKETS = 16;
+
+/// Calls taking fewer than (1 << SYSCALL_STATS_FIRST_BUCKET_SHIFT) TSC ticks are counted in the first bucket. Each
+/// later bucket covers twice the range of the one before it, except the last, which counts all longer calls.
+const uint32_t SYSCALL_STATS_FIRST_BUCKET_SHIFT = 7;
+
+/// @brief Statistics about a single system call.
+struct syscall_stats_entry
+{
+  /// The number of times the call has completed.
+  uint64_t count;
+
+  /// The total time spent in the call, in TSC ticks.
+  uint64_t total_ticks;
+
+  /// The number of calls falling in each latency bucket.
+  uint64_t histogram[SYSCALL_STATS_NUM_BUCKETS];
+};
+
+/// @brief Statistics about every system call, as made by a single process on a single processor.
+///
+/// Each process has one of these tables per processor, so that the table is only ever written by one processor and
+/// needs no lock.
+struct syscall_stats_table
+{
+  /// One entry per system call, indexed by the SYSCALL_IDX_ values.
+  syscall_stats_entry calls[SYSCALL_IDX_COUNT];
+};
+
+syscall_stats_table *syscall_stats_alloc();
+void syscall_stats_free(syscall_stats_table *tables);
+
+uint32_t syscall_stats_bucket(uint64_t ticks);
+void syscall_stats_add(task_process *proc, uint32_t proc_id, uint64_t syscall_idx, uint64_t ticks);
+void syscall_stats_sum(task_process *proc, syscall_stats_table &total);
+
+extern "C" void syscall_stats_record(uint64_t syscall_idx, uint64_t ticks);
@@ -8,6 +8,7 @@
 #include "syscall/syscall_kernel.h"
 #include "syscall/syscall_kernel-int.h"
 #include "object_mgr/object_mgr.h"
+#include "processor/timing/timing.h"
 
 /// @brief Wait for an object before allowing this thread to continue.
 ///
@@ -23,7 +24,7 @@ extern "C" ERR_CODE syscall_wait_for_object(GEN_HANDLE wait_object_handle)
   KL_TRC_ENTRY;
 
   ERR_CODE result = ERR_CODE::UNKNOWN;
-  std::shared_ptr<WaitObject> wait_obj;
+  object_data handle_data;
   task_thread *cur_thread = task_get_cur_thread();
 
   if (cur_thread == nullptr)
@@ -33,15 +34,15 @@ extern "C" ERR_CODE syscall_wait_for_object(GEN_HANDLE wait_object_handle)
   }
   else
   {
-    wait_obj = std::dynamic_pointer_cast<WaitObject>(cur_thread->thread_handles.retrieve_object(wait_object_handle));
-    if (wait_obj == nullptr)
+    if (!cur_thread->parent_process->proc_handles.retrieve_object_data(wait_object_handle, handle_data) ||
+        (handle_data.wait_obj == nullptr))
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Not a wait object\n");
       result = ERR_CODE::INVALID_OP;
     }
     else
     {
-      wait_obj->wait_for_signal();
+      handle_data.wait_obj->wait_for_signal();
       result = ERR_CODE::NO_ERROR;
     }
   }
@@ -65,3 +66,33 @@ ERR_CODE syscall_futex_wake(volatile int32_t *futex)
 
   return ERR_CODE::UNKNOWN;
 }
+
+/// @brief Get the number of nanoseconds since the system timer was started.
+///
+/// This is the same clock that is published in the shared page, for use when the TSC can't be used to read it.
+///
+/// @param ns_since_boot[out] The number of nanoseconds since the system timer was started.
+///
+/// @return ERR_CODE::INVALID_PARAM if ns_since_boot is not a valid user mode pointer. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE syscall_get_system_clock(uint64_t *ns_since_boot)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+
+  if ((ns_since_boot == nullptr) || !SYSCALL_IS_UM_ADDRESS(ns_since_boot))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid output pointer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    *ns_since_boot = time_get_system_timer_ns();
+    result = ERR_CODE::NO_ERROR;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
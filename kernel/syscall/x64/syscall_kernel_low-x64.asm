@@ -12,6 +12,7 @@ asm_syscall_x64_prepare:
   ; 2: Load the default kernel mode CS and SS into the appropriate MSR.
   ; 3: Load the default user mode CS and SS into the appropriate MSR.
   ; 4: Load the syscall instruction pointer into the appropriate MSR.
+  ; 5: Set the RFLAGS mask.
 
   ; 1: Set the SCE bit to enabled. It is bit 0 of EFER (0xC0000080)
   mov ecx, 0xC0000080
@@ -43,19 +44,32 @@ asm_syscall_x64_prepare:
   shr rdx, 32
   wrmsr
 
+  ; 5: Have the processor clear IF, TF, DF and NT in RFLAGS as part of executing SYSCALL. That way interrupts are
+  ; already disabled on entry, so the entry point doesn't need a CLI before it switches stacks.
+  ; The mask lives in IA32_FMASK.
+  mov ecx, 0xC0000084 ; IA32_FMASK
+  mov eax, 0x00004700
+  xor edx, edx
+  wrmsr
+
   ret
 
 ; The system call interface!
 ; There is no guarantee of any register remaining unchanged.
 ; System call number comes by RAX.
+;
+; This path is deliberately kept short:
+; - Interrupts are disabled by the processor on entry (see IA32_FMASK above), so there is no CLI here.
+; - The FPU/SSE state is not saved. The kernel is built without SSE or MMX code generation, so the user's FPU state
+;   passes through the system call untouched. If this thread is rescheduled during the call, the task switching code
+;   saves the FPU state along with everything else.
 GLOBAL asm_syscall_x64_syscall
-EXTERN syscall_x64_kernel_syscall
 EXTERN syscall_pointers
 EXTERN syscall_max_idx
+%ifdef AZALEA_SYSCALL_STATS
+EXTERN syscall_stats_record
+%endif
 asm_syscall_x64_syscall:
-  ; Stop interrupts while we're fiddling with the stack, to avoid bad corruptions.
-  cli
-
   ; Swap to this thread's kernel stack.
   swapgs
   mov [gs:16], rsp
@@ -70,30 +84,52 @@ asm_syscall_x64_syscall:
   push r14
   push r15
 
-  sub rsp, 512
-  fxsave64 [rsp]
-
   ; Save RCX (which is the stored RIP) and R11 (which is the stored RFLAGS).
   push rcx
   push r11
 
+  ; Now that we're on the kernel stack it's safe to take interrupts again - some system calls block.
   sti
 
   ; Confirm that the requested system call is within the boundaries of the index table:
   mov r12, syscall_max_idx
-  mov r12, [r12]
-
-  cmp rax, r12
+  cmp rax, [r12]
   ja invalid_syscall_idx
 
-  ; The call index requested fits within the table. Extract the function's address and call it. Move R10 into RCX to
+%ifdef AZALEA_SYSCALL_STATS
+  ; Read the TSC before and after the call, and record the difference against the calling process. The index is kept
+  ; in R13 and the start time in R14 - both were saved above. RDTSC overwrites RDX, which holds the third argument, so
+  ; park that in R15 meanwhile.
+  mov r13, rax
+  mov r15, rdx
+  rdtsc
+  shl rdx, 32
+  or rax, rdx
+  mov r14, rax
+  mov rdx, r15
+  mov rax, r13
+%endif
+
+  ; The call index requested fits within the table. Call the function directly from the table. Move R10 into RCX to
   ; fulfil the change between kernel interface ABI and x64 C function call ABI.
   mov r12, syscall_pointers
-  shl rax, 3
-  add rax, r12
-
   mov rcx, r10
-  call [rax]
+  call [r12 + rax * 8]
+
+%ifdef AZALEA_SYSCALL_STATS
+  ; Keep the result in R15 while recording. Interrupts are disabled first so that the process's table for this
+  ; processor can't be updated by anything else at the same time.
+  cli
+  mov r15, rax
+  rdtsc
+  shl rdx, 32
+  or rax, rdx
+  sub rax, r14
+  mov rsi, rax
+  mov rdi, r13
+  call syscall_stats_record
+  mov rax, r15
+%endif
 
   jmp end_of_syscall
 
@@ -103,16 +139,14 @@ asm_syscall_x64_syscall:
 
   end_of_syscall:
 
-  ; Put the RIP and R11 back again. Restore the FPU state.
+  ; Stop interrupts, because otherwise they might get called with the user stack (which is bad). SYSRET restores the
+  ; caller's RFLAGS from R11, so interrupts are enabled again on return to user mode.
+  cli
+
+  ; Put the RIP and R11 back again.
   pop r11
   pop rcx
 
-  fxrstor64 [rsp]
-  add rsp, 512
-
-  ; Stop interrupts, because otherwise they might get called with the user stack (which is bad)
-  cli
-
   ; Restore the registers that must be preserved by the calling convention.
   pop r15
   pop r14
@@ -130,4 +164,3 @@ asm_syscall_x64_syscall:
   ; 2 - For some reason, adding the prefix using its mnemonic doesn't seem to work with NASM.
   db 0x48
   sysret
-
@@ -56,4 +56,20 @@ GENERIC_SYSCALL 28, syscall_futex_wake
 ; New syscalls
 GENERIC_SYSCALL 29, syscall_create_obj_and_handle
 GENERIC_SYSCALL 30, syscall_set_handle_data_len
-GENERIC_SYSCALL 31, syscall_set_startup_params
\ No newline at end of file
+GENERIC_SYSCALL 31, syscall_set_startup_params
+GENERIC_SYSCALL 32, syscall_receive_message_details_wait
+GENERIC_SYSCALL 33, syscall_call_process
+GENERIC_SYSCALL 34, syscall_receive_call
+GENERIC_SYSCALL 35, syscall_reply_call
+GENERIC_SYSCALL 36, syscall_reply_and_receive_call
+GENERIC_SYSCALL 37, syscall_join_broadcast_group
+GENERIC_SYSCALL 38, syscall_leave_broadcast_group
+GENERIC_SYSCALL 39, syscall_broadcast_message
+GENERIC_SYSCALL 40, syscall_receive_message_batch
+GENERIC_SYSCALL 41, syscall_get_system_clock
+GENERIC_SYSCALL 42, syscall_read_handle_vec
+GENERIC_SYSCALL 43, syscall_write_handle_vec
+GENERIC_SYSCALL 44, syscall_io_ring_create
+GENERIC_SYSCALL 45, syscall_io_ring_enter
+GENERIC_SYSCALL 46, syscall_batch
+GENERIC_SYSCALL 47, syscall_spawn_process
@@ -57,28 +57,76 @@ ERR_CODE fat_filesystem::fat_file::read_bytes(uint64_t start,
 {
   KL_TRC_ENTRY;
 
+  io_vector vector;
+  ERR_CODE ec = ERR_CODE::NO_ERROR;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Start", start, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Length", length, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "buffer_length", buffer_length, "\n");
+
+  bytes_read = 0;
+
+  // Check parameters for correctness. The file boundaries are checked by read_bytes_vec()
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::ERROR, "buffer must not be NULL\n");
+    ec = ERR_CODE::INVALID_PARAM;
+  }
+  if (length > buffer_length)
+  {
+    KL_TRC_TRACE(TRC_LVL::ERROR, "Buffer must be sufficiently large\n");
+    ec = ERR_CODE::INVALID_PARAM;
+  }
+
+  if (ec == ERR_CODE::NO_ERROR)
+  {
+    vector.buffer = buffer;
+    vector.length = length;
+    ec = this->read_bytes_vec(start, &vector, 1, bytes_read);
+  }
+
+  KL_TRC_EXIT;
+  return ec;
+}
+
+/// @brief Read from the file into several buffers.
+///
+/// The cluster chain is followed once for the whole read, with each sector being copied into however many buffers it
+/// spans. Unlike read_bytes(), the read must be completely contained within the file. See IReadable::read_bytes_vec()
+/// for details of the parameters and return value.
+ERR_CODE fat_filesystem::fat_file::read_bytes_vec(uint64_t start,
+                                                  const io_vector *vectors,
+                                                  uint64_t num_vectors,
+                                                  uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  uint64_t length = 0;
   uint64_t bytes_read_so_far = 0;
   uint64_t read_offset;
   uint64_t bytes_from_this_sector = 0;
   uint64_t read_sector_num;
   uint64_t next_sector_num;
+  uint64_t vector_idx = 0;
+  uint64_t vector_offset = 0;
+  uint64_t sector_offset;
+  uint64_t this_copy;
 
   ERR_CODE ec = ERR_CODE::NO_ERROR;
 
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Start", start, "\n");
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Length", length, "\n");
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "buffer_length", buffer_length, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Vectors", num_vectors, "\n");
 
   // Check parameters for correctness.
-  if (buffer == nullptr)
+  if (!fs_io_vectors_valid(vectors, num_vectors, length))
   {
-    KL_TRC_TRACE(TRC_LVL::ERROR, "buffer must not be NULL\n");
+    KL_TRC_TRACE(TRC_LVL::ERROR, "Invalid vectors\n");
     ec = ERR_CODE::INVALID_PARAM;
   }
 
   // The file size record for directories is always zero, for some reason, so skip these checks and just rely on not
   // being able to find the correct cluster to stop us reading random bits of disk.
-  if (!this->_file_record.attributes.directory)
+  else if (!this->_file_record.attributes.directory)
   {
     if (start > this->_file_record.file_size)
     {
@@ -96,14 +144,11 @@ ERR_CODE fat_filesystem::fat_file::read_bytes(uint64_t start,
       ec = ERR_CODE::INVALID_PARAM;
     }
   }
-  if (length > buffer_length)
-  {
-    KL_TRC_TRACE(TRC_LVL::ERROR, "Buffer must be sufficiently large\n");
-    ec = ERR_CODE::INVALID_PARAM;
-  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Length", length, "\n");
 
   // Compute a starting point for the read.
-  if (ec == ERR_CODE::NO_ERROR)
+  if ((ec == ERR_CODE::NO_ERROR) && (length > 0))
   {
     std::shared_ptr<fat_filesystem> parent_ptr = _parent.lock();
     if (parent_ptr)
@@ -156,9 +201,30 @@ ERR_CODE fat_filesystem::fat_file::read_bytes(uint64_t start,
           KL_TRC_TRACE(TRC_LVL::EXTRA, "Offset", read_offset, "\n");
           KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes now", bytes_from_this_sector, "\n");
 
-          kl_memcpy((void *)(((uint8_t *)sector_buffer.get()) + read_offset),
-                    buffer + bytes_read_so_far,
-                    bytes_from_this_sector);
+          // Spread this sector across as many of the buffers as it covers.
+          sector_offset = 0;
+          while (sector_offset < bytes_from_this_sector)
+          {
+            ASSERT(vector_idx < num_vectors);
+            this_copy = vectors[vector_idx].length - vector_offset;
+            if (this_copy > (bytes_from_this_sector - sector_offset))
+            {
+              this_copy = bytes_from_this_sector - sector_offset;
+            }
+
+            kl_memcpy(sector_buffer.get() + read_offset + sector_offset,
+                      reinterpret_cast<uint8_t *>(vectors[vector_idx].buffer) + vector_offset,
+                      this_copy);
+            sector_offset += this_copy;
+            vector_offset += this_copy;
+
+            if (vector_offset == vectors[vector_idx].length)
+            {
+              KL_TRC_TRACE(TRC_LVL::FLOW, "Move to next vector\n");
+              vector_idx++;
+              vector_offset = 0;
+            }
+          }
 
           bytes_read_so_far += bytes_from_this_sector;
           read_offset = 0;
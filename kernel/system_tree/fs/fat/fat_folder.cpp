@@ -22,15 +22,15 @@ fat_filesystem::fat_folder::~fat_folder()
 
 }
 
-ERR_CODE fat_filesystem::fat_folder::get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child)
+ERR_CODE fat_filesystem::fat_folder::get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child)
 {
   ERR_CODE ec;
   std::shared_ptr<fat_file> file_obj;
   std::shared_ptr<fat_filesystem> parent_shared;
   std::shared_ptr<fat_folder> folder_obj;
   fat_dir_entry fde;
-  kl_string our_name_part;
-  kl_string child_name_part;
+  kl_string_view our_name_part;
+  kl_string_view child_name_part;
 
   KL_TRC_ENTRY;
 
@@ -42,11 +42,11 @@ ERR_CODE fat_filesystem::fat_folder::get_child(const kl_string &name, std::share
 
     split_name(name, our_name_part, child_name_part);
 
-    ec = this->get_dir_entry(our_name_part, fde);
+    ec = this->get_dir_entry(kl_string(our_name_part), fde);
 
     if (ec == ERR_CODE::NO_ERROR)
     {
-      if (child_name_part == "")
+      if (child_name_part.empty())
       {
         KL_TRC_TRACE(TRC_LVL::FLOW, "Requested a direct dependent\n");
         if (fde.attributes.directory)
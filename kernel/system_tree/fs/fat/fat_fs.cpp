@@ -122,7 +122,7 @@ fat_filesystem::~fat_filesystem()
   KL_TRC_EXIT;
 }
 
-ERR_CODE fat_filesystem::get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child)
+ERR_CODE fat_filesystem::get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child)
 {
   KL_TRC_ENTRY;
 
@@ -19,7 +19,7 @@ public:
   static std::shared_ptr<fat_filesystem> create(std::shared_ptr<IBlockDevice> parent_device);
   virtual ~fat_filesystem();
 
-  virtual ERR_CODE get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
+  virtual ERR_CODE get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
   virtual ERR_CODE add_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> child) override;
   virtual ERR_CODE rename_child(const kl_string &old_name, const kl_string &new_name) override;
   virtual ERR_CODE delete_child(const kl_string &name) override;
@@ -42,6 +42,11 @@ public:
                           uint64_t buffer_length,
                           uint64_t &bytes_read) override;
 
+    virtual ERR_CODE read_bytes_vec(uint64_t start,
+                                    const io_vector *vectors,
+                                    uint64_t num_vectors,
+                                    uint64_t &bytes_read) override;
+
     virtual ERR_CODE write_bytes(uint64_t start,
                                  uint64_t length,
                                  const uint8_t *buffer,
@@ -70,7 +75,7 @@ public:
     fat_folder(fat_dir_entry file_data_record, std::shared_ptr<fat_filesystem> parent, bool root_directory = false);
     virtual ~fat_folder();
 
-    virtual ERR_CODE get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
+    virtual ERR_CODE get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
     virtual ERR_CODE add_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> child) override;
     virtual ERR_CODE rename_child(const kl_string &old_name, const kl_string &new_name) override;
     virtual ERR_CODE delete_child(const kl_string &name) override;
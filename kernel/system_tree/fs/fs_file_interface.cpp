@@ -0,0 +1,156 @@
+/// @file
+/// @brief Default implementations of the vectored file interface functions.
+///
+/// These simply split a vectored request into one call per buffer. Objects that can do better - for example by taking
+/// their lock once for the whole request - override them.
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "system_tree/fs/fs_file_interface.h"
+
+ERR_CODE IReadable::read_bytes_vec(uint64_t start,
+                                   const io_vector *vectors,
+                                   uint64_t num_vectors,
+                                   uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t this_read;
+  uint64_t total_length;
+
+  bytes_read = 0;
+
+  if (!fs_io_vectors_valid(vectors, num_vectors, total_length))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid vectors\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    for (uint64_t i = 0; i < num_vectors; i++)
+    {
+      if (vectors[i].length == 0)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Skip empty vector ", i, "\n");
+        continue;
+      }
+
+      this_read = 0;
+      result = this->read_bytes(start + bytes_read,
+                                vectors[i].length,
+                                reinterpret_cast<uint8_t *>(vectors[i].buffer),
+                                vectors[i].length,
+                                this_read);
+      bytes_read += this_read;
+
+      if ((result != ERR_CODE::NO_ERROR) || (this_read < vectors[i].length))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Read stopped early in vector ", i, "\n");
+        break;
+      }
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes read: ", bytes_read, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE IWritable::write_bytes_vec(uint64_t start,
+                                    const io_vector *vectors,
+                                    uint64_t num_vectors,
+                                    uint64_t &bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t this_write;
+  uint64_t total_length;
+
+  bytes_written = 0;
+
+  if (!fs_io_vectors_valid(vectors, num_vectors, total_length))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid vectors\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    for (uint64_t i = 0; i < num_vectors; i++)
+    {
+      if (vectors[i].length == 0)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Skip empty vector ", i, "\n");
+        continue;
+      }
+
+      this_write = 0;
+      result = this->write_bytes(start + bytes_written,
+                                 vectors[i].length,
+                                 reinterpret_cast<const uint8_t *>(vectors[i].buffer),
+                                 vectors[i].length,
+                                 this_write);
+      bytes_written += this_write;
+
+      if ((result != ERR_CODE::NO_ERROR) || (this_write < vectors[i].length))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Write stopped early in vector ", i, "\n");
+        break;
+      }
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes written: ", bytes_written, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Check that a set of I/O vectors can be used, and find their total length.
+///
+/// @param vectors The vectors to check.
+///
+/// @param num_vectors The number of entries in vectors.
+///
+/// @param[out] total_length The sum of the lengths of all the vectors.
+///
+/// @return True if every non-empty vector has a buffer and the total length doesn't overflow, false otherwise.
+bool fs_io_vectors_valid(const io_vector *vectors, uint64_t num_vectors, uint64_t &total_length)
+{
+  KL_TRC_ENTRY;
+
+  bool result = true;
+
+  total_length = 0;
+
+  if ((vectors == nullptr) && (num_vectors != 0))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No vectors given\n");
+    result = false;
+  }
+  else
+  {
+    for (uint64_t i = 0; i < num_vectors; i++)
+    {
+      if (((vectors[i].buffer == nullptr) && (vectors[i].length != 0)) ||
+          (total_length + vectors[i].length < total_length))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Bad vector: ", i, "\n");
+        result = false;
+        break;
+      }
+
+      total_length += vectors[i].length;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
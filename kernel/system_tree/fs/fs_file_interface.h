@@ -2,6 +2,7 @@
 #define FS_FILE_INTFACE_H
 
 #include "user_interfaces/error_codes.h"
+#include "user_interfaces/kernel_types.h"
 
 /// @brief Interface for all objects that support arbitrarily sized reads.
 class IReadable
@@ -36,6 +37,28 @@ public:
                               uint8_t *buffer,
                               uint64_t buffer_length,
                               uint64_t &bytes_read) = 0;
+
+  /// @brief Read bytes from a readable object into several buffers.
+  ///
+  /// Reads a contiguous set of bytes from the object, filling each buffer in `vectors` in turn before moving on to the
+  /// next. The default implementation calls read_bytes() once per buffer - objects that can service the whole vector
+  /// in one pass should override it.
+  ///
+  /// @param start The first byte in the object to read from.
+  ///
+  /// @param vectors The buffers to read into. Buffers of zero length are skipped.
+  ///
+  /// @param num_vectors The number of entries in `vectors`.
+  ///
+  /// @param[out] bytes_read The total number of bytes read into all the buffers. The read stops early for the same
+  ///                        reasons as read_bytes(), in which case the later buffers are not modified.
+  ///
+  /// @return An appropriate choice from `ERR_CODE`. If the read succeeds, even if the number of bytes is not as
+  ///         requested, then the result will be `NO_ERROR`.
+  virtual ERR_CODE read_bytes_vec(uint64_t start,
+                                  const io_vector *vectors,
+                                  uint64_t num_vectors,
+                                  uint64_t &bytes_read);
 };
 
 /// @brief Interface for objects that support arbitrarily sized writes
@@ -70,8 +93,32 @@ public:
                                const uint8_t *buffer,
                                uint64_t buffer_length,
                                uint64_t &bytes_written) = 0;
+
+  /// @brief Write bytes to a writable object from several buffers.
+  ///
+  /// Writes the contents of each buffer in `vectors` in turn, as a contiguous set of bytes in the object. The default
+  /// implementation calls write_bytes() once per buffer - objects that can service the whole vector in one pass should
+  /// override it.
+  ///
+  /// @param start The first byte in the object to write to.
+  ///
+  /// @param vectors The buffers to write from. Buffers of zero length are skipped.
+  ///
+  /// @param num_vectors The number of entries in `vectors`.
+  ///
+  /// @param[out] bytes_written The total number of bytes written from all the buffers. The write stops early for the
+  ///                           same reasons as write_bytes().
+  ///
+  /// @return An appropriate choice from `ERR_CODE`. If the write succeeds, even if the number of bytes is not as
+  ///         requested, then the result will be `NO_ERROR`.
+  virtual ERR_CODE write_bytes_vec(uint64_t start,
+                                   const io_vector *vectors,
+                                   uint64_t num_vectors,
+                                   uint64_t &bytes_written);
 };
 
+bool fs_io_vectors_valid(const io_vector *vectors, uint64_t num_vectors, uint64_t &total_length);
+
 /// @brief Interface for objects that act like files on a traditional file system.
 class IBasicFile: public IReadable, public IWritable
 {
@@ -10,6 +10,7 @@
 
 #include <klib/klib.h>
 #include "mem_fs.h"
+#include "system_tree/process/process.h"
 
 #include <memory>
 
@@ -152,6 +153,115 @@ ERR_CODE mem_fs_leaf::write_bytes(uint64_t start,
 
   klib_synch_spinlock_unlock(this->_lock);
 
+  // Any process started from this file from now on must see the new contents.
+  proc_image_cache_invalidate(this);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Read from the file into several buffers, holding the file's lock throughout.
+///
+/// See IReadable::read_bytes_vec() for details of the parameters and return value.
+ERR_CODE mem_fs_leaf::read_bytes_vec(uint64_t start,
+                                     const io_vector *vectors,
+                                     uint64_t num_vectors,
+                                     uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t total_length;
+  uint64_t this_length;
+  uint64_t offset;
+
+  bytes_read = 0;
+
+  if (!fs_io_vectors_valid(vectors, num_vectors, total_length))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid vectors\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    klib_synch_spinlock_lock(this->_lock);
+
+    for (uint64_t i = 0; i < num_vectors; i++)
+    {
+      offset = start + bytes_read;
+      if (offset >= _buffer_length)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Reached end of file\n");
+        break;
+      }
+
+      this_length = vectors[i].length;
+      if (this_length > (_buffer_length - offset))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Truncating read\n");
+        this_length = _buffer_length - offset;
+      }
+
+      kl_memcpy(_buffer.get() + offset, vectors[i].buffer, this_length);
+      bytes_read += this_length;
+    }
+
+    klib_synch_spinlock_unlock(this->_lock);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes read: ", bytes_read, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Write to the file from several buffers, holding the file's lock throughout.
+///
+/// The file is extended at most once, to fit the whole write. See IWritable::write_bytes_vec() for details of the
+/// parameters and return value.
+ERR_CODE mem_fs_leaf::write_bytes_vec(uint64_t start,
+                                      const io_vector *vectors,
+                                      uint64_t num_vectors,
+                                      uint64_t &bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t total_length;
+
+  bytes_written = 0;
+
+  if (!fs_io_vectors_valid(vectors, num_vectors, total_length))
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid vectors\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    klib_synch_spinlock_lock(this->_lock);
+
+    if (start + total_length > this->_buffer_length)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Increasing buffer size\n");
+      this->_no_lock_set_file_size(start + total_length);
+    }
+
+    for (uint64_t i = 0; i < num_vectors; i++)
+    {
+      kl_memcpy(vectors[i].buffer, _buffer.get() + start + bytes_written, vectors[i].length);
+      bytes_written += vectors[i].length;
+    }
+
+    ASSERT(bytes_written == total_length);
+
+    klib_synch_spinlock_unlock(this->_lock);
+
+    proc_image_cache_invalidate(this);
+  }
+
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
   KL_TRC_EXIT;
 
@@ -177,6 +287,8 @@ ERR_CODE mem_fs_leaf::set_file_size(uint64_t file_size)
   this->_no_lock_set_file_size(file_size);
   klib_synch_spinlock_unlock(this->_lock);
 
+  proc_image_cache_invalidate(this);
+
   KL_TRC_EXIT;
   return ERR_CODE::NO_ERROR;
 }
@@ -217,4 +329,4 @@ void mem_fs_leaf::_no_lock_set_file_size(uint64_t file_size)
   _buffer.reset(new_buffer);
 
   KL_TRC_EXIT;
-}
\ No newline at end of file
+}
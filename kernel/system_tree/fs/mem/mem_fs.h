@@ -40,6 +40,16 @@ public:
                                 uint64_t buffer_length,
                                 uint64_t &bytes_written) override;
 
+  virtual ERR_CODE read_bytes_vec(uint64_t start,
+                                  const io_vector *vectors,
+                                  uint64_t num_vectors,
+                                  uint64_t &bytes_read) override;
+
+  virtual ERR_CODE write_bytes_vec(uint64_t start,
+                                   const io_vector *vectors,
+                                   uint64_t num_vectors,
+                                   uint64_t &bytes_written) override;
+
   virtual ERR_CODE get_file_size(uint64_t &file_size) override;
   virtual ERR_CODE set_file_size(uint64_t file_size) override;
 
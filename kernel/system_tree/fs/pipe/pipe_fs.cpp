@@ -9,18 +9,16 @@ using namespace std;
 
 namespace
 {
+  // Must be a power of two, as required by kl_spsc_ring.
   const uint64_t NORMAL_BUFFER_SIZE = 1 << 10;
   const char read_leaf_name[] = "read";
   const char write_leaf_name[] = "write";
 }
 
-pipe_branch::pipe_branch() : _buffer(new uint8_t[NORMAL_BUFFER_SIZE])
+pipe_branch::pipe_branch() : _ring(NORMAL_BUFFER_SIZE)
 {
   KL_TRC_ENTRY;
 
-  _read_ptr = _buffer.get();
-  _write_ptr = _read_ptr;
-
   klib_synch_spinlock_init(this->_pipe_lock);
 
   KL_TRC_EXIT;
@@ -41,7 +39,7 @@ pipe_branch::~pipe_branch()
   KL_TRC_EXIT;
 }
 
-ERR_CODE pipe_branch::get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child)
+ERR_CODE pipe_branch::get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child)
 {
   ERR_CODE ret = ERR_CODE::NOT_FOUND;
   KL_TRC_ENTRY;
@@ -109,52 +107,73 @@ ERR_CODE pipe_branch::pipe_read_leaf::read_bytes(uint64_t start,
                                                  uint64_t &bytes_read)
 {
   ERR_CODE ret = ERR_CODE::UNKNOWN;
+  io_vector vector;
+
+  KL_TRC_ENTRY;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid buffer ptr\n");
+    ret = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    if (length > buffer_length)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Truncate to buffer_length\n");
+      length = buffer_length;
+    }
+
+    vector.buffer = buffer;
+    vector.length = length;
+    ret = this->read_bytes_vec(start, &vector, 1, bytes_read);
+  }
+
+  KL_TRC_EXIT;
+
+  return ret;
+}
+
+/// @brief Read from the pipe into several buffers.
+///
+/// The pipe is locked once for the whole read. If the leaf is set to block, this waits until the pipe contains enough
+/// bytes to fill every buffer. See IReadable::read_bytes_vec() for details of the parameters and return value.
+ERR_CODE pipe_branch::pipe_read_leaf::read_bytes_vec(uint64_t start,
+                                                     const io_vector *vectors,
+                                                     uint64_t num_vectors,
+                                                     uint64_t &bytes_read)
+{
+  ERR_CODE ret = ERR_CODE::UNKNOWN;
+  uint64_t length;
   uint64_t read_length;
   uint64_t avail_length;
-  uint64_t rp;
-  uint64_t wp;
-  uint64_t buf_start;
+  uint64_t this_length;
 
   std::shared_ptr<pipe_branch> parent_branch = this->_parent.lock();
 
   KL_TRC_ENTRY;
 
+  bytes_read = 0;
+
   if (!parent_branch)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Parent branch deleted\n");
     ret = ERR_CODE::INVALID_OP;
   }
-  else if (buffer == nullptr)
+  else if (!fs_io_vectors_valid(vectors, num_vectors, length))
   {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid buffer ptr\n");
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid vectors\n");
     ret = ERR_CODE::INVALID_PARAM;
   }
   else
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Try to read ", length, " bytes from the pipe\n");
 
-    if (length > buffer_length)
-    {
-      KL_TRC_TRACE(TRC_LVL::FLOW, "Truncate to buffer_length\n");
-      length = buffer_length;
-    }
-
     klib_synch_spinlock_lock(parent_branch->_pipe_lock);
 
     while (1)
     {
-      rp = reinterpret_cast<uint64_t>(parent_branch->_read_ptr);
-      wp = reinterpret_cast<uint64_t>(parent_branch->_write_ptr);
-      buf_start = reinterpret_cast<uint64_t>(parent_branch->_buffer.get());
-
-      if (wp >= rp)
-      {
-        avail_length = wp - rp;
-      }
-      else
-      {
-        avail_length = (NORMAL_BUFFER_SIZE + wp) - rp;
-      }
+      avail_length = parent_branch->_ring.entries_available();
       KL_TRC_TRACE(TRC_LVL::EXTRA, "Available bytes to read: ", avail_length, "\n");
 
       if (this->block_on_read && (avail_length < length))
@@ -178,20 +197,15 @@ ERR_CODE pipe_branch::pipe_read_leaf::read_bytes(uint64_t start,
       read_length = length;
     }
 
-    // This isn't particularly elegant, but it'll do for now.
-    // Perhaps we could make a generic ring-buffer?
-    bytes_read = 0;
-    for (int i = 0; i < read_length; i++, bytes_read++)
+    for (uint64_t i = 0; (i < num_vectors) && (bytes_read < read_length); i++)
     {
-      *buffer = *parent_branch->_read_ptr;
-      buffer++;
-      parent_branch->_read_ptr++;
-      rp = reinterpret_cast<uint64_t>(parent_branch->_read_ptr);
-      if (rp > buf_start + NORMAL_BUFFER_SIZE)
+      this_length = vectors[i].length;
+      if (this_length > (read_length - bytes_read))
       {
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Read pointer wrapped\n");
-        parent_branch->_read_ptr = parent_branch->_buffer.get();
+        this_length = read_length - bytes_read;
       }
+
+      bytes_read += parent_branch->_ring.pop_bulk(reinterpret_cast<uint8_t *>(vectors[i].buffer), this_length);
     }
 
     ASSERT(read_length == bytes_read);
@@ -232,70 +246,89 @@ ERR_CODE pipe_branch::pipe_write_leaf::write_bytes(uint64_t start,
                                                    uint64_t &bytes_written)
 {
   ERR_CODE ret = ERR_CODE::UNKNOWN;
+  io_vector vector;
+
+  KL_TRC_ENTRY;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid buffer ptr\n");
+    ret = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    if (buffer_length < length)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Truncate write to buffer length\n");
+      length = buffer_length;
+    }
+
+    vector.buffer = const_cast<uint8_t *>(buffer);
+    vector.length = length;
+    ret = this->write_bytes_vec(start, &vector, 1, bytes_written);
+  }
+
+  KL_TRC_EXIT;
+
+  return ret;
+}
+
+/// @brief Write to the pipe from several buffers.
+///
+/// The pipe is locked once for the whole write, so the contents of the buffers arrive together, in order, without
+/// being interleaved with other writers. See IWritable::write_bytes_vec() for details of the parameters and return
+/// value.
+ERR_CODE pipe_branch::pipe_write_leaf::write_bytes_vec(uint64_t start,
+                                                       const io_vector *vectors,
+                                                       uint64_t num_vectors,
+                                                       uint64_t &bytes_written)
+{
+  ERR_CODE ret = ERR_CODE::UNKNOWN;
+  uint64_t length;
   uint64_t write_length;
   uint64_t avail_length;
-  uint64_t rp;
-  uint64_t wp;
-  uint64_t buf_start;
+  uint64_t this_length;
   std::shared_ptr<pipe_branch> parent_branch = this->_parent.lock();
 
   KL_TRC_ENTRY;
 
+  bytes_written = 0;
+
   if (!parent_branch)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Parent branch deleted\n");
     ret = ERR_CODE::INVALID_OP;
   }
-  else if (buffer == nullptr)
+  else if (!fs_io_vectors_valid(vectors, num_vectors, length))
   {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid buffer ptr\n");
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid vectors\n");
     ret = ERR_CODE::INVALID_PARAM;
   }
   else
   {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Try to write from the pipe\n");
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Try to write to the pipe\n");
     klib_synch_spinlock_lock(parent_branch->_pipe_lock);
 
-    rp = reinterpret_cast<uint64_t>(parent_branch->_read_ptr);
-    wp = reinterpret_cast<uint64_t>(parent_branch->_write_ptr);
-    buf_start = reinterpret_cast<uint64_t>(parent_branch->_buffer.get());
-
-    if (rp > wp)
-    {
-      avail_length = rp - wp;
-    }
-    else
-    {
-      avail_length = (NORMAL_BUFFER_SIZE + rp) - wp;
-    }
+    avail_length = parent_branch->_ring.space_available();
     KL_TRC_TRACE(TRC_LVL::EXTRA, "Available bytes to write: ", avail_length, "\n");
 
     write_length = avail_length;
-    if (buffer_length < write_length)
-    {
-      KL_TRC_TRACE(TRC_LVL::FLOW, "Truncate write to buffer length\n");
-      write_length = buffer_length;
-    }
     if (length < write_length)
     {
-      KL_TRC_TRACE(TRC_LVL::FLOW, "Truncate read to requested length\n");
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Truncate write to requested length\n");
       write_length = length;
     }
 
-    // This isn't particularly elegant, but it'll do for now.
-    // Perhaps we could make a generic ring-buffer?
-    bytes_written = 0;
-    for (int i = 0; i < write_length; i++, bytes_written++)
+    for (uint64_t i = 0; (i < num_vectors) && (bytes_written < write_length); i++)
     {
-      *parent_branch->_write_ptr = *buffer;
-      buffer++;
-      parent_branch->_write_ptr++;
-      wp = reinterpret_cast<uint64_t>(parent_branch->_write_ptr);
-      if (wp > buf_start + NORMAL_BUFFER_SIZE)
+      this_length = vectors[i].length;
+      if (this_length > (write_length - bytes_written))
       {
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Write pointer wrapped\n");
-        parent_branch->_write_ptr = parent_branch->_buffer.get();
+        this_length = write_length - bytes_written;
       }
+
+      bytes_written += parent_branch->_ring.push_bulk(reinterpret_cast<const uint8_t *>(vectors[i].buffer),
+                                                      this_length);
     }
 
     ASSERT(write_length == bytes_written);
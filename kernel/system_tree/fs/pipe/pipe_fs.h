@@ -2,6 +2,7 @@
 #define ST_FS_PIPE_HEADER
 
 #include "klib/klib.h"
+#include "klib/data_structures/ring_buffer.h"
 
 #include "system_tree/system_tree_branch.h"
 #include "system_tree/fs/fs_file_interface.h"
@@ -20,7 +21,7 @@ public:
   static std::shared_ptr<pipe_branch> create();
   virtual ~pipe_branch();
 
-  virtual ERR_CODE get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
+  virtual ERR_CODE get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
   virtual ERR_CODE add_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> child) override;
   virtual ERR_CODE rename_child(const kl_string &old_name, const kl_string &new_name) override;
   virtual ERR_CODE delete_child(const kl_string &name) override;
@@ -40,6 +41,11 @@ public:
                                 uint64_t buffer_length,
                                 uint64_t &bytes_read) override;
 
+    virtual ERR_CODE read_bytes_vec(uint64_t start,
+                                    const io_vector *vectors,
+                                    uint64_t num_vectors,
+                                    uint64_t &bytes_read) override;
+
     virtual void set_block_on_read(bool block);
 
   protected:
@@ -61,14 +67,19 @@ public:
                                  uint64_t buffer_length,
                                  uint64_t &bytes_written) override;
 
+    virtual ERR_CODE write_bytes_vec(uint64_t start,
+                                     const io_vector *vectors,
+                                     uint64_t num_vectors,
+                                     uint64_t &bytes_written) override;
+
   protected:
     std::weak_ptr<pipe_branch> _parent;
   };
 
 protected:
-  std::unique_ptr<uint8_t[]> _buffer;
-  uint8_t *_read_ptr;
-  uint8_t *_write_ptr;
+  /// The contents of the pipe. There may be several readers and writers, so they take _pipe_lock to make sure the ring
+  /// only ever has one producer and one consumer at a time.
+  kl_spsc_ring<uint8_t> _ring;
 
   kernel_spinlock _pipe_lock;
 };
@@ -51,6 +51,139 @@ public:
     std::shared_ptr<mem_fs_leaf> _id_file;
   };
 
+  /// @brief Leaf presenting the system call statistics of a single process as text.
+  ///
+  /// The first line describes the format. It is followed by one line per system call the process has made, giving the
+  /// call's index, the number of calls, the total number of TSC ticks spent in them, and then the number of calls
+  /// falling in each latency bucket. See syscall/syscall_stats.h for the bucket sizes.
+  ///
+  /// The text is generated afresh on each call, so reads are only consistent with each other if the process isn't
+  /// making system calls in the meantime.
+  class proc_fs_syscall_stats_leaf : public IBasicFile, public ISystemTreeLeaf
+  {
+  public:
+    proc_fs_syscall_stats_leaf(std::shared_ptr<task_process> related_proc);
+    virtual ~proc_fs_syscall_stats_leaf();
+
+    virtual ERR_CODE read_bytes(uint64_t start,
+                                uint64_t length,
+                                uint8_t *buffer,
+                                uint64_t buffer_length,
+                                uint64_t &bytes_read) override;
+    virtual ERR_CODE write_bytes(uint64_t start,
+                                 uint64_t length,
+                                 const uint8_t *buffer,
+                                 uint64_t buffer_length,
+                                 uint64_t &bytes_written) override;
+    virtual ERR_CODE get_file_size(uint64_t &file_size) override;
+    virtual ERR_CODE set_file_size(uint64_t file_size) override;
+
+  protected:
+    char *generate_text(uint64_t &text_length);
+
+    std::weak_ptr<task_process> _related_proc;
+  };
+
+  /// @brief Leaf giving access to the binary trace records stored by the kernel.
+  ///
+  /// Reading the leaf removes records from the trace rings, so each record can only be read once. Only whole records
+  /// are returned, so reads should be made in multiples of sizeof(kl_trc_record). The starting offset is ignored.
+  ///
+  /// The file size is the number of bytes of records currently waiting.
+  class proc_fs_trace_leaf : public IBasicFile, public ISystemTreeLeaf
+  {
+  public:
+    proc_fs_trace_leaf();
+    virtual ~proc_fs_trace_leaf();
+
+    virtual ERR_CODE read_bytes(uint64_t start,
+                                uint64_t length,
+                                uint8_t *buffer,
+                                uint64_t buffer_length,
+                                uint64_t &bytes_read) override;
+    virtual ERR_CODE write_bytes(uint64_t start,
+                                 uint64_t length,
+                                 const uint8_t *buffer,
+                                 uint64_t buffer_length,
+                                 uint64_t &bytes_written) override;
+    virtual ERR_CODE get_file_size(uint64_t &file_size) override;
+    virtual ERR_CODE set_file_size(uint64_t file_size) override;
+  };
+
+  /// @brief Leaf that shows and changes which trace categories and levels are output.
+  ///
+  /// Reading gives one "<category> <level>" line per category. Writing applies lines of the same form, as described by
+  /// kl_trc_apply_control() - the whole write is treated as a set of commands, and the starting offset is ignored.
+  class proc_fs_trace_control_leaf : public IBasicFile, public ISystemTreeLeaf
+  {
+  public:
+    proc_fs_trace_control_leaf();
+    virtual ~proc_fs_trace_control_leaf();
+
+    virtual ERR_CODE read_bytes(uint64_t start,
+                                uint64_t length,
+                                uint8_t *buffer,
+                                uint64_t buffer_length,
+                                uint64_t &bytes_read) override;
+    virtual ERR_CODE write_bytes(uint64_t start,
+                                 uint64_t length,
+                                 const uint8_t *buffer,
+                                 uint64_t buffer_length,
+                                 uint64_t &bytes_written) override;
+    virtual ERR_CODE get_file_size(uint64_t &file_size) override;
+    virtual ERR_CODE set_file_size(uint64_t file_size) override;
+  };
+
+  /// @brief Leaf giving access to the samples taken by the profiler, and controlling it.
+  ///
+  /// Reading the leaf removes samples from the profiler's rings, so each sample can only be read once. Only whole
+  /// samples are returned, so reads should be made in multiples of sizeof(prof_sample). The starting offset is ignored.
+  ///
+  /// Writing "start", optionally followed by the number of scheduler ticks between samples, starts the profiler.
+  /// Writing "stop" stops it. The file size is the number of bytes of samples currently waiting.
+  class proc_fs_profile_leaf : public IBasicFile, public ISystemTreeLeaf
+  {
+  public:
+    proc_fs_profile_leaf();
+    virtual ~proc_fs_profile_leaf();
+
+    virtual ERR_CODE read_bytes(uint64_t start,
+                                uint64_t length,
+                                uint8_t *buffer,
+                                uint64_t buffer_length,
+                                uint64_t &bytes_read) override;
+    virtual ERR_CODE write_bytes(uint64_t start,
+                                 uint64_t length,
+                                 const uint8_t *buffer,
+                                 uint64_t buffer_length,
+                                 uint64_t &bytes_written) override;
+    virtual ERR_CODE get_file_size(uint64_t &file_size) override;
+    virtual ERR_CODE set_file_size(uint64_t file_size) override;
+  };
+
+  /// @brief Leaf showing how long each phase of kernel startup took.
+  ///
+  /// Reading gives the text produced by boot_phase_describe(). The leaf is read-only.
+  class proc_fs_boot_times_leaf : public IBasicFile, public ISystemTreeLeaf
+  {
+  public:
+    proc_fs_boot_times_leaf();
+    virtual ~proc_fs_boot_times_leaf();
+
+    virtual ERR_CODE read_bytes(uint64_t start,
+                                uint64_t length,
+                                uint8_t *buffer,
+                                uint64_t buffer_length,
+                                uint64_t &bytes_read) override;
+    virtual ERR_CODE write_bytes(uint64_t start,
+                                 uint64_t length,
+                                 const uint8_t *buffer,
+                                 uint64_t buffer_length,
+                                 uint64_t &bytes_written) override;
+    virtual ERR_CODE get_file_size(uint64_t &file_size) override;
+    virtual ERR_CODE set_file_size(uint64_t file_size) override;
+  };
+
 protected:
 
   /// @brief Branch that returns the child objects of the currently running process.
@@ -63,7 +196,7 @@ protected:
     proc_fs_zero_proxy_branch(std::shared_ptr<proc_fs_root_branch> parent);
     virtual ~proc_fs_zero_proxy_branch();
 
-    virtual ERR_CODE get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
+    virtual ERR_CODE get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
     virtual ERR_CODE add_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> child) override;
     virtual ERR_CODE rename_child(const kl_string &old_name, const kl_string &new_name) override;
     virtual ERR_CODE delete_child(const kl_string &name) override;
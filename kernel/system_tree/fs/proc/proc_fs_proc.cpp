@@ -33,6 +33,11 @@ proc_fs_root_branch::proc_fs_proc_branch::proc_fs_proc_branch(std::shared_ptr<ta
   ec = system_tree_simple_branch::add_child("id", _id_file);
   ASSERT(ec == ERR_CODE::NO_ERROR);
 
+#ifdef AZALEA_SYSCALL_STATS
+  ec = system_tree_simple_branch::add_child("syscalls", std::make_shared<proc_fs_syscall_stats_leaf>(related_proc));
+  ASSERT(ec == ERR_CODE::NO_ERROR);
+#endif
+
   KL_TRC_EXIT;
 }
 
@@ -48,6 +53,9 @@ proc_fs_root_branch::proc_fs_proc_branch::~proc_fs_proc_branch()
   KL_TRC_ENTRY;
 
   system_tree_simple_branch::delete_child("id");
+#ifdef AZALEA_SYSCALL_STATS
+  system_tree_simple_branch::delete_child("syscalls");
+#endif
 
   KL_TRC_EXIT;
 }
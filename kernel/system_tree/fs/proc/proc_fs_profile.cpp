@@ -0,0 +1,173 @@
+/// @file
+/// @brief Implementation of the file giving access to the profiler in 'proc'.
+///
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "processor/profiler.h"
+#include "system_tree/fs/proc/proc_fs.h"
+
+namespace
+{
+  // Parse a decimal number that fills the whole of text. Returns false if there isn't one, or it doesn't fit.
+  bool profile_parse_number(const kl_string_view &text, uint32_t &number)
+  {
+    uint64_t value = 0;
+
+    if ((text.length() == 0) || (text.length() > 9))
+    {
+      return false;
+    }
+
+    for (uint64_t i = 0; i < text.length(); i++)
+    {
+      if ((text[i] < '0') || (text[i] > '9'))
+      {
+        return false;
+      }
+      value = (value * 10) + (text[i] - '0');
+    }
+
+    number = static_cast<uint32_t>(value);
+    return true;
+  }
+}
+
+proc_fs_root_branch::proc_fs_profile_leaf::proc_fs_profile_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+proc_fs_root_branch::proc_fs_profile_leaf::~proc_fs_profile_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_profile_leaf::read_bytes(uint64_t start,
+                                                               uint64_t length,
+                                                               uint8_t *buffer,
+                                                               uint64_t buffer_length,
+                                                               uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t max_samples;
+
+  bytes_read = 0;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No buffer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    max_samples = (length < buffer_length ? length : buffer_length) / sizeof(prof_sample);
+
+    // prof_sample contains only integers, so the samples can be stored straight in to the buffer.
+    bytes_read = prof_drain(reinterpret_cast<prof_sample *>(buffer), max_samples) * sizeof(prof_sample);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes read: ", bytes_read, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_profile_leaf::write_bytes(uint64_t start,
+                                                                uint64_t length,
+                                                                const uint8_t *buffer,
+                                                                uint64_t buffer_length,
+                                                                uint64_t &bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  kl_string_view command;
+  uint64_t space;
+  uint32_t interval = PROF_DEFAULT_INTERVAL;
+
+  bytes_written = 0;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No buffer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    if (length > buffer_length)
+    {
+      length = buffer_length;
+    }
+
+    command = kl_string_view(reinterpret_cast<const char *>(buffer), length);
+    while ((command.length() != 0) &&
+           ((command[command.length() - 1] == '\n') || (command[command.length() - 1] == '\r')))
+    {
+      command = command.substr(0, command.length() - 1);
+    }
+
+    space = command.find(' ');
+
+    if (command == kl_string_view("stop"))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Stop profiler\n");
+      prof_stop();
+    }
+    else if (command.substr(0, space) == kl_string_view("start"))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Start profiler\n");
+      if ((space != kl_string_view::npos) && !profile_parse_number(command.substr(space + 1), interval))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Bad interval\n");
+        result = ERR_CODE::INVALID_PARAM;
+      }
+      else
+      {
+        result = prof_start(interval);
+      }
+    }
+    else
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Unknown command\n");
+      result = ERR_CODE::INVALID_PARAM;
+    }
+
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      bytes_written = length;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes written: ", bytes_written, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_profile_leaf::get_file_size(uint64_t &file_size)
+{
+  KL_TRC_ENTRY;
+
+  file_size = prof_waiting() * sizeof(prof_sample);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "File size: ", file_size, "\n");
+  KL_TRC_EXIT;
+
+  return ERR_CODE::NO_ERROR;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_profile_leaf::set_file_size(uint64_t file_size)
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+
+  return ERR_CODE::INVALID_OP;
+}
@@ -13,6 +13,14 @@ proc_fs_root_branch::proc_fs_root_branch() :
 {
   KL_TRC_ENTRY;
 
+  ASSERT(system_tree_simple_branch::add_child("trace", std::make_shared<proc_fs_trace_leaf>()) == ERR_CODE::NO_ERROR);
+  ASSERT(system_tree_simple_branch::add_child("trace_control", std::make_shared<proc_fs_trace_control_leaf>()) ==
+         ERR_CODE::NO_ERROR);
+  ASSERT(system_tree_simple_branch::add_child("profile", std::make_shared<proc_fs_profile_leaf>()) ==
+         ERR_CODE::NO_ERROR);
+  ASSERT(system_tree_simple_branch::add_child("boot_times", std::make_shared<proc_fs_boot_times_leaf>()) ==
+         ERR_CODE::NO_ERROR);
+
   KL_TRC_EXIT;
 }
 
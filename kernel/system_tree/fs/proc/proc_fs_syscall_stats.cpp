@@ -0,0 +1,195 @@
+/// @file
+/// @brief Implementation of the file giving a process's system call statistics in 'proc'.
+///
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "system_tree/fs/proc/proc_fs.h"
+#include "syscall/syscall_stats.h"
+
+using namespace std;
+
+namespace
+{
+  const char stats_header[] = "# index count total_ticks histogram\n";
+
+  // Enough space for one line: the index, count and total, one value per bucket, separating spaces and the newline.
+  const uint64_t MAX_LINE_LEN = (SYSCALL_STATS_NUM_BUCKETS + 3) * 21 + 1;
+}
+
+proc_fs_root_branch::proc_fs_syscall_stats_leaf::proc_fs_syscall_stats_leaf(shared_ptr<task_process> related_proc) :
+  _related_proc(related_proc)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(related_proc != nullptr);
+
+  KL_TRC_EXIT;
+}
+
+proc_fs_root_branch::proc_fs_syscall_stats_leaf::~proc_fs_syscall_stats_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_syscall_stats_leaf::read_bytes(uint64_t start,
+                                                                     uint64_t length,
+                                                                     uint8_t *buffer,
+                                                                     uint64_t buffer_length,
+                                                                     uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  char *text;
+  uint64_t text_length;
+
+  bytes_read = 0;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No buffer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    text = generate_text(text_length);
+    if (text == nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Process has gone\n");
+      result = ERR_CODE::NOT_FOUND;
+    }
+    else
+    {
+      if (start < text_length)
+      {
+        bytes_read = text_length - start;
+        if (bytes_read > length)
+        {
+          bytes_read = length;
+        }
+        if (bytes_read > buffer_length)
+        {
+          bytes_read = buffer_length;
+        }
+
+        kl_memcpy(text + start, buffer, bytes_read);
+      }
+
+      delete[] text;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes read: ", bytes_read, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_syscall_stats_leaf::write_bytes(uint64_t start,
+                                                                      uint64_t length,
+                                                                      const uint8_t *buffer,
+                                                                      uint64_t buffer_length,
+                                                                      uint64_t &bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  bytes_written = 0;
+
+  KL_TRC_EXIT;
+
+  return ERR_CODE::INVALID_OP;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_syscall_stats_leaf::get_file_size(uint64_t &file_size)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  char *text;
+
+  text = generate_text(file_size);
+  if (text == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Process has gone\n");
+    result = ERR_CODE::NOT_FOUND;
+  }
+
+  delete[] text;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_syscall_stats_leaf::set_file_size(uint64_t file_size)
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+
+  return ERR_CODE::INVALID_OP;
+}
+
+/// @brief Write out the statistics of the related process as text.
+///
+/// @param[out] text_length The number of characters in the text, not including the terminating null.
+///
+/// @return A buffer containing the text, which the caller must release with delete[]. nullptr if the process no longer
+///         exists.
+char *proc_fs_root_branch::proc_fs_syscall_stats_leaf::generate_text(uint64_t &text_length)
+{
+  KL_TRC_ENTRY;
+
+  shared_ptr<task_process> proc = _related_proc.lock();
+  unique_ptr<syscall_stats_table> totals;
+  char *text = nullptr;
+  uint64_t buffer_length;
+  const syscall_stats_entry *entry;
+
+  text_length = 0;
+
+  if (proc)
+  {
+    totals = unique_ptr<syscall_stats_table>(new syscall_stats_table);
+    syscall_stats_sum(proc.get(), *totals);
+
+    buffer_length = sizeof(stats_header) + (SYSCALL_IDX_COUNT * MAX_LINE_LEN);
+    text = new char[buffer_length];
+    ASSERT(text != nullptr);
+
+    kl_memcpy(stats_header, text, sizeof(stats_header));
+    text_length = sizeof(stats_header) - 1;
+
+    for (uint32_t i = 0; i < SYSCALL_IDX_COUNT; i++)
+    {
+      entry = &totals->calls[i];
+      if (entry->count != 0)
+      {
+        text_length += klib_snprintf(text + text_length,
+                                     buffer_length - text_length,
+                                     "%u %lu %lu",
+                                     i,
+                                     entry->count,
+                                     entry->total_ticks);
+        for (uint32_t j = 0; j < SYSCALL_STATS_NUM_BUCKETS; j++)
+        {
+          text_length += klib_snprintf(text + text_length,
+                                       buffer_length - text_length,
+                                       " %lu",
+                                       entry->histogram[j]);
+        }
+        text_length += klib_snprintf(text + text_length, buffer_length - text_length, "\n");
+      }
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Text length: ", text_length, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", text, "\n");
+  KL_TRC_EXIT;
+
+  return text;
+}
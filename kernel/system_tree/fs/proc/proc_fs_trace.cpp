@@ -0,0 +1,88 @@
+/// @file
+/// @brief Implementation of the file giving access to binary trace records in 'proc'.
+///
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "system_tree/fs/proc/proc_fs.h"
+
+proc_fs_root_branch::proc_fs_trace_leaf::proc_fs_trace_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+proc_fs_root_branch::proc_fs_trace_leaf::~proc_fs_trace_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_leaf::read_bytes(uint64_t start,
+                                                             uint64_t length,
+                                                             uint8_t *buffer,
+                                                             uint64_t buffer_length,
+                                                             uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t max_records;
+
+  bytes_read = 0;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No buffer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    max_records = (length < buffer_length ? length : buffer_length) / sizeof(kl_trc_record);
+
+    // kl_trc_record contains only integers, so the records can be stored straight in to the buffer.
+    bytes_read = kl_trc_binary_drain(reinterpret_cast<kl_trc_record *>(buffer), max_records) * sizeof(kl_trc_record);
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes read: ", bytes_read, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_leaf::write_bytes(uint64_t start,
+                                                              uint64_t length,
+                                                              const uint8_t *buffer,
+                                                              uint64_t buffer_length,
+                                                              uint64_t &bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  bytes_written = 0;
+
+  KL_TRC_EXIT;
+
+  return ERR_CODE::INVALID_OP;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_leaf::get_file_size(uint64_t &file_size)
+{
+  KL_TRC_ENTRY;
+
+  file_size = kl_trc_binary_waiting() * sizeof(kl_trc_record);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "File size: ", file_size, "\n");
+  KL_TRC_EXIT;
+
+  return ERR_CODE::NO_ERROR;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_leaf::set_file_size(uint64_t file_size)
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+
+  return ERR_CODE::INVALID_OP;
+}
@@ -0,0 +1,129 @@
+/// @file
+/// @brief Implementation of the file that controls trace categories and levels in 'proc'.
+///
+
+//#define ENABLE_TRACING
+
+#include "klib/klib.h"
+#include "system_tree/fs/proc/proc_fs.h"
+
+proc_fs_root_branch::proc_fs_trace_control_leaf::proc_fs_trace_control_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+proc_fs_root_branch::proc_fs_trace_control_leaf::~proc_fs_trace_control_leaf()
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_control_leaf::read_bytes(uint64_t start,
+                                                                     uint64_t length,
+                                                                     uint8_t *buffer,
+                                                                     uint64_t buffer_length,
+                                                                     uint64_t &bytes_read)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t text_length;
+  char *text;
+
+  bytes_read = 0;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No buffer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    text_length = kl_trc_describe_levels(nullptr, 0);
+    text = new char[text_length + 1];
+    kl_trc_describe_levels(text, text_length + 1);
+
+    if (start < text_length)
+    {
+      bytes_read = text_length - start;
+      if (bytes_read > length)
+      {
+        bytes_read = length;
+      }
+      if (bytes_read > buffer_length)
+      {
+        bytes_read = buffer_length;
+      }
+
+      kl_memcpy(text + start, buffer, bytes_read);
+    }
+
+    delete[] text;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes read: ", bytes_read, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_control_leaf::write_bytes(uint64_t start,
+                                                                      uint64_t length,
+                                                                      const uint8_t *buffer,
+                                                                      uint64_t buffer_length,
+                                                                      uint64_t &bytes_written)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+
+  bytes_written = 0;
+
+  if (buffer == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No buffer\n");
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    if (length > buffer_length)
+    {
+      length = buffer_length;
+    }
+
+    result = kl_trc_apply_control(kl_string_view(reinterpret_cast<const char *>(buffer), length));
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      bytes_written = length;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Bytes written: ", bytes_written, "\n");
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_control_leaf::get_file_size(uint64_t &file_size)
+{
+  KL_TRC_ENTRY;
+
+  file_size = kl_trc_describe_levels(nullptr, 0);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "File size: ", file_size, "\n");
+  KL_TRC_EXIT;
+
+  return ERR_CODE::NO_ERROR;
+}
+
+ERR_CODE proc_fs_root_branch::proc_fs_trace_control_leaf::set_file_size(uint64_t file_size)
+{
+  KL_TRC_ENTRY;
+  KL_TRC_EXIT;
+
+  // Writes replace the settings rather than extending them, so truncating the file is allowed, but does nothing.
+  return ERR_CODE::NO_ERROR;
+}
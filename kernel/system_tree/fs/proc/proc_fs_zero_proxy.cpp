@@ -17,7 +17,7 @@ proc_fs_root_branch::proc_fs_zero_proxy_branch::~proc_fs_zero_proxy_branch()
 
 }
 
-ERR_CODE proc_fs_root_branch::proc_fs_zero_proxy_branch::get_child(const kl_string &name,
+ERR_CODE proc_fs_root_branch::proc_fs_zero_proxy_branch::get_child(const kl_string_view &name,
                                                                    std::shared_ptr<ISystemTreeLeaf> &child)
 {
   return this->get_current_proc_branch()->get_child(name, child);
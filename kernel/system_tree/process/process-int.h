@@ -0,0 +1,12 @@
+#ifndef __ST_PROCESS_INT_HEADER
+#define __ST_PROCESS_INT_HEADER
+
+#include "processor/processor.h"
+
+void proc_int_map_page_for_write(task_process *proc,
+                                 uint64_t page_addr,
+                                 void *window,
+                                 uint64_t fill_start = 0,
+                                 uint64_t fill_end = 0);
+
+#endif
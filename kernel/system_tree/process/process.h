@@ -3,8 +3,90 @@
 
 #include "processor/processor.h"
 #include "klib/data_structures/string.h"
+#include "system_tree/system_tree_leaf.h"
+
+/// The address in a new process at which its arguments and environment are stored. The default user mode stack ends
+/// just below this address.
+const uint64_t PROC_START_PARAMS_ADDR = 0x000000000F200000;
+
+/// The maximum space taken up by a process's arguments and environment, including the pointer arrays.
+const uint64_t PROC_START_PARAMS_MAX_SIZE = MEM_PAGE_SIZE;
+
+/// The number of pages the executable image cache may hold before it starts evicting images that no process is
+/// running.
+const uint64_t PROC_IMAGE_CACHE_MAX_PAGES = 32;
+
+/// @brief The read-only pages of an executable file, shared between all processes running that file.
+///
+/// Each page is also mapped into the kernel, which keeps the physical page alive for as long as the image exists, even
+/// if no process is using it. Processes hold a reference to the image they are running in task_process::exec_image.
+class proc_exec_image
+{
+public:
+  proc_exec_image(std::shared_ptr<ISystemTreeLeaf> file,
+                  const kl_string &file_name,
+                  uint64_t file_size,
+                  const uint8_t *headers,
+                  uint64_t headers_len,
+                  uint64_t max_pages);
+  ~proc_exec_image();
+
+  bool matches(ISystemTreeLeaf *file, uint64_t file_size, const uint8_t *headers, uint64_t headers_len);
+  bool is_from(ISystemTreeLeaf *file);
+  bool has_page(uint64_t user_addr);
+  void adopt_page(task_process *proc, uint64_t user_addr);
+  void map_into(task_process *proc);
+
+  /// The file this image was loaded from. The image doesn't keep the file alive.
+  const std::weak_ptr<ISystemTreeLeaf> file;
+
+  /// The System Tree name of the file this image was loaded from, when it was loaded.
+  const kl_string file_name;
+
+  /// The size of the file this image was loaded from.
+  const uint64_t file_size;
+
+  /// The number of pages in the image.
+  uint64_t num_pages;
+
+protected:
+  ISystemTreeLeaf *file_ptr;
+  uint8_t *headers;
+  uint64_t headers_len;
+  uint64_t max_pages;
+  uint64_t *user_addrs;
+  void **phys_addrs;
+  void **kernel_addrs;
+};
+
+std::shared_ptr<proc_exec_image> proc_image_cache_find(ISystemTreeLeaf *file,
+                                                       uint64_t file_size,
+                                                       const uint8_t *headers,
+                                                       uint64_t headers_len);
+uint64_t proc_image_cache_stamp();
+void proc_image_cache_add(std::shared_ptr<proc_exec_image> image, uint64_t stamp);
+void proc_image_cache_invalidate(ISystemTreeLeaf *file);
+uint64_t proc_image_cache_trim(uint64_t max_pages);
 
 std::shared_ptr<task_process> proc_load_binary_file(kl_string binary_name);
-std::shared_ptr<task_process> proc_load_elf_file(kl_string binary_name);
+ERR_CODE proc_load_elf_file(const kl_string &binary_name, std::shared_ptr<task_process> &new_proc);
+
+ERR_CODE proc_build_start_params(const char *argv0,
+                                 const char * const argv[],
+                                 const char * const envp[],
+                                 uint64_t user_addr,
+                                 char *buffer,
+                                 uint64_t &buffer_size,
+                                 uint64_t &argc,
+                                 uint64_t &argv_ptr,
+                                 uint64_t &envp_ptr);
+ERR_CODE proc_copy_start_params(task_process *proc,
+                                const char *argv0,
+                                const char * const argv[],
+                                const char * const envp[]);
+ERR_CODE proc_spawn_elf_file(const char *binary_name,
+                             const char * const argv[],
+                             const char * const envp[],
+                             std::shared_ptr<task_process> &new_proc);
 
 #endif
@@ -10,214 +10,506 @@
 #include "system_tree/system_tree.h"
 #include "system_tree/fs/fs_file_interface.h"
 #include "system_tree/process/process.h"
+#include "system_tree/process/process-int.h"
 #include "system_tree/process/process_elf_structs.h"
 
 typedef void (*fn_ptr)();
 
-/// @brief Load an ELF binary file into a new process
-///
-/// Create a new process space, and load the binary file's contents in to it. The only ELF format files that can be
-/// loaded successfully are those without any need for relocations or dynamic loading. Files with unsupported sections
-/// may load but not correctly execute.
-///
-/// When this function returns, the process is ready to start, but is suspended.
-///
-/// param binary_name The System Tree name for an ELF file to load into a new process.
-///
-/// return A task_process control structure for the new process.
-std::shared_ptr<task_process> proc_load_elf_file(kl_string binary_name)
+namespace
 {
-  KL_TRC_ENTRY;
+  const uint64_t USER_SPACE_LIMIT = 0x8000000000000000ULL;
+
+  /// @brief Read exactly the requested number of bytes from a file.
+  ///
+  /// @param file The file to read from.
+  ///
+  /// @param start The offset of the first byte to read.
+  ///
+  /// @param length The number of bytes to read.
+  ///
+  /// @param buffer Storage for the bytes read. Must be at least length bytes long.
+  ///
+  /// @return ERR_CODE::UNRECOGNISED if the file is too short, or any error from the file itself.
+  ERR_CODE proc_elf_read_exact(std::shared_ptr<IBasicFile> &file, uint64_t start, uint64_t length, void *buffer)
+  {
+    ERR_CODE result;
+    uint64_t bytes_read = 0;
 
-  // Start by locating the file in System Tree.
-  // Providing that it fits, allocate space for it.
-  // Create a user and kernel mode mappings so the kernel can write to it.
-  // Copy it into that mapping.
-  // Release the kernel side of that mapping.
+    result = file->read_bytes(start, length, reinterpret_cast<uint8_t *>(buffer), length, bytes_read);
+    if ((result == ERR_CODE::NO_ERROR) && (bytes_read != length))
+    {
+      result = ERR_CODE::UNRECOGNISED;
+    }
 
-  std::shared_ptr<ISystemTreeLeaf> disk_prog;
-  std::shared_ptr<IBasicFile> new_prog_file;
-  uint64_t prog_size;
-  uint64_t bytes_read;
-  std::shared_ptr<task_process> new_proc;
-  uint8_t* load_buffer;
-  elf64_file_header *file_header;
-  elf64_program_header *prog_header;
-  uint64_t end_addr;
-  uint64_t page_start_addr;
-  void *backing_addr;
-  void *kernel_write_window;
+    return result;
+  }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Attempting to load binary ", binary_name, "\n");
+  /// @brief Check that an ELF file header describes an executable file the kernel can load.
+  ///
+  /// @param header The header to check.
+  ///
+  /// @param file_size The size of the whole file.
+  ///
+  /// @return True if the file can be loaded, false otherwise.
+  bool proc_elf_header_valid(const elf64_file_header &header, uint64_t file_size)
+  {
+    return ((header.ident[0] == 0x7f) &&
+            (header.ident[1] == 'E') &&
+            (header.ident[2] == 'L') &&
+            (header.ident[3] == 'F') &&
+            (header.ident[4] == 2) && // 64-bit ELF.
+            (header.ident[5] == 1) && // Little-endian.
+            (header.ident[6] == 1) && // ELF version 1.
+            (header.type == 2) && // Executable.
+            (header.version == 1) && // ELF version 1 (again!)
+            (file_size >= ELF64_PROG_HDR_SIZE) &&
+            (header.prog_hdrs_off > 0) &&
+            (header.prog_hdrs_off < (file_size - ELF64_PROG_HDR_SIZE)) &&
+            (header.num_prog_hdrs > 0) &&
+            (header.entry_addr < USER_SPACE_LIMIT) &&
+            (header.file_header_size >= ELF64_FILE_HDR_SIZE) &&
+            (header.prog_hdr_entry_size >= ELF64_PROG_HDR_SIZE));
+  }
+
+  /// @brief Check that a LOAD segment lies within the file and within user space.
+  ///
+  /// @param prog_header The program header of the segment.
+  ///
+  /// @param file_size The size of the whole file.
+  ///
+  /// @return True if the segment can be loaded, false otherwise.
+  bool proc_elf_segment_valid(const elf64_program_header &prog_header, uint64_t file_size)
+  {
+    return ((prog_header.req_phys_addr < USER_SPACE_LIMIT) &&
+            (prog_header.req_virt_addr < USER_SPACE_LIMIT) &&
+            (prog_header.size_in_mem < USER_SPACE_LIMIT - prog_header.req_virt_addr) &&
+            (prog_header.size_in_file <= prog_header.size_in_mem) &&
+            (prog_header.file_offset <= file_size) &&
+            (prog_header.size_in_file <= file_size - prog_header.file_offset));
+  }
+
+  /// @brief A kernel window onto one page of the process being loaded.
+  ///
+  /// Small binaries usually have several segments sharing a page, so the window is left in place between segments and
+  /// only moved when a segment needs a different page.
+  struct proc_elf_window
+  {
+    /// A page of kernel address space used to write to the process's pages.
+    uint8_t *window;
+
+    /// The address, in the process, of the page currently mapped at window. Only valid if page_mapped is true.
+    uint64_t mapped_page;
+
+    /// Is any page currently mapped at window?
+    bool page_mapped;
+  };
+
+  /// @brief Release the page mapped in a window, if there is one.
+  ///
+  /// @param win The window to clear.
+  void proc_elf_window_release(proc_elf_window &win)
+  {
+    if (win.page_mapped)
+    {
+      mem_unmap_range(win.window, 1, nullptr, false);
+      win.page_mapped = false;
+    }
+  }
+
+  /// @brief Make sure a window shows the given page of the process.
+  ///
+  /// @param win The window to use.
+  ///
+  /// @param proc The process being loaded.
+  ///
+  /// @param page_addr The page of the process to show.
+  ///
+  /// @param fill_start The offset within the page of the first byte that is about to be written.
+  ///
+  /// @param fill_end The offset within the page after the last byte that is about to be written.
+  void proc_elf_window_move(proc_elf_window &win,
+                            task_process *proc,
+                            uint64_t page_addr,
+                            uint64_t fill_start,
+                            uint64_t fill_end)
+  {
+    if (!win.page_mapped || (win.mapped_page != page_addr))
+    {
+      proc_elf_window_release(win);
+      proc_int_map_page_for_write(proc, page_addr, win.window, fill_start, fill_end);
+      win.mapped_page = page_addr;
+      win.page_mapped = true;
+    }
+  }
 
-  ASSERT(system_tree()->get_child(binary_name, disk_prog) == ERR_CODE::NO_ERROR);
-
-  // Check the file will fit into a single page. This means we know the copy below has enough space.
-  // There's no technical reason why it must fit in one page, but it makes it easier for the time being.
-  new_prog_file = std::dynamic_pointer_cast<IBasicFile>(disk_prog);
-  ASSERT(new_prog_file != nullptr);
-  new_prog_file->get_file_size(prog_size);
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Binary file size ", prog_size, "\n");
-  ASSERT(prog_size < MEM_PAGE_SIZE);
-
-  // Load the entire file into a buffer - it'll make it easier to process, but slower.
-  load_buffer = new uint8_t[prog_size];
-  ASSERT(new_prog_file->read_bytes(0, prog_size, load_buffer, prog_size, bytes_read) == ERR_CODE::NO_ERROR);
-  ASSERT(bytes_read == prog_size);
-
-  // Check that this is a valid ELF64 file.
-  file_header = reinterpret_cast<elf64_file_header *>(load_buffer);
-  ASSERT((file_header->ident[0] == 0x7f)
-         && (file_header->ident[1] == 'E')
-         && (file_header->ident[2] == 'L')
-         && (file_header->ident[3] == 'F'));
-  ASSERT(file_header->ident[4] == 2); // 64-bit ELF.
-  ASSERT(file_header->ident[5] == 1); // Little-endian.
-  ASSERT(file_header->ident[6] == 1); // ELF version 1.
-  ASSERT(file_header->type == 2); // Executable.
-  ASSERT(file_header->version == 1); // ELF version 1 (again!)
-  ASSERT((file_header->prog_hdrs_off > 0) && (file_header->prog_hdrs_off < (prog_size - ELF64_PROG_HDR_SIZE)));
-  ASSERT(file_header->num_prog_hdrs > 1);
-  ASSERT(file_header->entry_addr < 0x8000000000000000LL);
-  ASSERT(file_header->file_header_size >= ELF64_FILE_HDR_SIZE);
-  ASSERT(file_header->prog_hdr_entry_size >= ELF64_PROG_HDR_SIZE);
-
-  // Create a task context with the correct entry point - this is needed before we can map pages to copy the image in
-  // to.
-  fn_ptr start_addr_ptr = reinterpret_cast<fn_ptr>(file_header->entry_addr);
-  new_proc = task_process::create(start_addr_ptr, false);
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Created new process with entry point ", start_addr_ptr, "\n");
-
-  // The kernel does writes in its own address space, to avoid accidentally trampling over the current process.
-  // Allocate an address to use for that.
-  kernel_write_window = mem_allocate_virtual_range(1);
-
-  // Cycle through the program headers, looking for segments to load.
-  for (uint32_t i = 0; i < file_header->num_prog_hdrs; i++)
+  /// @brief Copy one LOAD segment from a file into a process.
+  ///
+  /// Each page is read straight from the file into the process's memory, with a single read per page. The part of the
+  /// segment beyond the end of the file data is zeroed. Bytes of a new page that are about to be read from the file are
+  /// not zeroed first.
+  ///
+  /// @param file The ELF file.
+  ///
+  /// @param prog_header The program header of the segment. It must have been checked by proc_elf_segment_valid().
+  ///
+  /// @param proc The process to load the segment into.
+  ///
+  /// @param win A window that can be used to write to the process's pages. It may be left showing any page.
+  ///
+  /// @param shared_image If not nullptr, pages provided by this image are already mapped into the process, and are
+  ///                     skipped.
+  ///
+  /// @return A suitable error code.
+  ERR_CODE proc_elf_load_segment(std::shared_ptr<IBasicFile> &file,
+                                 const elf64_program_header &prog_header,
+                                 task_process *proc,
+                                 proc_elf_window &win,
+                                 proc_exec_image *shared_image)
   {
-    KL_TRC_TRACE(TRC_LVL::FLOW, "Looking at header idx ", i, "\n");
-    prog_header = reinterpret_cast<elf64_program_header *>(file_header->prog_hdrs_off
-                                                           + i * (file_header->prog_hdr_entry_size)
-                                                           + reinterpret_cast<uint64_t>(load_buffer));
-    KL_TRC_TRACE(TRC_LVL::EXTRA, "Address in mem: ", prog_header, "\n");
-
-    // At the moment, this is the only type that we'll load.
-    if (prog_header->type == 1) //LOAD type
+    KL_TRC_ENTRY;
+
+    ERR_CODE result = ERR_CODE::NO_ERROR;
+    uint64_t copy_end_addr = prog_header.req_virt_addr + prog_header.size_in_file;
+    uint64_t end_addr = prog_header.req_virt_addr + prog_header.size_in_mem;
+    uint64_t page_start_addr = prog_header.req_virt_addr - (prog_header.req_virt_addr % MEM_PAGE_SIZE);
+    uint64_t copy_start;
+    uint64_t copy_end;
+    uint64_t zero_start;
+    uint64_t zero_end;
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Requested start address: ", prog_header.req_virt_addr, "\n");
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Requested mem size: ", prog_header.size_in_mem, "\n");
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Size in file: ", prog_header.size_in_file, "\n");
+
+    for (uint64_t this_page = page_start_addr;
+         (this_page < end_addr) && (result == ERR_CODE::NO_ERROR);
+         this_page += MEM_PAGE_SIZE)
     {
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "---------------\n");
-      KL_TRC_TRACE(TRC_LVL::FLOW, "Loading section\n");
-      ASSERT(prog_header->req_phys_addr < 0x8000000000000000L);
-
-      uint64_t copy_end_addr;
-      uint64_t copy_length;
-      uint64_t offset;
-      uint64_t bytes_to_zero = 0;
-      uint64_t bytes_written = 0;
-      void *write_ptr;
-      void *read_ptr;
-
-      end_addr = prog_header->req_virt_addr + prog_header->size_in_mem;
-      copy_end_addr = prog_header->req_virt_addr + prog_header->size_in_file;
-      page_start_addr = prog_header->req_virt_addr - (prog_header->req_virt_addr % MEM_PAGE_SIZE);
-
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "Requested start address: ", prog_header->req_virt_addr, "\n");
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "Requested mem size: ", prog_header->size_in_mem, "\n");
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "Size in file: ", prog_header->size_in_file, "\n");
-
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "Start of first page: ", page_start_addr, "\n");
-      KL_TRC_TRACE(TRC_LVL::EXTRA, "End address: ", copy_end_addr, "\n");
-
-      if (prog_header->size_in_mem > prog_header->size_in_file)
+      if ((shared_image != nullptr) && shared_image->has_page(this_page))
       {
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Some area needs zero-ing\n");
-        bytes_to_zero = prog_header->size_in_mem - prog_header->size_in_file;
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Page ", this_page, " is shared\n");
+        continue;
       }
 
-      offset = prog_header->req_virt_addr % MEM_PAGE_SIZE;
+      // The part of this page covered by the segment's file data.
+      copy_start = (prog_header.req_virt_addr > this_page) ? prog_header.req_virt_addr : this_page;
+      copy_end = (copy_end_addr < this_page + MEM_PAGE_SIZE) ? copy_end_addr : this_page + MEM_PAGE_SIZE;
+
+      // The part of this page that is in the segment, but not in the file.
+      zero_start = (copy_end_addr > this_page) ? copy_end_addr : this_page;
+      zero_end = (end_addr < this_page + MEM_PAGE_SIZE) ? end_addr : this_page + MEM_PAGE_SIZE;
 
-      for (uint64_t this_page = page_start_addr; this_page < end_addr; this_page += MEM_PAGE_SIZE)
+      // Between them, the file data and the zeroed part cover all of the segment that lies in this page, so a new page
+      // need only be zeroed outside of that.
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Writing on page: ", this_page, "\n");
+      proc_elf_window_move(win,
+                           proc,
+                           this_page,
+                           ((copy_start < copy_end) ? copy_start : zero_start) - this_page,
+                           zero_end - this_page);
+
+      if (copy_start < copy_end)
       {
-        KL_TRC_TRACE(TRC_LVL::FLOW, "Writing on another page: ", this_page, "\n");
+        KL_TRC_TRACE(TRC_LVL::EXTRA, "Copy ", copy_end - copy_start, " bytes to ", copy_start, "\n");
+        result = proc_elf_read_exact(file,
+                                     prog_header.file_offset + (copy_start - prog_header.req_virt_addr),
+                                     copy_end - copy_start,
+                                     win.window + (copy_start - this_page));
+      }
 
-        // Is there already a page for this mapped into the process's address space? If not, create one. In all cases,
-        // map it into the kernel's space so we can write onto it.
-        backing_addr = mem_get_phys_addr(reinterpret_cast<void *>(this_page), new_proc.get());
-        if (backing_addr == nullptr)
-        {
-          KL_TRC_TRACE(TRC_LVL::FLOW, "No space for that allocated in the child process, grabbing a new page...\n");
-          backing_addr = mem_allocate_physical_pages(1);
+      if ((result == ERR_CODE::NO_ERROR) && (zero_start < zero_end))
+      {
+        KL_TRC_TRACE(TRC_LVL::EXTRA, "Zero ", zero_end - zero_start, " bytes at ", zero_start, "\n");
+        kl_memset(win.window + (zero_start - this_page), 0, zero_end - zero_start);
+      }
+    }
 
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Allocating this page in the process's tables\n");
-          mem_vmm_allocate_specific_range(this_page, 1, new_proc.get());
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+    KL_TRC_EXIT;
 
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Mapping new page ", backing_addr, " to ", this_page, "\n");
-          mem_map_range(backing_addr, reinterpret_cast<void *>(this_page), 1, new_proc.get());
-        }
+    return result;
+  }
 
-        KL_TRC_TRACE(TRC_LVL::EXTRA, "Mapping page ", backing_addr, " to ", kernel_write_window, " for kernel writing\n");
-        mem_map_range(backing_addr, kernel_write_window, 1);
+  /// @brief Does a LOAD segment cover any part of a page?
+  ///
+  /// @param prog_header The program header of the segment.
+  ///
+  /// @param page_addr The page-aligned address of the page.
+  ///
+  /// @return True if the segment is a LOAD segment and overlaps the page.
+  bool proc_elf_segment_on_page(const elf64_program_header &prog_header, uint64_t page_addr)
+  {
+    return ((prog_header.type == ELF64_PROG_TYPE_LOAD) &&
+            (prog_header.size_in_mem != 0) &&
+            (prog_header.req_virt_addr < page_addr + MEM_PAGE_SIZE) &&
+            (prog_header.req_virt_addr + prog_header.size_in_mem > page_addr));
+  }
 
-        // If there are still bytes need writing, then do it, otherwise skip to filling in zeros.
-        if (bytes_written < prog_header->size_in_file)
-        {
-          KL_TRC_TRACE(TRC_LVL::FLOW, "Writing data\n");
+  /// @brief Can a page be shared between all processes running the same file?
+  ///
+  /// This is the case if every LOAD segment covering the page is read-only, since the page's contents then depend only
+  /// on the file.
+  ///
+  /// @param prog_headers All program headers of the file.
+  ///
+  /// @param num_headers The number of headers in prog_headers.
+  ///
+  /// @param page_addr The page-aligned address of the page.
+  ///
+  /// @return True if at least one LOAD segment covers the page, and none of them are writable.
+  bool proc_elf_page_shareable(const elf64_program_header *prog_headers, uint16_t num_headers, uint64_t page_addr)
+  {
+    bool found_segment = false;
+    bool shareable = true;
 
-          // In this copy, fill up until the end of the page.
-          copy_length = MEM_PAGE_SIZE - offset;
+    for (uint16_t i = 0; (i < num_headers) && shareable; i++)
+    {
+      if (proc_elf_segment_on_page(prog_headers[i], page_addr))
+      {
+        found_segment = true;
+        shareable = ((prog_headers[i].flags & ELF64_PROG_FLAG_WRITE) == 0);
+      }
+    }
 
-          // However, if that is greater than the end of the required copying then only copy the actually required
-          // number of bytes.
-          if (this_page + offset + copy_length > copy_end_addr)
-          {
-            KL_TRC_TRACE(TRC_LVL::FLOW, "Adjusting length\n");
-            copy_length = copy_end_addr - this_page - offset;
-          }
+    return found_segment && shareable;
+  }
 
-          write_ptr = reinterpret_cast<void *>(reinterpret_cast<uint64_t>(kernel_write_window) + offset);
-          read_ptr = reinterpret_cast<void *>(reinterpret_cast<uint64_t>(load_buffer)
-                                              + prog_header->file_offset
-                                              + bytes_written);
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Copy data:\n----------\n");
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Write pointer: ", write_ptr, "\n");
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Read pointer: ", read_ptr, "\n");
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Length: ", copy_length, "\n");
-          kl_memcpy(read_ptr, write_ptr, copy_length);
-          bytes_written += copy_length;
-          offset += copy_length;
-
-          KL_TRC_TRACE(TRC_LVL::EXTRA, "Copy complete\n");
-        }
+  /// @brief Move all shareable pages of a newly loaded process into a new image.
+  ///
+  /// @param file The file the process was loaded from.
+  ///
+  /// @param binary_name The System Tree name of that file.
+  ///
+  /// @param file_size The size of that file.
+  ///
+  /// @param headers The file header of the file followed by all of its program headers.
+  ///
+  /// @param headers_len The number of bytes in headers.
+  ///
+  /// @param proc The process that has been loaded.
+  ///
+  /// @return The new image, or nullptr if the process has no shareable pages.
+  std::shared_ptr<proc_exec_image> proc_elf_create_image(std::shared_ptr<ISystemTreeLeaf> file,
+                                                         const kl_string &binary_name,
+                                                         uint64_t file_size,
+                                                         const uint8_t *headers,
+                                                         uint64_t headers_len,
+                                                         task_process *proc)
+  {
+    KL_TRC_ENTRY;
+
+    std::shared_ptr<proc_exec_image> image;
+    const elf64_file_header *file_header = reinterpret_cast<const elf64_file_header *>(headers);
+    const elf64_program_header *prog_headers =
+      reinterpret_cast<const elf64_program_header *>(headers + sizeof(elf64_file_header));
+    uint64_t max_pages = 0;
+    uint64_t page_start_addr;
+
+    // Count the pages in all LOAD segments, which is at least the number that could be shared.
+    for (uint16_t i = 0; i < file_header->num_prog_hdrs; i++)
+    {
+      if ((prog_headers[i].type == ELF64_PROG_TYPE_LOAD) && (prog_headers[i].size_in_mem != 0))
+      {
+        page_start_addr = prog_headers[i].req_virt_addr - (prog_headers[i].req_virt_addr % MEM_PAGE_SIZE);
+        max_pages += ((prog_headers[i].req_virt_addr + prog_headers[i].size_in_mem - page_start_addr - 1)
+                      / MEM_PAGE_SIZE) + 1;
+      }
+    }
 
-        // If all the code is written, fill in zeroes
-        if ((bytes_written >= prog_header->size_in_file) && bytes_to_zero && (offset < MEM_PAGE_SIZE))
+    for (uint16_t i = 0; i < file_header->num_prog_hdrs; i++)
+    {
+      if ((prog_headers[i].type == ELF64_PROG_TYPE_LOAD) && ((prog_headers[i].flags & ELF64_PROG_FLAG_WRITE) == 0))
+      {
+        page_start_addr = prog_headers[i].req_virt_addr - (prog_headers[i].req_virt_addr % MEM_PAGE_SIZE);
+        for (uint64_t this_page = page_start_addr;
+             this_page < prog_headers[i].req_virt_addr + prog_headers[i].size_in_mem;
+             this_page += MEM_PAGE_SIZE)
         {
-          KL_TRC_TRACE(TRC_LVL::FLOW, "Writing zeroes\n");
-          uint64_t bytes_now = MEM_PAGE_SIZE - offset;
-          if (bytes_now > bytes_to_zero)
+          if (proc_elf_page_shareable(prog_headers, file_header->num_prog_hdrs, this_page) &&
+              ((image == nullptr) || !image->has_page(this_page)))
           {
-            bytes_now = bytes_to_zero;
+            if (image == nullptr)
+            {
+              image = std::make_shared<proc_exec_image>(file,
+                                                        binary_name,
+                                                        file_size,
+                                                        headers,
+                                                        headers_len,
+                                                        max_pages);
+            }
+            image->adopt_page(proc, this_page);
           }
-
-          write_ptr = reinterpret_cast<void *>(reinterpret_cast<uint64_t>(kernel_write_window) + offset);
-          kl_memset(write_ptr, 0, bytes_now);
-          bytes_to_zero -= bytes_now;
         }
+      }
+    }
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", image.get(), "\n");
+    KL_TRC_EXIT;
+
+    return image;
+  }
+}
+
+/// @brief Load an ELF binary file into a new process
+///
+/// Create a new process space, and load the binary file's contents in to it. The only ELF format files that can be
+/// loaded successfully are those without any need for relocations or dynamic loading. Files with unsupported sections
+/// may load but not correctly execute.
+///
+/// The file is read directly into the new process's pages - it is never copied in full into the kernel. Pages covered
+/// only by read-only segments are shared with any other process loaded from the same file, using the image cache in
+/// process_image_cache.cpp.
+///
+/// When this function returns successfully, the process is ready to start, but is suspended.
+///
+/// @param binary_name The System Tree name for an ELF file to load into a new process.
+///
+/// @param[out] new_proc The new process. nullptr if the process could not be created.
+///
+/// @return ERR_CODE::NOT_FOUND if the file doesn't exist. ERR_CODE::UNRECOGNISED if it isn't an ELF file that can be
+///         loaded. Otherwise a suitable error code.
+ERR_CODE proc_load_elf_file(const kl_string &binary_name, std::shared_ptr<task_process> &new_proc)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  std::shared_ptr<ISystemTreeLeaf> disk_prog;
+  std::shared_ptr<IBasicFile> new_prog_file;
+  uint64_t prog_size = 0;
+  elf64_file_header file_header;
+  std::unique_ptr<uint8_t[]> headers;
+  uint64_t headers_len = 0;
+  elf64_program_header *prog_headers = nullptr;
+  proc_elf_window write_window;
+  std::shared_ptr<proc_exec_image> image;
+  uint64_t cache_stamp;
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Attempting to load binary ", binary_name, "\n");
+
+  new_proc = nullptr;
+
+  // If the file changes while it is being loaded, don't cache what was loaded - it may be a mixture of old and new.
+  cache_stamp = proc_image_cache_stamp();
+
+  result = system_tree()->get_child(binary_name, disk_prog);
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    new_prog_file = std::dynamic_pointer_cast<IBasicFile>(disk_prog);
+    if (new_prog_file == nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Not a file\n");
+      result = ERR_CODE::UNRECOGNISED;
+    }
+    else
+    {
+      result = new_prog_file->get_file_size(prog_size);
+    }
+  }
 
-        // Having done the writing, unmap it again.
-        KL_TRC_TRACE(TRC_LVL::EXTRA, "Unmapping kernel side\n");
-        mem_unmap_range(kernel_write_window, 1, nullptr, false);
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Binary file size ", prog_size, "\n");
+    result = proc_elf_read_exact(new_prog_file, 0, sizeof(file_header), &file_header);
+    if ((result == ERR_CODE::NO_ERROR) && !proc_elf_header_valid(file_header, prog_size))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid ELF header\n");
+      result = ERR_CODE::UNRECOGNISED;
+    }
+  }
 
-        offset = 0;
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    // Keep the file header and all the program headers together. As well as being needed to load the file, they
+    // identify it in the image cache.
+    headers_len = sizeof(file_header) + (file_header.num_prog_hdrs * sizeof(elf64_program_header));
+    headers = std::unique_ptr<uint8_t[]>(new uint8_t[headers_len]);
+    kl_memcpy(&file_header, headers.get(), sizeof(file_header));
+    prog_headers = reinterpret_cast<elf64_program_header *>(headers.get() + sizeof(file_header));
+
+    for (uint32_t i = 0; (i < file_header.num_prog_hdrs) && (result == ERR_CODE::NO_ERROR); i++)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Looking at header idx ", i, "\n");
+      result = proc_elf_read_exact(new_prog_file,
+                                   file_header.prog_hdrs_off + (i * file_header.prog_hdr_entry_size),
+                                   sizeof(elf64_program_header),
+                                   &prog_headers[i]);
+
+      // At the moment, this is the only type that we'll load.
+      if ((result == ERR_CODE::NO_ERROR) &&
+          (prog_headers[i].type == ELF64_PROG_TYPE_LOAD) &&
+          !proc_elf_segment_valid(prog_headers[i], prog_size))
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Invalid segment\n");
+        result = ERR_CODE::UNRECOGNISED;
       }
     }
   }
 
-  KL_TRC_TRACE(TRC_LVL::EXTRA, "Releasing kernel write window space\n");
-  mem_deallocate_virtual_range(kernel_write_window, 1);
-  delete[] load_buffer;
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    // Create a task context with the correct entry point - this is needed before we can map pages to copy the image
+    // in to.
+    fn_ptr start_addr_ptr = reinterpret_cast<fn_ptr>(file_header.entry_addr);
+    new_proc = task_process::create(start_addr_ptr, false);
+    ASSERT(new_proc != nullptr);
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Created new process with entry point ", start_addr_ptr, "\n");
+
+    // If another process has loaded this file, share its read-only pages rather than reading them again.
+    image = proc_image_cache_find(disk_prog.get(), prog_size, headers.get(), headers_len);
+    if (image != nullptr)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Using cached image\n");
+      image->map_into(new_proc.get());
+    }
+
+    // The kernel does writes in its own address space, to avoid accidentally trampling over the current process.
+    // Allocate an address to use for that.
+    write_window.window = reinterpret_cast<uint8_t *>(mem_allocate_virtual_range(1));
+    write_window.mapped_page = 0;
+    write_window.page_mapped = false;
 
-  KL_TRC_EXIT;
+    for (uint32_t i = 0; (i < file_header.num_prog_hdrs) && (result == ERR_CODE::NO_ERROR); i++)
+    {
+      if (prog_headers[i].type == ELF64_PROG_TYPE_LOAD)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Loading section ", i, "\n");
+        result = proc_elf_load_segment(new_prog_file, prog_headers[i], new_proc.get(), write_window, image.get());
+      }
+    }
+
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Releasing kernel write window space\n");
+    proc_elf_window_release(write_window);
+    mem_deallocate_virtual_range(write_window.window, 1);
+
+    if (result != ERR_CODE::NO_ERROR)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Failed to load, destroy the new process\n");
+      new_proc->destroy_process();
+      new_proc = nullptr;
+    }
+    else
+    {
+      if (image == nullptr)
+      {
+        KL_TRC_TRACE(TRC_LVL::FLOW, "Not cached, create a new image\n");
+        image = proc_elf_create_image(disk_prog,
+                                      binary_name,
+                                      prog_size,
+                                      headers.get(),
+                                      headers_len,
+                                      new_proc.get());
+        if (image != nullptr)
+        {
+          proc_image_cache_add(image, cache_stamp);
+        }
+      }
 
-  return new_proc;
+      new_proc->exec_image = image;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
 
+  return result;
 }
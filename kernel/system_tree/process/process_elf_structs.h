@@ -8,6 +8,9 @@
 const uint64_t ELF64_FILE_HDR_SIZE = 64;
 const uint64_t ELF64_PROG_HDR_SIZE = 56;
 
+const uint32_t ELF64_PROG_TYPE_LOAD = 1;
+const uint32_t ELF64_PROG_FLAG_WRITE = 2;
+
 typedef struct
 {
   uint8_t ident[16];
@@ -0,0 +1,444 @@
+/// @file
+/// @brief A cache of the read-only pages of executable files.
+///
+/// When an ELF file is loaded, any page covered only by read-only segments is the same in every process running that
+/// file. Such pages are kept in a proc_exec_image, which is cached here, so that the next process to load the same file
+/// can map them instead of reading them again.
+///
+/// Sharing is only safe because the pages are mapped read-only in every process, and the kernel runs with CR0.WP set
+/// (see entry-x86.asm), so the kernel can't be tricked into writing to them either - for example, by a system call
+/// given an output pointer into a shared page. Such a write faults rather than changing the code other processes run.
+///
+/// Images are identified by the System Tree leaf they were loaded from, as well as the size of the file and the
+/// contents of its ELF headers. Files that can be written to must call proc_image_cache_invalidate() whenever they
+/// change, so that the next process loaded from them doesn't run stale code. Processes already running an image keep
+/// it.
+///
+/// The cache holds at most PROC_IMAGE_CACHE_MAX_PAGES pages. Beyond that, the least recently used images that no
+/// process is running are evicted. proc_image_cache_trim() can be used to evict images sooner if memory is short.
+
+//#define ENABLE_TRACING
+
+#include <memory>
+#include "klib/klib.h"
+#include "system_tree/process/process.h"
+
+namespace
+{
+  /// All cached images. The most recently used image is at the tail.
+  klib_list<std::shared_ptr<proc_exec_image>> image_cache_list;
+
+  /// The total number of pages in all cached images.
+  uint64_t image_cache_pages = 0;
+
+  /// The number of times any file has been invalidated. A file's contents may have changed while it was being loaded
+  /// if this changes in the meantime - see proc_image_cache_stamp().
+  uint64_t image_cache_invalidations = 0;
+
+  /// Protects image_cache_list, image_cache_pages and image_cache_invalidations. Never held while memory is being
+  /// allocated or freed, since the memory manager may take its own locks.
+  kernel_spinlock image_cache_lock;
+
+  /// @brief Destroy images removed from the cache.
+  ///
+  /// This must be done without holding image_cache_lock, since it frees memory.
+  ///
+  /// @param evicted The list of images to destroy. It is empty afterwards.
+  void proc_image_cache_destroy(klib_list<std::shared_ptr<proc_exec_image>> &evicted)
+  {
+    klib_list_item<std::shared_ptr<proc_exec_image>> *cur_item;
+
+    while (evicted.head != nullptr)
+    {
+      cur_item = evicted.head;
+      klib_list_remove(cur_item);
+      cur_item->item = nullptr;
+      delete cur_item;
+    }
+  }
+}
+
+/// @brief Create a new, empty, image.
+///
+/// @param file The file the image is loaded from.
+///
+/// @param file_name The System Tree name of that file. Only used for tracing.
+///
+/// @param file_size The size of that file.
+///
+/// @param headers The ELF file header and program headers of the file, which are used to identify it later.
+///
+/// @param headers_len The number of bytes in headers.
+///
+/// @param max_pages The maximum number of pages that will be added to the image using adopt_page().
+proc_exec_image::proc_exec_image(std::shared_ptr<ISystemTreeLeaf> file,
+                                 const kl_string &file_name,
+                                 uint64_t file_size,
+                                 const uint8_t *headers,
+                                 uint64_t headers_len,
+                                 uint64_t max_pages) :
+  file(file),
+  file_name(file_name),
+  file_size(file_size),
+  num_pages(0),
+  file_ptr(file.get()),
+  headers(nullptr),
+  headers_len(headers_len),
+  max_pages(max_pages),
+  user_addrs(nullptr),
+  phys_addrs(nullptr),
+  kernel_addrs(nullptr)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT((headers != nullptr) || (headers_len == 0));
+
+  if (headers_len != 0)
+  {
+    this->headers = new uint8_t[headers_len];
+    kl_memcpy(headers, this->headers, headers_len);
+  }
+
+  if (max_pages != 0)
+  {
+    this->user_addrs = new uint64_t[max_pages];
+    this->phys_addrs = new void *[max_pages];
+    this->kernel_addrs = new void *[max_pages];
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Release the kernel's hold on all pages in the image.
+///
+/// Pages still mapped into a process are not freed until that process unmaps them.
+proc_exec_image::~proc_exec_image()
+{
+  KL_TRC_ENTRY;
+
+  for (uint64_t i = 0; i < this->num_pages; i++)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Release page ", this->user_addrs[i], "\n");
+    mem_unmap_range(this->kernel_addrs[i], 1, nullptr, true);
+    mem_deallocate_virtual_range(this->kernel_addrs[i], 1);
+  }
+
+  delete[] this->headers;
+  delete[] this->user_addrs;
+  delete[] this->phys_addrs;
+  delete[] this->kernel_addrs;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Was this image loaded from the given file?
+///
+/// @param file The file. An image never matches once the file it was loaded from has been destroyed, even if another
+///             file is later created at the same address.
+///
+/// @param file_size The size of the file.
+///
+/// @param headers The ELF file header and program headers of the file.
+///
+/// @param headers_len The number of bytes in headers.
+///
+/// @return True if the image matches the file, false otherwise.
+bool proc_exec_image::matches(ISystemTreeLeaf *file,
+                              uint64_t file_size,
+                              const uint8_t *headers,
+                              uint64_t headers_len)
+{
+  return (this->is_from(file) &&
+          (this->file_size == file_size) &&
+          (this->headers_len == headers_len) &&
+          ((headers_len == 0) || (kl_memcmp(this->headers, headers, headers_len) == 0)));
+}
+
+/// @brief Was this image loaded from the given file, regardless of what the file now contains?
+///
+/// This doesn't take a reference to the file, so it is safe to call while holding a lock that must not be held while
+/// memory is freed.
+///
+/// @param file The file.
+///
+/// @return True if the image was loaded from file, and file still exists.
+bool proc_exec_image::is_from(ISystemTreeLeaf *file)
+{
+  return ((file != nullptr) && (this->file_ptr == file) && !this->file.expired());
+}
+
+/// @brief Does this image provide the page at the given address?
+///
+/// @param user_addr The page-aligned address of the page, as seen by processes.
+///
+/// @return True if the page is part of this image.
+bool proc_exec_image::has_page(uint64_t user_addr)
+{
+  bool result = false;
+
+  for (uint64_t i = 0; (i < this->num_pages) && !result; i++)
+  {
+    result = (this->user_addrs[i] == user_addr);
+  }
+
+  return result;
+}
+
+/// @brief Make a page already loaded into a process part of this image.
+///
+/// The page is made read-only in the process, and mapped into the kernel so that it outlives the process. The kernel
+/// mapping is only used to keep the page alive - nothing writes to the page once it has been adopted.
+///
+/// @param proc The process the page was loaded into.
+///
+/// @param user_addr The page-aligned address of the page in proc.
+void proc_exec_image::adopt_page(task_process *proc, uint64_t user_addr)
+{
+  KL_TRC_ENTRY;
+
+  void *phys_addr;
+  void *kernel_addr;
+
+  ASSERT(proc != nullptr);
+  ASSERT((user_addr % MEM_PAGE_SIZE) == 0);
+  ASSERT(this->num_pages < this->max_pages);
+  ASSERT(!this->has_page(user_addr));
+
+  phys_addr = mem_get_phys_addr(reinterpret_cast<void *>(user_addr), proc);
+  ASSERT(phys_addr != nullptr);
+
+  KL_TRC_TRACE(TRC_LVL::FLOW, "Adopt page ", user_addr, " backed by ", phys_addr, "\n");
+  kernel_addr = mem_allocate_virtual_range(1);
+  mem_map_range(phys_addr, kernel_addr, 1);
+
+  mem_unmap_range(reinterpret_cast<void *>(user_addr), 1, proc, false);
+  mem_map_range(phys_addr, reinterpret_cast<void *>(user_addr), 1, proc, MEM_WRITE_BACK, false);
+
+  this->user_addrs[this->num_pages] = user_addr;
+  this->phys_addrs[this->num_pages] = phys_addr;
+  this->kernel_addrs[this->num_pages] = kernel_addr;
+  this->num_pages++;
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Map all pages of this image, read-only, into a process.
+///
+/// @param proc The process to map the pages into. None of the pages may already be allocated in it.
+void proc_exec_image::map_into(task_process *proc)
+{
+  KL_TRC_ENTRY;
+
+  ASSERT(proc != nullptr);
+
+  for (uint64_t i = 0; i < this->num_pages; i++)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "Map shared page ", this->user_addrs[i], "\n");
+    mem_vmm_allocate_specific_range(this->user_addrs[i], 1, proc);
+    mem_map_range(this->phys_addrs[i],
+                  reinterpret_cast<void *>(this->user_addrs[i]),
+                  1,
+                  proc,
+                  MEM_WRITE_BACK,
+                  false);
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Look for a cached image of a file.
+///
+/// @param file The file.
+///
+/// @param file_size The size of the file.
+///
+/// @param headers The ELF file header and program headers of the file.
+///
+/// @param headers_len The number of bytes in headers.
+///
+/// @return The cached image, or nullptr if there isn't one.
+std::shared_ptr<proc_exec_image> proc_image_cache_find(ISystemTreeLeaf *file,
+                                                       uint64_t file_size,
+                                                       const uint8_t *headers,
+                                                       uint64_t headers_len)
+{
+  KL_TRC_ENTRY;
+
+  std::shared_ptr<proc_exec_image> result;
+  klib_list_item<std::shared_ptr<proc_exec_image>> *cur_item;
+
+  klib_synch_spinlock_lock(image_cache_lock);
+
+  for (cur_item = image_cache_list.head; cur_item != nullptr; cur_item = cur_item->next)
+  {
+    if (cur_item->item->matches(file, file_size, headers, headers_len))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Found cached image\n");
+      result = cur_item->item;
+
+      // Move the image to the most recently used end of the list.
+      klib_list_remove(cur_item);
+      klib_list_add_tail(&image_cache_list, cur_item);
+      break;
+    }
+  }
+
+  klib_synch_spinlock_unlock(image_cache_lock);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result.get(), "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Get a stamp to pass to proc_image_cache_add().
+///
+/// This must be called before the file an image is made from is first read.
+///
+/// @return The current stamp.
+uint64_t proc_image_cache_stamp()
+{
+  uint64_t stamp;
+
+  klib_synch_spinlock_lock(image_cache_lock);
+  stamp = image_cache_invalidations;
+  klib_synch_spinlock_unlock(image_cache_lock);
+
+  return stamp;
+}
+
+/// @brief Add a newly loaded image to the cache.
+///
+/// If the cache is then too large, older images that are not in use are evicted.
+///
+/// @param image The image to add. If another image of the same file was added in the meantime, both are kept until
+///              the older one is evicted.
+///
+/// @param stamp The result of proc_image_cache_stamp() from before the file was read. If any file has been invalidated
+///              since then, the image may not match the file any more, so it is not added.
+void proc_image_cache_add(std::shared_ptr<proc_exec_image> image, uint64_t stamp)
+{
+  KL_TRC_ENTRY;
+
+  klib_list_item<std::shared_ptr<proc_exec_image>> *new_item;
+  bool added = false;
+
+  ASSERT(image != nullptr);
+
+  new_item = new klib_list_item<std::shared_ptr<proc_exec_image>>();
+  klib_list_item_initialize(new_item);
+  new_item->item = image;
+
+  klib_synch_spinlock_lock(image_cache_lock);
+  if (stamp == image_cache_invalidations)
+  {
+    klib_list_add_tail(&image_cache_list, new_item);
+    image_cache_pages += image->num_pages;
+    added = true;
+  }
+  klib_synch_spinlock_unlock(image_cache_lock);
+
+  if (added)
+  {
+    proc_image_cache_trim(PROC_IMAGE_CACHE_MAX_PAGES);
+  }
+  else
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "A file changed while ", image->file_name, " was loading, don't cache it\n");
+    new_item->item = nullptr;
+    delete new_item;
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Remove all images of a file from the cache, because the file has changed.
+///
+/// Processes already running one of the images keep it, since their pages were loaded before the change.
+///
+/// @param file The file that has changed.
+void proc_image_cache_invalidate(ISystemTreeLeaf *file)
+{
+  KL_TRC_ENTRY;
+
+  klib_list<std::shared_ptr<proc_exec_image>> evicted;
+  klib_list_item<std::shared_ptr<proc_exec_image>> *cur_item;
+  klib_list_item<std::shared_ptr<proc_exec_image>> *next_item;
+
+  klib_list_initialize(&evicted);
+
+  klib_synch_spinlock_lock(image_cache_lock);
+
+  image_cache_invalidations++;
+
+  cur_item = image_cache_list.head;
+  while (cur_item != nullptr)
+  {
+    next_item = cur_item->next;
+
+    if (cur_item->item->is_from(file))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Invalidate image of ", cur_item->item->file_name, "\n");
+      image_cache_pages -= cur_item->item->num_pages;
+      klib_list_remove(cur_item);
+      klib_list_add_tail(&evicted, cur_item);
+    }
+
+    cur_item = next_item;
+  }
+
+  klib_synch_spinlock_unlock(image_cache_lock);
+
+  proc_image_cache_destroy(evicted);
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Evict images that no process is running, oldest first, until the cache is no larger than requested.
+///
+/// Images in use by a process are never evicted, so the cache may remain larger than max_pages.
+///
+/// @param max_pages The number of pages to reduce the cache to. Zero evicts every image not in use.
+///
+/// @return The number of pages remaining in the cache.
+uint64_t proc_image_cache_trim(uint64_t max_pages)
+{
+  KL_TRC_ENTRY;
+
+  klib_list<std::shared_ptr<proc_exec_image>> evicted;
+  klib_list_item<std::shared_ptr<proc_exec_image>> *cur_item;
+  klib_list_item<std::shared_ptr<proc_exec_image>> *next_item;
+  uint64_t remaining;
+
+  klib_list_initialize(&evicted);
+
+  klib_synch_spinlock_lock(image_cache_lock);
+
+  cur_item = image_cache_list.head;
+  while ((cur_item != nullptr) && ((image_cache_pages > max_pages) || (max_pages == 0)))
+  {
+    next_item = cur_item->next;
+
+    // The cache's own reference is the only one if no process is running the image.
+    if (cur_item->item.use_count() == 1)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Evict image of ", cur_item->item->file_name, "\n");
+      image_cache_pages -= cur_item->item->num_pages;
+      klib_list_remove(cur_item);
+      klib_list_add_tail(&evicted, cur_item);
+    }
+
+    cur_item = next_item;
+  }
+
+  remaining = image_cache_pages;
+
+  klib_synch_spinlock_unlock(image_cache_lock);
+
+  proc_image_cache_destroy(evicted);
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", remaining, "\n");
+  KL_TRC_EXIT;
+
+  return remaining;
+}
@@ -0,0 +1,329 @@
+/// @file
+/// @brief Create and start a new process from an executable file in one step.
+///
+/// This is the kernel side of syscall_spawn_process(). Loading the file and copying the arguments and environment is
+/// all done by the kernel, writing directly into the new process's pages.
+
+//#define ENABLE_TRACING
+
+#include <memory>
+#include "klib/klib.h"
+#include "system_tree/process/process.h"
+#include "system_tree/process/process-int.h"
+
+/// @brief Map a page of a process's address space into the kernel, so the kernel can write to it.
+///
+/// If the process has no page at that address yet, a new one is allocated, mapped into the process and zeroed. If the
+/// caller is about to overwrite part of the page anyway it can say so using fill_start and fill_end, and that part is
+/// not zeroed first.
+///
+/// The caller must unmap the window using mem_unmap_range() once it has finished writing.
+///
+/// @param proc The process owning the page.
+///
+/// @param page_addr The page-aligned address of the page in the process's address space.
+///
+/// @param window A page of kernel address space, as allocated by mem_allocate_virtual_range(), to map the page at.
+///
+/// @param fill_start The offset within the page of the first byte the caller will write.
+///
+/// @param fill_end The offset within the page after the last byte the caller will write. If this is not greater than
+///                 fill_start then all of a new page is zeroed.
+void proc_int_map_page_for_write(task_process *proc,
+                                 uint64_t page_addr,
+                                 void *window,
+                                 uint64_t fill_start,
+                                 uint64_t fill_end)
+{
+  KL_TRC_ENTRY;
+
+  void *backing_addr;
+  bool new_page = false;
+  uint8_t *window_bytes = reinterpret_cast<uint8_t *>(window);
+
+  ASSERT(proc != nullptr);
+  ASSERT((page_addr % MEM_PAGE_SIZE) == 0);
+  ASSERT(fill_end <= MEM_PAGE_SIZE);
+
+  backing_addr = mem_get_phys_addr(reinterpret_cast<void *>(page_addr), proc);
+  if (backing_addr == nullptr)
+  {
+    KL_TRC_TRACE(TRC_LVL::FLOW, "No page allocated in the process, grabbing a new one\n");
+    backing_addr = mem_allocate_physical_pages(1);
+    mem_vmm_allocate_specific_range(page_addr, 1, proc);
+    mem_map_range(backing_addr, reinterpret_cast<void *>(page_addr), 1, proc);
+    new_page = true;
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Mapping page ", backing_addr, " to ", window, " for kernel writing\n");
+  mem_map_range(backing_addr, window, 1);
+
+  if (new_page)
+  {
+    if (fill_start < fill_end)
+    {
+      KL_TRC_TRACE(TRC_LVL::EXTRA, "Zero around the filled range ", fill_start, " -> ", fill_end, "\n");
+      kl_memset(window_bytes, 0, fill_start);
+      kl_memset(window_bytes + fill_end, 0, MEM_PAGE_SIZE - fill_end);
+    }
+    else
+    {
+      kl_memset(window_bytes, 0, MEM_PAGE_SIZE);
+    }
+  }
+
+  KL_TRC_EXIT;
+}
+
+/// @brief Lay out the arguments and environment of a new process.
+///
+/// The layout is the argv pointer array, then the environment pointer array, then the strings they point to. Both
+/// pointer arrays are terminated by nullptr. The pointers are written as they will be seen by the new process, which
+/// will find the block at user_addr.
+///
+/// argv0, argv and envp must be in kernel memory, so that they can't change between measuring and building the block.
+///
+/// @param argv0 The first argument, conventionally the name of the program. Must not be nullptr.
+///
+/// @param argv The remaining arguments, terminated by nullptr. May be nullptr if there are none.
+///
+/// @param envp The environment, terminated by nullptr. May be nullptr if it is empty.
+///
+/// @param user_addr The address of the block in the new process.
+///
+/// @param buffer Storage for the block. May be nullptr, in which case only the size is calculated.
+///
+/// @param[in,out] buffer_size On entry, the size of buffer. On exit, the size of the block.
+///
+/// @param[out] argc The number of arguments, including argv0.
+///
+/// @param[out] argv_ptr The address of the argv array in the new process.
+///
+/// @param[out] envp_ptr The address of the environment array in the new process.
+///
+/// @return ERR_CODE::INVALID_PARAM if argv0 is nullptr, or if buffer is given but too small. ERR_CODE::OUT_OF_RESOURCE
+///         if the block would be larger than PROC_START_PARAMS_MAX_SIZE. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE proc_build_start_params(const char *argv0,
+                                 const char * const argv[],
+                                 const char * const envp[],
+                                 uint64_t user_addr,
+                                 char *buffer,
+                                 uint64_t &buffer_size,
+                                 uint64_t &argc,
+                                 uint64_t &argv_ptr,
+                                 uint64_t &envp_ptr)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result = ERR_CODE::NO_ERROR;
+  uint64_t envc = 0;
+  uint64_t strings_size;
+  uint64_t total_size;
+  uint64_t str_len;
+  uint64_t space_left;
+  char **argv_out;
+  char **envp_out;
+  char *string_out;
+  const char *cur_str;
+
+  argc = 1;
+
+  if (argv0 == nullptr)
+  {
+    result = ERR_CODE::INVALID_PARAM;
+  }
+  else
+  {
+    // First, work out how much space is needed.
+    strings_size = kl_strlen(argv0, PROC_START_PARAMS_MAX_SIZE) + 1;
+    while ((argv != nullptr) && (argv[argc - 1] != nullptr) && (strings_size <= PROC_START_PARAMS_MAX_SIZE))
+    {
+      strings_size += kl_strlen(argv[argc - 1], PROC_START_PARAMS_MAX_SIZE) + 1;
+      argc++;
+    }
+    while ((envp != nullptr) && (envp[envc] != nullptr) && (strings_size <= PROC_START_PARAMS_MAX_SIZE))
+    {
+      strings_size += kl_strlen(envp[envc], PROC_START_PARAMS_MAX_SIZE) + 1;
+      envc++;
+    }
+
+    total_size = strings_size + ((argc + 1 + envc + 1) * sizeof(char *));
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "Block size: ", total_size, "\n");
+
+    if (total_size > PROC_START_PARAMS_MAX_SIZE)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Too large\n");
+      result = ERR_CODE::OUT_OF_RESOURCE;
+    }
+    else if ((buffer != nullptr) && (buffer_size < total_size))
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Buffer too small\n");
+      result = ERR_CODE::INVALID_PARAM;
+    }
+    else
+    {
+      buffer_size = total_size;
+      argv_ptr = user_addr;
+      envp_ptr = user_addr + ((argc + 1) * sizeof(char *));
+
+      if (buffer != nullptr)
+      {
+        argv_out = reinterpret_cast<char **>(buffer);
+        envp_out = argv_out + argc + 1;
+        string_out = reinterpret_cast<char *>(envp_out + envc + 1);
+
+        for (uint64_t i = 0; i < argc + envc; i++)
+        {
+          cur_str = (i == 0) ? argv0 : ((i < argc) ? argv[i - 1] : envp[i - argc]);
+
+          // The strings must not have changed since the block was measured - callers pass copies the kernel owns - but
+          // never read or write beyond the block regardless. Each string needs room for its terminator.
+          space_left = (buffer + total_size) - string_out;
+          ASSERT(space_left > 0);
+          str_len = kl_strlen(cur_str, space_left);
+          ASSERT(str_len < space_left);
+
+          // Pointers are stored as the new process will see them.
+          if (i < argc)
+          {
+            argv_out[i] = reinterpret_cast<char *>(user_addr + (string_out - buffer));
+          }
+          else
+          {
+            envp_out[i - argc] = reinterpret_cast<char *>(user_addr + (string_out - buffer));
+          }
+
+          kl_memcpy(cur_str, string_out, str_len);
+          string_out[str_len] = 0;
+          string_out += str_len + 1;
+        }
+
+        argv_out[argc] = nullptr;
+        envp_out[envc] = nullptr;
+      }
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Copy arguments and environment into a new process, and give them to its main thread.
+///
+/// The block is stored at PROC_START_PARAMS_ADDR. See proc_build_start_params() for the layout.
+///
+/// @param proc The process to give the parameters to. It must never have been started.
+///
+/// @param argv0 The first argument, conventionally the name of the program.
+///
+/// @param argv The remaining arguments, terminated by nullptr. May be nullptr if there are none.
+///
+/// @param envp The environment, terminated by nullptr. May be nullptr if it is empty.
+///
+/// @return A suitable error code. See proc_build_start_params().
+ERR_CODE proc_copy_start_params(task_process *proc,
+                                const char *argv0,
+                                const char * const argv[],
+                                const char * const envp[])
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+  uint64_t block_size = 0;
+  uint64_t argc;
+  uint64_t argv_ptr;
+  uint64_t envp_ptr;
+  void *window;
+
+  ASSERT(proc != nullptr);
+  ASSERT(!proc->has_ever_started);
+
+  result = proc_build_start_params(argv0,
+                                   argv,
+                                   envp,
+                                   PROC_START_PARAMS_ADDR,
+                                   nullptr,
+                                   block_size,
+                                   argc,
+                                   argv_ptr,
+                                   envp_ptr);
+
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    // The block is no larger than one page, and starts on a page boundary, so it fits in a single page.
+    window = mem_allocate_virtual_range(1);
+    proc_int_map_page_for_write(proc, PROC_START_PARAMS_ADDR, window, 0, block_size);
+
+    result = proc_build_start_params(argv0,
+                                     argv,
+                                     envp,
+                                     PROC_START_PARAMS_ADDR,
+                                     reinterpret_cast<char *>(window),
+                                     block_size,
+                                     argc,
+                                     argv_ptr,
+                                     envp_ptr);
+
+    mem_unmap_range(window, 1, nullptr, false);
+    mem_deallocate_virtual_range(window, 1);
+  }
+
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    task_set_start_params(proc, argc, reinterpret_cast<char **>(argv_ptr), reinterpret_cast<char **>(envp_ptr));
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
+
+/// @brief Load an ELF file into a new process, give it its arguments and start it.
+///
+/// If anything fails, the partly created process is destroyed.
+///
+/// @param binary_name The System Tree name of the file to load. It is also given to the process as argv[0].
+///
+/// @param argv The remaining arguments, terminated by nullptr. May be nullptr if there are none.
+///
+/// @param envp The environment, terminated by nullptr. May be nullptr if it is empty.
+///
+/// @param[out] new_proc The new, running, process. nullptr if it could not be started.
+///
+/// @return A suitable error code. See proc_load_elf_file() and proc_copy_start_params().
+ERR_CODE proc_spawn_elf_file(const char *binary_name,
+                             const char * const argv[],
+                             const char * const envp[],
+                             std::shared_ptr<task_process> &new_proc)
+{
+  KL_TRC_ENTRY;
+
+  ERR_CODE result;
+
+  ASSERT(binary_name != nullptr);
+
+  result = proc_load_elf_file(binary_name, new_proc);
+  if (result == ERR_CODE::NO_ERROR)
+  {
+    result = proc_copy_start_params(new_proc.get(), binary_name, argv, envp);
+    if (result == ERR_CODE::NO_ERROR)
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Starting new process ", new_proc.get(), "\n");
+      new_proc->start_process();
+    }
+    else
+    {
+      KL_TRC_TRACE(TRC_LVL::FLOW, "Failed to set parameters, destroy the process\n");
+      new_proc->destroy_process();
+      new_proc = nullptr;
+    }
+  }
+
+  KL_TRC_TRACE(TRC_LVL::EXTRA, "Result: ", result, "\n");
+  KL_TRC_EXIT;
+
+  return result;
+}
@@ -32,7 +32,7 @@ public:
   /// @param[out] child If the named child can be found, a pointer to it is stored in child.
   ///
   /// @return An appropriate choice from `ERR_CODE`
-  virtual ERR_CODE get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) = 0;
+  virtual ERR_CODE get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child) = 0;
 
   /// @brief Add a child to this branch of System Tree.
   ///
@@ -103,6 +103,31 @@ public:
       second_part = name_to_split.substr(split_pos + 1, kl_string::npos);
     }
   }
+
+  /// @brief Splits a child's path name into the part referring to a child of this branch, and the remainder.
+  ///
+  /// This behaves in the same way as the version taking kl_strings, but the parts refer to the characters of
+  /// `name_to_split` rather than copying them, so no memory is allocated.
+  ///
+  /// @param[in] name_to_split The path to split.
+  ///
+  /// @param[out] first_part The part of the path given that refers to a child branch of this one.
+  ///
+  /// @param[out] second_part The remainder of the path.
+  void split_name(const kl_string_view &name_to_split, kl_string_view &first_part, kl_string_view &second_part) const
+  {
+    uint64_t split_pos = name_to_split.find('\\');
+
+    first_part = name_to_split.substr(0, split_pos);
+    if (split_pos == kl_string_view::npos)
+    {
+      second_part = kl_string_view();
+    }
+    else
+    {
+      second_part = name_to_split.substr(split_pos + 1);
+    }
+  }
 };
 
 #endif
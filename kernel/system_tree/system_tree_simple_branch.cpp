@@ -20,31 +20,33 @@ system_tree_simple_branch::~system_tree_simple_branch()
   KL_TRC_EXIT;
 }
 
-ERR_CODE system_tree_simple_branch::get_child(const kl_string &name,
+ERR_CODE system_tree_simple_branch::get_child(const kl_string_view &name,
                                               std::shared_ptr<ISystemTreeLeaf> &child)
 {
   KL_TRC_ENTRY;
 
   ERR_CODE ret_code = ERR_CODE::NO_ERROR;
-  kl_string our_part;
-  kl_string child_part;
+  kl_string_view our_part;
+  kl_string_view child_part;
   std::shared_ptr<ISystemTreeBranch> branch;
-  std::shared_ptr<ISystemTreeLeaf> direct_child;
+  std::shared_ptr<ISystemTreeLeaf> *direct_child;
 
   KL_TRC_TRACE(TRC_LVL::EXTRA, "Looking for child with name ", name, "to store in ", &child, "\n");
 
   this->split_name(name, our_part, child_part);
 
-  if (children.contains(our_part))
+  // Names are normally short enough that creating the key doesn't allocate.
+  direct_child = children.find(kl_string(our_part));
+
+  if (direct_child != nullptr)
   {
     KL_TRC_TRACE(TRC_LVL::FLOW, "Retrieve direct child\n");
-    direct_child = children.search(our_part);
 
-    if (child_part != "")
+    if (!child_part.empty())
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Attempt to pass request to child\n");
 
-      branch = std::dynamic_pointer_cast<ISystemTreeBranch>(direct_child);
+      branch = std::dynamic_pointer_cast<ISystemTreeBranch>(*direct_child);
 
       if (branch)
       {
@@ -59,7 +61,7 @@ ERR_CODE system_tree_simple_branch::get_child(const kl_string &name,
     else
     {
       KL_TRC_TRACE(TRC_LVL::FLOW, "Found child ourselves\n");
-      child = direct_child;
+      child = *direct_child;
     }
   }
   else
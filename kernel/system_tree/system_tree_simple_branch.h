@@ -13,7 +13,7 @@ public:
   system_tree_simple_branch();
   virtual ~system_tree_simple_branch();
 
-  virtual ERR_CODE get_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
+  virtual ERR_CODE get_child(const kl_string_view &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
   virtual ERR_CODE add_child (const kl_string &name, std::shared_ptr<ISystemTreeLeaf> child) override;
   virtual ERR_CODE create_child(const kl_string &name, std::shared_ptr<ISystemTreeLeaf> &child) override;
   virtual ERR_CODE rename_child(const kl_string &old_name, const kl_string &new_name) override;
@@ -93,6 +93,11 @@ enum AZALEA_ENUM_CLASS ERR_CODE_T
    *  The provided data wasn't in a recognised format
    */
   UNRECOGNISED = 16,
+
+  /**
+   *  The recipient's message queue is full, and the sender chose not to wait (or gave up waiting) for space.
+   */
+  SYNC_MSG_QUEUE_FULL = 17,
 };
 
 AZALEA_RENAME_ENUM(ERR_CODE);
@@ -0,0 +1,108 @@
+#ifndef __USER_INTFACE_IO_RING_H
+#define __USER_INTFACE_IO_RING_H
+
+/** @file
+ *  @brief Layout of the submission and completion rings used for asynchronous handle I/O.
+ *
+ *  A process places an io_ring_header, followed by the submission queue and then the completion queue, in a block of
+ *  its own memory and passes it to syscall_io_ring_create(). The process adds requests to the submission queue and
+ *  advances sq_tail, then calls syscall_io_ring_enter() to make sure a kernel worker thread has noticed them. The
+ *  workers carry out the requests and post the results to the completion queue, which the process can read without
+ *  making a system call.
+ *
+ *  The indices in the header are never wrapped. The entry an index refers to is found by masking it with the number
+ *  of entries in the queue minus one. */
+
+#include <stdint.h>
+#include "./kernel_types.h"
+#include "./error_codes.h"
+#include "./macros.h"
+
+/* The maximum number of entries in each queue. */
+#define IO_RING_MAX_ENTRIES 256
+
+/* The maximum number of kernel worker threads servicing a single ring. */
+#define IO_RING_MAX_WORKERS 8
+
+/**
+ * @brief The operations that can be requested through the submission queue.
+ **/
+enum AZALEA_ENUM_CLASS IO_RING_OP_T
+{
+  NOP = 0, /**< Do nothing, but still post a completion. */
+  READ = 1, /**< Read from `handle`, as per syscall_read_handle(). `value` is the number of bytes read. */
+  WRITE = 2, /**< Write to `handle`, as per syscall_write_handle(). `value` is the number of bytes written. */
+  OPEN = 3, /**< Open the path in `buffer`, as per syscall_open_handle(). `value` is the new handle. */
+  CLOSE = 4, /**< Close `handle`, as per syscall_close_handle(). */
+  WAIT = 5, /**< Wait for the object `handle`, as per syscall_wait_for_object(). */
+};
+
+AZALEA_RENAME_ENUM(IO_RING_OP);
+
+/**
+ * @brief One request in the submission queue.
+ **/
+struct io_ring_sqe
+{
+  uint64_t opcode; /**< One of the IO_RING_OP values. */
+  GEN_HANDLE handle; /**< The handle to operate on. Unused by NOP and OPEN. */
+  uint64_t offset; /**< The offset to begin reading or writing at. */
+  void *buffer; /**< The buffer to read into or write from, or the path to open. */
+  uint64_t length; /**< The length of buffer, in bytes. */
+  uint64_t user_data; /**< Copied to the completion, so that the process can match it to the request. */
+};
+
+/**
+ * @brief One result in the completion queue.
+ **/
+struct io_ring_cqe
+{
+  uint64_t user_data; /**< The user_data of the request this result is for. */
+  ERR_CODE result; /**< The result of the request. */
+  uint64_t value; /**< The number of bytes transferred, or the new handle. See IO_RING_OP. */
+};
+
+/**
+ * @brief The header at the start of the ring memory.
+ *
+ * The process writes sq_tail and cq_head. The kernel writes everything else.
+ **/
+struct io_ring_header
+{
+  volatile uint32_t sq_head; /**< The next request the kernel will take from the submission queue. */
+  volatile uint32_t sq_tail; /**< One past the last request the process has submitted. */
+  volatile uint32_t cq_head; /**< The next completion the process will read. */
+  volatile uint32_t cq_tail; /**< One past the last completion the kernel has posted. */
+  uint32_t entries; /**< The number of entries in each queue. Set by the kernel. */
+  uint32_t reserved; /**< Reserved, set to zero. */
+};
+
+/* The number of bytes of memory needed for a ring with the given number of entries in each queue. */
+#define IO_RING_SIZE(entries) (sizeof(struct io_ring_header) + \
+                               ((entries) * (sizeof(struct io_ring_sqe) + sizeof(struct io_ring_cqe))))
+
+/**
+ * @brief Find the submission queue of a ring.
+ *
+ * @param ring The header at the start of the ring memory.
+ *
+ * @return The first entry in the submission queue.
+ **/
+static inline struct io_ring_sqe *io_ring_sq(struct io_ring_header *ring)
+{
+  return (struct io_ring_sqe *)(ring + 1);
+}
+
+/**
+ * @brief Find the completion queue of a ring.
+ *
+ * @param ring The header at the start of the ring memory.
+ *
+ * @return The first entry in the completion queue.
+ **/
+static inline struct io_ring_cqe *io_ring_cq(struct io_ring_header *ring)
+{
+  return (struct io_ring_cqe *)(io_ring_sq(ring) + ring->entries);
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "./macros.h"
+#include "./error_codes.h"
 
 typedef uint64_t GEN_HANDLE;
 
@@ -17,4 +18,37 @@ enum AZALEA_ENUM_CLASS TLS_REGISTERS_T
 
 AZALEA_RENAME_ENUM(TLS_REGISTERS);
 
+/* The maximum number of buffers in a single vectored read or write. */
+#define IO_MAX_VECTORS 64
+
+/**
+ *  @brief One buffer in a vectored read or write.
+ */
+struct io_vector
+{
+  void *buffer; /**< The start of the buffer. */
+  uint64_t length; /**< The length of the buffer, in bytes. */
+};
+
+/* The maximum number of calls in a single syscall_batch() request. */
+#define SYSCALL_BATCH_MAX_CALLS 32
+
+/* Flags for syscall_batch() */
+#define SYSCALL_BATCH_STOP_ON_ERROR 1 /**< Don't make any more calls after one returns an error. */
+
+/**
+ *  @brief One system call within a call to syscall_batch().
+ *
+ *  Some system calls write their results to memory given by a pointer argument. A later call in the same batch can use
+ *  such a result by setting the corresponding bit of indirect_args and putting the address the result was written to
+ *  in args. For example, the handle written by an open call can be used as the handle for a following read.
+ */
+struct syscall_batch_call
+{
+  uint64_t syscall_idx; /**< Which system call to make. One of the SYSCALL_IDX_... values. */
+  uint64_t args[6]; /**< The arguments to the system call. Unused arguments are ignored. */
+  uint64_t indirect_args; /**< If bit n is set, args[n] is the address of the 64-bit value to use as argument n. */
+  ERR_CODE result; /**< Set to the result of the call, if the call was made. */
+};
+
 #endif
@@ -8,6 +8,45 @@ const uint64_t SM_KEYDOWN = 1;
 const uint64_t SM_KEYUP = 2;
 const uint64_t SM_PCHAR = 3;
 
+/* Pass as the max_wait parameter of the message receiving functions to wait indefinitely for a message. */
+const uint64_t MSG_MAX_WAIT = 0xFFFFFFFFFFFFFFFF;
+
+/* The number of 64-bit words carried by a synchronous call or its reply. These are passed in registers, so that
+ * small requests do not need a message buffer at all. */
+#define MSG_CALL_WORDS 4
+
+/**
+ * @brief The payload of a synchronous call or its reply.
+ **/
+struct msg_call_words
+{
+  uint64_t words[MSG_CALL_WORDS];
+};
+
+/**
+ * @brief Details of a synchronous call received by a server.
+ **/
+struct msg_call_details
+{
+  uint64_t calling_proc_id; /**< The ID of the process making the call. */
+  struct msg_call_words request; /**< The words sent by the caller. */
+};
+
+/* The maximum number of messages that can be retrieved by one call to syscall_receive_message_batch(). */
+#define MSG_MAX_BATCH 64
+
+/**
+ * @brief Details of one message retrieved by syscall_receive_message_batch().
+ **/
+struct msg_batch_entry
+{
+  uint64_t sending_proc_id; /**< The ID of the process that sent the message. */
+  uint64_t message_id; /**< The ID of the message type. */
+  uint64_t message_len; /**< The full length of the message. */
+  uint64_t body_offset; /**< The offset of the message body within the caller's body buffer. */
+  uint64_t body_copied; /**< The number of bytes of the body copied. Less than message_len if the buffer was full. */
+};
+
 /* System message structures */
 
 /**
@@ -0,0 +1,101 @@
+#ifndef __USER_INTFACE_SHARED_PAGE_H
+#define __USER_INTFACE_SHARED_PAGE_H
+
+/** @file
+ *  @brief Layout of the read-only page that the kernel maps into every user mode process.
+ *
+ *  The kernel publishes timekeeping and scheduling information in this page so that user mode code can read the time
+ *  and find out which CPU and thread it is running on without making a system call. */
+
+#include <stdint.h>
+
+/* The address of the shared page in every user mode process. This is the last page of the user mode address space. */
+#define SHARED_PAGE_USER_ADDR 0x00003FFFFFE00000
+
+/* The version of the layout below. Incremented if any field moves. */
+#define SHARED_PAGE_VERSION 1
+
+/* The number of processors that have an entry in the shared page. */
+#define SHARED_PAGE_MAX_CPUS 256
+
+/* The number of bits the product of a TSC delta and shared_page_time_block.tsc_mult is shifted by. */
+#define SHARED_PAGE_TSC_SHIFT 32
+
+/* Flags within shared_page_layout.flags */
+#define SHARED_PAGE_FLAG_TSC_USABLE 1 /**< The time block is valid and the TSC runs at a constant rate. */
+#define SHARED_PAGE_FLAG_CPU_ID_USABLE 2 /**< RDTSCP returns the kernel's ID for the current processor. */
+
+/**
+ * @brief Parameters for converting the TSC to nanoseconds since boot.
+ *
+ * The kernel calibrates the TSC against the HPET. The conversion is:
+ *
+ * ns = base_ns + (((tsc - base_tsc) * tsc_mult) >> SHARED_PAGE_TSC_SHIFT)
+ *
+ * The kernel increments `sequence` before and after updating the block, so it is odd while an update is in progress.
+ * Readers must retry if the sequence is odd or has changed while they were reading.
+ **/
+struct shared_page_time_block
+{
+  volatile uint64_t sequence; /**< Seqlock sequence number. */
+  volatile uint64_t base_tsc; /**< TSC value at the time given by base_ns. */
+  volatile uint64_t base_ns; /**< Nanoseconds since boot at base_tsc. */
+  volatile uint64_t tsc_mult; /**< Nanoseconds per TSC tick, as a fixed point value. */
+};
+
+/**
+ * @brief The thread running on one processor.
+ *
+ * Only written by the processor the entry belongs to, whenever it switches thread. `sequence` is incremented before and
+ * after each change, in the same way as for shared_page_time_block. Each entry occupies its own cache line.
+ **/
+struct shared_page_cpu_block
+{
+  volatile uint64_t sequence; /**< Seqlock sequence number. */
+  volatile uint64_t thread_id; /**< The ID of the thread running on this processor. */
+  volatile uint64_t process_id; /**< The ID of the process that owns thread_id. */
+  uint64_t reserved[5]; /**< Pads the structure to the size of a cache line. */
+};
+
+/**
+ * @brief The layout of the shared page.
+ **/
+struct shared_page_layout
+{
+  uint64_t version; /**< Set to SHARED_PAGE_VERSION. */
+  volatile uint64_t flags; /**< Any of the SHARED_PAGE_FLAG_... values. */
+  uint64_t reserved[6]; /**< Keeps the time block in its own cache line. */
+  struct shared_page_time_block time; /**< TSC calibration. */
+  uint64_t reserved_2[4]; /**< Keeps the CPU blocks in their own cache lines. */
+  struct shared_page_cpu_block cpus[SHARED_PAGE_MAX_CPUS]; /**< The thread running on each processor. */
+};
+
+/**
+ * @brief Convert a TSC value into nanoseconds since boot.
+ *
+ * @param base_tsc The base_tsc field of a consistent copy of the time block.
+ *
+ * @param base_ns The base_ns field of the same copy.
+ *
+ * @param tsc_mult The tsc_mult field of the same copy.
+ *
+ * @param tsc The TSC value to convert.
+ *
+ * @return The number of nanoseconds since boot at the time the TSC held the value tsc.
+ **/
+static inline uint64_t shared_page_tsc_to_ns(uint64_t base_tsc, uint64_t base_ns, uint64_t tsc_mult, uint64_t tsc)
+{
+  unsigned __int128 delta;
+
+  /* The TSCs of different processors may be very slightly out of step, so never go back past the base time. */
+  if (tsc < base_tsc)
+  {
+    return base_ns;
+  }
+
+  delta = (unsigned __int128)(tsc - base_tsc) * tsc_mult;
+
+  return base_ns + (uint64_t)(delta >> SHARED_PAGE_TSC_SHIFT);
+}
+
+#endif
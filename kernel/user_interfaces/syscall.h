@@ -3,6 +3,61 @@
 
 #include "error_codes.h"
 #include "kernel_types.h"
+#include "messages.h"
+
+/* System call index numbers, for use with syscall_batch(). These must match the order of syscall_pointers in the
+ * kernel. */
+#define SYSCALL_IDX_DEBUG_OUTPUT                 0
+#define SYSCALL_IDX_OPEN_HANDLE                  1
+#define SYSCALL_IDX_CLOSE_HANDLE                 2
+#define SYSCALL_IDX_READ_HANDLE                  3
+#define SYSCALL_IDX_GET_HANDLE_DATA_LEN          4
+#define SYSCALL_IDX_WRITE_HANDLE                 5
+#define SYSCALL_IDX_REGISTER_FOR_MP              6
+#define SYSCALL_IDX_SEND_MESSAGE                 7
+#define SYSCALL_IDX_RECEIVE_MESSAGE_DETAILS      8
+#define SYSCALL_IDX_RECEIVE_MESSAGE_BODY         9
+#define SYSCALL_IDX_MESSAGE_COMPLETE             10
+#define SYSCALL_IDX_CREATE_PROCESS               11
+#define SYSCALL_IDX_START_PROCESS                12
+#define SYSCALL_IDX_STOP_PROCESS                 13
+#define SYSCALL_IDX_DESTROY_PROCESS              14
+#define SYSCALL_IDX_EXIT_PROCESS                 15
+#define SYSCALL_IDX_CREATE_THREAD                16
+#define SYSCALL_IDX_START_THREAD                 17
+#define SYSCALL_IDX_STOP_THREAD                  18
+#define SYSCALL_IDX_DESTROY_THREAD               19
+#define SYSCALL_IDX_EXIT_THREAD                  20
+#define SYSCALL_IDX_THREAD_SET_TLS_BASE          21
+#define SYSCALL_IDX_ALLOCATE_BACKING_MEMORY      22
+#define SYSCALL_IDX_RELEASE_BACKING_MEMORY       23
+#define SYSCALL_IDX_MAP_MEMORY                   24
+#define SYSCALL_IDX_UNMAP_MEMORY                 25
+#define SYSCALL_IDX_WAIT_FOR_OBJECT              26
+#define SYSCALL_IDX_FUTEX_WAIT                   27
+#define SYSCALL_IDX_FUTEX_WAKE                   28
+#define SYSCALL_IDX_CREATE_OBJ_AND_HANDLE        29
+#define SYSCALL_IDX_SET_HANDLE_DATA_LEN          30
+#define SYSCALL_IDX_SET_STARTUP_PARAMS           31
+#define SYSCALL_IDX_RECEIVE_MESSAGE_DETAILS_WAIT 32
+#define SYSCALL_IDX_CALL_PROCESS                 33
+#define SYSCALL_IDX_RECEIVE_CALL                 34
+#define SYSCALL_IDX_REPLY_CALL                   35
+#define SYSCALL_IDX_REPLY_AND_RECEIVE_CALL       36
+#define SYSCALL_IDX_JOIN_BROADCAST_GROUP         37
+#define SYSCALL_IDX_LEAVE_BROADCAST_GROUP        38
+#define SYSCALL_IDX_BROADCAST_MESSAGE            39
+#define SYSCALL_IDX_RECEIVE_MESSAGE_BATCH        40
+#define SYSCALL_IDX_GET_SYSTEM_CLOCK             41
+#define SYSCALL_IDX_READ_HANDLE_VEC              42
+#define SYSCALL_IDX_WRITE_HANDLE_VEC             43
+#define SYSCALL_IDX_IO_RING_CREATE               44
+#define SYSCALL_IDX_IO_RING_ENTER                45
+#define SYSCALL_IDX_BATCH                        46
+#define SYSCALL_IDX_SPAWN_PROCESS                47
+
+/* The number of system calls. */
+#define SYSCALL_IDX_COUNT                        48
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +81,19 @@ ERR_CODE syscall_write_handle(GEN_HANDLE handle,
                               unsigned char *buffer,
                               uint64_t buffer_size,
                               uint64_t *bytes_written);
+ERR_CODE syscall_read_handle_vec(GEN_HANDLE handle,
+                                 uint64_t start_offset,
+                                 const struct io_vector *vectors,
+                                 uint64_t num_vectors,
+                                 uint64_t *bytes_read);
+ERR_CODE syscall_write_handle_vec(GEN_HANDLE handle,
+                                  uint64_t start_offset,
+                                  const struct io_vector *vectors,
+                                  uint64_t num_vectors,
+                                  uint64_t *bytes_written);
+ERR_CODE syscall_io_ring_create(void *ring_memory, uint64_t entries, uint64_t num_workers, GEN_HANDLE *ring_handle);
+ERR_CODE syscall_io_ring_enter(GEN_HANDLE ring_handle, uint64_t min_complete);
+ERR_CODE syscall_batch(struct syscall_batch_call *calls, uint64_t num_calls, uint64_t flags, uint64_t *num_completed);
 ERR_CODE syscall_create_obj_and_handle(const char *path, uint64_t path_len, GEN_HANDLE *handle);
 ERR_CODE syscall_set_handle_data_len(GEN_HANDLE handle, uint64_t data_length);
 
@@ -38,13 +106,47 @@ ERR_CODE syscall_send_message(uint64_t target_proc_id,
 ERR_CODE syscall_receive_message_details(uint64_t *sending_proc_id,
                                          uint64_t *message_id,
                                          uint64_t *message_len);
+ERR_CODE syscall_receive_message_details_wait(uint64_t *sending_proc_id,
+                                              uint64_t *message_id,
+                                              uint64_t *message_len,
+                                              uint64_t max_wait);
 ERR_CODE syscall_receive_message_body(char *message_buffer, uint64_t buffer_size);
 ERR_CODE syscall_message_complete();
+ERR_CODE syscall_receive_message_batch(struct msg_batch_entry *entries,
+                                       uint64_t max_entries,
+                                       char *body_buffer,
+                                       uint64_t body_buffer_size,
+                                       uint64_t *entries_received,
+                                       uint64_t max_wait);
+ERR_CODE syscall_call_process(uint64_t target_proc_id,
+                              uint64_t word_0,
+                              uint64_t word_1,
+                              uint64_t word_2,
+                              uint64_t word_3,
+                              struct msg_call_words *reply);
+ERR_CODE syscall_receive_call(struct msg_call_details *call, uint64_t max_wait);
+ERR_CODE syscall_reply_call(uint64_t word_0, uint64_t word_1, uint64_t word_2, uint64_t word_3);
+ERR_CODE syscall_reply_and_receive_call(uint64_t word_0,
+                                        uint64_t word_1,
+                                        uint64_t word_2,
+                                        uint64_t word_3,
+                                        struct msg_call_details *next_call);
+ERR_CODE syscall_join_broadcast_group(uint64_t group_id);
+ERR_CODE syscall_leave_broadcast_group(uint64_t group_id);
+ERR_CODE syscall_broadcast_message(uint64_t group_id,
+                                   uint64_t message_id,
+                                   uint64_t message_len,
+                                   const char *message_ptr);
 
 /* Process & thread control */
 ERR_CODE syscall_create_process(void *entry_point_addr, GEN_HANDLE *proc_handle);
 ERR_CODE syscall_set_startup_params(GEN_HANDLE proc_handle, uint64_t argc, uint64_t argv_ptr, uint64_t environ_ptr);
 ERR_CODE syscall_start_process(GEN_HANDLE proc_handle);
+ERR_CODE syscall_spawn_process(const char *path,
+                               uint64_t path_len,
+                               char * const argv[],
+                               char * const envp[],
+                               GEN_HANDLE *proc_handle);
 ERR_CODE syscall_stop_process(GEN_HANDLE proc_handle);
 ERR_CODE syscall_destroy_process(GEN_HANDLE proc_handle);
 void syscall_exit_process();
@@ -74,6 +176,9 @@ ERR_CODE syscall_wait_for_object(GEN_HANDLE wait_object_handle);
 ERR_CODE syscall_futex_wait(volatile int32_t *futex, int32_t req_value);
 ERR_CODE syscall_futex_wake(volatile int32_t *futex);
 
+/* Time. Where possible, user mode reads the time from the shared page instead - see shared_page.h */
+ERR_CODE syscall_get_system_clock(uint64_t *ns_since_boot);
+
 #ifdef __cplusplus
 }
 #endif
@@ -77,7 +77,8 @@ bool mem_is_valid_virt_addr(uint64_t virtual_addr)
 void mem_x64_map_virtual_page(uint64_t virt_addr,
                               uint64_t phys_addr,
                               task_process *context,
-                              MEM_CACHE_MODES cache_mode)
+                              MEM_CACHE_MODES cache_mode,
+                              bool writable)
 {
   // In the test scripts this doesn't do anything, but scripts that rely on mapping will fail.
 }
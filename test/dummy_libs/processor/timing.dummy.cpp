@@ -3,7 +3,43 @@
 #include "processor/timing/timing.h"
 #include "test/test_core/test.h"
 
+#include <chrono>
+
 void time_stall_process(uint64_t wait_in_ns)
 {
   test_spin_sleep(wait_in_ns);
-}
\ No newline at end of file
+}
+
+// In the test scripts, the "system timer" simply counts nanoseconds.
+uint64_t time_get_system_timer_count()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t time_get_system_timer_offset(uint64_t wait_in_ns)
+{
+  return wait_in_ns;
+}
+
+uint64_t time_get_system_timer_ns()
+{
+  return time_get_system_timer_count();
+}
+
+uint64_t time_now_ns()
+{
+  return time_get_system_timer_count();
+}
+
+bool time_tsc_in_use()
+{
+  return false;
+}
+
+// The test scripts' "TSC" also counts nanoseconds.
+bool time_tsc_ticks_to_ns(uint64_t ticks, uint64_t &ns)
+{
+  ns = ticks;
+  return true;
+}
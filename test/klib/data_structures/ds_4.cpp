@@ -91,3 +91,68 @@ TEST(DataStructuresTest, Strings1)
   kl_string string_h("Hello!", 4);
   ASSERT_EQ(string_h, "Hell");
 }
+
+// Tests of strings around the short string limit, and of kl_string_view.
+TEST(DataStructuresTest, Strings2)
+{
+  const char *short_text = "Short";
+  const char *limit_text = "Twenty-three characters";
+  const char *long_text = "This string is much too long to fit in the short string buffer";
+
+  // Strings either side of the short string limit should behave the same.
+  kl_string short_str(short_text);
+  kl_string limit_str(limit_text, 23);
+  kl_string long_str(long_text);
+  ASSERT_EQ(limit_str.length(), 23);
+  ASSERT_EQ(long_str.length(), 62);
+  ASSERT_TRUE(limit_str == "Twenty-three characters");
+
+  // Moving a short string must copy it, while moving a long one transfers the buffer.
+  kl_string moved_short(std::move(short_str));
+  kl_string moved_long(std::move(long_str));
+  ASSERT_TRUE(moved_short == short_text);
+  ASSERT_TRUE(moved_long == long_text);
+  ASSERT_EQ(short_str.length(), 0);
+  ASSERT_EQ(long_str.length(), 0);
+
+  short_str = std::move(moved_long);
+  long_str = std::move(moved_short);
+  ASSERT_TRUE(short_str == long_text);
+  ASSERT_TRUE(long_str == short_text);
+
+  // Self-assignment leaves the string alone.
+  kl_string &self_ref = short_str;
+  short_str = self_ref;
+  ASSERT_TRUE(short_str == long_text);
+
+  // Growing from short to long, and substrings from long to short.
+  long_str = long_str + " and now it is much, much longer than before";
+  ASSERT_TRUE(long_str == "Short and now it is much, much longer than before");
+  ASSERT_TRUE(long_str.substr(0, 5) == "Short");
+
+  // A default constructed string is empty, not null.
+  kl_string empty_str;
+  ASSERT_EQ(empty_str.length(), 0);
+  ASSERT_EQ(empty_str.hash(), kl_string("").hash());
+
+  // Views
+  kl_string_view view("pipes\\terminal-output\\read");
+  ASSERT_EQ(view.length(), 26);
+  ASSERT_EQ(view.find('\\'), 5);
+  ASSERT_EQ(view.find("terminal"), 6);
+  ASSERT_EQ(view.find("nothing"), kl_string_view::npos);
+  ASSERT_EQ(view.find('x'), kl_string_view::npos);
+  ASSERT_TRUE(view.substr(0, 5) == "pipes");
+  ASSERT_TRUE(view.substr(22) == "read");
+  ASSERT_TRUE(view.substr(26).empty());
+  ASSERT_TRUE(view.substr(100).empty());
+  ASSERT_TRUE(view.substr(6, 8) != "terminal-output");
+
+  kl_string from_view(view.substr(6, 15));
+  ASSERT_TRUE(from_view == "terminal-output");
+  ASSERT_TRUE(kl_string_view(from_view) == view.substr(6, 15));
+  ASSERT_EQ(from_view.hash(), view.substr(6, 15).hash());
+
+  ASSERT_TRUE(kl_string_view(nullptr).empty());
+  ASSERT_TRUE(kl_string_view() == "");
+}
@@ -0,0 +1,212 @@
+#include "test/test_core/test.h"
+#include "klib/data_structures/hash_map.h"
+#include "klib/data_structures/red_black_tree.h"
+#include "klib/data_structures/string.h"
+#include "klib/misc/assert.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <time.h>
+#include <map>
+#include <vector>
+#include <functional>
+#include <string>
+#include "gtest/gtest.h"
+
+using namespace std;
+
+// Tests of kl_hash_map, checked against std::map.
+
+namespace
+{
+  const uint64_t HASH_TEST_KEYS = 10000;
+  const uint64_t HASH_BENCH_KEYS = 100000;
+}
+
+TEST(DataStructuresTest, HashMapBasics)
+{
+  kl_hash_map<uint64_t, uint64_t> map;
+  uint64_t value;
+
+  ASSERT_EQ(map.num_entries(), 0);
+  ASSERT_FALSE(map.contains(1));
+  ASSERT_FALSE(map.find(1, value));
+  map.debug_verify_map();
+
+  map.insert(1, 10);
+  map.insert(2, 20);
+  ASSERT_EQ(map.num_entries(), 2);
+  ASSERT_TRUE(map.contains(1));
+  ASSERT_EQ(map.search(2), 20);
+
+  // Inserting an existing key replaces the value.
+  map.insert(1, 11);
+  ASSERT_EQ(map.num_entries(), 2);
+  ASSERT_TRUE(map.find(1, value));
+  ASSERT_EQ(value, 11);
+
+  map.remove(1);
+  ASSERT_FALSE(map.contains(1));
+  ASSERT_TRUE(map.contains(2));
+  ASSERT_EQ(map.num_entries(), 1);
+  map.debug_verify_map();
+
+  map.clear();
+  ASSERT_EQ(map.num_entries(), 0);
+  ASSERT_FALSE(map.contains(2));
+}
+
+TEST(DataStructuresTest, HashMapRandom)
+{
+  kl_hash_map<uint64_t, uint64_t> map;
+  std::map<uint64_t, uint64_t> reference;
+  uint64_t key;
+  uint64_t value;
+
+  srand(time(nullptr));
+
+  // Keys are all multiples of 64, so that a poor hash would give lots of collisions.
+  while (reference.size() < HASH_TEST_KEYS)
+  {
+    key = (rand() % 1000000) * 64;
+    reference[key] = key + 1;
+    map.insert(key, key + 1);
+  }
+  ASSERT_EQ(map.num_entries(), reference.size());
+  map.debug_verify_map();
+
+  for (auto &entry : reference)
+  {
+    ASSERT_TRUE(map.find(entry.first, value));
+    ASSERT_EQ(value, entry.second);
+  }
+
+  // Remove about half the keys, and check that the rest are still there.
+  for (auto iter = reference.begin(); iter != reference.end(); )
+  {
+    if (rand() % 2)
+    {
+      map.remove(iter->first);
+      iter = reference.erase(iter);
+    }
+    else
+    {
+      iter++;
+    }
+  }
+  ASSERT_EQ(map.num_entries(), reference.size());
+  map.debug_verify_map();
+
+  for (uint64_t i = 0; i < 1000000; i += 997)
+  {
+    key = i * 64;
+    ASSERT_EQ(map.contains(key), reference.find(key) != reference.end());
+  }
+
+  while (!reference.empty())
+  {
+    map.remove(reference.begin()->first);
+    reference.erase(reference.begin());
+  }
+  ASSERT_EQ(map.num_entries(), 0);
+  map.debug_verify_map();
+}
+
+TEST(DataStructuresTest, HashMapStrings)
+{
+  kl_hash_map<kl_string, uint64_t> map;
+  kl_hash_map<uint64_t, kl_string> reverse_map;
+  kl_string name;
+  char buffer[32];
+
+  for (uint64_t i = 0; i < 1000; i++)
+  {
+    snprintf(buffer, sizeof(buffer), "message.%lu", i);
+    map.insert(kl_string(buffer), i);
+    reverse_map.insert(i, kl_string(buffer));
+  }
+  map.debug_verify_map();
+
+  for (uint64_t i = 0; i < 1000; i++)
+  {
+    snprintf(buffer, sizeof(buffer), "message.%lu", i);
+    ASSERT_EQ(map.search(kl_string(buffer)), i);
+    ASSERT_TRUE(reverse_map.find(i, name));
+    ASSERT_TRUE(name == kl_string(buffer));
+  }
+
+  // Empty strings are equal however they were created, so they must hash the same too.
+  kl_string empty_a;
+  kl_string empty_b("");
+  ASSERT_EQ(empty_a.hash(), empty_b.hash());
+  map.insert(empty_a, 5000);
+  ASSERT_EQ(map.search(empty_b), 5000);
+
+  ASSERT_FALSE(map.contains(kl_string("message.1000")));
+
+  for (uint64_t i = 0; i < 1000; i += 2)
+  {
+    snprintf(buffer, sizeof(buffer), "message.%lu", i);
+    map.remove(kl_string(buffer));
+  }
+  map.debug_verify_map();
+  ASSERT_EQ(map.num_entries(), 501);
+}
+
+// Not really a test - compares the speed of kl_hash_map against kl_rb_tree, and prints the results.
+TEST(DataStructuresTest, DISABLED_HashMapBenchmark)
+{
+  kl_hash_map<uint64_t, uint64_t> *map = new kl_hash_map<uint64_t, uint64_t>();
+  kl_rb_tree<uint64_t, uint64_t> *tree = new kl_rb_tree<uint64_t, uint64_t>();
+  vector<uint64_t> keys;
+  vector<kl_string> string_keys;
+  kl_hash_map<kl_string, uint64_t> *string_map = new kl_hash_map<kl_string, uint64_t>();
+  kl_rb_tree<kl_string, uint64_t> *string_tree = new kl_rb_tree<kl_string, uint64_t>();
+  uint64_t total = 0;
+  char buffer[32];
+
+  for (uint64_t i = 0; i < HASH_BENCH_KEYS; i++)
+  {
+    keys.push_back(kl_hash_mix(i));
+    snprintf(buffer, sizeof(buffer), "bench.name.%lu", i * 7919);
+    string_keys.push_back(kl_string(buffer));
+  }
+
+  auto time_it = [](const char *name, const std::function<void()> &fn)
+  {
+    cout << name << ": " << test_time_ms(fn) << " ms" << endl;
+  };
+
+  time_it("kl_hash_map insert", [&]() { for (uint64_t k : keys) { map->insert(k, k); } });
+  time_it("kl_rb_tree insert ", [&]() { for (uint64_t k : keys) { tree->insert(k, k); } });
+  time_it("kl_hash_map lookup", [&]() { for (uint64_t k : keys) { total += map->search(k); } });
+  time_it("kl_rb_tree lookup ", [&]() { for (uint64_t k : keys) { total += tree->search(k); } });
+  time_it("kl_hash_map remove", [&]() { for (uint64_t k : keys) { map->remove(k); } });
+  time_it("kl_rb_tree remove ", [&]() { for (uint64_t k : keys) { tree->remove(k); } });
+  ASSERT_EQ(tree->num_leaves(), 0);
+
+  time_it("kl_hash_map string insert", [&]()
+  {
+    for (uint64_t i = 0; i < HASH_BENCH_KEYS; i++)
+    {
+      string_map->insert(string_keys[i], i);
+    }
+  });
+  time_it("kl_rb_tree string insert ", [&]()
+  {
+    for (uint64_t i = 0; i < HASH_BENCH_KEYS; i++)
+    {
+      string_tree->insert(string_keys[i], i);
+    }
+  });
+  time_it("kl_hash_map string lookup", [&]() { for (auto &s : string_keys) { total += string_map->search(s); } });
+  time_it("kl_rb_tree string lookup ", [&]() { for (auto &s : string_keys) { total += string_tree->search(s); } });
+
+  ASSERT_EQ(map->num_entries(), 0);
+  ASSERT_NE(total, 0);
+
+  delete map;
+  delete tree;
+  delete string_map;
+  delete string_tree;
+}
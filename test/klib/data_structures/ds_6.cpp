@@ -0,0 +1,189 @@
+// Tests of the red-black tree's iterators, range queries, node pool and intrusive variant.
+
+#include "test/test_core/test.h"
+#include "klib/data_structures/red_black_tree.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <time.h>
+#include <map>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace
+{
+  const uint64_t NUM_KEYS = 5000;
+
+  // An object that lives in an intrusive tree.
+  struct tree_object
+  {
+    uint64_t data;
+    kl_rb_tree_node<uint64_t, tree_object *> tree_entry;
+  };
+}
+
+// Check that iterating over a tree gives its keys in order, and that lower_bound and upper_bound agree with std::map.
+TEST(DataStructuresTest, RedBlackTreeIterators)
+{
+  kl_rb_tree<uint64_t, uint64_t> tree;
+  map<uint64_t, uint64_t> reference;
+  map<uint64_t, uint64_t>::iterator ref_iter;
+  kl_rb_tree<uint64_t, uint64_t>::iterator tree_iter;
+  uint64_t key;
+
+  srand(time(nullptr));
+
+  ASSERT_TRUE(tree.begin() == tree.end());
+  ASSERT_TRUE(tree.lower_bound(5) == tree.end());
+
+  while (reference.size() < NUM_KEYS)
+  {
+    key = rand() % 100000;
+    reference[key] = key * 2;
+    tree.insert(key, key * 2);
+  }
+  tree.debug_verify_tree();
+  ASSERT_EQ(tree.num_leaves(), reference.size());
+
+  tree_iter = tree.begin();
+  for (ref_iter = reference.begin(); ref_iter != reference.end(); ref_iter++, tree_iter++)
+  {
+    ASSERT_TRUE(tree_iter != tree.end());
+    ASSERT_EQ(tree_iter->key, ref_iter->first);
+    ASSERT_EQ(tree_iter->value, ref_iter->second);
+  }
+  ASSERT_TRUE(tree_iter == tree.end());
+
+  // Walk back from the end to the beginning.
+  ref_iter = reference.end();
+  while (ref_iter != reference.begin())
+  {
+    ref_iter--;
+    tree_iter--;
+    ASSERT_EQ(tree_iter->key, ref_iter->first);
+  }
+  ASSERT_TRUE(tree_iter == tree.begin());
+
+  for (uint64_t i = 0; i < 1000; i++)
+  {
+    key = rand() % 100001;
+
+    ref_iter = reference.lower_bound(key);
+    tree_iter = tree.lower_bound(key);
+    ASSERT_EQ(ref_iter == reference.end(), tree_iter == tree.end());
+    if (ref_iter != reference.end())
+    {
+      ASSERT_EQ(tree_iter->key, ref_iter->first);
+    }
+
+    ref_iter = reference.upper_bound(key);
+    tree_iter = tree.upper_bound(key);
+    ASSERT_EQ(ref_iter == reference.end(), tree_iter == tree.end());
+    if (ref_iter != reference.end())
+    {
+      ASSERT_EQ(tree_iter->key, ref_iter->first);
+    }
+  }
+}
+
+// Check that find() gives a pointer to the stored value, and that the leaf count stays correct while nodes are removed
+// and reused from the pool.
+TEST(DataStructuresTest, RedBlackTreePooling)
+{
+  kl_rb_tree<uint64_t, uint64_t> tree;
+  uint64_t *value;
+
+  tree.reserve_nodes(100);
+
+  for (uint64_t i = 0; i < 100; i++)
+  {
+    tree.insert(i, i);
+  }
+
+  value = tree.find(50);
+  ASSERT_NE(value, nullptr);
+  *value = 5000;
+  ASSERT_EQ(tree.search(50), 5000);
+  ASSERT_EQ(tree.find(100), nullptr);
+
+  for (uint64_t round = 0; round < 10; round++)
+  {
+    for (uint64_t i = 0; i < 100; i += 2)
+    {
+      tree.remove(i);
+      tree.debug_verify_tree();
+    }
+    ASSERT_EQ(tree.num_leaves(), 50);
+
+    for (uint64_t i = 0; i < 100; i += 2)
+    {
+      tree.insert(i, round);
+    }
+    tree.debug_verify_tree();
+    ASSERT_EQ(tree.num_leaves(), 100);
+  }
+
+  tree.clear_tree();
+  ASSERT_EQ(tree.num_leaves(), 0);
+  ASSERT_TRUE(tree.begin() == tree.end());
+
+  tree.insert(7, 7);
+  tree.debug_verify_tree();
+  tree.trim_node_pool();
+  ASSERT_EQ(tree.search(7), 7);
+}
+
+// Check that an intrusive tree links caller-owned nodes without moving them.
+TEST(DataStructuresTest, RedBlackTreeIntrusive)
+{
+  kl_intrusive_rb_tree<uint64_t, tree_object *> tree;
+  vector<tree_object> objects(NUM_KEYS);
+  kl_rb_tree_node<uint64_t, tree_object *> *node;
+  uint64_t expected_key;
+
+  for (uint64_t i = 0; i < NUM_KEYS; i++)
+  {
+    objects[i].data = i;
+    objects[i].tree_entry.key = (i * 7919) % NUM_KEYS;
+    objects[i].tree_entry.value = &objects[i];
+    ASSERT_TRUE(tree.insert(&objects[i].tree_entry));
+  }
+  tree.debug_verify_tree();
+  ASSERT_EQ(tree.num_leaves(), NUM_KEYS);
+
+  // Duplicate keys are refused.
+  ASSERT_FALSE(tree.insert(&objects[0].tree_entry));
+
+  // Removing nodes by pointer must leave every other node where its owner put it.
+  for (uint64_t i = 0; i < NUM_KEYS; i += 3)
+  {
+    tree.remove(&objects[i].tree_entry);
+  }
+  tree.debug_verify_tree();
+
+  for (uint64_t i = 0; i < NUM_KEYS; i++)
+  {
+    node = tree.find(objects[i].tree_entry.key);
+    if ((i % 3) == 0)
+    {
+      ASSERT_EQ(node, nullptr);
+    }
+    else
+    {
+      ASSERT_EQ(node, &objects[i].tree_entry);
+      ASSERT_EQ(node->value->data, i);
+    }
+  }
+
+  expected_key = 0;
+  for (auto iter = tree.begin(); iter != tree.end(); iter++)
+  {
+    ASSERT_GE(iter->key, expected_key);
+    expected_key = iter->key + 1;
+  }
+
+  tree.clear_tree();
+  ASSERT_EQ(tree.num_leaves(), 0);
+}
@@ -0,0 +1,339 @@
+#include "test/test_core/test.h"
+#include "klib/data_structures/ring_buffer.h"
+#include "klib/synch/kernel_locks.h"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <string>
+#include "gtest/gtest.h"
+
+using namespace std;
+
+// Tests of kl_spsc_ring and kl_mpmc_ring, including multithreaded tests and throughput benchmarks.
+
+namespace
+{
+  const uint64_t RING_TEST_ITEMS = 1000000;
+  const uint64_t RING_TEST_THREADS = 4;
+  const uint64_t RING_BULK_SIZE = 37;
+
+  // Packs a producer number and sequence number together, so consumers can check ordering.
+  uint64_t make_item(uint64_t producer, uint64_t seq)
+  {
+    return (producer << 48) | seq;
+  }
+
+  void ring_time_it(const string &name, uint64_t items, const function<void()> &fn)
+  {
+    double ms = test_time_ms(fn);
+
+    cout << name << ": " << ms << " ms, " << (items / ms / 1000.0) << " M items/s" << endl;
+  }
+
+  // Runs one producer thread and one consumer thread over a ring, moving RING_TEST_ITEMS items in bulk.
+  template <class ring_type> void ring_spsc_transfer(ring_type &ring)
+  {
+    thread producer([&]()
+    {
+      uint64_t buf[RING_BULK_SIZE];
+      uint64_t next = 0;
+      uint64_t count;
+      uint64_t done;
+      uint64_t added;
+
+      while (next < RING_TEST_ITEMS)
+      {
+        count = RING_TEST_ITEMS - next;
+        if (count > RING_BULK_SIZE)
+        {
+          count = RING_BULK_SIZE;
+        }
+        for (uint64_t i = 0; i < count; i++)
+        {
+          buf[i] = next + i;
+        }
+
+        done = 0;
+        while (done < count)
+        {
+          added = ring.push_bulk(buf + done, count - done);
+          if (added == 0)
+          {
+            this_thread::yield();
+          }
+          done += added;
+        }
+        next += count;
+      }
+    });
+
+    uint64_t buf[RING_BULK_SIZE];
+    uint64_t expected = 0;
+    uint64_t got;
+    bool in_order = true;
+
+    while (expected < RING_TEST_ITEMS)
+    {
+      got = ring.pop_bulk(buf, RING_BULK_SIZE);
+      if (got == 0)
+      {
+        this_thread::yield();
+      }
+      for (uint64_t i = 0; i < got; i++)
+      {
+        in_order = in_order && (buf[i] == expected);
+        expected++;
+      }
+    }
+
+    producer.join();
+    ASSERT_TRUE(in_order);
+    ASSERT_EQ(ring.entries_available(), 0);
+  }
+
+  // Runs several producers and consumers over an MPMC ring. Every item must arrive exactly once, and the items from
+  // each producer must reach each consumer in the order they were produced.
+  void ring_mpmc_transfer(kl_mpmc_ring<uint64_t> &ring, uint64_t num_producers, uint64_t num_consumers)
+  {
+    const uint64_t per_producer = RING_TEST_ITEMS / num_producers;
+    vector<thread> threads;
+    vector<uint64_t> received_sums(num_consumers, 0);
+    vector<uint64_t> received_counts(num_consumers, 0);
+    vector<uint8_t> consumer_ok(num_consumers, 1);
+    std::atomic<uint64_t> total_received(0);
+    uint64_t expected_sum = 0;
+    uint64_t sum = 0;
+    uint64_t count = 0;
+
+    for (uint64_t p = 0; p < num_producers; p++)
+    {
+      threads.emplace_back([&ring, p, per_producer]()
+      {
+        uint64_t buf[RING_BULK_SIZE];
+        uint64_t next = 0;
+        uint64_t batch;
+        uint64_t done;
+        uint64_t added;
+
+        while (next < per_producer)
+        {
+          batch = per_producer - next;
+          if (batch > RING_BULK_SIZE)
+          {
+            batch = RING_BULK_SIZE;
+          }
+          for (uint64_t i = 0; i < batch; i++)
+          {
+            buf[i] = make_item(p, next + i);
+          }
+
+          done = 0;
+          while (done < batch)
+          {
+            added = ring.push_bulk(buf + done, batch - done);
+            if (added == 0)
+            {
+              this_thread::yield();
+            }
+            done += added;
+          }
+          next += batch;
+        }
+      });
+    }
+
+    for (uint64_t c = 0; c < num_consumers; c++)
+    {
+      threads.emplace_back([&, c]()
+      {
+        uint64_t buf[RING_BULK_SIZE];
+        vector<uint64_t> last_seen(num_producers, 0);
+        vector<bool> seen_any(num_producers, false);
+        uint64_t got;
+        uint64_t producer;
+        uint64_t seq;
+
+        while (total_received.load() < per_producer * num_producers)
+        {
+          got = ring.pop_bulk(buf, RING_BULK_SIZE);
+          if (got == 0)
+          {
+            this_thread::yield();
+          }
+          for (uint64_t i = 0; i < got; i++)
+          {
+            producer = buf[i] >> 48;
+            seq = buf[i] & ((1ULL << 48) - 1);
+            if ((producer >= num_producers) || (seen_any[producer] && (seq <= last_seen[producer])))
+            {
+              consumer_ok[c] = 0;
+            }
+            else
+            {
+              seen_any[producer] = true;
+              last_seen[producer] = seq;
+            }
+            received_sums[c] += seq;
+          }
+          received_counts[c] += got;
+          total_received += got;
+        }
+      });
+    }
+
+    for (thread &t : threads)
+    {
+      t.join();
+    }
+
+    for (uint64_t c = 0; c < num_consumers; c++)
+    {
+      ASSERT_TRUE(consumer_ok[c]);
+      sum += received_sums[c];
+      count += received_counts[c];
+    }
+
+    expected_sum = num_producers * ((per_producer * (per_producer - 1)) / 2);
+    ASSERT_EQ(count, per_producer * num_producers);
+    ASSERT_EQ(sum, expected_sum);
+    ASSERT_EQ(ring.entries_available(), 0);
+  }
+}
+
+TEST(DataStructuresTest, RingBufferBasics)
+{
+  kl_spsc_ring<uint64_t> spsc(8);
+  kl_mpmc_ring<uint64_t> mpmc(8);
+  uint64_t items[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+  uint64_t out[12];
+  uint64_t item;
+
+  ASSERT_EQ(spsc.capacity(), 8);
+  ASSERT_FALSE(spsc.pop(item));
+  ASSERT_FALSE(mpmc.pop(item));
+
+  ASSERT_TRUE(spsc.push(100));
+  ASSERT_TRUE(mpmc.push(100));
+  ASSERT_EQ(spsc.entries_available(), 1);
+  ASSERT_EQ(mpmc.entries_available(), 1);
+  ASSERT_TRUE(spsc.pop(item));
+  ASSERT_EQ(item, 100);
+  ASSERT_TRUE(mpmc.pop(item));
+  ASSERT_EQ(item, 100);
+
+  // Run several laps of the rings, so that bulk copies wrap around the end of the buffer.
+  for (uint64_t lap = 0; lap < 10; lap++)
+  {
+    ASSERT_EQ(spsc.push_bulk(items, 5), 5);
+    ASSERT_EQ(mpmc.push_bulk(items, 5), 5);
+
+    // Only three more entries will fit.
+    ASSERT_EQ(spsc.push_bulk(items + 5, 7), 3);
+    ASSERT_EQ(mpmc.push_bulk(items + 5, 7), 3);
+    ASSERT_EQ(spsc.space_available(), 0);
+    ASSERT_EQ(mpmc.space_available(), 0);
+    ASSERT_FALSE(spsc.push(99));
+    ASSERT_FALSE(mpmc.push(99));
+
+    ASSERT_EQ(spsc.pop_bulk(out, 3), 3);
+    ASSERT_EQ(spsc.pop_bulk(out + 3, 12), 5);
+    for (uint64_t i = 0; i < 8; i++)
+    {
+      ASSERT_EQ(out[i], i);
+    }
+
+    ASSERT_EQ(mpmc.pop_bulk(out, 3), 3);
+    ASSERT_EQ(mpmc.pop_bulk(out + 3, 12), 5);
+    for (uint64_t i = 0; i < 8; i++)
+    {
+      ASSERT_EQ(out[i], i);
+    }
+
+    ASSERT_EQ(spsc.entries_available(), 0);
+    ASSERT_EQ(mpmc.entries_available(), 0);
+
+    // Leave the rings at a different offset for the next lap.
+    ASSERT_TRUE(spsc.push(lap));
+    ASSERT_TRUE(spsc.pop(item));
+    ASSERT_TRUE(mpmc.push(lap));
+    ASSERT_TRUE(mpmc.pop(item));
+  }
+}
+
+TEST(DataStructuresTest, RingBufferSpscThreads)
+{
+  kl_spsc_ring<uint64_t> ring(1024);
+  ring_spsc_transfer(ring);
+}
+
+TEST(DataStructuresTest, RingBufferMpmcThreads)
+{
+  kl_mpmc_ring<uint64_t> ring(1024);
+
+  ring_mpmc_transfer(ring, 1, 1);
+  ring_mpmc_transfer(ring, RING_TEST_THREADS, 1);
+  ring_mpmc_transfer(ring, 1, RING_TEST_THREADS);
+  ring_mpmc_transfer(ring, RING_TEST_THREADS, RING_TEST_THREADS);
+
+  // A small ring makes full and empty rings, and wrapping, much more common.
+  kl_mpmc_ring<uint64_t> small_ring(4);
+  ring_mpmc_transfer(small_ring, RING_TEST_THREADS, RING_TEST_THREADS);
+}
+
+// Compare the rings against a spinlock-protected copy loop, like the one pipes used to use.
+TEST(DataStructuresTest, DISABLED_RingBufferBenchmark)
+{
+  kl_spsc_ring<uint64_t> spsc(1024);
+  kl_mpmc_ring<uint64_t> mpmc(1024);
+
+  // A minimal locked ring, copying entries one at a time.
+  struct locked_ring
+  {
+    kernel_spinlock lock;
+    uint64_t buffer[1024];
+    uint64_t read_count = 0;
+    uint64_t write_count = 0;
+
+    uint64_t push_bulk(const uint64_t *items, uint64_t count)
+    {
+      uint64_t i;
+      klib_synch_spinlock_lock(lock);
+      for (i = 0; (i < count) && (write_count - read_count < 1024); i++)
+      {
+        buffer[write_count % 1024] = items[i];
+        write_count++;
+      }
+      klib_synch_spinlock_unlock(lock);
+      return i;
+    }
+
+    uint64_t pop_bulk(uint64_t *items, uint64_t count)
+    {
+      uint64_t i;
+      klib_synch_spinlock_lock(lock);
+      for (i = 0; (i < count) && (read_count != write_count); i++)
+      {
+        items[i] = buffer[read_count % 1024];
+        read_count++;
+      }
+      klib_synch_spinlock_unlock(lock);
+      return i;
+    }
+
+    uint64_t entries_available()
+    {
+      return write_count - read_count;
+    }
+  };
+  locked_ring *locked = new locked_ring;
+  klib_synch_spinlock_init(locked->lock);
+
+  ring_time_it("locked ring, 1 to 1", RING_TEST_ITEMS, [&]() { ring_spsc_transfer(*locked); });
+  ring_time_it("kl_spsc_ring, 1 to 1", RING_TEST_ITEMS, [&]() { ring_spsc_transfer(spsc); });
+  ring_time_it("kl_mpmc_ring, 1 to 1", RING_TEST_ITEMS, [&]() { ring_mpmc_transfer(mpmc, 1, 1); });
+  ring_time_it("kl_mpmc_ring, 4 to 4", RING_TEST_ITEMS, [&]() { ring_mpmc_transfer(mpmc, 4, 4); });
+
+  delete locked;
+}
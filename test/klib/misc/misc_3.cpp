@@ -0,0 +1,222 @@
+#include "klib/c_helpers/buffers.h"
+#include "test/test_core/test.h"
+
+#include <iostream>
+#include <functional>
+#include <string>
+#include <memory>
+#include "gtest/gtest.h"
+
+using namespace std;
+
+// Tests of the different implementations of kl_memcpy, kl_memset and kl_memcmp, and a benchmark comparing them.
+
+namespace
+{
+  const KL_MEM_IMPL all_impls[] = { KL_MEM_IMPL::WORD_LOOP, KL_MEM_IMPL::REP_QWORD, KL_MEM_IMPL::REP_BYTE };
+  const char *impl_names[] = { "word loop", "rep movsq", "rep movsb" };
+
+  // Sizes chosen to cover the byte-only cases, the boundary where the string instructions take over, and the
+  // non-temporal threshold.
+  const uint64_t test_sizes[] = { 0, 1, 7, 8, 9, 31, 63, 255, 256, 257, 1000, 4095, 4096, 4097, 65543 };
+
+  // Guard bytes either side of the area being written, to catch overruns.
+  const uint64_t GUARD = 16;
+  const uint8_t GUARD_VAL = 0xAA;
+
+  void fill_pattern(uint8_t *buf, uint64_t len, uint8_t seed)
+  {
+    for (uint64_t i = 0; i < len; i++)
+    {
+      buf[i] = static_cast<uint8_t>((i * 31) + seed);
+    }
+  }
+
+  void buffer_time_it(const string &name, uint64_t size, uint64_t reps, const function<void()> &fn)
+  {
+    double ms = test_time_ms([&]()
+    {
+      for (uint64_t i = 0; i < reps; i++)
+      {
+        fn();
+      }
+    });
+
+    cout << name << ", " << size << " bytes: " << ((size * reps) / ms / 1000.0) << " MB/s" << endl;
+  }
+
+  // The original byte-at-a-time copy, as a benchmark baseline.
+  void byte_copy(const void *from, void *to, uint64_t len)
+  {
+    const uint8_t *f = static_cast<const uint8_t *>(from);
+    uint8_t *t = static_cast<uint8_t *>(to);
+
+    for (uint64_t i = 0; i < len; i++)
+    {
+      t[i] = f[i];
+    }
+  }
+}
+
+TEST(KlibMiscTests, MemcpyAllImplementations)
+{
+  const uint64_t buf_size = 65543 + 8 + (2 * GUARD);
+  unique_ptr<uint8_t[]> src(new uint8_t[buf_size]);
+  unique_ptr<uint8_t[]> dest(new uint8_t[buf_size]);
+  KL_MEM_IMPL orig_impl = kl_mem_get_impl();
+
+  fill_pattern(src.get(), buf_size, 3);
+
+  for (KL_MEM_IMPL impl : all_impls)
+  {
+    kl_mem_select_impl(impl);
+
+    for (uint64_t size : test_sizes)
+    {
+      // Try each combination of source and destination alignment within a word.
+      for (uint64_t src_off = 0; src_off < 8; src_off++)
+      {
+        for (uint64_t dest_off = 0; dest_off < 8; dest_off += 3)
+        {
+          uint8_t *d = dest.get() + GUARD + dest_off;
+          const uint8_t *s = src.get() + GUARD + src_off;
+
+          memset(dest.get(), GUARD_VAL, buf_size);
+          kl_memcpy(s, d, size);
+
+          ASSERT_EQ(memcmp(s, d, size), 0) << "Size " << size << ", offsets " << src_off << "/" << dest_off;
+          for (uint64_t i = 0; i < GUARD; i++)
+          {
+            ASSERT_EQ(*(d - 1 - i), GUARD_VAL);
+            ASSERT_EQ(d[size + i], GUARD_VAL);
+          }
+
+          memset(dest.get(), GUARD_VAL, buf_size);
+          kl_memcpy_nt(s, d, size);
+
+          ASSERT_EQ(memcmp(s, d, size), 0) << "NT size " << size << ", offsets " << src_off << "/" << dest_off;
+          for (uint64_t i = 0; i < GUARD; i++)
+          {
+            ASSERT_EQ(*(d - 1 - i), GUARD_VAL);
+            ASSERT_EQ(d[size + i], GUARD_VAL);
+          }
+        }
+      }
+    }
+  }
+
+  kl_mem_select_impl(orig_impl);
+}
+
+TEST(KlibMiscTests, MemsetAllImplementations)
+{
+  const uint64_t buf_size = 65543 + 8 + (2 * GUARD);
+  unique_ptr<uint8_t[]> dest(new uint8_t[buf_size]);
+  KL_MEM_IMPL orig_impl = kl_mem_get_impl();
+
+  for (KL_MEM_IMPL impl : all_impls)
+  {
+    kl_mem_select_impl(impl);
+
+    for (uint64_t size : test_sizes)
+    {
+      // kl_memset doesn't accept zero-length buffers.
+      if (size == 0)
+      {
+        continue;
+      }
+
+      for (uint64_t off = 0; off < 8; off++)
+      {
+        uint8_t *d = dest.get() + GUARD + off;
+
+        memset(dest.get(), GUARD_VAL, buf_size);
+        kl_memset(d, 0x5C, size);
+
+        for (uint64_t i = 0; i < size; i++)
+        {
+          ASSERT_EQ(d[i], 0x5C) << "Size " << size << ", offset " << off << ", byte " << i;
+        }
+        for (uint64_t i = 0; i < GUARD; i++)
+        {
+          ASSERT_EQ(*(d - 1 - i), GUARD_VAL);
+          ASSERT_EQ(d[size + i], GUARD_VAL);
+        }
+      }
+    }
+  }
+
+  kl_mem_select_impl(orig_impl);
+}
+
+TEST(KlibMiscTests, MemcmpWordwise)
+{
+  const uint64_t buf_size = 100;
+  uint8_t a[buf_size];
+  uint8_t b[buf_size];
+
+  // Keep every byte clear of 0 and 255, so that adding or subtracting one below doesn't wrap.
+  for (uint64_t i = 0; i < buf_size; i++)
+  {
+    a[i] = static_cast<uint8_t>(1 + ((i * 31) % 253));
+  }
+
+  // A difference at every position, in each direction, for several lengths and alignments, must be found and ordered
+  // correctly.
+  for (uint64_t off = 0; off < 8; off++)
+  {
+    for (uint64_t len = 1; len < (buf_size - off); len += 5)
+    {
+      memcpy(b, a, buf_size);
+      ASSERT_EQ(kl_memcmp(a + off, b + off, len), 0);
+
+      for (uint64_t diff = 0; diff < len; diff++)
+      {
+        memcpy(b, a, buf_size);
+        b[off + diff] = a[off + diff] + 1;
+
+        // Make the bytes after the difference compare the other way, so only the first difference can give the result.
+        if (diff + 1 < len)
+        {
+          b[off + diff + 1] = a[off + diff + 1] - 1;
+        }
+
+        ASSERT_EQ(kl_memcmp(a + off, b + off, len), -1) << "Offset " << off << ", len " << len << ", diff " << diff;
+        ASSERT_EQ(kl_memcmp(b + off, a + off, len), 1) << "Offset " << off << ", len " << len << ", diff " << diff;
+        ASSERT_EQ(kl_memcmp(a + off, b + off, diff), 0);
+      }
+    }
+  }
+}
+
+// Compare the implementations over a range of buffer sizes.
+TEST(KlibMiscTests, DISABLED_BufferBenchmark)
+{
+  const uint64_t max_size = 2 * 1024 * 1024;
+  const uint64_t bytes_per_size = 16 * 1024 * 1024;
+  unique_ptr<uint8_t[]> src(new uint8_t[max_size]);
+  unique_ptr<uint8_t[]> dest(new uint8_t[max_size]);
+  KL_MEM_IMPL orig_impl = kl_mem_get_impl();
+  uint64_t reps;
+
+  fill_pattern(src.get(), max_size, 1);
+
+  for (uint64_t size = 8; size <= max_size; size *= 8)
+  {
+    reps = bytes_per_size / size;
+
+    buffer_time_it("byte loop copy", size, reps, [&]() { byte_copy(src.get(), dest.get(), size); });
+
+    for (uint64_t i = 0; i < (sizeof(all_impls) / sizeof(all_impls[0])); i++)
+    {
+      kl_mem_select_impl(all_impls[i]);
+      buffer_time_it(string(impl_names[i]) + " copy", size, reps, [&]() { kl_memcpy(src.get(), dest.get(), size); });
+      buffer_time_it(string(impl_names[i]) + " set", size, reps, [&]() { kl_memset(dest.get(), 0x11, size); });
+    }
+
+    buffer_time_it("non-temporal copy", size, reps, [&]() { kl_memcpy_nt(src.get(), dest.get(), size); });
+    buffer_time_it("memcmp", size, reps, [&]() { kl_memcmp(src.get(), src.get(), size); });
+  }
+
+  kl_mem_select_impl(orig_impl);
+}
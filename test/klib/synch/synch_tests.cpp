@@ -118,6 +118,304 @@ TEST_F(KlibSynchTest, MessagePassing1)
   proc_b->destroy_process();
 }
 
+// Test that message queues are bounded, and that receiving with a timeout gives up if nothing arrives.
+TEST_F(KlibSynchTest, MessagePassingBoundedQueue)
+{
+  std::shared_ptr<task_process> proc_a = task_process::create(nullptr);
+  std::shared_ptr<task_thread> thread_a = proc_a->child_threads.head->item;
+
+  klib_message_hdr send_msg;
+  klib_message_hdr recv_msg;
+  ERR_CODE res;
+
+  const uint64_t queue_len = 2;
+
+  test_only_set_cur_thread(thread_a.get());
+
+  res = msg_register_process(proc_a.get(), queue_len);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  // Nothing has been sent, so waiting briefly should time out with an empty queue.
+  res = msg_retrieve_next_msg(recv_msg, 1000);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_EMPTY);
+  ASSERT_TRUE(thread_a->permit_running);
+
+  send_msg.originating_process = proc_a.get();
+  send_msg.msg_length = 1;
+
+  // Fill the queue.
+  for (uint64_t i = 0; i < queue_len; i++)
+  {
+    send_msg.msg_id = i;
+    send_msg.msg_contents = new char[1];
+    res = msg_send_to_process(proc_a.get(), send_msg);
+    ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  }
+
+  // The next message should be rejected, both immediately and after a short wait. The caller keeps the buffer.
+  send_msg.msg_contents = new char[1];
+  res = msg_send_to_process(proc_a.get(), send_msg);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_FULL);
+  res = msg_send_to_process(proc_a.get(), send_msg, 1000);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_FULL);
+
+  // Handling a message makes space for one more.
+  res = msg_retrieve_next_msg(recv_msg, MSG_MAX_WAIT);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(recv_msg.msg_id, 0);
+
+  // The message being handled still occupies space until it is completed.
+  res = msg_send_to_process(proc_a.get(), send_msg);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_FULL);
+
+  res = msg_msg_complete(recv_msg);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  send_msg.msg_id = queue_len;
+  res = msg_send_to_process(proc_a.get(), send_msg);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  // Messages come out of the ring in the order they went in, even after it wraps around.
+  for (uint64_t i = 1; i <= queue_len; i++)
+  {
+    res = msg_retrieve_next_msg(recv_msg);
+    ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+    ASSERT_EQ(recv_msg.msg_id, i);
+    res = msg_msg_complete(recv_msg);
+    ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  }
+
+  test_only_set_cur_thread(nullptr);
+
+  proc_a->destroy_process();
+
+  // A process stops accepting messages as soon as it starts being destroyed, and can't start accepting them again.
+  send_msg.msg_contents = nullptr;
+  send_msg.msg_length = 0;
+  res = msg_send_to_process(proc_a.get(), send_msg, MSG_MAX_WAIT);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+  res = msg_register_process(proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::INVALID_OP);
+}
+
+// Retrieve several messages at once, and check they come out in order.
+TEST_F(KlibSynchTest, MessagePassingBatch)
+{
+  std::shared_ptr<task_process> proc_a = task_process::create(nullptr);
+  std::shared_ptr<task_thread> thread_a = proc_a->child_threads.head->item;
+
+  klib_message_hdr send_msg;
+  klib_message_hdr recv_msgs[3];
+  uint64_t num_msgs;
+  ERR_CODE res;
+
+  const uint64_t msgs_to_send = 5;
+
+  test_only_set_cur_thread(thread_a.get());
+
+  res = msg_register_process(proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  res = msg_retrieve_msg_batch(recv_msgs, 3, num_msgs);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_EMPTY);
+  ASSERT_EQ(num_msgs, 0);
+
+  send_msg.originating_process = proc_a.get();
+  send_msg.msg_length = 1;
+  for (uint64_t i = 0; i < msgs_to_send; i++)
+  {
+    send_msg.msg_id = i;
+    send_msg.msg_contents = new char[1];
+    res = msg_send_to_process(proc_a.get(), send_msg);
+    ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  }
+
+  // The batch retrieve can't be mixed with a message retrieved the normal way.
+  res = msg_retrieve_next_msg(recv_msgs[0]);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  res = msg_retrieve_msg_batch(recv_msgs, 3, num_msgs);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_INCOMPLETE);
+  res = msg_msg_complete(recv_msgs[0]);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  // Of the four remaining messages, the first batch is limited by the size of the array and the second by the number of
+  // messages left.
+  res = msg_retrieve_msg_batch(recv_msgs, 3, num_msgs, MSG_MAX_WAIT);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(num_msgs, 3);
+  for (uint64_t i = 0; i < num_msgs; i++)
+  {
+    ASSERT_EQ(recv_msgs[i].msg_id, i + 1);
+    msg_release_contents(recv_msgs[i]);
+  }
+
+  res = msg_retrieve_msg_batch(recv_msgs, 3, num_msgs);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(num_msgs, 1);
+  ASSERT_EQ(recv_msgs[0].msg_id, 4);
+  msg_release_contents(recv_msgs[0]);
+
+  res = msg_retrieve_msg_batch(recv_msgs, 3, num_msgs, 1000);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_EMPTY);
+
+  test_only_set_cur_thread(nullptr);
+
+  proc_a->destroy_process();
+}
+
+// Check the parts of synchronous call handling that don't need a second thread to be running.
+TEST_F(KlibSynchTest, MessageCallErrors)
+{
+  std::shared_ptr<task_process> proc_a = task_process::create(nullptr);
+  std::shared_ptr<task_process> proc_b = task_process::create(nullptr);
+  std::shared_ptr<task_thread> thread_a = proc_a->child_threads.head->item;
+
+  msg_call_words request = { { 1, 2, 3, 4 } };
+  msg_call_words reply = { { 0, 0, 0, 0 } };
+  msg_call_details call;
+  ERR_CODE res;
+
+  test_only_set_cur_thread(thread_a.get());
+
+  // Neither process accepts messages yet, so no calls can be made or received.
+  res = msg_call_process(proc_b.get(), request, reply);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+  ASSERT_FALSE(klib_list_item_is_in_any_list(thread_a->synch_list_item));
+
+  res = msg_receive_call(call);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+
+  res = msg_register_process(proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  // No calls have been made, so there's nothing to receive or reply to.
+  res = msg_receive_call(call);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_EMPTY);
+  res = msg_receive_call(call, 1000);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_EMPTY);
+  ASSERT_FALSE(klib_list_item_is_in_any_list(thread_a->synch_list_item));
+
+  res = msg_reply_call(reply);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_MISMATCH);
+
+  // A process that is being destroyed can't be called, even while other references to it remain.
+  res = msg_register_process(proc_b.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  proc_b->destroy_process();
+  res = msg_call_process(proc_b.get(), request, reply);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+  ASSERT_FALSE(klib_list_item_is_in_any_list(thread_a->synch_list_item));
+
+  test_only_set_cur_thread(nullptr);
+
+  proc_a->destroy_process();
+  proc_b->destroy_process();
+}
+
+// Broadcast a message to a group, and check that each member sees the same contents.
+TEST_F(KlibSynchTest, MessageBroadcastGroups)
+{
+  std::shared_ptr<task_process> proc_a = task_process::create(nullptr);
+  std::shared_ptr<task_process> proc_b = task_process::create(nullptr);
+  std::shared_ptr<task_thread> thread_a = proc_a->child_threads.head->item;
+  std::shared_ptr<task_thread> thread_b = proc_b->child_threads.head->item;
+
+  const uint64_t group_id = 5;
+  klib_message_hdr send_msg;
+  klib_message_hdr recv_a;
+  klib_message_hdr recv_b;
+  char *contents;
+  ERR_CODE res;
+
+  res = msg_register_process(proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  // proc_b can't join until it accepts messages.
+  res = msg_init_broadcast_group(group_id);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  res = msg_init_broadcast_group(group_id);
+  ASSERT_EQ(res, ERR_CODE::ALREADY_EXISTS);
+  res = msg_add_process_to_grp(group_id + 1, proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NOT_FOUND);
+  res = msg_add_process_to_grp(group_id, proc_b.get());
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_NOT_ACCEPTED);
+
+  res = msg_register_process(proc_b.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  res = msg_add_process_to_grp(group_id, proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  res = msg_add_process_to_grp(group_id, proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::ALREADY_EXISTS);
+  res = msg_add_process_to_grp(group_id, proc_b.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  contents = new char[4];
+  memcpy(contents, "abc", 4);
+  send_msg.originating_process = proc_a.get();
+  send_msg.msg_id = 1;
+  send_msg.msg_length = 4;
+  send_msg.msg_contents = contents;
+
+  res = msg_broadcast_msg(group_id, send_msg);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(send_msg.msg_contents, nullptr);
+
+  // Both recipients share a single copy of the contents.
+  test_only_set_cur_thread(thread_a.get());
+  res = msg_retrieve_next_msg(recv_a);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(recv_a.msg_contents, contents);
+
+  test_only_set_cur_thread(thread_b.get());
+  res = msg_retrieve_next_msg(recv_b);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(recv_b.msg_contents, contents);
+
+  // Completing the message in one process leaves it intact for the other.
+  test_only_set_cur_thread(thread_a.get());
+  res = msg_msg_complete(recv_a);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(recv_b.shared_contents.use_count(), 2);
+  ASSERT_EQ(strcmp(recv_b.msg_contents, "abc"), 0);
+
+  test_only_set_cur_thread(thread_b.get());
+  res = msg_msg_complete(recv_b);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  // After leaving, proc_a no longer receives broadcasts.
+  res = msg_remove_process_from_grp(group_id, proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  res = msg_remove_process_from_grp(group_id, proc_a.get());
+  ASSERT_EQ(res, ERR_CODE::NOT_FOUND);
+
+  send_msg.msg_contents = new char[4];
+  res = msg_broadcast_msg(group_id, send_msg);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+
+  test_only_set_cur_thread(thread_a.get());
+  res = msg_retrieve_next_msg(recv_a);
+  ASSERT_EQ(res, ERR_CODE::SYNC_MSG_QUEUE_EMPTY);
+
+  // Unregistering proc_b removes it from the group, and discards the message still waiting for it.
+  res = msg_unregister_process(proc_b.get());
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  ASSERT_TRUE(klib_list_is_empty(&proc_b->msg_groups));
+
+  res = msg_terminate_broadcast_group(group_id);
+  ASSERT_EQ(res, ERR_CODE::NO_ERROR);
+  res = msg_terminate_broadcast_group(group_id);
+  ASSERT_EQ(res, ERR_CODE::NOT_FOUND);
+
+  send_msg.msg_contents = new char[4];
+  res = msg_broadcast_msg(group_id, send_msg);
+  ASSERT_EQ(res, ERR_CODE::NOT_FOUND);
+
+  test_only_set_cur_thread(nullptr);
+
+  proc_a->destroy_process();
+  proc_b->destroy_process();
+}
+
 // Test that name and ID mapping works, that names and IDs cannot be duplicated.
 TEST_F(KlibSynchTest, MessagePassing2)
 {
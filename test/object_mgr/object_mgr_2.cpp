@@ -3,6 +3,7 @@
 #include "object_mgr/handles.h"
 #include "object_mgr/object_mgr.h"
 #include "processor/processor.h"
+#include "system_tree/fs/fs_file_interface.h"
 
 #include "gtest/gtest.h"
 
@@ -16,6 +17,22 @@ public:
   virtual ~simple_object() {}
 };
 
+class readable_object : public ISystemTreeLeaf, public IReadable
+{
+public:
+  virtual ~readable_object() {}
+
+  virtual ERR_CODE read_bytes(uint64_t start,
+                              uint64_t length,
+                              uint8_t *buffer,
+                              uint64_t buffer_length,
+                              uint64_t &bytes_read) override
+  {
+    bytes_read = 0;
+    return ERR_CODE::NO_ERROR;
+  }
+};
+
 // A very simple test of the handle manager.
 TEST(ObjectManagerTest, StoreAndRetrieve)
 {
@@ -42,3 +59,62 @@ TEST(ObjectManagerTest, StoreAndRetrieve)
     ASSERT_EQ(objects[i].use_count(), 1);
   }
 }
+
+// Check that handles are not reused for a new object, that the table grows, and that interfaces are cached.
+TEST(ObjectManagerTest, HandleReuseAndInterfaces)
+{
+  const uint32_t many_objects = 100;
+  shared_ptr<simple_object> objects[many_objects];
+  GEN_HANDLE handles[many_objects];
+  shared_ptr<readable_object> readable = make_shared<readable_object>();
+  GEN_HANDLE readable_handle;
+  GEN_HANDLE old_handle;
+  object_data data;
+  unique_ptr<object_manager> om = std::make_unique<object_manager>();
+
+  for (int i = 0; i < many_objects; i++)
+  {
+    objects[i] = make_shared<simple_object>();
+    handles[i] = om->store_object(objects[i]);
+    ASSERT_NE(handles[i], 0);
+  }
+
+  for (int i = 0; i < many_objects; i++)
+  {
+    ASSERT_EQ(objects[i], dynamic_pointer_cast<simple_object>(om->retrieve_object(handles[i])));
+  }
+
+  // A removed handle must not find the object that reuses its slot.
+  old_handle = handles[10];
+  om->remove_object(old_handle);
+  ASSERT_EQ(objects[10].use_count(), 1);
+  ASSERT_EQ(om->retrieve_object(old_handle), nullptr);
+
+  readable_handle = om->store_object(readable);
+  ASSERT_NE(readable_handle, old_handle);
+  ASSERT_EQ(om->retrieve_object(old_handle), nullptr);
+  ASSERT_FALSE(om->retrieve_object_data(old_handle, data));
+
+  // Removing a stale handle has no effect.
+  om->remove_object(old_handle);
+  ASSERT_EQ(om->retrieve_object(readable_handle), readable);
+
+  ASSERT_TRUE(om->retrieve_object_data(readable_handle, data));
+  ASSERT_EQ(data.object_ptr, readable);
+  ASSERT_EQ(data.handle, readable_handle);
+  ASSERT_EQ(data.readable, dynamic_cast<IReadable *>(readable.get()));
+  ASSERT_EQ(data.writable, nullptr);
+  ASSERT_EQ(data.wait_obj, nullptr);
+
+  ASSERT_TRUE(om->retrieve_object_data(handles[0], data));
+  ASSERT_EQ(data.readable, nullptr);
+  data.object_ptr = nullptr;
+
+  om->remove_all_objects();
+  ASSERT_EQ(readable.use_count(), 1);
+  for (int i = 0; i < many_objects; i++)
+  {
+    ASSERT_EQ(objects[i].use_count(), 1);
+    ASSERT_EQ(om->retrieve_object(handles[i]), nullptr);
+  }
+}
@@ -0,0 +1,74 @@
+#include "test/test_core/test.h"
+#include "object_mgr/ref_counter.h"
+
+#include "gtest/gtest.h"
+
+#include <utility>
+
+using namespace std;
+
+// Test the intrusive reference counter and kl_ref_ptr.
+
+namespace
+{
+  uint32_t objects_deleted = 0;
+}
+
+class counted_object : public IRefCounted
+{
+public:
+  virtual ~counted_object() { }
+
+  uint64_t ref_count() { return _ref_counter; }
+
+protected:
+  virtual void ref_counter_zero() override
+  {
+    objects_deleted++;
+    delete this;
+  }
+};
+
+TEST(ObjectManagerTest, IntrusiveRefCounting)
+{
+  counted_object *obj = new counted_object();
+  objects_deleted = 0;
+
+  // The creator holds the first reference.
+  ASSERT_EQ(obj->ref_count(), 1);
+
+  {
+    kl_ref_ptr<counted_object> ptr_a(obj);
+    ASSERT_EQ(obj->ref_count(), 2);
+    ASSERT_EQ(ptr_a.get(), obj);
+    ASSERT_TRUE(ptr_a != nullptr);
+
+    kl_ref_ptr<counted_object> ptr_b = ptr_a;
+    ASSERT_EQ(obj->ref_count(), 3);
+    ASSERT_TRUE(ptr_a == ptr_b);
+
+    // Moving transfers the reference without changing the count.
+    kl_ref_ptr<counted_object> ptr_c = std::move(ptr_b);
+    ASSERT_EQ(obj->ref_count(), 3);
+    ASSERT_TRUE(ptr_b == nullptr);
+    ASSERT_EQ(ptr_c.get(), obj);
+
+    ptr_c = nullptr;
+    ASSERT_EQ(obj->ref_count(), 2);
+
+    // Self-assignment must not release the object.
+    ptr_a = ptr_a;
+    ASSERT_EQ(obj->ref_count(), 2);
+  }
+
+  ASSERT_EQ(obj->ref_count(), 1);
+  ASSERT_EQ(objects_deleted, 0);
+
+  // Adopting takes over the creator's reference, so the object goes when the pointer does.
+  {
+    kl_ref_ptr<counted_object> owner = kl_ref_ptr<counted_object>::adopt(obj);
+    ASSERT_EQ(obj->ref_count(), 1);
+  }
+
+  ASSERT_EQ(objects_deleted, 1);
+}
@@ -0,0 +1,88 @@
+/// @file Tests of boot phase timing.
+///
+
+#include "gtest/gtest.h"
+#include "test/test_core/test.h"
+#include "processor/boot_phases.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(ProcessorTests, BootPhases)
+{
+  uint32_t outer;
+  uint32_t inner;
+  uint32_t unfinished;
+  uint64_t length;
+  char small_buffer[8];
+  string text;
+  vector<thread> threads;
+
+  test_only_reset_boot_phases();
+
+  // With no phases, there is just the header.
+  length = boot_phase_describe(nullptr, 0);
+  text.resize(length + 1);
+  ASSERT_EQ(boot_phase_describe(&text[0], length + 1), length);
+  text.resize(length);
+  ASSERT_EQ(text, "phase start_us duration_us\n");
+
+  // Phases can be nested, and left unfinished.
+  outer = boot_phase_begin("outer");
+  inner = boot_phase_begin("inner");
+  test_spin_sleep(2000000);
+  boot_phase_end(inner);
+  boot_phase_end(outer);
+  unfinished = boot_phase_begin("unfinished");
+  ASSERT_EQ(outer, 0);
+  ASSERT_EQ(inner, 1);
+  ASSERT_EQ(unfinished, 2);
+
+  length = boot_phase_describe(nullptr, 0);
+  text.resize(length + 1);
+  ASSERT_EQ(boot_phase_describe(&text[0], length + 1), length);
+  text.resize(length);
+  ASSERT_EQ(text.find("\nouter 0 "), text.find('\n'));
+  ASSERT_NE(text.find("\ninner "), string::npos);
+  ASSERT_NE(text.find("\nunfinished "), string::npos);
+  ASSERT_EQ(text.substr(text.length() - 3), " -\n");
+
+  // The inner phase took at least the 2ms spent sleeping.
+  ASSERT_GE(stoull(text.substr(text.find(' ', text.find("\ninner ") + 7) + 1)), 2000);
+
+  // Short buffers are truncated, but still terminated.
+  ASSERT_EQ(boot_phase_describe(small_buffer, sizeof(small_buffer)), length);
+  ASSERT_EQ(string(small_buffer), "phase s");
+
+  // Phases can be started on several threads at once, and any beyond the limit are ignored.
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    threads.emplace_back([]()
+    {
+      for (uint32_t j = 0; j < BOOT_MAX_PHASES; j++)
+      {
+        boot_phase_end(boot_phase_begin("thread"));
+      }
+    });
+  }
+  for (thread &t : threads)
+  {
+    t.join();
+  }
+
+  ASSERT_EQ(boot_phase_begin("too many"), BOOT_PHASE_NONE);
+  boot_phase_end(BOOT_PHASE_NONE);
+
+  length = boot_phase_describe(nullptr, 0);
+  text.resize(length + 1);
+  boot_phase_describe(&text[0], length + 1);
+  text.resize(length);
+  ASSERT_EQ(text.find("too many"), string::npos);
+  ASSERT_EQ(std::count(text.begin(), text.end(), '\n'), BOOT_MAX_PHASES + 1);
+
+  test_only_reset_boot_phases();
+}
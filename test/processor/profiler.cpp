@@ -0,0 +1,129 @@
+/// @file Tests of the sampling profiler.
+///
+
+#include "gtest/gtest.h"
+#include "test/test_core/test.h"
+#include "processor/processor.h"
+#include "processor/profiler.h"
+#include "system_tree/system_tree.h"
+
+using namespace std;
+
+namespace
+{
+  uint64_t addr_of(uint64_t *p)
+  {
+    return reinterpret_cast<uint64_t>(p);
+  }
+}
+
+TEST(ProcessorTests, ProfilerSamples)
+{
+  uint64_t stack[64] = { 0 };
+  uint64_t stack_low = addr_of(stack);
+  uint64_t stack_high = addr_of(stack + 64);
+  shared_ptr<task_process> proc;
+  task_thread *thread;
+  prof_sample samples[4];
+
+  system_tree_init();
+  task_gen_init();
+  proc = task_process::create(dummy_thread_fn);
+  thread = proc->child_threads.head->item.get();
+
+  // A chain of three frames, the last of which points back down the stack.
+  stack[4] = addr_of(stack + 10);
+  stack[5] = 0x1111;
+  stack[10] = addr_of(stack + 20);
+  stack[11] = 0x2222;
+  stack[20] = addr_of(stack + 2);
+  stack[21] = 0x3333;
+
+  // Nothing is recorded until the profiler starts.
+  ASSERT_FALSE(prof_is_running());
+  prof_timer_tick(0xAAAA, addr_of(stack + 4), stack_low, stack_high, false, nullptr);
+  ASSERT_EQ(prof_waiting(), 0);
+
+  ASSERT_EQ(prof_start(0), ERR_CODE::INVALID_PARAM);
+  ASSERT_EQ(prof_start(1, 3), ERR_CODE::INVALID_PARAM);
+  ASSERT_FALSE(prof_is_running());
+  ASSERT_EQ(prof_start(2, 4), ERR_CODE::NO_ERROR);
+  ASSERT_TRUE(prof_is_running());
+
+  // Only every second tick gives a sample.
+  prof_timer_tick(0xAAAA, addr_of(stack + 4), stack_low, stack_high, false, nullptr);
+  ASSERT_EQ(prof_waiting(), 0);
+  prof_timer_tick(0xAAAA, addr_of(stack + 4), stack_low, stack_high, false, nullptr);
+  ASSERT_EQ(prof_waiting(), 1);
+
+  ASSERT_EQ(prof_drain(samples, 4), 1);
+  ASSERT_EQ(samples[0].proc_id, 0);
+  ASSERT_EQ(samples[0].flags, 0);
+  ASSERT_EQ(samples[0].thread, 0);
+  ASSERT_EQ(samples[0].process, 0);
+  ASSERT_EQ(samples[0].num_frames, 4);
+  ASSERT_EQ(samples[0].frames[0], 0xAAAA);
+  ASSERT_EQ(samples[0].frames[1], 0x1111);
+  ASSERT_EQ(samples[0].frames[2], 0x2222);
+  ASSERT_EQ(samples[0].frames[3], 0x3333);
+  ASSERT_EQ(samples[0].frames[4], 0);
+
+  // User mode stacks are never followed, only the instruction pointer is recorded.
+  prof_timer_tick(0xABAB, addr_of(stack + 4), stack_low, stack_high, true, nullptr);
+  prof_timer_tick(0xABAB, addr_of(stack + 4), stack_low, stack_high, true, nullptr);
+  ASSERT_EQ(prof_drain(samples, 4), 1);
+  ASSERT_EQ(samples[0].flags, PROF_SAMPLE_USER_MODE);
+  ASSERT_EQ(samples[0].num_frames, 1);
+  ASSERT_EQ(samples[0].frames[0], 0xABAB);
+  ASSERT_EQ(samples[0].frames[1], 0);
+
+  // Frames outside the permitted part of the stack, or misaligned, are not followed.
+  prof_timer_tick(0xBBBB, addr_of(stack + 4), stack_low, addr_of(stack + 11), false, thread);
+  prof_timer_tick(0xBBBB, addr_of(stack + 4), stack_low, addr_of(stack + 11), false, thread);
+  prof_timer_tick(0xCCCC, addr_of(stack + 4), addr_of(stack + 5), stack_high, false, thread);
+  prof_timer_tick(0xCCCC, addr_of(stack + 4), addr_of(stack + 5), stack_high, false, thread);
+  prof_timer_tick(0xDDDD, addr_of(stack + 4) + 1, stack_low, stack_high, false, thread);
+  prof_timer_tick(0xDDDD, addr_of(stack + 4) + 1, stack_low, stack_high, false, thread);
+
+  ASSERT_EQ(prof_drain(samples, 4), 3);
+  ASSERT_EQ(samples[0].flags, 0);
+  ASSERT_EQ(samples[0].thread, reinterpret_cast<uint64_t>(thread));
+  ASSERT_EQ(samples[0].process, reinterpret_cast<uint64_t>(proc.get()));
+  ASSERT_EQ(samples[0].num_frames, 2);
+  ASSERT_EQ(samples[0].frames[1], 0x1111);
+  ASSERT_EQ(samples[1].num_frames, 1);
+  ASSERT_EQ(samples[1].frames[0], 0xCCCC);
+  ASSERT_EQ(samples[2].num_frames, 1);
+  ASSERT_EQ(samples[2].frames[0], 0xDDDD);
+
+  // A chain that loops back on itself is only followed once round.
+  stack[20] = addr_of(stack + 4);
+  stack[21] = 0x3333;
+  prof_timer_tick(0xEEEE, addr_of(stack + 4), stack_low, stack_high, false, nullptr);
+  prof_timer_tick(0xEEEE, addr_of(stack + 4), stack_low, stack_high, false, nullptr);
+  ASSERT_EQ(prof_drain(samples, 4), 1);
+  ASSERT_EQ(samples[0].num_frames, 4);
+
+  // When the ring fills, samples are dropped.
+  for (uint32_t i = 0; i < 12; i++)
+  {
+    prof_timer_tick(0xFFFF, 0, stack_low, stack_high, false, nullptr);
+  }
+  ASSERT_EQ(prof_waiting(), 4);
+  ASSERT_EQ(prof_dropped(), 2);
+
+  // Stopping the profiler keeps the samples already taken.
+  prof_stop();
+  ASSERT_FALSE(prof_is_running());
+  prof_timer_tick(0xFFFF, 0, stack_low, stack_high, false, nullptr);
+  prof_timer_tick(0xFFFF, 0, stack_low, stack_high, false, nullptr);
+  ASSERT_EQ(prof_drain(samples, 4), 4);
+  ASSERT_EQ(samples[3].frames[0], 0xFFFF);
+  ASSERT_EQ(prof_waiting(), 0);
+
+  test_only_reset_profiler();
+  proc->destroy_process();
+  proc = nullptr;
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+}
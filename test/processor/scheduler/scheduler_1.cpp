@@ -113,3 +113,76 @@ TEST(SchedulerTest, SimpleTests)
   test_only_reset_system_tree();
   test_only_reset_allocator();
 }
+
+// Check that the scheduler prefers a hinted thread, but ignores the hint if that thread can't run.
+TEST(SchedulerTest, SwitchHint)
+{
+  shared_ptr<task_process> sys_proc;
+  shared_ptr<task_process> procs[3];
+  task_thread *threads[3];
+  task_thread *cur_thread;
+  task_thread *hinted_thread;
+  task_thread *expected_next;
+  task_thread *ret_thread;
+
+  hm_gen_init();
+  system_tree_init();
+  sys_proc = task_init();
+  sys_proc->stop_process();
+
+  for (int i = 0; i < 3; i++)
+  {
+    procs[i] = task_process::create(dummy_thread_fn);
+    threads[i] = procs[i]->child_threads.head->item.get();
+    procs[i]->start_process();
+  }
+
+  // Pick a thread that normal round-robin scheduling would not choose next. The cycle also contains the (stopped)
+  // system threads, so skip over those.
+  cur_thread = task_get_next_thread();
+  expected_next = cur_thread->next_thread;
+  while (!expected_next->permit_running)
+  {
+    expected_next = expected_next->next_thread;
+  }
+  hinted_thread = nullptr;
+  for (int i = 0; i < 3; i++)
+  {
+    if ((threads[i] != cur_thread) && (threads[i] != expected_next))
+    {
+      hinted_thread = threads[i];
+    }
+  }
+  ASSERT_NE(hinted_thread, nullptr);
+
+  task_set_switch_hint(hinted_thread);
+  ASSERT_EQ(hinted_thread, task_get_next_thread());
+
+  // The hint is only used once, after which scheduling carries on around the cycle.
+  ret_thread = task_get_next_thread();
+  ASSERT_NE(ret_thread, hinted_thread);
+
+  // A hint to a stopped thread is ignored.
+  hinted_thread = (ret_thread == threads[0]) ? threads[1] : threads[0];
+  hinted_thread->permit_running = false;
+  task_set_switch_hint(hinted_thread);
+  ret_thread = task_get_next_thread();
+  ASSERT_NE(ret_thread, hinted_thread);
+
+  // Switch to the idle thread, so that none of the test threads are still locked by the scheduler.
+  for (int i = 0; i < 3; i++)
+  {
+    threads[i]->permit_running = false;
+  }
+  task_get_next_thread();
+
+  for (int i = 0; i < 3; i++)
+  {
+    procs[i]->destroy_process();
+    procs[i] = nullptr;
+  }
+
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+  test_only_reset_allocator();
+}
@@ -0,0 +1,89 @@
+/// @file Tests of the page shared between the kernel and all user mode processes.
+///
+
+#include "gtest/gtest.h"
+#include "test/test_core/test.h"
+#include "processor/processor.h"
+#include "processor/processor-int.h"
+#include "mem/mem.h"
+#include "system_tree/system_tree.h"
+#include "user_interfaces/shared_page.h"
+
+using namespace std;
+
+TEST(ProcessorTests, SharedPage)
+{
+  shared_ptr<task_process> sys_proc;
+  shared_ptr<task_process> proc_a;
+  task_thread *thread_a;
+  const shared_page_layout *page;
+  uint64_t sequence;
+
+  hm_gen_init();
+  system_tree_init();
+  proc_shared_page_init();
+  sys_proc = task_init();
+
+  page = test_only_get_shared_page();
+  ASSERT_NE(page, nullptr);
+  ASSERT_EQ(page->version, SHARED_PAGE_VERSION);
+  ASSERT_EQ(page->flags, 0);
+
+  // Don't run any threads from the system process, it just confuses the rest of the test.
+  sys_proc->stop_process();
+
+  // User mode processes get the page at a fixed address.
+  proc_a = task_process::create(dummy_thread_fn);
+  ASSERT_EQ(mem_get_virtual_allocation_size(SHARED_PAGE_USER_ADDR, proc_a.get()), 1);
+  proc_a->start_process();
+
+  // Scheduling a thread records it in the block for this processor.
+  thread_a = task_get_next_thread();
+  ASSERT_NE(thread_a, nullptr);
+  ASSERT_EQ(page->cpus[0].thread_id, reinterpret_cast<uint64_t>(thread_a));
+  ASSERT_EQ(page->cpus[0].process_id, reinterpret_cast<uint64_t>(proc_a.get()));
+  sequence = page->cpus[0].sequence;
+  ASSERT_NE(sequence, 0);
+  ASSERT_EQ(sequence % 2, 0);
+
+  // Continuing to run the same thread doesn't update the block.
+  ASSERT_EQ(thread_a, task_get_next_thread());
+  ASSERT_EQ(page->cpus[0].sequence, sequence);
+
+  // Publish a clock running at two ticks per nanosecond.
+  proc_shared_page_set_time(1000, 5000, 1ULL << (SHARED_PAGE_TSC_SHIFT - 1));
+  ASSERT_NE(page->flags & SHARED_PAGE_FLAG_TSC_USABLE, 0);
+  ASSERT_NE(page->time.sequence, 0);
+  ASSERT_EQ(page->time.sequence % 2, 0);
+  ASSERT_EQ(shared_page_tsc_to_ns(page->time.base_tsc, page->time.base_ns, page->time.tsc_mult, 3000), 6000);
+
+  // Earlier TSC values never give a time before the base, and large differences don't overflow.
+  ASSERT_EQ(shared_page_tsc_to_ns(page->time.base_tsc, page->time.base_ns, page->time.tsc_mult, 10), 5000);
+  ASSERT_EQ(shared_page_tsc_to_ns(1000, 5000, 3ULL << SHARED_PAGE_TSC_SHIFT, 1000 + (1ULL << 40)),
+            5000 + (3ULL << 40));
+
+  proc_shared_page_enable_cpu_ids();
+  ASSERT_NE(page->flags & SHARED_PAGE_FLAG_CPU_ID_USABLE, 0);
+
+  // If the kernel stops trusting the TSC, user mode is told to stop using it, but can still find the processor ID.
+  proc_shared_page_clear_time();
+  ASSERT_EQ(page->flags & SHARED_PAGE_FLAG_TSC_USABLE, 0);
+  ASSERT_NE(page->flags & SHARED_PAGE_FLAG_CPU_ID_USABLE, 0);
+
+  // Switch to having the idle thread be current. It is necessary to unschedule all tasks as otherwise
+  // test_only_reset_task_mgr() gets stuck waiting for the thread to be unscheduled.
+  proc_a->stop_process();
+  ASSERT_NE(thread_a, task_get_next_thread());
+  ASSERT_NE(page->cpus[0].thread_id, reinterpret_cast<uint64_t>(thread_a));
+  ASSERT_GT(page->cpus[0].sequence, sequence);
+  test_only_set_cur_thread(nullptr);
+  proc_a->destroy_process();
+
+  proc_a = nullptr;
+  sys_proc = nullptr;
+
+  test_only_reset_task_mgr();
+  test_only_reset_shared_page();
+  test_only_reset_system_tree();
+  test_only_reset_allocator();
+}
@@ -3,6 +3,10 @@
 #include "system_tree/system_tree.h"
 #include "system_tree/fs/mem/mem_fs.h"
 #include "user_interfaces/syscall.h"
+#include "user_interfaces/io_ring.h"
+#include "syscall/io_ring.h"
+#include "syscall/syscall_kernel-int.h"
+#include "system_tree/process/process.h"
 
 #include "gtest/gtest.h"
 
@@ -101,6 +105,416 @@ TEST_F(MemFsSyscallTests, CreateWriteAndRead)
   ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
 }
 
+TEST_F(MemFsSyscallTests, VectoredWriteAndRead)
+{
+  ERR_CODE ec;
+  char filename[] = "mem\\new_file";
+  char header[] = "Header:";
+  char payload[] = "payload";
+  char part_a[5];
+  char part_b[10];
+  io_vector vectors[3];
+  GEN_HANDLE new_file_handle;
+  uint64_t br;
+
+  memset(part_a, 0, sizeof(part_a));
+  memset(part_b, 0, sizeof(part_b));
+
+  ec = syscall_create_obj_and_handle(filename, strlen(filename), &new_file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+
+  // Write a header and a payload in one go. The empty vector in the middle is skipped.
+  vectors[0].buffer = header;
+  vectors[0].length = 7;
+  vectors[1].buffer = nullptr;
+  vectors[1].length = 0;
+  vectors[2].buffer = payload;
+  vectors[2].length = 7;
+
+  ec = syscall_write_handle_vec(new_file_handle, 0, vectors, 3, &br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 14);
+
+  ec = syscall_get_handle_data_len(new_file_handle, &br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 14);
+
+  // Read it back split at a different point. The read stops at the end of the file.
+  vectors[0].buffer = part_a;
+  vectors[0].length = 4;
+  vectors[1].buffer = part_b;
+  vectors[1].length = 9;
+
+  ec = syscall_read_handle_vec(new_file_handle, 2, vectors, 2, &br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 12);
+  ASSERT_STREQ(part_a, "ader");
+  ASSERT_STREQ(part_b, ":payload");
+
+  // Invalid vector arrays are rejected.
+  ec = syscall_read_handle_vec(new_file_handle, 0, nullptr, 1, &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_read_handle_vec(new_file_handle, 0, vectors, 0, &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_read_handle_vec(new_file_handle, 0, vectors, IO_MAX_VECTORS + 1, &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  vectors[1].buffer = nullptr;
+  ec = syscall_write_handle_vec(new_file_handle, 0, vectors, 2, &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  // The whole of the array, and the whole of every buffer, must be in user space.
+  ec = syscall_read_handle_vec(new_file_handle,
+                               0,
+                               reinterpret_cast<io_vector *>(0x8000000000000000ULL - sizeof(io_vector)),
+                               2,
+                               &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  vectors[1].buffer = reinterpret_cast<char *>(0x8000000000000000ULL - 4);
+  vectors[1].length = 8;
+  ec = syscall_read_handle_vec(new_file_handle, 0, vectors, 2, &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  vectors[1].buffer = part_b;
+  vectors[1].length = 0xFFFFFFFFFFFFFFFFULL;
+  ec = syscall_read_handle_vec(new_file_handle, 0, vectors, 2, &br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  ec = syscall_close_handle(new_file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+}
+
+TEST_F(MemFsSyscallTests, IoRing)
+{
+  ERR_CODE ec;
+  char filename[] = "mem\\new_file";
+  unsigned char test_string[23] = "This is a test string.";
+  unsigned char output_buffer[23];
+  const uint64_t entries = 4;
+  std::unique_ptr<uint64_t[]> ring_mem(new uint64_t[(IO_RING_SIZE(entries) / sizeof(uint64_t)) + 1]);
+  io_ring_header *ring = reinterpret_cast<io_ring_header *>(ring_mem.get());
+  io_ring_sqe *sq;
+  io_ring_cqe *cq;
+  GEN_HANDLE ring_handle;
+  GEN_HANDLE second_handle;
+  GEN_HANDLE file_handle;
+
+  memset(output_buffer, 0, 23);
+
+  ec = syscall_create_obj_and_handle(filename, strlen(filename), &file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+
+  ec = syscall_io_ring_create(ring, 3, 0, &ring_handle);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_io_ring_create(ring, entries, IO_RING_MAX_WORKERS + 1, &ring_handle);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  // With no workers, requests are carried out during syscall_io_ring_enter().
+  ec = syscall_io_ring_create(ring, entries, 0, &ring_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(ring->entries, entries);
+  sq = io_ring_sq(ring);
+  cq = io_ring_cq(ring);
+
+  // Only one ring per process.
+  ec = syscall_io_ring_create(ring, entries, 0, &second_handle);
+  ASSERT_EQ(ec, ERR_CODE::ALREADY_EXISTS);
+
+  sq[0] = { static_cast<uint64_t>(IO_RING_OP::WRITE), file_handle, 0, test_string, 23, 1 };
+  sq[1] = { static_cast<uint64_t>(IO_RING_OP::OPEN), 0, 0, filename, strlen(filename), 2 };
+  sq[2] = { 99, 0, 0, nullptr, 0, 3 };
+  ring->sq_tail = 3;
+
+  ec = syscall_io_ring_enter(ring_handle, 0);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(ring->sq_head, 3);
+  ASSERT_EQ(ring->cq_tail, 3);
+
+  ASSERT_EQ(cq[0].user_data, 1);
+  ASSERT_EQ(cq[0].result, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(cq[0].value, 23);
+  ASSERT_EQ(cq[1].user_data, 2);
+  ASSERT_EQ(cq[1].result, ERR_CODE::NO_ERROR);
+  second_handle = cq[1].value;
+  ASSERT_EQ(cq[2].user_data, 3);
+  ASSERT_EQ(cq[2].result, ERR_CODE::INVALID_PARAM);
+
+  // The completions haven't been reaped, so there is only space in the completion queue for one of these requests.
+  // The queue indices wrap around the end of the queue.
+  sq[3] = { static_cast<uint64_t>(IO_RING_OP::READ), second_handle, 0, output_buffer, 23, 4 };
+  sq[0] = { static_cast<uint64_t>(IO_RING_OP::CLOSE), second_handle, 0, nullptr, 0, 5 };
+  ring->sq_tail = 5;
+
+  ec = syscall_io_ring_enter(ring_handle, 0);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(ring->sq_head, 4);
+  ASSERT_EQ(ring->cq_tail, 4);
+  ASSERT_EQ(cq[3].user_data, 4);
+  ASSERT_EQ(cq[3].result, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(cq[3].value, 23);
+  ASSERT_STREQ((char *)output_buffer, (char *)test_string);
+
+  ring->cq_head = 4;
+  ec = syscall_io_ring_enter(ring_handle, 0);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(ring->sq_head, 5);
+  ASSERT_EQ(ring->cq_tail, 5);
+  ASSERT_EQ(cq[0].user_data, 5);
+  ASSERT_EQ(cq[0].result, ERR_CODE::NO_ERROR);
+
+  // The handle really was closed.
+  ec = syscall_close_handle(second_handle);
+  ASSERT_EQ(ec, ERR_CODE::NOT_FOUND);
+
+  ec = syscall_io_ring_enter(file_handle, 0);
+  ASSERT_EQ(ec, ERR_CODE::NOT_FOUND);
+
+  ec = syscall_close_handle(ring_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ec = syscall_close_handle(file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+
+  // The process isn't destroyed during this test, so shut the ring down manually.
+  sys_proc->io_ring_obj->shutdown();
+  sys_proc->io_ring_obj = nullptr;
+}
+
+// Only the failure cases can be tested, since the test memory manager can't provide pages for a new process.
+TEST_F(MemFsSyscallTests, SpawnProcessFailures)
+{
+  ERR_CODE ec;
+  char filename[] = "mem\\not_elf";
+  char missing_filename[] = "mem\\missing";
+  unsigned char test_string[] = "This file is definitely not an executable.";
+  GEN_HANDLE file_handle;
+  GEN_HANDLE proc_handle = 0;
+  uint64_t bytes_written;
+  char *good_args[] = { filename, nullptr };
+  char *bad_args[] = { reinterpret_cast<char *>(0xFFFFFFFF00000000ULL), nullptr };
+  unique_ptr<char[]> long_arg = make_unique<char[]>(PROC_START_PARAMS_MAX_SIZE + 1);
+  char *long_args[] = { long_arg.get(), nullptr };
+
+  memset(long_arg.get(), 'a', PROC_START_PARAMS_MAX_SIZE);
+  long_arg[PROC_START_PARAMS_MAX_SIZE] = 0;
+
+  ec = syscall_create_obj_and_handle(filename, strlen(filename), &file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ec = syscall_write_handle(file_handle, 0, sizeof(test_string), test_string, sizeof(test_string), &bytes_written);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ec = syscall_close_handle(file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+
+  ec = syscall_spawn_process(nullptr, 5, nullptr, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_spawn_process(filename, 0, nullptr, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_spawn_process(filename, strlen(filename), nullptr, nullptr, nullptr);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_spawn_process(filename, strlen(filename), bad_args, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_spawn_process(filename, strlen(filename), nullptr, bad_args, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_spawn_process(filename, strlen(filename), long_args, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::OUT_OF_RESOURCE);
+
+  ec = syscall_spawn_process(missing_filename, strlen(missing_filename), good_args, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::NOT_FOUND);
+  ec = syscall_spawn_process(filename, strlen(filename), good_args, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::UNRECOGNISED);
+  ASSERT_EQ(proc_handle, 0);
+
+  // Directories aren't executable either.
+  ec = syscall_spawn_process("mem", 3, nullptr, nullptr, &proc_handle);
+  ASSERT_EQ(ec, ERR_CODE::UNRECOGNISED);
+}
+
+TEST_F(MemFsSyscallTests, BatchedCalls)
+{
+  ERR_CODE ec;
+  char filename[] = "mem\\new_file";
+  char bad_filename[] = "mem\\missing";
+  unsigned char test_string[23] = "This is a test string.";
+  unsigned char output_buffer[23];
+  GEN_HANDLE file_handle = 0;
+  uint64_t bytes_written = 0;
+  uint64_t bytes_read = 0;
+  uint64_t file_len = 0;
+  uint64_t num_completed = 0;
+  syscall_batch_call calls[5];
+
+  memset(output_buffer, 0, 23);
+  memset(calls, 0, sizeof(calls));
+
+  // Create a file, then use the handle written by that call in all of the following calls.
+  calls[0].syscall_idx = SYSCALL_IDX_CREATE_OBJ_AND_HANDLE;
+  calls[0].args[0] = reinterpret_cast<uint64_t>(filename);
+  calls[0].args[1] = strlen(filename);
+  calls[0].args[2] = reinterpret_cast<uint64_t>(&file_handle);
+
+  calls[1].syscall_idx = SYSCALL_IDX_WRITE_HANDLE;
+  calls[1].indirect_args = 1;
+  calls[1].args[0] = reinterpret_cast<uint64_t>(&file_handle);
+  calls[1].args[1] = 0;
+  calls[1].args[2] = 23;
+  calls[1].args[3] = reinterpret_cast<uint64_t>(test_string);
+  calls[1].args[4] = 23;
+  calls[1].args[5] = reinterpret_cast<uint64_t>(&bytes_written);
+
+  calls[2].syscall_idx = SYSCALL_IDX_GET_HANDLE_DATA_LEN;
+  calls[2].indirect_args = 1;
+  calls[2].args[0] = reinterpret_cast<uint64_t>(&file_handle);
+  calls[2].args[1] = reinterpret_cast<uint64_t>(&file_len);
+
+  calls[3].syscall_idx = SYSCALL_IDX_READ_HANDLE;
+  calls[3].indirect_args = 1;
+  calls[3].args[0] = reinterpret_cast<uint64_t>(&file_handle);
+  calls[3].args[1] = 0;
+  calls[3].args[2] = 23;
+  calls[3].args[3] = reinterpret_cast<uint64_t>(output_buffer);
+  calls[3].args[4] = 23;
+  calls[3].args[5] = reinterpret_cast<uint64_t>(&bytes_read);
+
+  calls[4].syscall_idx = SYSCALL_IDX_CLOSE_HANDLE;
+  calls[4].indirect_args = 1;
+  calls[4].args[0] = reinterpret_cast<uint64_t>(&file_handle);
+
+  ec = syscall_batch(calls, 5, SYSCALL_BATCH_STOP_ON_ERROR, &num_completed);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(num_completed, 5);
+  for (int i = 0; i < 5; i++)
+  {
+    ASSERT_EQ(calls[i].result, ERR_CODE::NO_ERROR);
+  }
+  ASSERT_EQ(bytes_written, 23);
+  ASSERT_EQ(file_len, 23);
+  ASSERT_EQ(bytes_read, 23);
+  ASSERT_STREQ((char *)output_buffer, (char *)test_string);
+
+  // The handle was closed by the last call.
+  ec = syscall_close_handle(file_handle);
+  ASSERT_EQ(ec, ERR_CODE::NOT_FOUND);
+
+  // Stop at the first failure, if asked to.
+  calls[0].syscall_idx = SYSCALL_IDX_OPEN_HANDLE;
+  calls[0].args[0] = reinterpret_cast<uint64_t>(bad_filename);
+  calls[0].args[1] = strlen(bad_filename);
+  calls[0].args[2] = reinterpret_cast<uint64_t>(&file_handle);
+  calls[1].result = ERR_CODE::UNKNOWN;
+
+  ec = syscall_batch(calls, 2, SYSCALL_BATCH_STOP_ON_ERROR, &num_completed);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(num_completed, 1);
+  ASSERT_EQ(calls[0].result, ERR_CODE::NOT_FOUND);
+  ASSERT_EQ(calls[1].result, ERR_CODE::UNKNOWN);
+
+  // Otherwise carry on regardless.
+  calls[1].syscall_idx = 1000;
+  calls[2].syscall_idx = SYSCALL_IDX_EXIT_PROCESS;
+  calls[3].syscall_idx = SYSCALL_IDX_BATCH;
+  calls[4].indirect_args = 1;
+  calls[4].args[0] = 0;
+
+  ec = syscall_batch(calls, 5, 0, &num_completed);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(num_completed, 5);
+  ASSERT_EQ(calls[0].result, ERR_CODE::NOT_FOUND);
+  ASSERT_EQ(calls[1].result, ERR_CODE::SYSCALL_INVALID_IDX);
+  ASSERT_EQ(calls[2].result, ERR_CODE::INVALID_OP);
+  ASSERT_EQ(calls[3].result, ERR_CODE::INVALID_OP);
+  ASSERT_EQ(calls[4].result, ERR_CODE::INVALID_PARAM);
+
+  ec = syscall_batch(calls, SYSCALL_BATCH_MAX_CALLS + 1, 0, &num_completed);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_batch(calls, 1, 0x100, &num_completed);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  // The whole array must be in user space, not just the first entry.
+  ec = syscall_batch(reinterpret_cast<syscall_batch_call *>(0x8000000000000000ULL - sizeof(syscall_batch_call)),
+                     2,
+                     0,
+                     &num_completed);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+}
+
+// Both of the buffers given to syscall_receive_message_batch() must be entirely in user space.
+TEST(SyscallTests, MessageBatchBadBuffers)
+{
+  ERR_CODE ec;
+  msg_batch_entry entries[2];
+  char body[16];
+  uint64_t received;
+
+  // An entries array that starts in user space and ends outside it.
+  ec = syscall_receive_message_batch(reinterpret_cast<msg_batch_entry *>(0x8000000000000000ULL - sizeof(entries[0])),
+                                     2,
+                                     body,
+                                     sizeof(body),
+                                     &received,
+                                     0);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  // The same for the body buffer, and a body buffer so large that its end wraps around.
+  ec = syscall_receive_message_batch(entries, 2, reinterpret_cast<char *>(0x8000000000000000ULL - 8), 16, &received, 0);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = syscall_receive_message_batch(entries, 2, body, 0xFFFFFFFFFFFFFFFFULL, &received, 0);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+}
+
+// The index numbers given to user mode must match the kernel's table.
+TEST(SyscallTests, IndexNumbers)
+{
+  ASSERT_EQ(syscall_max_idx, SYSCALL_IDX_COUNT - 1);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_DEBUG_OUTPUT], (void *)syscall_debug_output);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_OPEN_HANDLE], (void *)syscall_open_handle);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_CLOSE_HANDLE], (void *)syscall_close_handle);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_READ_HANDLE], (void *)syscall_read_handle);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_GET_HANDLE_DATA_LEN], (void *)syscall_get_handle_data_len);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_WRITE_HANDLE], (void *)syscall_write_handle);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_REGISTER_FOR_MP], (void *)syscall_register_for_mp);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_SEND_MESSAGE], (void *)syscall_send_message);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_RECEIVE_MESSAGE_DETAILS], (void *)syscall_receive_message_details);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_RECEIVE_MESSAGE_BODY], (void *)syscall_receive_message_body);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_MESSAGE_COMPLETE], (void *)syscall_message_complete);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_CREATE_PROCESS], (void *)syscall_create_process);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_START_PROCESS], (void *)syscall_start_process);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_STOP_PROCESS], (void *)syscall_stop_process);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_DESTROY_PROCESS], (void *)syscall_destroy_process);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_EXIT_PROCESS], (void *)syscall_exit_process);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_CREATE_THREAD], (void *)syscall_create_thread);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_START_THREAD], (void *)syscall_start_thread);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_STOP_THREAD], (void *)syscall_stop_thread);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_DESTROY_THREAD], (void *)syscall_destroy_thread);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_EXIT_THREAD], (void *)syscall_exit_thread);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_THREAD_SET_TLS_BASE], (void *)syscall_thread_set_tls_base);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_ALLOCATE_BACKING_MEMORY], (void *)syscall_allocate_backing_memory);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_RELEASE_BACKING_MEMORY], (void *)syscall_release_backing_memory);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_MAP_MEMORY], (void *)syscall_map_memory);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_UNMAP_MEMORY], (void *)syscall_unmap_memory);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_WAIT_FOR_OBJECT], (void *)syscall_wait_for_object);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_FUTEX_WAIT], (void *)syscall_futex_wait);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_FUTEX_WAKE], (void *)syscall_futex_wake);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_CREATE_OBJ_AND_HANDLE], (void *)syscall_create_obj_and_handle);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_SET_HANDLE_DATA_LEN], (void *)syscall_set_handle_data_len);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_SET_STARTUP_PARAMS], (void *)syscall_set_startup_params);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_RECEIVE_MESSAGE_DETAILS_WAIT], (void *)syscall_receive_message_details_wait);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_CALL_PROCESS], (void *)syscall_call_process);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_RECEIVE_CALL], (void *)syscall_receive_call);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_REPLY_CALL], (void *)syscall_reply_call);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_REPLY_AND_RECEIVE_CALL], (void *)syscall_reply_and_receive_call);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_JOIN_BROADCAST_GROUP], (void *)syscall_join_broadcast_group);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_LEAVE_BROADCAST_GROUP], (void *)syscall_leave_broadcast_group);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_BROADCAST_MESSAGE], (void *)syscall_broadcast_message);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_RECEIVE_MESSAGE_BATCH], (void *)syscall_receive_message_batch);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_GET_SYSTEM_CLOCK], (void *)syscall_get_system_clock);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_READ_HANDLE_VEC], (void *)syscall_read_handle_vec);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_WRITE_HANDLE_VEC], (void *)syscall_write_handle_vec);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_IO_RING_CREATE], (void *)syscall_io_ring_create);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_IO_RING_ENTER], (void *)syscall_io_ring_enter);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_BATCH], (void *)syscall_batch);
+  ASSERT_EQ(syscall_pointers[SYSCALL_IDX_SPAWN_PROCESS], (void *)syscall_spawn_process);
+}
+
 TEST_F(MemFsSyscallTests, FileDoesntExist)
 {
   char filename[] = "mem\\new_file";
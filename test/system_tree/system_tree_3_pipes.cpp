@@ -68,3 +68,69 @@ TEST(SystemTreeTest, GeneralPipes)
   ASSERT_EQ(r, ERR_CODE::NO_ERROR);
   ASSERT_EQ(read_this_time, 0);
 }
+
+// Vectored reads and writes are transferred in one go, including across the wrap-around point of the pipe's buffer.
+TEST(SystemTreeTest, VectoredPipes)
+{
+  std::shared_ptr<pipe_branch> pipe_obj = pipe_branch::create();
+  shared_ptr<pipe_branch::pipe_read_leaf> reader;
+  shared_ptr<pipe_branch::pipe_write_leaf> writer;
+  shared_ptr<ISystemTreeLeaf> leaf;
+  std::unique_ptr<uint8_t[]> buf(new uint8_t [pipe_size]);
+  std::unique_ptr<uint8_t[]> out_buf(new uint8_t [pipe_size]);
+  io_vector vectors[2];
+  uint64_t transferred;
+  ERR_CODE r;
+
+  for (int i = 0; i < pipe_size; i++)
+  {
+    buf[i] = i;
+  }
+
+  r = pipe_obj->get_child("read", leaf);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  reader = dynamic_pointer_cast<pipe_branch::pipe_read_leaf>(leaf);
+  ASSERT_TRUE(reader);
+
+  r = pipe_obj->get_child("write", leaf);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  writer = dynamic_pointer_cast<pipe_branch::pipe_write_leaf>(leaf);
+  ASSERT_TRUE(writer);
+
+  // Move the read and write positions most of the way through the buffer.
+  r = writer->write_bytes(0, pipe_size - buffer_size, buf.get(), pipe_size, transferred);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(transferred, pipe_size - buffer_size);
+  r = reader->read_bytes(0, pipe_size - buffer_size, out_buf.get(), pipe_size, transferred);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(transferred, pipe_size - buffer_size);
+
+  // Write from two buffers, wrapping around the end of the pipe.
+  vectors[0].buffer = buf.get();
+  vectors[0].length = buffer_size;
+  vectors[1].buffer = buf.get() + buffer_size;
+  vectors[1].length = buffer_size;
+  r = writer->write_bytes_vec(0, vectors, 2, transferred);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(transferred, buffer_size * 2);
+
+  // Read it back into two differently sized buffers.
+  memset(out_buf.get(), 0, pipe_size);
+  vectors[0].buffer = out_buf.get();
+  vectors[0].length = 3;
+  vectors[1].buffer = out_buf.get() + 3;
+  vectors[1].length = pipe_size - 3;
+  r = reader->read_bytes_vec(0, vectors, 2, transferred);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(transferred, buffer_size * 2);
+  ASSERT_EQ(memcmp(buf.get(), out_buf.get(), buffer_size * 2), 0);
+
+  // A vectored write is truncated to the space left in the pipe.
+  vectors[0].buffer = buf.get();
+  vectors[0].length = pipe_size - 10;
+  vectors[1].buffer = buf.get();
+  vectors[1].length = 20;
+  r = writer->write_bytes_vec(0, vectors, 2, transferred);
+  ASSERT_EQ(r, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(transferred, pipe_size);
+}
@@ -2,6 +2,9 @@
 #include "processor/processor.h"
 #include "system_tree/system_tree.h"
 #include "system_tree/fs/fs_file_interface.h"
+#include "syscall/syscall_stats.h"
+#include "processor/profiler.h"
+#include "processor/boot_phases.h"
 #include "test/test_core/test.h"
 
 #include "gtest/gtest.h"
@@ -65,3 +68,289 @@ TEST(SystemTreeTest, ProcFsOneProcessIdFile)
   test_only_reset_system_tree();
   test_only_reset_allocator();
 }
+
+TEST(SystemTreeTest, ProcFsSyscallStats)
+{
+  shared_ptr<ISystemTreeLeaf> stats_leaf;
+  shared_ptr<IBasicFile> stats_file;
+  ERR_CODE ec;
+  char read_buffer[512];
+  uint64_t br;
+  uint64_t file_size;
+  const char expected_text[] = "# index count total_ticks histogram\n"
+                               "3 3 1073742224 1 0 1 0 0 0 0 0 0 0 0 0 0 0 0 1\n"
+                               "5 1 200 0 1 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n";
+
+  ASSERT_EQ(syscall_stats_bucket(0), 0);
+  ASSERT_EQ(syscall_stats_bucket(127), 0);
+  ASSERT_EQ(syscall_stats_bucket(128), 1);
+  ASSERT_EQ(syscall_stats_bucket(255), 1);
+  ASSERT_EQ(syscall_stats_bucket(256), 2);
+  ASSERT_EQ(syscall_stats_bucket(~0ULL), SYSCALL_STATS_NUM_BUCKETS - 1);
+
+  system_tree_init();
+  task_gen_init();
+
+  shared_ptr<task_process> proc = task_process::create(dummy_thread_fn);
+  ASSERT_TRUE(proc);
+  ASSERT_NE(proc->syscall_stats, nullptr);
+
+  test_only_set_cur_thread(proc->child_threads.head->item.get());
+
+  ec = system_tree()->get_child("proc\\0\\syscalls", stats_leaf);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  stats_file = dynamic_pointer_cast<IBasicFile>(stats_leaf);
+  ASSERT_TRUE(stats_file);
+
+  // A process that has made no calls only has the header line.
+  memset(read_buffer, 0, sizeof(read_buffer));
+  ec = stats_file->read_bytes(0, sizeof(read_buffer), reinterpret_cast<uint8_t *>(read_buffer), sizeof(read_buffer), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_STREQ(read_buffer, "# index count total_ticks histogram\n");
+
+  syscall_stats_record(3, 100);
+  syscall_stats_record(3, 300);
+  syscall_stats_record(3, 1ULL << 30);
+  syscall_stats_record(5, 200);
+
+  // Out of range calls and processors are ignored.
+  syscall_stats_record(SYSCALL_IDX_COUNT, 100);
+  syscall_stats_add(proc.get(), 1, 3, 100);
+
+  ec = stats_file->get_file_size(file_size);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(file_size, strlen(expected_text));
+
+  memset(read_buffer, 0, sizeof(read_buffer));
+  ec = stats_file->read_bytes(0, sizeof(read_buffer), reinterpret_cast<uint8_t *>(read_buffer), sizeof(read_buffer), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, strlen(expected_text));
+  ASSERT_STREQ(read_buffer, expected_text);
+
+  // Partial reads start where asked.
+  memset(read_buffer, 0, sizeof(read_buffer));
+  ec = stats_file->read_bytes(36, 2, reinterpret_cast<uint8_t *>(read_buffer), sizeof(read_buffer), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 2);
+  ASSERT_STREQ(read_buffer, "3 ");
+
+  ec = stats_file->write_bytes(0, 1, reinterpret_cast<uint8_t *>(read_buffer), 1, br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_OP);
+
+  test_only_set_cur_thread(nullptr);
+  proc->destroy_process();
+  proc = nullptr;
+
+  // The file doesn't keep the process alive.
+  ec = stats_file->get_file_size(file_size);
+  ASSERT_EQ(ec, ERR_CODE::NOT_FOUND);
+  stats_file = nullptr;
+  stats_leaf = nullptr;
+
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+  test_only_reset_allocator();
+}
+
+TEST(SystemTreeTest, ProcFsTrace)
+{
+  shared_ptr<ISystemTreeLeaf> trace_leaf;
+  shared_ptr<IBasicFile> trace_file;
+  ERR_CODE ec;
+  kl_trc_record records[4];
+  uint64_t br;
+  uint64_t file_size;
+
+  system_tree_init();
+  task_gen_init();
+  kl_trc_binary_init(1, 8);
+
+  ec = system_tree()->get_child("proc\\trace", trace_leaf);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  trace_file = dynamic_pointer_cast<IBasicFile>(trace_leaf);
+  ASSERT_TRUE(trace_file);
+
+  kl_trc_event(TRC_EVENT::FIRST_AD_HOC, 1);
+  kl_trc_event(TRC_EVENT::FIRST_AD_HOC, 2);
+  kl_trc_event(TRC_EVENT::FIRST_AD_HOC, 3);
+
+  ec = trace_file->get_file_size(file_size);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(file_size, 3 * sizeof(kl_trc_record));
+
+  // Only whole records are returned.
+  ec = trace_file->read_bytes(0, sizeof(kl_trc_record) - 1, reinterpret_cast<uint8_t *>(records), sizeof(records), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 0);
+
+  ec = trace_file->read_bytes(0, sizeof(records), reinterpret_cast<uint8_t *>(records), sizeof(records), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 3 * sizeof(kl_trc_record));
+  ASSERT_EQ(records[0].args[0], 1);
+  ASSERT_EQ(records[2].args[0], 3);
+
+  // The records have now been consumed.
+  ec = trace_file->read_bytes(0, sizeof(records), reinterpret_cast<uint8_t *>(records), sizeof(records), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 0);
+
+  ec = trace_file->write_bytes(0, 1, reinterpret_cast<uint8_t *>(records), 1, br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_OP);
+
+  trace_leaf = nullptr;
+  trace_file = nullptr;
+  test_only_reset_binary_tracing();
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+}
+
+TEST(SystemTreeTest, ProcFsTraceControl)
+{
+  shared_ptr<ISystemTreeLeaf> control_leaf;
+  shared_ptr<IBasicFile> control_file;
+  ERR_CODE ec;
+  char buffer[512];
+  const char *command = "fs flow\n";
+  uint64_t br;
+  uint64_t file_size;
+
+  system_tree_init();
+  task_gen_init();
+
+  ec = system_tree()->get_child("proc\\trace_control", control_leaf);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  control_file = dynamic_pointer_cast<IBasicFile>(control_leaf);
+  ASSERT_TRUE(control_file);
+
+  ec = control_file->write_bytes(0,
+                                 strlen(command),
+                                 reinterpret_cast<const uint8_t *>(command),
+                                 strlen(command),
+                                 br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, strlen(command));
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::FS), static_cast<uint8_t>(TRC_LVL::FLOW));
+
+  ec = control_file->get_file_size(file_size);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_LT(file_size, sizeof(buffer));
+
+  ec = control_file->read_bytes(0, file_size, reinterpret_cast<uint8_t *>(buffer), sizeof(buffer), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, file_size);
+  buffer[br] = 0;
+  ASSERT_NE(string(buffer).find("\nfs 60\n"), string::npos);
+
+  ec = control_file->write_bytes(0, 9, reinterpret_cast<const uint8_t *>("fs silent"), 9, br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ASSERT_EQ(br, 0);
+
+  control_leaf = nullptr;
+  control_file = nullptr;
+  test_only_reset_trace_levels();
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+}
+
+TEST(SystemTreeTest, ProcFsProfile)
+{
+  shared_ptr<ISystemTreeLeaf> profile_leaf;
+  shared_ptr<IBasicFile> profile_file;
+  ERR_CODE ec;
+  prof_sample samples[2];
+  const char *start_command = "start 1\n";
+  uint64_t br;
+  uint64_t file_size;
+
+  system_tree_init();
+  task_gen_init();
+
+  ec = system_tree()->get_child("proc\\profile", profile_leaf);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  profile_file = dynamic_pointer_cast<IBasicFile>(profile_leaf);
+  ASSERT_TRUE(profile_file);
+
+  ec = profile_file->write_bytes(0, 2, reinterpret_cast<const uint8_t *>("go"), 2, br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ec = profile_file->write_bytes(0, 7, reinterpret_cast<const uint8_t *>("start x"), 7, br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+  ASSERT_FALSE(prof_is_running());
+
+  ec = profile_file->write_bytes(0,
+                                 strlen(start_command),
+                                 reinterpret_cast<const uint8_t *>(start_command),
+                                 strlen(start_command),
+                                 br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, strlen(start_command));
+  ASSERT_TRUE(prof_is_running());
+
+  prof_timer_tick(0x1000, 0, 0, 0, false, nullptr);
+  prof_timer_tick(0x2000, 0, 0, 0, false, nullptr);
+
+  ec = profile_file->get_file_size(file_size);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(file_size, 2 * sizeof(prof_sample));
+
+  ec = profile_file->write_bytes(0, 4, reinterpret_cast<const uint8_t *>("stop"), 4, br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_FALSE(prof_is_running());
+
+  ec = profile_file->read_bytes(0, sizeof(samples), reinterpret_cast<uint8_t *>(samples), sizeof(samples), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, 2 * sizeof(prof_sample));
+  ASSERT_EQ(samples[0].frames[0], 0x1000);
+  ASSERT_EQ(samples[1].frames[0], 0x2000);
+
+  profile_leaf = nullptr;
+  profile_file = nullptr;
+  test_only_reset_profiler();
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+}
+
+TEST(SystemTreeTest, ProcFsBootTimes)
+{
+  shared_ptr<ISystemTreeLeaf> boot_leaf;
+  shared_ptr<IBasicFile> boot_file;
+  ERR_CODE ec;
+  char buffer[256];
+  uint64_t br;
+  uint64_t file_size;
+
+  system_tree_init();
+  task_gen_init();
+  test_only_reset_boot_phases();
+  boot_phase_end(boot_phase_begin("first_phase"));
+
+  ec = system_tree()->get_child("proc\\boot_times", boot_leaf);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  boot_file = dynamic_pointer_cast<IBasicFile>(boot_leaf);
+  ASSERT_TRUE(boot_file);
+
+  ec = boot_file->get_file_size(file_size);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_LT(file_size, sizeof(buffer));
+
+  ec = boot_file->read_bytes(0, file_size, reinterpret_cast<uint8_t *>(buffer), sizeof(buffer), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, file_size);
+  buffer[br] = 0;
+  ASSERT_EQ(string(buffer).find("phase start_us duration_us\nfirst_phase 0 "), 0);
+
+  // Reading part way through gives the rest of the text.
+  ec = boot_file->read_bytes(6, file_size, reinterpret_cast<uint8_t *>(buffer), sizeof(buffer), br);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(br, file_size - 6);
+  ASSERT_EQ(buffer[0], 's');
+
+  ec = boot_file->write_bytes(0, 2, reinterpret_cast<const uint8_t *>("hi"), 2, br);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_OP);
+  ASSERT_EQ(br, 0);
+
+  boot_leaf = nullptr;
+  boot_file = nullptr;
+  test_only_reset_boot_phases();
+  test_only_reset_task_mgr();
+  test_only_reset_system_tree();
+}
@@ -0,0 +1,134 @@
+#include "test/test_core/test.h"
+#include "system_tree/process/process.h"
+#include "system_tree/fs/mem/mem_fs.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+// Check the layout of the arguments and environment given to a new process.
+TEST(SystemTreeTest, ProcessStartParams)
+{
+  ERR_CODE ec;
+  const uint64_t user_addr = 0x10000;
+  const char *args[] = { "one", "two", nullptr };
+  const char *env[] = { "A=B", nullptr };
+  unique_ptr<char[]> buffer;
+  uint64_t buffer_size = 0;
+  uint64_t argc;
+  uint64_t argv_ptr;
+  uint64_t envp_ptr;
+  char **argv_out;
+  char **envp_out;
+
+  // Measure first, then fill in.
+  ec = proc_build_start_params("prog", args, env, user_addr, nullptr, buffer_size, argc, argv_ptr, envp_ptr);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(argc, 3);
+  ASSERT_EQ(buffer_size, (6 * sizeof(char *)) + 5 + 4 + 4 + 4);
+
+  buffer = unique_ptr<char[]>(new char[buffer_size]);
+  buffer_size = buffer_size - 1;
+  ec = proc_build_start_params("prog", args, env, user_addr, buffer.get(), buffer_size, argc, argv_ptr, envp_ptr);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+
+  buffer_size = buffer_size + 1;
+  ec = proc_build_start_params("prog", args, env, user_addr, buffer.get(), buffer_size, argc, argv_ptr, envp_ptr);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(argv_ptr, user_addr);
+  ASSERT_EQ(envp_ptr, user_addr + (4 * sizeof(char *)));
+
+  // Pointers in the block are as seen by the new process, so translate them back to find the strings.
+  argv_out = reinterpret_cast<char **>(buffer.get());
+  envp_out = reinterpret_cast<char **>(buffer.get() + (envp_ptr - user_addr));
+  ASSERT_STREQ(buffer.get() + (reinterpret_cast<uint64_t>(argv_out[0]) - user_addr), "prog");
+  ASSERT_STREQ(buffer.get() + (reinterpret_cast<uint64_t>(argv_out[1]) - user_addr), "one");
+  ASSERT_STREQ(buffer.get() + (reinterpret_cast<uint64_t>(argv_out[2]) - user_addr), "two");
+  ASSERT_EQ(argv_out[3], nullptr);
+  ASSERT_STREQ(buffer.get() + (reinterpret_cast<uint64_t>(envp_out[0]) - user_addr), "A=B");
+  ASSERT_EQ(envp_out[1], nullptr);
+
+  // No extra arguments or environment.
+  ec = proc_build_start_params("prog", nullptr, nullptr, user_addr, nullptr, buffer_size, argc, argv_ptr, envp_ptr);
+  ASSERT_EQ(ec, ERR_CODE::NO_ERROR);
+  ASSERT_EQ(argc, 1);
+  ASSERT_EQ(buffer_size, (3 * sizeof(char *)) + 5);
+
+  ec = proc_build_start_params(nullptr, args, env, user_addr, nullptr, buffer_size, argc, argv_ptr, envp_ptr);
+  ASSERT_EQ(ec, ERR_CODE::INVALID_PARAM);
+}
+
+// Check that executable images are found by file, and only evicted when no process is using them.
+TEST(SystemTreeTest, ProcessImageCache)
+{
+  const uint8_t headers_a[] = { 1, 2, 3, 4 };
+  const uint8_t headers_b[] = { 1, 2, 3, 5 };
+  shared_ptr<mem_fs_leaf> file_a = make_shared<mem_fs_leaf>(nullptr);
+  shared_ptr<mem_fs_leaf> file_b = make_shared<mem_fs_leaf>(nullptr);
+  shared_ptr<mem_fs_leaf> file_c = make_shared<mem_fs_leaf>(nullptr);
+  shared_ptr<proc_exec_image> image_a;
+  shared_ptr<proc_exec_image> image_b;
+  shared_ptr<proc_exec_image> found;
+  weak_ptr<proc_exec_image> weak_b;
+  uint64_t stamp;
+  uint64_t bw;
+
+  image_a = make_shared<proc_exec_image>(file_a, "a", 100, headers_a, sizeof(headers_a), 0);
+  image_b = make_shared<proc_exec_image>(file_b, "b", 200, headers_b, sizeof(headers_b), 0);
+  ASSERT_EQ(image_a->num_pages, 0);
+
+  ASSERT_EQ(proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a)), nullptr);
+
+  stamp = proc_image_cache_stamp();
+  proc_image_cache_add(image_a, stamp);
+  proc_image_cache_add(image_b, stamp);
+
+  found = proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a));
+  ASSERT_EQ(found, image_a);
+  found = proc_image_cache_find(file_b.get(), 200, headers_b, sizeof(headers_b));
+  ASSERT_EQ(found, image_b);
+
+  // Any difference in file, size or headers is a different file.
+  ASSERT_EQ(proc_image_cache_find(file_b.get(), 200, headers_a, sizeof(headers_a)), nullptr);
+  ASSERT_EQ(proc_image_cache_find(file_b.get(), 201, headers_b, sizeof(headers_b)), nullptr);
+  ASSERT_EQ(proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a) - 1), nullptr);
+  ASSERT_EQ(proc_image_cache_find(file_c.get(), 100, headers_a, sizeof(headers_a)), nullptr);
+
+  // Only image_a is still in use, so only image_b is evicted.
+  weak_b = image_b;
+  image_b = nullptr;
+  found = nullptr;
+  ASSERT_EQ(proc_image_cache_trim(0), 0);
+  ASSERT_TRUE(weak_b.expired());
+  ASSERT_EQ(proc_image_cache_find(file_b.get(), 200, headers_b, sizeof(headers_b)), nullptr);
+  ASSERT_EQ(proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a)), image_a);
+
+  // Writing to a file removes its images from the cache, even if the size and headers are unchanged. Writes to other
+  // files don't.
+  image_b = make_shared<proc_exec_image>(file_b, "b", 200, headers_b, sizeof(headers_b), 0);
+  proc_image_cache_add(image_b, proc_image_cache_stamp());
+  ASSERT_EQ(file_a->write_bytes(0, sizeof(headers_a), headers_a, sizeof(headers_a), bw), ERR_CODE::NO_ERROR);
+  ASSERT_EQ(proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a)), nullptr);
+  ASSERT_EQ(proc_image_cache_find(file_b.get(), 200, headers_b, sizeof(headers_b)), image_b);
+
+  // So does changing its size.
+  ASSERT_EQ(file_b->set_file_size(200), ERR_CODE::NO_ERROR);
+  ASSERT_EQ(proc_image_cache_find(file_b.get(), 200, headers_b, sizeof(headers_b)), nullptr);
+
+  // An image made from a file that changed while it was being loaded isn't cached at all.
+  stamp = proc_image_cache_stamp();
+  ASSERT_EQ(file_c->set_file_size(100), ERR_CODE::NO_ERROR);
+  proc_image_cache_add(make_shared<proc_exec_image>(file_a, "a", 100, headers_a, sizeof(headers_a), 0), stamp);
+  ASSERT_EQ(proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a)), nullptr);
+
+  // Images of a file that no longer exists are never found.
+  proc_image_cache_add(image_a, proc_image_cache_stamp());
+  ASSERT_EQ(proc_image_cache_find(file_a.get(), 100, headers_a, sizeof(headers_a)), image_a);
+  ISystemTreeLeaf *old_file_a = file_a.get();
+  file_a = nullptr;
+  ASSERT_EQ(proc_image_cache_find(old_file_a, 100, headers_a, sizeof(headers_a)), nullptr);
+
+  image_a = nullptr;
+  image_b = nullptr;
+  ASSERT_EQ(proc_image_cache_trim(0), 0);
+}
@@ -50,3 +50,12 @@ void test_spin_sleep(uint64_t sleep_time_ns)
     //spin
   }
 }
+
+double test_time_ms(const std::function<void()> &fn)
+{
+  auto start = chrono::steady_clock::now();
+  fn();
+  auto end = chrono::steady_clock::now();
+
+  return chrono::duration<double, milli>(end - start).count();
+}
@@ -11,6 +11,8 @@
 
 #endif
 
+#include <functional>
+
 // Allow asserting in all tests. Expect to be linked against the dummy panic lib
 // so that panics are caught by the test system.
 #include "klib/misc/assert.h"
@@ -29,6 +31,10 @@ private:
 
 void test_spin_sleep(uint64_t sleep_time_ns);
 
+// Used by the benchmarks. These are named DISABLED_... so they only run when asked for, using
+// --gtest_also_run_disabled_tests.
+double test_time_ms(const std::function<void()> &fn);
+
 // defined in processor.dummy.cpp
 class task_thread;
 void test_only_set_cur_thread(task_thread *thread);
@@ -0,0 +1,126 @@
+#define ENABLE_TRACING
+
+#include "test/test_core/test.h"
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "klib/tracing/tracing.h"
+
+using namespace std;
+
+// Tests of binary tracing.
+
+namespace
+{
+  // A function with binary entry and exit tracing.
+  void traced_function()
+  {
+    KL_TRC_ENTRY;
+    KL_TRC_EXIT;
+  }
+}
+
+TEST(TracingTest, BinaryRecords)
+{
+  kl_trc_record records[8];
+  uint64_t fn_addr = reinterpret_cast<uint64_t>(&traced_function);
+  uint64_t dropped = kl_trc_binary_dropped();
+
+  // Records made before tracing starts are dropped.
+  KL_TRC_EVENT(TRC_EVENT::FIRST_AD_HOC, 1);
+  ASSERT_EQ(kl_trc_binary_dropped(), dropped + 1);
+  ASSERT_EQ(kl_trc_binary_drain(records, 8), 0);
+
+  kl_trc_binary_init(1, 4);
+
+  KL_TRC_EVENT(TRC_EVENT::FIRST_AD_HOC, 10, 11, 12, 13);
+  KL_TRC_EVENT(TRC_EVENT::THREAD_SWITCH, 20, 21);
+  traced_function();
+  ASSERT_EQ(kl_trc_binary_waiting(), 4);
+
+  ASSERT_EQ(kl_trc_binary_drain(records, 8), 4);
+  ASSERT_EQ(kl_trc_binary_waiting(), 0);
+
+  ASSERT_EQ(records[0].event_id, static_cast<uint16_t>(TRC_EVENT::FIRST_AD_HOC));
+  ASSERT_EQ(records[0].proc_id, 0);
+  ASSERT_EQ(records[0].reserved, 0);
+  ASSERT_EQ(records[0].args[0], 10);
+  ASSERT_EQ(records[0].args[1], 11);
+  ASSERT_EQ(records[0].args[2], 12);
+  ASSERT_EQ(records[0].args[3], 13);
+
+  ASSERT_EQ(records[1].event_id, static_cast<uint16_t>(TRC_EVENT::THREAD_SWITCH));
+  ASSERT_EQ(records[1].args[0], 20);
+  ASSERT_EQ(records[1].args[1], 21);
+  ASSERT_EQ(records[1].args[2], 0);
+  ASSERT_GE(records[1].timestamp, records[0].timestamp);
+
+  // Entry and exit records point in to the traced function, so the decoder can find it in the map file.
+  ASSERT_EQ(records[2].event_id, static_cast<uint16_t>(TRC_EVENT::FN_ENTRY));
+  ASSERT_EQ(records[3].event_id, static_cast<uint16_t>(TRC_EVENT::FN_EXIT));
+  ASSERT_GT(records[2].args[0], fn_addr);
+  ASSERT_GT(records[3].args[0], records[2].args[0]);
+  ASSERT_LT(records[3].args[0], fn_addr + 256);
+
+  // A full ring drops new records, and keeps the old ones.
+  for (uint64_t i = 0; i < 6; i++)
+  {
+    KL_TRC_EVENT(TRC_EVENT::FIRST_AD_HOC, i);
+  }
+  ASSERT_EQ(kl_trc_binary_dropped(), dropped + 3);
+  ASSERT_EQ(kl_trc_binary_drain(records, 8), 4);
+  for (uint64_t i = 0; i < 4; i++)
+  {
+    ASSERT_EQ(records[i].args[0], i);
+  }
+
+  test_only_reset_binary_tracing();
+}
+
+TEST(TracingTest, BinaryRecordsThreaded)
+{
+  const uint64_t num_threads = 4;
+  const uint64_t events_per_thread = 10000;
+  vector<thread> threads;
+  vector<uint64_t> next_expected(num_threads, 0);
+  kl_trc_record records[64];
+  uint64_t got;
+  uint64_t total = 0;
+  uint64_t dropped = kl_trc_binary_dropped();
+
+  kl_trc_binary_init(1, 65536);
+
+  for (uint64_t t = 0; t < num_threads; t++)
+  {
+    threads.emplace_back([t]()
+    {
+      for (uint64_t i = 0; i < events_per_thread; i++)
+      {
+        KL_TRC_EVENT(TRC_EVENT::FIRST_AD_HOC, t, i);
+      }
+    });
+  }
+  for (thread &t : threads)
+  {
+    t.join();
+  }
+
+  // Every record must be present, and each thread's records in order.
+  do
+  {
+    got = kl_trc_binary_drain(records, 64);
+    for (uint64_t i = 0; i < got; i++)
+    {
+      ASSERT_LT(records[i].args[0], num_threads);
+      ASSERT_EQ(records[i].args[1], next_expected[records[i].args[0]]);
+      next_expected[records[i].args[0]]++;
+    }
+    total += got;
+  } while (got != 0);
+
+  ASSERT_EQ(total, num_threads * events_per_thread);
+  ASSERT_EQ(kl_trc_binary_dropped(), dropped);
+
+  test_only_reset_binary_tracing();
+}
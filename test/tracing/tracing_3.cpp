@@ -0,0 +1,98 @@
+// Tracepoints are compiled in to this file, but not forced on, so its output is selected at runtime.
+#define KL_TRACE_ALL
+
+#include "test/test_core/test.h"
+#include <string>
+#include "gtest/gtest.h"
+
+#include "klib/tracing/tracing.h"
+
+using namespace std;
+
+// Tests of runtime selection of trace output by category and level.
+
+namespace
+{
+  // Run the tracepoints in this file at each level, and return what they output.
+  string trace_all_levels()
+  {
+    testing::internal::CaptureStdout();
+    KL_TRC_TRACE(TRC_LVL::EXTRA, "extra\n");
+    KL_TRC_TRACE(TRC_LVL::FLOW, "flow\n");
+    KL_TRC_TRACE(TRC_LVL::IMPORTANT, "important\n");
+    KL_TRC_TRACE(TRC_LVL::ERROR, "error\n");
+    KL_TRC_TRACE(TRC_LVL::FATAL, "fatal\n");
+    return testing::internal::GetCapturedStdout();
+  }
+}
+
+static_assert(kl_trc_path_category("kernel/system_tree/fs/fat/fat_fs.cpp") == TRC_CAT::FS, "FS not found");
+static_assert(kl_trc_path_category("kernel\\system_tree\\system_tree.cpp") == TRC_CAT::SYSTEM_TREE, "Tree not found");
+static_assert(kl_trc_path_category("/src/kernel/mem/x64/mem-x64.cpp") == TRC_CAT::MEM, "Mem not found");
+static_assert(kl_trc_path_category("kernel/entry.cpp") == TRC_CAT::GENERAL, "General not found");
+
+TEST(TracingTest, RuntimeLevels)
+{
+  ASSERT_EQ(KL_TRC_FILE_CATEGORY, TRC_CAT::GENERAL);
+
+  // Everything is off by default.
+  ASSERT_EQ(trace_all_levels(), "");
+
+  kl_trc_set_level(TRC_CAT::GENERAL, static_cast<uint8_t>(TRC_LVL::ERROR));
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::GENERAL), static_cast<uint8_t>(TRC_LVL::ERROR));
+  ASSERT_EQ(trace_all_levels(), "error\nfatal\n");
+
+  kl_trc_set_level(TRC_CAT::GENERAL, 0);
+  ASSERT_EQ(trace_all_levels(), "extra\nflow\nimportant\nerror\nfatal\n");
+
+  // Other categories don't affect this file.
+  kl_trc_set_level(TRC_CAT::GENERAL, TRC_LVL_OFF);
+  kl_trc_set_level(TRC_CAT::MEM, 0);
+  ASSERT_EQ(trace_all_levels(), "");
+
+  test_only_reset_trace_levels();
+}
+
+TEST(TracingTest, RuntimeLevelCommands)
+{
+  char text[512];
+  uint64_t length;
+
+  ASSERT_EQ(kl_trc_apply_control("general important"), ERR_CODE::NO_ERROR);
+  ASSERT_EQ(trace_all_levels(), "important\nerror\nfatal\n");
+
+  ASSERT_EQ(kl_trc_apply_control("all 95\r\n\n  mem\tflow  \nacpi off"), ERR_CODE::NO_ERROR);
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::GENERAL), 95);
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::DEVICES), 95);
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::MEM), static_cast<uint8_t>(TRC_LVL::FLOW));
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::ACPI), TRC_LVL_OFF);
+  ASSERT_EQ(trace_all_levels(), "fatal\n");
+
+  // Bad commands are rejected, but earlier lines have already been applied.
+  ASSERT_EQ(kl_trc_apply_control("klib extra\nnot_a_category flow"), ERR_CODE::NOT_FOUND);
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::KLIB), static_cast<uint8_t>(TRC_LVL::EXTRA));
+  ASSERT_EQ(kl_trc_apply_control("klib"), ERR_CODE::INVALID_PARAM);
+  ASSERT_EQ(kl_trc_apply_control("klib 256"), ERR_CODE::INVALID_PARAM);
+  ASSERT_EQ(kl_trc_apply_control("klib flow extra"), ERR_CODE::INVALID_PARAM);
+  ASSERT_EQ(kl_trc_apply_control("klib loud"), ERR_CODE::INVALID_PARAM);
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::KLIB), static_cast<uint8_t>(TRC_LVL::EXTRA));
+
+  // The description can be applied again to give the same settings.
+  length = kl_trc_describe_levels(nullptr, 0);
+  ASSERT_LT(length, sizeof(text));
+  ASSERT_EQ(kl_trc_describe_levels(text, sizeof(text)), length);
+  ASSERT_EQ(string(text).substr(0, 26), "general 95\nacpi off\ndevice");
+  ASSERT_NE(string(text).find("\nklib 10\nmem 60\n"), string::npos);
+
+  test_only_reset_trace_levels();
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::KLIB), TRC_LVL_OFF);
+  ASSERT_EQ(kl_trc_apply_control(text), ERR_CODE::NO_ERROR);
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::KLIB), static_cast<uint8_t>(TRC_LVL::EXTRA));
+  ASSERT_EQ(kl_trc_get_level(TRC_CAT::ACPI), TRC_LVL_OFF);
+
+  // A short buffer gets truncated text.
+  ASSERT_EQ(kl_trc_describe_levels(text, 8), length);
+  ASSERT_EQ(string(text), "general");
+
+  test_only_reset_trace_levels();
+}
@@ -0,0 +1,116 @@
+// Measures the round-trip cost of synchronous call/reply message passing.
+//
+// A server thread within this process answers calls made by the main thread. Each call carries its payload entirely
+// in registers, so this measures the kernel's call path and the direct switch between the two threads.
+
+#include <azalea/azalea.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" int main (int argc, char **argv);
+
+void server_thread();
+uint64_t read_tsc();
+
+const uint64_t DEFAULT_ITERATIONS = 10000;
+const uint64_t WARMUP_ITERATIONS = 100;
+
+int main (int argc, char **argv)
+{
+  GEN_HANDLE server_handle;
+  ERR_CODE ec;
+  msg_call_words reply;
+  uint64_t iterations = DEFAULT_ITERATIONS;
+  uint64_t start_time;
+  uint64_t end_time;
+  uint64_t null_cycles;
+  uint64_t call_cycles;
+
+  if (argc > 1)
+  {
+    iterations = strtoull(argv[1], nullptr, 10);
+  }
+  if (iterations == 0)
+  {
+    iterations = DEFAULT_ITERATIONS;
+  }
+
+  ec = syscall_register_for_mp();
+  if (ec != ERR_CODE::NO_ERROR)
+  {
+    printf("Failed to register for messages: %d\n", ec);
+    return 1;
+  }
+
+  ec = syscall_create_thread(server_thread, &server_handle);
+  if (ec == ERR_CODE::NO_ERROR)
+  {
+    ec = syscall_start_thread(server_handle);
+  }
+  if (ec != ERR_CODE::NO_ERROR)
+  {
+    printf("Failed to start server thread: %d\n", ec);
+    return 1;
+  }
+
+  // Warm up, and check that the server is answering correctly.
+  for (uint64_t i = 0; i < WARMUP_ITERATIONS; i++)
+  {
+    ec = syscall_call_process(0, i, 1, 2, 3, &reply);
+    if ((ec != ERR_CODE::NO_ERROR) || (reply.words[0] != i + 1))
+    {
+      printf("Call failed: %d\n", ec);
+      return 1;
+    }
+  }
+
+  // Baseline: a system call that does nothing useful, since this thread is not serving a call.
+  start_time = read_tsc();
+  for (uint64_t i = 0; i < iterations; i++)
+  {
+    syscall_reply_call(0, 0, 0, 0);
+  }
+  end_time = read_tsc();
+  null_cycles = (end_time - start_time) / iterations;
+
+  start_time = read_tsc();
+  for (uint64_t i = 0; i < iterations; i++)
+  {
+    syscall_call_process(0, i, 1, 2, 3, &reply);
+  }
+  end_time = read_tsc();
+  call_cycles = (end_time - start_time) / iterations;
+
+  printf("Iterations: %llu\n", iterations);
+  printf("Null syscall: %llu cycles\n", null_cycles);
+  printf("Call/reply round trip: %llu cycles\n", call_cycles);
+
+  return 0;
+}
+
+// Answer calls forever. The first word of each reply is one more than the first word of the request, and the rest
+// are echoed back.
+void server_thread()
+{
+  msg_call_details call = { 0, { { 0, 0, 0, 0 } } };
+
+  // The first reply is skipped, since there is no call to reply to yet.
+  while (1)
+  {
+    syscall_reply_and_receive_call(call.request.words[0] + 1,
+                                   call.request.words[1],
+                                   call.request.words[2],
+                                   call.request.words[3],
+                                   &call);
+  }
+}
+
+uint64_t read_tsc()
+{
+  uint32_t low;
+  uint32_t high;
+
+  asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+
+  return (static_cast<uint64_t>(high) << 32) | low;
+}
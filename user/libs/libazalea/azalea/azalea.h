@@ -5,15 +5,18 @@
 
 // Parts of the API defined in the kernel.
 #include <azalea/error_codes.h>
+#include <azalea/io_ring.h>
 #include <azalea/kernel_types.h>
 #include <azalea/keyboard.h>
 #include <azalea/macros.h>
 #include <azalea/messages.h>
+#include <azalea/shared_page.h>
 #include <azalea/syscall.h>
 #include <azalea/system_properties.h>
 
 // Parts of the API executed in user mode.
 #include <azalea/processes.h>
+#include <azalea/system_info.h>
 
 // General functions that don't have a more specific header file.
 #ifdef __cplusplus
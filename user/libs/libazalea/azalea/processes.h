@@ -58,6 +58,7 @@ ERR_CODE exec_file(const char *filename,
                    char * const argv[],
                    char * const envp[]);
 ERR_CODE proc_read_elf_file_header(GEN_HANDLE proc_file, elf64_file_header *header);
+ERR_CODE proc_check_elf_file_header(const elf64_file_header *header, uint64_t file_size);
 ERR_CODE proc_read_elf_prog_header(GEN_HANDLE proc_file,
                                    elf64_file_header *file_header,
                                    elf64_program_header *prog_header,
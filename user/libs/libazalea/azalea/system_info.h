@@ -0,0 +1,20 @@
+/// @file
+/// @brief Fast access to information the kernel publishes in the shared page.
+
+#pragma once
+
+#include <azalea/error_codes.h>
+#include <azalea/kernel_types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+ERR_CODE time_get_monotonic_ns(uint64_t *ns_since_boot);
+ERR_CODE proc_get_current_cpu(uint32_t *cpu_id);
+ERR_CODE proc_get_current_thread(uint64_t *thread_id, uint64_t *process_id);
+
+#ifdef __cplusplus
+};
+#endif
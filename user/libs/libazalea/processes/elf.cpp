@@ -40,6 +40,24 @@ ERR_CODE proc_read_elf_file_header(GEN_HANDLE proc_file, elf64_file_header *head
     return result;
   }
 
+  return proc_check_elf_file_header(header, elf_file_size);
+}
+
+/// @brief Check that an ELF file header describes an executable file we understand.
+///
+/// @param header The header to check.
+///
+/// @param file_size The size of the whole ELF file, in bytes.
+///
+/// @return ERR_CODE::UNRECOGNISED if the file isn't an ELF file we understand. ERR_CODE::INVALID_PARAM if header ==
+///         nullptr. ERR_CODE::NO_ERROR if the header is acceptable.
+ERR_CODE proc_check_elf_file_header(const elf64_file_header *header, uint64_t file_size)
+{
+  if (header == nullptr)
+  {
+    return ERR_CODE::INVALID_PARAM;
+  }
+
   if (!((header->ident[0] == 0x7f) &&
         (header->ident[1] == 'E') &&
         (header->ident[2] == 'L') &&
@@ -49,7 +67,7 @@ ERR_CODE proc_read_elf_file_header(GEN_HANDLE proc_file, elf64_file_header *head
       (header->ident[6] != 1) || // ELF version 1.
       (header->type != 2) || // Executable.
       (header->version != 1) || // ELF version 1 (again!)
-      !((header->prog_hdrs_off > 0) && (header->prog_hdrs_off < (elf_file_size - ELF64_PROG_HDR_SIZE))) ||
+      !((header->prog_hdrs_off > 0) && (header->prog_hdrs_off < (file_size - ELF64_PROG_HDR_SIZE))) ||
       (header->num_prog_hdrs == 0) ||
       (header->entry_addr >= 0x8000000000000000LL) ||
       (header->file_header_size < ELF64_FILE_HDR_SIZE) ||
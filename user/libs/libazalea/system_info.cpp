@@ -0,0 +1,161 @@
+/// @file
+/// @brief Read the time, and the current processor and thread, from the kernel's shared page.
+///
+/// The kernel maps a read-only page into every user mode process - see shared_page.h for its layout. Reading it is much
+/// cheaper than a system call. Each block in the page carries a sequence number that is odd while the kernel is
+/// updating it, so the functions below retry until they have read a consistent copy.
+
+#include <azalea/azalea.h>
+
+namespace
+{
+  const shared_page_layout *shared_page = reinterpret_cast<const shared_page_layout *>(SHARED_PAGE_USER_ADDR);
+
+  uint64_t read_tsc()
+  {
+    uint32_t low;
+    uint32_t high;
+
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+
+    return (static_cast<uint64_t>(high) << 32) | low;
+  }
+
+  // The kernel stores its ID for each processor in IA32_TSC_AUX, which RDTSCP returns in ECX.
+  uint32_t read_cpu_id()
+  {
+    uint32_t low;
+    uint32_t high;
+    uint32_t aux;
+
+    asm volatile ("rdtscp" : "=a"(low), "=d"(high), "=c"(aux));
+
+    return aux;
+  }
+}
+
+/// @brief Get the number of nanoseconds since the system timer was started.
+///
+/// If the kernel was able to calibrate the TSC, this is done without entering the kernel. Otherwise, it falls back to
+/// syscall_get_system_clock(). Both give the same clock.
+///
+/// @param ns_since_boot[out] The number of nanoseconds since the system timer was started.
+///
+/// @return ERR_CODE::INVALID_PARAM if ns_since_boot is nullptr. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE time_get_monotonic_ns(uint64_t *ns_since_boot)
+{
+  uint64_t sequence;
+  uint64_t base_tsc;
+  uint64_t base_ns;
+  uint64_t tsc_mult;
+  uint64_t tsc;
+
+  if (ns_since_boot == nullptr)
+  {
+    return ERR_CODE::INVALID_PARAM;
+  }
+
+  if ((shared_page->flags & SHARED_PAGE_FLAG_TSC_USABLE) == 0)
+  {
+    return syscall_get_system_clock(ns_since_boot);
+  }
+
+  do
+  {
+    sequence = shared_page->time.sequence;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    base_tsc = shared_page->time.base_tsc;
+    base_ns = shared_page->time.base_ns;
+    tsc_mult = shared_page->time.tsc_mult;
+    tsc = read_tsc();
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (((sequence & 1) != 0) || (sequence != shared_page->time.sequence));
+
+  *ns_since_boot = shared_page_tsc_to_ns(base_tsc, base_ns, tsc_mult, tsc);
+
+  return ERR_CODE::NO_ERROR;
+}
+
+/// @brief Get the ID of the processor this thread is running on.
+///
+/// The thread may have moved to another processor by the time this function returns, so the result is only a hint.
+///
+/// @param cpu_id[out] The kernel's ID for the processor this thread was running on.
+///
+/// @return ERR_CODE::INVALID_PARAM if cpu_id is nullptr. ERR_CODE::INVALID_OP if the processor doesn't support
+///         RDTSCP. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE proc_get_current_cpu(uint32_t *cpu_id)
+{
+  if (cpu_id == nullptr)
+  {
+    return ERR_CODE::INVALID_PARAM;
+  }
+
+  if ((shared_page->flags & SHARED_PAGE_FLAG_CPU_ID_USABLE) == 0)
+  {
+    return ERR_CODE::INVALID_OP;
+  }
+
+  *cpu_id = read_cpu_id();
+
+  return ERR_CODE::NO_ERROR;
+}
+
+/// @brief Get the IDs of the calling thread and its process.
+///
+/// These are the same IDs that the kernel uses elsewhere - for example, process IDs match the sending process IDs of
+/// messages.
+///
+/// The kernel records which thread each processor is running. The result is only accepted if this thread was on the
+/// same processor before and after reading that record, and the processor did not switch threads in the meantime -
+/// which means the record must have described this thread.
+///
+/// @param thread_id[out] The ID of the calling thread.
+///
+/// @param process_id[out] The ID of the process that owns the calling thread. May be nullptr if not needed.
+///
+/// @return ERR_CODE::INVALID_PARAM if thread_id is nullptr. ERR_CODE::INVALID_OP if the processor doesn't support
+///         RDTSCP. ERR_CODE::NO_ERROR otherwise.
+ERR_CODE proc_get_current_thread(uint64_t *thread_id, uint64_t *process_id)
+{
+  uint32_t start_cpu;
+  uint32_t end_cpu;
+  uint64_t start_sequence;
+  uint64_t end_sequence;
+  uint64_t thread;
+  uint64_t process;
+
+  if (thread_id == nullptr)
+  {
+    return ERR_CODE::INVALID_PARAM;
+  }
+
+  if ((shared_page->flags & SHARED_PAGE_FLAG_CPU_ID_USABLE) == 0)
+  {
+    return ERR_CODE::INVALID_OP;
+  }
+
+  do
+  {
+    start_cpu = read_cpu_id();
+    start_sequence = shared_page->cpus[start_cpu].sequence;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    thread = shared_page->cpus[start_cpu].thread_id;
+    process = shared_page->cpus[start_cpu].process_id;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    end_cpu = read_cpu_id();
+    end_sequence = shared_page->cpus[start_cpu].sequence;
+  } while (((start_sequence & 1) != 0) || (start_cpu != end_cpu) || (start_sequence != end_sequence));
+
+  *thread_id = thread;
+  if (process_id != nullptr)
+  {
+    *process_id = process;
+  }
+
+  return ERR_CODE::NO_ERROR;
+}
@@ -0,0 +1,93 @@
+// Measures the cost of entering and leaving the kernel via the syscall instruction.
+//
+// Two cases are measured:
+// - A "null" system call, using an index beyond the end of the system call table. The kernel rejects it straight
+//   away in the entry code, so this is the cost of the entry and exit path alone.
+// - A real system call that fails quickly (closing a handle that doesn't exist), which adds the dispatch into C code.
+
+#include <azalea/azalea.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" int main (int argc, char **argv);
+
+uint64_t null_syscall();
+uint64_t read_tsc();
+
+const uint64_t DEFAULT_ITERATIONS = 100000;
+const uint64_t WARMUP_ITERATIONS = 1000;
+
+// Far beyond the end of the system call table.
+const uint64_t NULL_SYSCALL_IDX = 0xFFFF;
+
+// No handle is ever given this value.
+const GEN_HANDLE INVALID_HANDLE = 0xFFFFFFFFFFFFFFFF;
+
+int main (int argc, char **argv)
+{
+  uint64_t iterations = DEFAULT_ITERATIONS;
+  uint64_t start_time;
+  uint64_t end_time;
+  uint64_t null_cycles;
+  uint64_t dispatch_cycles;
+
+  if (argc > 1)
+  {
+    iterations = strtoull(argv[1], nullptr, 10);
+  }
+  if (iterations == 0)
+  {
+    iterations = DEFAULT_ITERATIONS;
+  }
+
+  for (uint64_t i = 0; i < WARMUP_ITERATIONS; i++)
+  {
+    null_syscall();
+  }
+
+  start_time = read_tsc();
+  for (uint64_t i = 0; i < iterations; i++)
+  {
+    null_syscall();
+  }
+  end_time = read_tsc();
+  null_cycles = (end_time - start_time) / iterations;
+
+  start_time = read_tsc();
+  for (uint64_t i = 0; i < iterations; i++)
+  {
+    syscall_close_handle(INVALID_HANDLE);
+  }
+  end_time = read_tsc();
+  dispatch_cycles = (end_time - start_time) / iterations;
+
+  printf("Iterations: %llu\n", iterations);
+  printf("Null syscall: %llu cycles\n", null_cycles);
+  printf("Dispatched syscall: %llu cycles\n", dispatch_cycles);
+
+  return 0;
+}
+
+// Make a system call with an out-of-range index. The kernel preserves the same registers as for any other system
+// call, so tell the compiler that the rest may be changed.
+uint64_t null_syscall()
+{
+  uint64_t result;
+
+  asm volatile ("syscall"
+                : "=a"(result)
+                : "a"(NULL_SYSCALL_IDX)
+                : "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11", "memory");
+
+  return result;
+}
+
+uint64_t read_tsc()
+{
+  uint32_t low;
+  uint32_t high;
+
+  asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+
+  return (static_cast<uint64_t>(high) << 32) | low;
+}